@@ -46,6 +46,15 @@ using namespace jdip;
 #define track(ct)
 #endif
 
+/// Record in an AST node where the token it was made from was read, for error reporting.
+#ifdef NO_ERROR_REPORTING
+  #define note_origin(node, token)
+#elif defined(NO_ERROR_POSITION)
+  #define note_origin(node, token) { int p_ = -1; (node)->linenum = -1; token.locate((node)->filename, (node)->linenum, p_); }
+#else
+  #define note_origin(node, token) ((node)->linenum = (node)->pos = -1, token.locate((node)->filename, (node)->linenum, (node)->pos))
+#endif
+
 #include "AST_operator.h"
 
 namespace jdi
@@ -74,8 +83,8 @@ namespace jdi
                   if (!--depth) { token = tk; break; }
               } else if (tk.type == TT_LEFTPARENTH) ++depth;
               else if (tk.type == TT_ENDOFCODE) break;
-              else if (tk.type != TT_OPERATOR or tk.content.len != 1
-                   or (*tk.content.str != '*' and *tk.content.str != '&'))
+              else if (tk.type != TT_OPERATOR or tk.len != 1
+                   or (*tk.str != '*' and *tk.str != '&'))
                 is_cast = false;
             }
             if (token.type != TT_RIGHTPARENTH) {
@@ -89,35 +98,23 @@ namespace jdi
               read_referencers(ft.refs, ft, lex, token, search_scope, NULL, herr); // Read all referencers
               track(ft.refs.toString());
               myroot = new AST_Node_Type(ft);
-              token_basics(
-                myroot->type = AT_TYPE,
-                myroot->filename = (const char*)token.file,
-                myroot->linenum = token.linenum,
-                myroot->pos = token.pos
-              );
+              myroot->type = AT_TYPE;
+              note_origin(myroot, token);
             }
             else {
               AST_Node_Cast* nr = new AST_Node_Cast(parse_expression(token, 0), ft);
               nr->content = nr->cast_type.toString();
               myroot = nr;
-              token_basics(
-                myroot->type = AT_UNARY_PREFIX,
-                myroot->filename = (const char*)token.file,
-                myroot->linenum = token.linenum,
-                myroot->pos = token.pos
-              );
+              myroot->type = AT_UNARY_PREFIX;
+              note_origin(myroot, token);
             }
             lex = lb.fallback_lexer;
           }
           else {
             read_referencers(ft.refs, ft, lex, token, search_scope, NULL, herr); // Read all referencers
             myroot = new AST_Node_Type(ft);
-            token_basics(
-              myroot->type = AT_TYPE,
-              myroot->filename = (const char*)token.file,
-              myroot->linenum = token.linenum,
-              myroot->pos = token.pos
-            );
+            myroot->type = AT_TYPE;
+            note_origin(myroot, token);
           }
           if (token.type == TT_RIGHTPARENTH) // Facilitate casts
             return myroot;
@@ -125,8 +122,8 @@ namespace jdi
         } break;
       
       case TT_IDENTIFIER: case TT_DEFINITION: {
+          const string n(token.type == TT_DEFINITION? token.def->name : token.toString());
           if (search_scope) {
-            string n(token.content.toString());
             definition *def = search_scope->look_up(n);
             if (def) {
               myroot = new AST_Node_Definition(def);
@@ -141,7 +138,7 @@ namespace jdi
             myroot = new AST_Node();
             at = AT_IDENTIFIER;
           }
-          myroot->content = token.content.toString();
+          myroot->content = n;
           track(myroot->content);
         } break;
       
@@ -154,8 +151,8 @@ namespace jdi
         return NULL;
       
       case TT_OPERATOR: case TT_TILDE: {
-        ct = token.content.toString();
-        symbol& op = symbols[ct];
+        ct = token.toString();
+        const symbol& op = symbols.get(ct);
         if (not(op.type & ST_UNARY_PRE)) {
           token.report_error(herr,"Operator cannot be used as unary prefix");
           return NULL;
@@ -189,7 +186,7 @@ namespace jdi
         if (myroot->type == AT_TYPE) {
           AST_Node_Type *ad = (AST_Node_Type*)myroot;
           token = get_next_token(); read_next = true;
-          AST_Node_Cast *nr = new AST_Node_Cast(parse_expression(token, symbols["(cast)"].prec_unary_pre));
+          AST_Node_Cast *nr = new AST_Node_Cast(parse_expression(token, symbols.get("(cast)").prec_unary_pre));
           nr->cast_type.swap(ad->dec_type); nr->content = nr->cast_type.toString();
           delete myroot; myroot = nr;
         }
@@ -237,7 +234,7 @@ namespace jdi
         
         bool stillgoing = true;
         while (token.type == TT_OPERATOR) {
-          if (token.content.len != 1 or *token.content.str != '*') {
+          if (token.len != 1 or *token.str != '*') {
             stillgoing = false;
             break;
           }
@@ -279,14 +276,14 @@ namespace jdi
         return NULL;
       
       case TT_STRINGLITERAL:
-      case TT_CHARLITERAL: myroot = new AST_Node(); myroot->content = token.content.toString();
+      case TT_CHARLITERAL: myroot = new AST_Node(); myroot->content = token.toString();
                            track(myroot->content); at = AT_CHRLITERAL; break;
       
-      case TT_DECLITERAL: myroot = new AST_Node(); myroot->content = token.content.toString();
+      case TT_DECLITERAL: myroot = new AST_Node(); myroot->content = token.toString();
                           track(myroot->content); at = AT_DECLITERAL; break;
-      case TT_HEXLITERAL: myroot = new AST_Node(); myroot->content = token.content.toString();
+      case TT_HEXLITERAL: myroot = new AST_Node(); myroot->content = token.toString();
                           track(myroot->content); at = AT_HEXLITERAL; break;
-      case TT_OCTLITERAL: myroot = new AST_Node(); myroot->content = token.content.toString();
+      case TT_OCTLITERAL: myroot = new AST_Node(); myroot->content = token.toString();
                           track(myroot->content); at = AT_OCTLITERAL; break;
       
       case TT_DECLTYPE:
@@ -331,13 +328,10 @@ namespace jdi
       case TT_INVALID: default: token.report_error(herr, "Invalid token type returned!");
         return NULL;
     }
-    if (!handled_basics)
-      token_basics(
-        myroot->type = at,
-        myroot->filename = (const char*)token.file,
-        myroot->linenum = token.linenum,
-        myroot->pos = token.pos
-      );
+    if (!handled_basics) {
+      myroot->type = at;
+      note_origin(myroot, token);
+    }
     if (!read_next)
       token = get_next_token();
     
@@ -399,13 +393,13 @@ namespace jdi
         break;
       }
       case TT_OPERATOR: case_TT_OPERATOR: {
-          string op(token.content.toString());
-          map<string,symbol>::iterator b = symbols.find(op);
+          string op(token.toString());
+          symbol_iter b = symbols.find(op);
           if (b == symbols.end()) {
-            token.report_error(herr, "Operator `" + token.content.toString() + "' not defined");
+            token.report_error(herr, DIAG_MISUSE, "Operator `%s' not defined", token.toString());
             delete left_node; return NULL;
           }
-          symbol &s = b->second;
+          const symbol &s = b->second;
           if (s.type & ST_BINARY) {
             if (s.prec_binary < prec_min)
               return left_node;
@@ -422,7 +416,7 @@ namespace jdi
           if (s.type & ST_TERNARY) {
             if (s.prec_binary < prec_min)
               return left_node;
-            string ct(token.content.toString());
+            string ct(token.toString());
             track(ct);
             
             token = get_next_token();
@@ -648,7 +642,7 @@ namespace jdi
     if (!left or !right) return value();
     symbol_iter si = symbols.find(content);
     if (si == symbols.end()) return value();
-    symbol &s = si->second;
+    const symbol &s = si->second;
     if (!s.operate) return value();
     value l = left->eval(), r = right->eval();
     value res = s.operate(l, r);
@@ -670,13 +664,13 @@ namespace jdi
   value AST::AST_Node_Unary::eval() const {
     if (!operand) { cerr << "No operand to unary (operator" << content << ")!" << endl; return value(); }
     if (prefix) {
-      if (!symbols[content].operate_unary_pre) { cerr << "No method to unary (operator" << content << ")!" << endl; return value(); }
-      value b4 = operand->eval(), after = symbols[content].operate_unary_pre(b4);
+      if (!symbols.get(content).operate_unary_pre) { cerr << "No method to unary (operator" << content << ")!" << endl; return value(); }
+      value b4 = operand->eval(), after = symbols.get(content).operate_unary_pre(b4);
       return after;
     }
     else {
-      if (!symbols[content].operate_unary_post) { cerr << "No method to unary (operator" << content << ")!" << endl; return value(); }
-      value b4 = operand->eval(), after = symbols[content].operate_unary_post(b4);
+      if (!symbols.get(content).operate_unary_post) { cerr << "No method to unary (operator" << content << ")!" << endl; return value(); }
+      value b4 = operand->eval(), after = symbols.get(content).operate_unary_post(b4);
       return after;
     }
   }
@@ -908,7 +902,7 @@ namespace jdi
   
   AST::AST_Node::AST_Node(): parent(NULL) {}
   AST::AST_Node::AST_Node(string ct): parent(NULL), content(ct) {}
-  AST::AST_Node_Definition::AST_Node_Definition(definition* d): def(d) {}
+  AST::AST_Node_Definition::AST_Node_Definition(definition* d): def(d) { if (d) d->flags |= DEF_REFERENCED; }
   AST::AST_Node_Scope::AST_Node_Scope(AST_Node* l, AST_Node* r, string op): AST_Node_Binary(l,r,op) {}
   AST::AST_Node_Type::AST_Node_Type(full_type &ft) { dec_type.swap(ft); }
   AST::AST_Node_Unary::AST_Node_Unary(AST_Node* r): operand(r) {}
@@ -975,6 +969,104 @@ namespace jdi
   void AST::AST_Node_delete::operate(ConstASTOperator *aop, void *param) const { aop->operate_delete(this, param); }
   void AST::AST_Node_Subscript::operate(ConstASTOperator *aop, void *param) const { aop->operate_Subscript(this, param); }
   
+  struct AST::node_copier: ConstASTOperator {
+    /// Copy a node, or return NULL if given NULL.
+    AST_Node *copy(const AST_Node *x) {
+      if (!x) return NULL;
+      AST_Node *res = NULL;
+      x->operate(this, &res);
+      return res;
+    }
+    /// Copy a child, giving it its new parent.
+    AST_Node *child(const AST_Node *x, AST_Node *parent) {
+      AST_Node *res = copy(x);
+      if (res) res->parent = parent;
+      return res;
+    }
+    /// Copy what every node has, and hand the node back through \p param.
+    void common(const AST_Node *x, AST_Node *res, void *param) {
+      res->type = x->type;
+      res->content = x->content;
+      res->precedence = x->precedence;
+      #ifndef NO_ERROR_REPORTING
+        res->filename = x->filename;
+        res->linenum = x->linenum;
+        #ifndef NO_ERROR_POSITION
+          res->pos = x->pos;
+        #endif
+      #endif
+      *(AST_Node**)param = res;
+    }
+    void copy_unary(const AST_Node_Unary *x, AST_Node_Unary *res, void *param) {
+      common(x, res, param);
+      res->operand = child(x->operand, res);
+      res->prefix = x->prefix;
+    }
+    
+    void operate(const AST_Node *x, void *param) { common(x, new AST_Node(), param); }
+    void operate_Definition(const AST_Node_Definition *x, void *param) { common(x, new AST_Node_Definition(x->def), param); }
+    void operate_Scope(const AST_Node_Scope *x, void *param) {
+      AST_Node_Scope *res = new AST_Node_Scope(NULL, NULL, string());
+      common(x, res, param);
+      res->left = child(x->left, res), res->right = child(x->right, res);
+    }
+    void operate_Type(const AST_Node_Type *x, void *param) {
+      full_type ft; ft.copy(x->dec_type);
+      common(x, new AST_Node_Type(ft), param);
+    }
+    void operate_Unary(const AST_Node_Unary *x, void *param) { copy_unary(x, new AST_Node_Unary(), param); }
+    void operate_sizeof(const AST_Node_sizeof *x, void *param) { copy_unary(x, new AST_Node_sizeof(NULL, x->negate), param); }
+    void operate_Cast(const AST_Node_Cast *x, void *param) { copy_unary(x, new AST_Node_Cast(NULL, x->cast_type), param); }
+    void operate_delete(const AST_Node_delete *x, void *param) { copy_unary(x, new AST_Node_delete(NULL, x->array), param); }
+    void operate_Binary(const AST_Node_Binary *x, void *param) {
+      AST_Node_Binary *res = new AST_Node_Binary();
+      common(x, res, param);
+      res->left = child(x->left, res), res->right = child(x->right, res);
+    }
+    void operate_Ternary(const AST_Node_Ternary *x, void *param) {
+      AST_Node_Ternary *res = new AST_Node_Ternary();
+      common(x, res, param);
+      res->exp = child(x->exp, res), res->left = child(x->left, res), res->right = child(x->right, res);
+    }
+    void operate_Parameters(const AST_Node_Parameters *x, void *param) {
+      AST_Node_Parameters *res = new AST_Node_Parameters();
+      common(x, res, param);
+      res->func = child(x->func, res);
+      res->params.reserve(x->params.size());
+      for (size_t i = 0; i < x->params.size(); ++i)
+        res->params.push_back(child(x->params[i], res));
+    }
+    void operate_Array(const AST_Node_Array *x, void *param) {
+      AST_Node_Array *res = new AST_Node_Array();
+      common(x, res, param);
+      res->elements.reserve(x->elements.size());
+      for (size_t i = 0; i < x->elements.size(); ++i)
+        res->elements.push_back(child(x->elements[i], res));
+    }
+    void operate_new(const AST_Node_new *x, void *param) {
+      AST_Node_new *res = new AST_Node_new();
+      common(x, res, param);
+      res->type.copy(x->type);
+      res->position = child(x->position, res), res->bound = child(x->bound, res);
+    }
+    void operate_Subscript(const AST_Node_Subscript *x, void *param) {
+      AST_Node_Subscript *res = new AST_Node_Subscript();
+      common(x, res, param);
+      res->left = child(x->left, res), res->index = child(x->index, res);
+    }
+  };
+  
+  AST *AST::duplicate() const {
+    AST *res = new AST();
+    node_copier nc;
+    res->root = nc.copy(root);
+    res->tt_greater_is_op = tt_greater_is_op;
+    #ifdef DEBUG_MODE
+      res->expression = expression;
+    #endif
+    return res;
+  }
+  
   //===========================================================================================================================
   //=: Everything else :=======================================================================================================
   //===========================================================================================================================
@@ -30,6 +30,7 @@
 #define _AST__H__DEBUG // Used in debug_macros.h. Do not rename on a whim.
 
 namespace jdi { class AST; }
+namespace jdip { struct image_writer; struct image_reader; }
 
 #include <string>
 #include <System/token.h>
@@ -72,8 +73,13 @@ namespace jdi {
     /// This class can export SVG files. Some info needs tossed around to do so.
     struct SVGrenderInfo;
     
+    /// Copies each kind of node, with its children; see AST.cpp.
+    struct node_copier;
+    
     friend struct jdi::ASTOperator;
     friend struct jdi::ConstASTOperator;
+    friend struct jdip::image_writer;
+    friend struct jdip::image_reader;
     
     /** Private storage mechanism designed to hold token information and any linkages.
         In general, a node has no linkages, and so we use AST_Node as the base class for
@@ -421,6 +427,9 @@ namespace jdi {
     /// Clear the AST out, effectively creating a new instance of this class
     void clear();
     
+    /// Allocate a copy of this AST, node for node. Definitions named are shared, not copied.
+    AST *duplicate() const;
+    
     /// Check if this AST is empty.
     bool empty();
     
@@ -19,6 +19,9 @@
  * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
 **/
  
+#ifndef _COMPILE_SETTINGS__H
+#define _COMPILE_SETTINGS__H
+
 /// True if comments ending in backslashes should continue onto the next line.
 #define ALLOW_MULTILINE_COMMENTS 1
 
@@ -47,3 +50,11 @@
   #define FATAL_TERNARY(fatal,nonfatal) nonfatal
   #define IF_FATAL(fatal) fatal
 #endif
+
+/// True if parses may be timed, into a \c jdi::parse_stats. Timing costs a little on every parse given
+/// somewhere to put it, and a test on each phase of those which are not; define as 1 to compile it in.
+#ifndef PARSE_STATS
+  #define PARSE_STATS 0
+#endif
+
+#endif
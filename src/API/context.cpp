@@ -30,17 +30,162 @@ using namespace std;
 #include "context.h"
 #include <System/macros.h>
 #include <System/builtins.h>
+#include <General/llreader.h>
+#include <General/parse_basics.h>
+#include <Parser/reparse.h>
+#include <Parser/parse_budget.h>
 
 using namespace jdi;
 using namespace jdip;
 
-void context::read_macros(const char* filename)
+/// Read the rest of a directive line into res, dropping comments. Continued lines are kept with
+/// their backslash and newline, as the lexer keeps them. Returns the position of the newline ending the directive.
+static size_t read_directive_line(const char *data, size_t len, size_t pos, size_t &line, string &res)
 {
-  ifstream in(filename);
-  if (!in.is_open())
-    return;
-  // TODO: IMPLEMENT
-  in.close();
+  size_t spos = pos;
+  while (pos < len and data[pos] != '\n' and data[pos] != '\r') {
+    if (data[pos] == '\\' and pos + 1 < len and (data[pos+1] == '\n' or data[pos+1] == '\r')) {
+      pos += (data[pos+1] == '\r' and pos + 2 < len and data[pos+2] == '\n')? 3 : 2;
+      ++line;
+    }
+    else if (data[pos] == '"' or data[pos] == '\'') {
+      const char q = data[pos++];
+      while (pos < len and data[pos] != q and data[pos] != '\n')
+        pos += (data[pos] == '\\')? 2 : 1;
+      if (pos < len and data[pos] == q) ++pos;
+      else if (pos > len) pos = len;
+    }
+    else if (data[pos] == '/' and pos + 1 < len and data[pos+1] == '/') {
+      res.append(data + spos, pos - spos);
+      while (pos < len and data[pos] != '\n') ++pos;
+      return pos;
+    }
+    else if (data[pos] == '/' and pos + 1 < len and data[pos+1] == '*') {
+      res.append(data + spos, pos - spos), res += ' ';
+      for (pos += 2; pos < len and !(data[pos] == '*' and pos + 1 < len and data[pos+1] == '/'); ++pos)
+        if (data[pos] == '\n') ++line;
+      spos = pos = (pos < len)? pos + 2 : len;
+    }
+    else ++pos;
+  }
+  res.append(data + spos, pos - spos);
+  return pos;
+}
+
+int context::read_macros(const char* filename, error_handler *errhandl)
+{
+  if (errhandl)
+    herr = errhandl;
+  llreader in(filename);
+  if (!in.is_open()) {
+    herr->error("Could not open macro file for reading", filename);
+    return 1;
+  }
+  
+  const char *const data = in.data;
+  const size_t len = in.length;
+  
+  string dline;
+  dline.reserve(256);
+  size_t line = 1;
+  for (size_t pos = 0; pos < len; ++pos, ++line)
+  {
+    while (pos < len and (data[pos] == ' ' or data[pos] == '\t')) ++pos;
+    if (pos < len and data[pos] == '#') {
+      while (++pos < len and (data[pos] == ' ' or data[pos] == '\t'));
+      const bool define = len - pos > 6 and !memcmp(data + pos, "define", 6) and !is_letterd(data[pos+6]);
+      const bool undef = !define and len - pos > 5 and !memcmp(data + pos, "undef", 5) and !is_letterd(data[pos+5]);
+      if (define or undef) {
+        const size_t dl = line;
+        pos += define? 6 : 5;
+        
+        // Most lines hold nothing needing special care; copy those whole.
+        const char *const bol = data + pos, *eol = (const char*)memchr(bol, '\n', len - pos);
+        if (!eol) eol = data + len;
+        if (eol > bol and eol[-1] == '\r') --eol;
+        const size_t ll = eol - bol;
+        if (memchr(bol, '\\', ll) or memchr(bol, '/', ll) or memchr(bol, '"', ll) or memchr(bol, '\'', ll)) {
+          dline.clear();
+          pos = read_directive_line(data, len, pos, line, dline);
+        }
+        else
+          dline.assign(bol, ll), pos += ll;
+        
+        const char *argstr = dline.c_str();
+        size_t i = 0;
+        while (is_useless(argstr[i])) ++i;
+        if (!is_letter(argstr[i]))
+          herr->error("Expected macro definiendum at this point", filename, dl, 0);
+        else {
+          const size_t nsi = i;
+          while (is_letterd(argstr[++i]));
+          const string name = dline.substr(nsi, i - nsi);
+          size_t trim = dline.length();
+          while (trim > i and is_useless(argstr[trim - 1])) --trim;
+          
+          if (undef) {
+            macro_iter it = macros.find(name);
+            if (it != macros.end()) {
+              macro_type::free(it->second);
+              macros.erase(it);
+            }
+          }
+          else {
+            const macro_type *m;
+            if (argstr[i] == '(') {
+              vector<string> paramlist;
+              bool variadic = false;
+              while (is_useless(argstr[++i]));
+              while (argstr[i] != ')') {
+                if (argstr[i] == '.' and argstr[i+1] == '.' and argstr[i+2] == '.') {
+                  variadic = true, i += 3;
+                  while (is_useless(argstr[i])) ++i;
+                  if (argstr[i] != ')')
+                    herr->error("Expected end of parameters after variadic", filename, dl, i);
+                  break;
+                }
+                if (!is_letter(argstr[i])) {
+                  herr->error("Expected parameter name for macro declaration", filename, dl, i);
+                  break;
+                }
+                const size_t si = i;
+                while (is_letterd(argstr[++i]));
+                paramlist.push_back(dline.substr(si, i - si));
+                while (is_useless(argstr[i])) ++i;
+                if (argstr[i] == ',') while (is_useless(argstr[++i]));
+                else if (argstr[i] == '.' and argstr[i+1] == '.' and argstr[i+2] == '.') { // GNU named variadic
+                  variadic = true, i += 3;
+                  while (is_useless(argstr[i])) ++i;
+                  if (argstr[i] != ')')
+                    herr->error("Expected closing parenthesis at this point; further parameters not allowed following variadic", filename, dl, i);
+                  break;
+                }
+                else if (argstr[i] != ')') {
+                  herr->error("Expected comma or closing parenthesis at this point", filename, dl, i);
+                  break;
+                }
+              }
+              if (argstr[i] == ')') ++i;
+              if (i > trim) trim = i;
+              m = new macro_function(name, paramlist, dline.substr(i, trim - i), variadic, herr);
+            }
+            else {
+              while (i < trim and is_useless(argstr[i])) ++i;
+              m = new macro_scalar(name, dline.substr(i, trim - i));
+            }
+            pair<macro_iter, bool> mins = macros.insert(macro_map::value_type(name, m));
+            if (!mins.second) {
+              macro_type::free(mins.first->second);
+              mins.first->second = m;
+            }
+          }
+        }
+      }
+    }
+    while (pos < len and data[pos] != '\n') ++pos;
+  }
+  
+  return 0;
 }
 void context::add_macro(string definiendum, string definiens) {
   macros[definiendum] = (macro_type*)new macro_scalar(definiendum, definiens);
@@ -114,12 +259,70 @@ void context::add_search_directory(string dir)
 {
   search_directories.push_back(dir);
 }
+void context::memoize_headers(bool enable)
+{
+  memoizing = enable;
+}
+
+void context::harvest_macros_only(bool enable)
+{
+  harvesting = enable;
+}
+
+void context::retain(unsigned flags)
+{
+  retention = flags;
+}
+unsigned context::retained() const
+{
+  return retention;
+}
+
+void context::limit_parses(const parse_limits &limits)
+{
+  delete budget;
+  budget = limits.max_errors or limits.max_usec or limits.cancel? new parse_budget(limits) : NULL;
+}
+parse_limits context::parse_limit() const
+{
+  return budget? budget->limits : parse_limits();
+}
+parse_end context::parse_ending() const
+{
+  return ending;
+}
+
+void context::report_declarations(declaration_handler *handler, bool drop)
+{
+  hdecl = handler;
+  dropping = drop;
+}
+
+string declaration::scope_path() const
+{
+  string res;
+  for (const definition_scope *s = scope; s and s->parent; s = s->parent)
+    res = res.empty()? s->name : s->name + "::" + res;
+  return res;
+}
 
 static definition* find_mirror(definition *x, definition_scope* root) {
   if (x) return ((definition_scope*)find_mirror(x->parent, root))->look_up(x->name);
   return root;
 }
 
+/// Find the definition standing in one tree where the given definition stands in another, by the names
+/// of the scopes holding it, or NULL if there is none.
+static definition *mirror_in(definition *x, const definition_scope *from, definition_scope *to) {
+  if (x == from)
+    return to;
+  definition *p = x and x->parent? mirror_in(x->parent, from, to) : NULL;
+  if (!p or !(p->flags & DEF_SCOPE))
+    return NULL;
+  definition_scope::defiter it = ((definition_scope*)p)->members.find(x->name);
+  return it == ((definition_scope*)p)->members.end()? NULL : it->second;
+}
+
 void context::reset()
 {
   
@@ -130,12 +333,19 @@ void context::reset_all()
 }
 void context::copy(const context &ct)
 {
-  ct.global->copy(global);
+  global->copy(ct.global);
+  memoizing = ct.memoizing;
+  harvesting = ct.harvesting;
+  retention = ct.retention;
+  if (ct.budget)
+    limit_parses(ct.budget->limits);
+  for (size_t i = 0; i < ct.search_directories.size(); ++i)
+    search_directories.push_back(ct.search_directories[i]);
   for (macro_iter_c mi = ct.macros.begin(); mi != ct.macros.end(); ++mi){
     pair<macro_iter,bool> dest = macros.insert(pair<string,macro_type*>(mi->first,NULL));
     if (dest.second) {
       dest.first->second = mi->second;
-      ++mi->second->refc;
+      macro_type::retain(mi->second);
     }
   }
   for (set<definition*>::iterator it = ct.variadics.begin(); it != ct.variadics.end(); ++it) {
@@ -144,6 +354,9 @@ void context::copy(const context &ct)
     else
       variadics.insert(*it);
   }
+  for (set<pair<definition*, string> >::const_iterator it = ct.skipped_privates.begin(); it != ct.skipped_privates.end(); ++it)
+    if (definition *cls = mirror_in(it->first, ct.global, global))
+      skipped_privates.insert(pair<definition*, string>(cls, it->second));
 }
 void context::swap(context &ct) {
   if (!parse_open and !ct.parse_open) {
@@ -151,10 +364,69 @@ void context::swap(context &ct) {
       ct.global = global; global = gs; }
     macros.swap(ct.macros);
     variadics.swap(ct.variadics);
+    skipped_privates.swap(ct.skipped_privates);
   }
   else cerr << "ERROR! Cannot swap context while parse is active" << endl;
 }
 
+static bool owned_by(definition *x, const set<definition*> &owners) {
+  for (; x; x = x->parent)
+    if (owners.find(x) != owners.end())
+      return true;
+  return false;
+}
+
+void context::merge(context &ct)
+{
+  if (parse_open or ct.parse_open) {
+    cerr << "ERROR! Cannot merge context while parse is active" << endl;
+    return;
+  }
+  
+  definition::remap_set n;
+  vector<definition*> moved;
+  global->absorb(ct.global, n, moved);
+  for (map<string,definition*>::iterator it = ct.c_structs.begin(); it != ct.c_structs.end(); ++it) {
+    if (!it->second) continue;
+    pair<map<string,definition*>::iterator, bool> dest = c_structs.insert(*it);
+    if (dest.second) {
+      definition::remap_set::iterator pm = n.find(it->second->parent);
+      if (pm != n.end()) it->second->parent = (definition_scope*)pm->second;
+      moved.push_back(it->second);
+      it->second = NULL;
+    }
+    else if (dest.first->second and dest.first->second != it->second) {
+      n[it->second] = dest.first->second;
+      if ((dest.first->second->flags & DEF_SCOPE) and (it->second->flags & DEF_SCOPE))
+        ((definition_scope*)dest.first->second)->complete_from((definition_scope*)it->second, n, moved);
+    }
+  }
+  for (size_t i = 0; i < moved.size(); ++i)
+    moved[i]->remap(n);
+  
+  set<definition*> adopted(moved.begin(), moved.end());
+  for (set<definition*>::iterator it = ct.variadics.begin(); it != ct.variadics.end(); ++it) {
+    definition::remap_set::iterator ex = n.find(*it);
+    if (ex != n.end())
+      variadics.insert(ex->second);
+    else if (owned_by(*it, adopted))
+      variadics.insert(*it);
+  }
+  for (set<pair<definition*, string> >::iterator it = ct.skipped_privates.begin(); it != ct.skipped_privates.end(); ++it) {
+    definition::remap_set::iterator ex = n.find(it->first);
+    if (ex != n.end())
+      skipped_privates.insert(pair<definition*, string>(ex->second, it->second));
+    else if (owned_by(it->first, adopted))
+      skipped_privates.insert(*it);
+  }
+  
+  for (macro_iter_c mi = ct.macros.begin(); mi != ct.macros.end(); ++mi) {
+    pair<macro_iter,bool> dest = macros.insert(*mi);
+    if (dest.second)
+      macro_type::retain(mi->second);
+  }
+}
+
 macro_map &context::global_macros() {
   return builtin->macros;
 }
@@ -169,7 +441,6 @@ void context::load_gnu_builtins()
 }
 
 #include <iostream>
-#include <General/parse_basics.h>
 
 void context::output_types(ostream &out) {
   out << "Unimplemented";
@@ -194,20 +465,25 @@ void context::output_definitions(ostream &out) {
   out << global->toString();
 }
 
-definition_scope* context::get_global() {
+definition_scope* context::get_global() const {
   return global;
 }
 
-context::context(): parse_open(false), lex(NULL), herr(def_error_handler), global(new definition_scope()) {
+context::context(): parse_open(false), memoizing(false), harvesting(false), tracker(NULL), lex(NULL), herr(def_error_handler), global(new definition_scope()), anon_count(1), hdecl(NULL), dropping(false), retention(RETAIN_ALL), budget(NULL), ending(PARSE_COMPLETE), discarded(false) {
   copy(*builtin);
 }
 
-const macro_map& context::get_macros() { return macros; }
+const macro_map& context::get_macros() const { return macros; }
 
-context::context(int): parse_open(false), lex(NULL), herr(def_error_handler), global(new definition_scope()) { }
+context::context(int): parse_open(false), memoizing(false), harvesting(false), tracker(NULL), lex(NULL), herr(def_error_handler), global(new definition_scope()), anon_count(1), hdecl(NULL), dropping(false), retention(RETAIN_ALL), budget(NULL), ending(PARSE_COMPLETE), discarded(false) { }
+
+context::context(const context &ct): parse_open(false), memoizing(false), harvesting(false), tracker(NULL), lex(NULL), herr(def_error_handler), global(new definition_scope()), anon_count(1), hdecl(NULL), dropping(false), retention(RETAIN_ALL), budget(NULL), ending(PARSE_COMPLETE), discarded(false) {
+  copy(ct);
+}
 
 size_t context::search_dir_count() { return search_directories.size(); }
 string context::search_dir(size_t index) { return search_directories[index]; }
+const vector<string>& context::get_search_directories() { return search_directories; }
 
 void context::dump_macros() {
   // Clean up macros
@@ -221,6 +497,8 @@ decpair context::declare_c_struct(string n, definition* def) {
 }
 
 context::~context() {
+  delete tracker;
+  delete budget;
   delete global;
   delete lex;
   for (map<string,definition*>::iterator it = c_structs.begin(); it != c_structs.end(); ++it)
@@ -44,11 +44,15 @@ namespace jdi {
 }
 namespace jdip {
   class context_parser;
+  struct lexer_cpp;
+  struct dependency_tracker;
+  struct parse_budget;
 }
 
 #include <System/macros.h>
 #include <System/type_usage_flags.h>
 #include <Storage/definition.h>
+#include <Storage/full_type.h>
 #include <General/llreader.h>
 #include <Parser/parse_context.h>
 #include <API/error_reporting.h>
@@ -66,6 +70,161 @@ namespace jdi
   typedef macro_map::iterator macro_iter; ///< Iterator type for macro maps.
   typedef macro_map::const_iterator macro_iter_c; ///< Const iterator type for macro maps.
   
+  /**
+    @struct parse_report
+    @brief  Outcome and timing of a batch parse; see \c context::parse_C_files.
+  **/
+  struct parse_report {
+    /// Outcome and timing of one file in the batch.
+    struct file_report {
+      string filename; ///< The name of the file, as given.
+      int result; ///< The value returned by the parse; zero if it succeeded.
+      unsigned error_count; ///< The number of errors reported while parsing the file.
+      unsigned long parse_usec; ///< Microseconds spent copying the base context and parsing the file into it.
+    };
+    vector<file_report> files; ///< One entry for each file, in the order the files were given.
+    unsigned thread_count; ///< The number of threads which did the parsing.
+    unsigned long parse_usec; ///< Wall microseconds from starting the first thread to the last thread finishing.
+    unsigned long merge_usec; ///< Wall microseconds spent merging each file's context into the destination.
+  };
+  
+  /// The phases a parse is divided into for timing; see \c parse_stats.
+  enum parse_phase {
+    PHASE_OTHER,        ///< Anything not in a phase below, chiefly splitting text into tokens and reading statements.
+    PHASE_IO,           ///< Finding and opening #included files.
+    PHASE_DIRECTIVES,   ///< Obeying preprocessor directives.
+    PHASE_CONDITIONALS, ///< Evaluating the expressions of #if and #elif.
+    PHASE_MACROS,       ///< Expanding macros in code.
+    PHASE_DECLARATORS,  ///< Reading types and declarators.
+    PHASE_LOOKUP,       ///< Looking identifiers up in scope.
+    PHASE_COUNT         ///< The number of phases.
+  };
+  
+  /**
+    @struct parse_stats
+    @brief  Where the time of a parse went; see \c context::parse_C_stream.
+    
+    Phases are timed exclusively: time spent in a phase within another, such as evaluating an #if
+    while obeying directives, is counted only in the inner one, so that the phases of a parse read on
+    one thread add up to its wall time. Where the lexer runs on a thread of its own, the phases of
+    lexing are timed on that thread, and overlap those of the parser. Timing is compiled in only
+    where \c PARSE_STATS is defined as 1; otherwise, the stats given a parse are only cleared.
+  **/
+  struct parse_stats {
+    /// The time spent in one phase.
+    struct phase_stats {
+      unsigned long usec; ///< Microseconds spent in the phase, and in no other within it.
+      unsigned long count; ///< The number of times the phase was entered.
+    };
+    /// The time spent with one file open.
+    struct file_stats {
+      string filename; ///< The name of the file, as it was opened.
+      unsigned opened; ///< The number of times the file was opened.
+      unsigned long inclusive_usec; ///< Microseconds spent with the file open, including in files it included.
+      unsigned long exclusive_usec; ///< Microseconds spent with the file open, but not in files it included.
+    };
+    unsigned long usec; ///< Wall microseconds taken by the parse.
+    phase_stats phases[PHASE_COUNT]; ///< The time spent in each \c parse_phase.
+    vector<file_stats> files; ///< Each file read, in the order first opened, beginning with the stream given.
+    map<string, unsigned long> expansions; ///< The number of times each macro was expanded, in code or in an #if.
+    
+    static const char *phase_name(parse_phase phase); ///< Return the name of a phase, for printing.
+    void clear(); ///< Forget everything timed and counted.
+    /** Print where the time went, for a log.
+        @param out    The stream to print to.
+        @param limit  The most files and macros to print, the costliest first. **/
+    void print(ostream &out = cout, size_t limit = 10) const;
+    parse_stats(); ///< Construct with nothing timed.
+  };
+  
+  /**
+    @struct token_array
+    @brief  Tokens read by \c context::lex_C_stream, kept as one array for each field.
+    
+    Entry \c i of each array describes the \c i th token. The arrays are cleared, but not
+    freed, by each lex, so reusing one \c token_array for many files allocates only while
+    the arrays grow. A token produced by expanding a macro is placed at the macro's name.
+  **/
+  struct token_array {
+    vector<unsigned char> types; ///< The type of each token, a \c jdip::TOKEN_TYPE.
+    vector<unsigned> offsets; ///< The offset in its file of each token.
+    vector<unsigned> lengths; ///< The length of the text of each token.
+    vector<unsigned> files; ///< The index in \c filenames of the file each token was read from, or \c no_file.
+    vector<string> filenames; ///< The name of each file from which tokens were read.
+    static const unsigned no_file = ~0u; ///< The file of a token which was not read from any.
+    size_t size() const { return types.size(); } ///< Return the number of tokens.
+    void clear(); ///< Remove every token and file name, keeping the storage.
+  };
+  
+  /**
+    @struct include_graph
+    @brief  The files read by \c context::scan_includes, and where each was included.
+  **/
+  struct include_graph {
+    /// An #include directive which was obeyed.
+    struct edge {
+      unsigned from; ///< The index in \c files of the including file.
+      unsigned to; ///< The index in \c files of the included file.
+      int line; ///< The line of the directive in the including file.
+    };
+    vector<string> files; ///< Each file read, once each, beginning with the stream scanned.
+    vector<edge> edges; ///< Each #include obeyed, in the order they were read.
+    void clear(); ///< Remove every file and edge.
+  };
+  
+  /**
+    @struct declaration
+    @brief  A declaration which the parser has just finished reading; see \c context::report_declarations.
+  **/
+  struct declaration {
+    /// What was declared: a variable, function, or typedef, or a class, union, enum, or template
+    /// which was given its body.
+    definition *def;
+    /// The type declared, named as in the declaration; for a class, union, enum, or template, just that definition.
+    full_type type;
+    definition_scope *scope; ///< The namespace in which it was declared; the global scope has no name.
+    string filename; ///< The file in which the declaration began.
+    int line; ///< The line on which the declaration began, or -1 if it is not known.
+    int pos; ///< The position in that line at which the declaration began, or -1 if it is not known.
+    string scope_path() const; ///< Name the namespace of the declaration, as from the global scope, such as "std::tr1".
+  };
+  
+  /// Abstract class receiving each declaration as the parser finishes it. Implement it yourself.
+  struct declaration_handler {
+    /** Method invoked as each declaration at namespace scope finishes: once its closing semicolon, or
+        the body of its function, has been read. A statement declaring several things reports each.
+        @param d  The declaration, whose definition may be searched, but not changed.
+        @return Return true if the declaration has been dealt with, and need not be kept. **/
+    virtual bool declared(const declaration &d) = 0;
+    virtual ~declaration_handler() {}
+  };
+  
+  /// Parts of what is parsed which a context may be asked not to keep; see \c context::retain.
+  enum retention_flags {
+    RETAIN_DEFAULT_ARGUMENTS = 1, ///< The expression given as the default value of each function parameter.
+    RETAIN_HYPOTHETICALS = 2, ///< The expression naming each dependent type within a template.
+    RETAIN_PRIVATE_MEMBERS = 4, ///< Variables and functions declared as private members of a class.
+    RETAIN_IMPLEMENTATIONS = 8, ///< Whatever \c handle_function_implementation makes of each function body.
+    RETAIN_ALL = 15 ///< Everything; the default.
+  };
+  
+  /// Limits on how far a single parse may run before it is stopped; see \c context::limit_parses.
+  struct parse_limits {
+    unsigned max_errors; ///< Stop once this many errors have been reported; zero for no limit.
+    unsigned long max_usec; ///< Stop once this many microseconds have passed on the wall clock; zero for no limit.
+    /// Stop as soon as this is set nonzero, from any thread; NULL for none. It must outlive every parse it limits.
+    const volatile int *cancel;
+    parse_limits(): max_errors(0), max_usec(0), cancel(NULL) {}
+  };
+  
+  /// How the last parse of a context ended; see \c context::parse_ending.
+  enum parse_end {
+    PARSE_COMPLETE, ///< The parse read to the end of its code.
+    PARSE_TOO_MANY_ERRORS, ///< The parse was stopped on reaching \c parse_limits::max_errors.
+    PARSE_OUT_OF_TIME, ///< The parse was stopped on running past \c parse_limits::max_usec.
+    PARSE_CANCELLED ///< The parse was stopped because \c parse_limits::cancel was set.
+  };
+  
   /**
     @class context
     @brief A class representing a context for manipulation.
@@ -79,6 +238,15 @@ namespace jdi
   class context
   {
     bool parse_open; ///< True if we're already parsing something
+    bool memoizing; ///< True if the headers this context reads are memoized; see \c memoize_headers.
+    bool harvesting; ///< True if parsing harvests only macros; see \c harvest_macros_only.
+    jdip::dependency_tracker *tracker; ///< What is kept of the files given to \c track_files, or NULL if none were.
+    
+    /** Obey the directives of a stream, as \c parse_C_stream does while harvesting only macros.
+        @param source    The lexer reading the stream, which is kept in place of the last, as after a parse.
+        @param errhandl  The handler to receive errors, or NULL to use the previous one.
+        @return Returns the number of errors reported, or -1 if this context is already being parsed. **/
+    int harvest_stream(jdip::lexer_cpp *source, error_handler *errhandl);
     
     protected: // Make sure our method-packing child can use these.
     lexer *lex; ///< The lexer which all methods and all calls therefrom will poll for tokens.
@@ -87,6 +255,24 @@ namespace jdi
     macro_map macros; ///< A map of macros defined in this context.
     vector<string> search_directories; ///< A list of #include directories in the order they will be searched.
     definition_scope* global; ///< The global scope represented in this context.
+    unsigned anon_count; ///< The number of anonymous definitions named so far in this context, for generating unique names.
+    
+    declaration_handler *hdecl; ///< The handler to which declarations are reported, or NULL; see \c report_declarations.
+    bool dropping; ///< True if declarations which \c hdecl consumes are freed.
+    /// A declaration read in a statement which has not yet finished.
+    struct pending_declaration {
+      definition *def; ///< What was declared.
+      definition_scope *scope; ///< The namespace it was declared in.
+      pending_declaration(definition *d, definition_scope *s): def(d), scope(s) {}
+    };
+    vector<pending_declaration> pending; ///< Declarations to be reported to \c hdecl when their statements finish.
+    unsigned retention; ///< The parts of what is parsed which are kept, as \c retention_flags; see \c retain.
+    jdip::parse_budget *budget; ///< What is left of the limits on the parse underway, or NULL if parses are not limited.
+    parse_end ending; ///< How the last parse ended.
+    bool discarded; ///< True if the declarator last handled was skipped, as \c retention asks, rather than declared.
+    /// The class and name of each private member skipped, as \c retention asks, so that a definition
+    /// of it outside its class is read past, rather than reported as naming no member.
+    set<pair<definition*, string> > skipped_privates;
     
   public:
     set<definition*> variadics; ///< Set of variadic types.
@@ -99,10 +285,11 @@ namespace jdi
     */
     decpair declare_c_struct(string name, definition* def = NULL);
     
-    definition_scope* get_global(); ///< Return the global scope.
+    definition_scope* get_global() const; ///< Return the global scope.
     
     size_t search_dir_count(); ///< Return the number of search directories
     string search_dir(size_t index); ///< Return the search directory with the given index, in [0, search_dir_count).
+    const vector<string>& get_search_directories(); ///< Get a reference to the list of search directories.
     
     /** Add a type name to this context
         The type will be added as a primitive. To add a typedef, use \c jdi::context::add_typedef().
@@ -118,7 +305,15 @@ namespace jdi
     **/
     void add_typedef(string definiendum, definition *definiens);
     
-    void read_macros(const char* filename); ///< Read a file containing exclusively macros, in C format.
+    /** Read a file containing exclusively macros, in C format, such as the output of `gcc -dM -E`.
+        Only #define and #undef directives are read; anything else is skipped. The lexer is not
+        involved, so this is far faster than parsing the same file with \c parse_C_stream.
+        @param filename  The file to read macros from.
+        @param errhandl  An instance of \c jdi::error_handler which will receive any errors encountered.
+                         If this parameter is NULL, the previous error handler will be used, or the default will be used.
+        @return Returns zero on success, or 1 if the file could not be opened.
+    **/
+    int read_macros(const char* filename, error_handler *errhandl = NULL);
     void add_macro(string definiendum, string definiens); ///< Add a macro to this context.
     
     /// Add a macro function with no parameters to this context.
@@ -141,10 +336,63 @@ namespace jdi
     void read_search_directories_gnu(const char* filename, const char* begin_line, const char* end_line);
     /// Add an #include search directory to this context.
     void add_search_directory(string dir);
+    /** Memoize each header this context reads, and replay a memo instead of reading a header again
+        wherever each macro the header looks at holds what it did when the memo was made. Memos are
+        shared by every context, so that one context reads a header and the rest replay it; parsing
+        still runs over the replayed tokens. Contexts copied from this one memoize as it does.
+        @param enable  Whether to memoize headers read from now on. **/
+    void memoize_headers(bool enable = true);
+    /** Report each declaration this context reads at namespace scope to the given handler, as it
+        finishes, instead of leaving the caller to walk the definitions once the parse is done.
+        Class members are not reported apart from their class. Copies of this context report nothing.
+        @param handler  The handler to receive declarations, or NULL to report none.
+        @param drop     If true, a variable or function which the handler consumes is removed from its
+                        scope and freed at once, unless it is overloaded, so that memory holds only the
+                        declarations which are still to be read or which later ones may refer to.
+                        Types, typedefs, and templates are always kept, as later declarations use them.
+                        Later code can not name a declaration which was dropped. **/
+    void report_declarations(declaration_handler *handler, bool drop = false);
+    /** Harvest only macros from whatever this context parses from now on, for tools which want
+        nothing but the macros left by a set of headers. Directives are obeyed and #included files
+        read as in a parse, but everything between directives is skipped as code within a false
+        conditional is, without being split into tokens or handed to the parser; no definitions
+        are read. This holds for \c parse_C_stream and everything built on it, such as \c parse_C_files
+        and \c track_files. The macros are then in \c get_macros, and the files each tracked file read,
+        in \c get_dependencies. Headers are not memoized while harvesting. Contexts copied from this
+        one harvest as it does.
+        @param enable  Whether to harvest only macros from now on. **/
+    void harvest_macros_only(bool enable = true);
+    /** Choose which parts of what this context parses from now on are kept. Whatever is not kept is
+        read past without being stored, rather than stored and freed later, so it never takes memory;
+        a symbol index, for instance, needs none of these. Contexts copied from this one keep what it does.
+        Parameters whose default value was not kept compare as though none was given. Private types and
+        typedefs are always kept, as later members may use them; where a member is defined outside
+        of its class under a name the class does not hold, it is taken for a private member not kept.
+        @param flags  The parts to keep, as a combination of \c retention_flags. **/
+    void retain(unsigned flags = RETAIN_ALL);
+    unsigned retained() const; ///< Get the parts of what is parsed which are kept, as \c retention_flags.
+    /** Bound how far each parse from now on may run, for callers which must answer in time even
+        when given a pathological header. The lexer and parser check the limits every few hundred
+        tokens, and before reading each #included file; once any is reached, the parse reads nothing
+        more, and every construct still open is closed as though the code ended there. Whatever was
+        read is kept, and nothing reported while closing them is passed on; a single error saying
+        why the parse stopped is reported instead. This holds for \c parse_C_stream and everything
+        built on it, such as \c parse_C_files, where the limits apply to each file alone; it does
+        not hold while harvesting only macros. Contexts copied from this one are limited as it is.
+        @param limits  The limits; with every member zero or NULL, parses are not limited. **/
+    void limit_parses(const parse_limits &limits);
+    parse_limits parse_limit() const; ///< Get the limits on each parse, as given to \c limit_parses.
+    parse_end parse_ending() const; ///< Get how the last parse ended, or \c PARSE_COMPLETE if it was not stopped.
     
     void reset(); ///< Reset back to the built-ins; delete all parsed definitions
     void reset_all(); ///< Reset everything, dumping all built-ins as well as all parsed definitions
     void copy(const context &ct); ///< Copy the contents of another context.
+    /** Move the contents of another context into this one, keeping anything already defined here.
+        Definitions and macros which \p ct shares with this context, such as those read from a common
+        header, are discarded as duplicates. Anything referring to a discarded definition is pointed to
+        ours instead. The remains of \p ct are fit only to be destroyed.
+        @param ct  The context to gut. [in-out] **/
+    void merge(context &ct);
     void swap(context &ct); ///< Swap contents with another context.
     
     /** Load standard built-in types, such as int. 
@@ -165,7 +413,7 @@ namespace jdi
     void dump_macros();
     
     /// Get a reference to the macro map
-    const macro_map& get_macros();
+    const macro_map& get_macros() const;
     
     /// Get a non-const reference to the global macro set.
     static macro_map &global_macros();
@@ -174,16 +422,125 @@ namespace jdi
         @param cfile     The stream to be read in.
         @param errhandl  An instance of \c jdi::error_handler which will receive any warnings or errors encountered.
                          If this parameter is NULL, the previous error handler will be used, or the default will be used.
+        @param stats     If non-NULL, receives where the time of the parse went, if \c PARSE_STATS is set.
+                         Nothing is timed while harvesting only macros. [out]
+    **/
+    int parse_C_stream(llreader& cfile, const char* fname = NULL, error_handler *errhandl = NULL, parse_stats *stats = NULL);
+    
+    /** Parse an input stream for definitions, preprocessing on a second thread.
+        Behaves as \c parse_C_stream, except that the C++ lexer is run on a thread of its own,
+        reading included files and expanding macros while the parser works on what it has read.
+        @param cfile     The stream to be read in.
+        @param errhandl  An instance of \c jdi::error_handler which will receive any warnings or errors encountered.
+                         All reports are delivered on the calling thread.
+                         If this parameter is NULL, the previous error handler will be used, or the default will be used.
+        @param stats     If non-NULL, receives where the time of the parse went, on either thread. [out]
+    **/
+    int parse_C_stream_pipelined(llreader& cfile, const char* fname = NULL, error_handler *errhandl = NULL, parse_stats *stats = NULL);
+    
+    /** Parse a number of files in parallel, merging all results into this context.
+        Each file is parsed into its own copy of this context on a pool of threads, each thread
+        taking the next unparsed file as it becomes free. The contexts are then merged into this
+        one, in the order the files were given, by \c merge().
+        @param filenames    The files to be read in.
+        @param thread_count The number of threads to parse on; zero uses one per online processor.
+        @param errhandl     An instance of \c jdi::error_handler which will receive any warnings or errors encountered.
+                            These are delivered on the calling thread, file by file, once all parsing is finished.
+                            If this parameter is NULL, the previous error handler will be used, or the default will be used.
+        @param report       If non-NULL, receives the outcome and timing of each file and of the merge. [out]
+        @return Returns the number of files which failed to parse.
+    **/
+    int parse_C_files(const vector<string> &filenames, unsigned thread_count = 0, error_handler *errhandl = NULL, parse_report *report = NULL);
+    
+    /** Parse a number of files as \c parse_C_files does, and keep track of every file each reads,
+        so that \c reparse_changed can harvest them again when any of those files changes.
+        Each file is kept parsed in a context of its own, copied from what this context held
+        when it first tracked a file, which holds every definition and macro harvested from it.
+        Tracking therefore costs about as much memory again as the definitions tracked.
+        Files which are already tracked are skipped. Copies of this context do not track anything.
+        @param filenames    The files to be read in.
+        @param thread_count The number of threads to parse on; zero uses one per online processor.
+        @param errhandl     An instance of \c jdi::error_handler which will receive any warnings or errors encountered.
+                            If this parameter is NULL, the previous error handler will be used, or the default will be used.
+        @param report       If non-NULL, receives the outcome and timing of each file parsed and of the merge. [out]
+        @return Returns the number of files which failed to parse.
+    **/
+    int track_files(const vector<string> &filenames, unsigned thread_count = 0, error_handler *errhandl = NULL, parse_report *report = NULL);
+    
+    /** Parse again each tracked file which read any file whose text has changed, or which has gone
+        missing, since it was last parsed. A file is only read to see whether its text changed when
+        its modification time or size has moved. If anything is parsed again, everything this context
+        holds is rebuilt from what it held when it first tracked a file, and the tracked files; this
+        discards anything parsed into it directly since then.
+        @param thread_count The number of threads to parse on; zero uses one per online processor.
+        @param errhandl     An instance of \c jdi::error_handler which will receive any warnings or errors encountered.
+                            If this parameter is NULL, the previous error handler will be used, or the default will be used.
+        @param report       If non-NULL, receives the outcome and timing of each file parsed again, and of the
+                            rebuild; its list of files is left empty if nothing had changed. [out]
+        @return Returns the number of files which failed to parse, or -1 if this context is already being parsed.
+    **/
+    int reparse_changed(unsigned thread_count = 0, error_handler *errhandl = NULL, parse_report *report = NULL);
+    
+    /** Get every file read by the files given to \c track_files, and each #include obeyed among them.
+        @param dest  The graph to fill; whatever it held is cleared first. Each #include obeyed
+                     by more than one tracked file is listed once. [out] **/
+    void get_dependencies(include_graph &dest) const;
+    
+    /** Read every token of an input stream into arrays, without parsing any of them.
+        Keywords and built-in declarators are told apart from other identifiers, as for the parser.
+        Tokens are read from the C++ lexer directly, rather than through \c lexer::get_token.
+        @param cfile       The stream to be read in.
+        @param dest        The arrays to fill; whatever they held is cleared first. [out]
+        @param fname       The name of the stream, as given to \c parse_C_stream.
+        @param preprocess  If true, directives are obeyed and macros expanded, with the effect on
+                           this context's macros that a parse would have; #included files are read, and
+                           their tokens placed in their own files. If false, the stream's text is only
+                           split into tokens, and directives appear as the tokens which spell them.
+        @param errhandl    An instance of \c jdi::error_handler which will receive any warnings or errors encountered.
+                           If this parameter is NULL, the previous error handler will be used, or the default will be used.
+        @return Returns the number of errors reported, or -1 if this context is already being parsed.
+    **/
+    int lex_C_stream(llreader& cfile, token_array &dest, const char* fname = NULL, bool preprocess = true, error_handler *errhandl = NULL);
+    
+    /** Find which files an input stream #includes, and where, as `gcc -M` would, without parsing it.
+        Directives are obeyed as in a parse, with the same effect on this context's macros, and
+        #included files are read in turn; everything between directives is skipped as code within
+        a false conditional is, without being split into tokens.
+        @param cfile     The stream to be read in.
+        @param dest      The graph to fill; whatever it held is cleared first. [out]
+        @param fname     The name of the stream, as given to \c parse_C_stream.
+        @param errhandl  An instance of \c jdi::error_handler which will receive any warnings or errors encountered.
+                         If this parameter is NULL, the previous error handler will be used, or the default will be used.
+        @return Returns the number of errors reported, or -1 if this context is already being parsed.
+    **/
+    int scan_includes(llreader& cfile, include_graph &dest, const char* fname = NULL, error_handler *errhandl = NULL);
+    
+    /** Write everything this context holds to a binary image, which \c load_image can read back
+        much faster than the original headers can be parsed. This includes all definitions, macros,
+        and search directories. Images are specific to the platform and build which wrote them.
+        @param filename  The file to write the image to.
+        @return Returns zero on success, 1 if the file could not be opened, or 2 if it could not be written.
+    **/
+    int save_image(const char* filename) const;
+    
+    /** Replace everything this context holds with the contents of an image written by \c save_image.
+        The file is mapped into memory and read in one pass. On failure, the context is left as it was.
+        @param filename  The image file to read.
+        @param errhandl  An instance of \c jdi::error_handler which will receive any errors encountered.
+                         If this parameter is NULL, the previous error handler will be used, or the default will be used.
+        @return Returns zero on success, 1 if the image could not be opened, or 2 if it was malformed or incompatible.
     **/
-    int parse_C_stream(llreader& cfile, const char* fname = NULL, error_handler *errhandl = NULL);
+    int load_image(const char* filename, error_handler *errhandl = NULL);
     
     /** Parse an input stream for definitions using the default C++ lexer.
         @param lang_lexer The lexer which will be polled for tokens. This lexer will already know its token source.
                           If this parameter is NULL, the previous lexer will be used. Or else a huge error will be thrown.
         @param errhandl   An instance of \c jdi::error_handler which will receive any warnings or errors encountered.
                           If this parameter is NULL, the previous error handler will be used, or the default will be used.
+        @param stats      If non-NULL, receives where the time of the parse went. The lexer is timed by way
+                          of \c lexer::time_with. [out]
     **/
-    int parse_stream(lexer *lang_lexer = NULL, error_handler *errhandl = NULL);
+    int parse_stream(lexer *lang_lexer = NULL, error_handler *errhandl = NULL, parse_stats *stats = NULL);
     
     /** Default constructor; allocates a global context with built-in definitions.
         Definitions are copied into the new context from the \c builtin context.
@@ -20,7 +20,11 @@
 **/
 
 #include <cstdio>
+#include <cstring>
 #include <API/error_reporting.h>
+#include <General/atomics.h>
+#include <General/parse_basics.h>
+#include <System/source_map.h>
 
 namespace jdi {
   void default_error_handler::error(std::string err, std::string filename, int line, int pos) {
@@ -44,6 +48,117 @@ namespace jdi {
       fprintf(stderr, "Warning(%s,%d,%d): %s\n", filename.c_str(), line, pos, err.c_str());
   }
 
+  deferred_error_handler::report::report(bool e, std::string r, std::string f, int l, int p): is_error(e), err(r), filename(f), line(l), pos(p) {}
+  deferred_error_handler::deferred_error_handler(): error_count(0) {}
+  void deferred_error_handler::error(std::string err, std::string filename, int line, int pos) {
+    reports.push_back(report(true, err, filename, line, pos));
+    ++error_count;
+  }
+  void deferred_error_handler::warning(std::string err, std::string filename, int line, int pos) {
+    reports.push_back(report(false, err, filename, line, pos));
+  }
+  void deferred_error_handler::replay(error_handler *herr) const {
+    for (std::vector<report>::const_iterator it = reports.begin(); it != reports.end(); ++it)
+      if (it->is_error) herr->error(it->err, it->filename, it->line, it->pos);
+      else herr->warning(it->err, it->filename, it->line, it->pos);
+  }
+
+  diagnostic::diagnostic(diagnostic_severity sev, diagnostic_id i, const char *fmt):
+    severity(sev), id(i), format(fmt), file(0), line(-1), pos(-1), strings(0), numbers(0) {}
+  diagnostic::diagnostic(): severity(DS_ERROR), id(DIAG_OTHER), format(""), file(0), line(-1), pos(-1), strings(0), numbers(0) {}
+
+  diagnostic &diagnostic::arg(const char *str, size_t len) {
+    if (strings >= max_strings)
+      return *this;
+    const size_t at = strings? ends[strings - 1] : 0;
+    if (len > text_size - at)
+      len = text_size - at;
+    memcpy(text + at, str, len);
+    ends[strings++] = at + len;
+    return *this;
+  }
+  diagnostic &diagnostic::arg(const std::string &str) { return arg(str.data(), str.length()); }
+  diagnostic &diagnostic::arg(long num) {
+    if (numbers < max_numbers)
+      number[numbers++] = num;
+    return *this;
+  }
+
+  std::string diagnostic::message() const {
+    std::string res;
+    unsigned si = 0, ni = 0;
+    for (const char *f = format; *f; ++f) {
+      if (*f == '%' and f[1] == 's' and strings) {
+        const unsigned i = si < strings? si++ : strings - 1;
+        const size_t from = i? ends[i - 1] : 0;
+        res.append(text + from, ends[i] - from);
+        ++f;
+      }
+      else if (*f == '%' and f[1] == 'd' and ni < numbers)
+        res += ::toString(number[ni++]), ++f;
+      else
+        res += *f;
+    }
+    return res;
+  }
+  std::string diagnostic::filename() const { return jdip::source_name(file); }
+
+  bool error_handler::wants(diagnostic_severity, diagnostic_id) { return true; }
+  void error_handler::report(const diagnostic &d) {
+    if (d.severity == DS_ERROR) error(d.message(), d.filename(), d.line, d.pos);
+    else warning(d.message(), d.filename(), d.line, d.pos);
+  }
+
+  diagnostic_ring::diagnostic_ring(size_t capacity): mask(1), tail(0), seen_head(0), dropped_count(0), head(0), seen_tail(0) {
+    while (mask < capacity) mask <<= 1;
+    slots.resize(mask--);
+    muted[0] = muted[1] = 0;
+  }
+  bool diagnostic_ring::wants(diagnostic_severity severity, diagnostic_id id) {
+    return !(muted[severity] & (1ul << id));
+  }
+  void diagnostic_ring::mute(diagnostic_severity severity, diagnostic_id id, bool mute) {
+    if (mute) muted[severity] |= 1ul << id;
+    else muted[severity] &= ~(1ul << id);
+  }
+  void diagnostic_ring::report(const diagnostic &d) {
+    const size_t t = tail;
+    if (t - seen_head > mask and t - (seen_head = quick::atomic_get(head)) > mask) {
+      quick::atomic_inc(dropped_count);
+      return;
+    }
+    slots[t & mask] = d;
+    quick::atomic_set(tail, t + 1); // Publishes the slot to the reader
+  }
+  void diagnostic_ring::error(std::string err, std::string filename, int line, int pos) {
+    if (!wants(DS_ERROR, DIAG_OTHER)) return;
+    diagnostic d(DS_ERROR, DIAG_OTHER, "%s");
+    d.arg(err), d.file = jdip::source_id(filename), d.line = line, d.pos = pos;
+    report(d);
+  }
+  void diagnostic_ring::warning(std::string err, std::string filename, int line, int pos) {
+    if (!wants(DS_WARNING, DIAG_OTHER)) return;
+    diagnostic d(DS_WARNING, DIAG_OTHER, "%s");
+    d.arg(err), d.file = jdip::source_id(filename), d.line = line, d.pos = pos;
+    report(d);
+  }
+  bool diagnostic_ring::pop(diagnostic &d) {
+    const size_t h = head;
+    if (h == seen_tail and h == (seen_tail = quick::atomic_get(tail)))
+      return false;
+    d = slots[h & mask];
+    quick::atomic_set(head, h + 1); // Hands the slot back to the reporter
+    return true;
+  }
+  size_t diagnostic_ring::drain(error_handler *herr) {
+    size_t n = 0;
+    for (diagnostic d; pop(d); ++n)
+      if (herr->wants(d.severity, d.id))
+        herr->report(d);
+    return n;
+  }
+  unsigned long diagnostic_ring::dropped() const { return quick::atomic_get(dropped_count); }
+
   /// The instance of \c default_error_handler to which \c def_error_handler will point.
   static default_error_handler deh_instance;
   default_error_handler *def_error_handler = &deh_instance;
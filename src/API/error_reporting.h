@@ -4,6 +4,14 @@
  *
  * Also defines a default error handling class, which shall write all warnings
  * and errors to stderr.
+ *
+ * Most of what the lexer and parser report is also offered in a structured form, as
+ * a \c diagnostic: a number saying what kind of problem it is, a message template in
+ * static storage, its arguments, copied as they are, and a location given by the number
+ * of a file rather than its name. Nothing about a diagnostic is formatted until someone
+ * asks for its message, so a handler which drops or defers it never pays for that, and
+ * one which says it does not want it at all, through \c error_handler::wants, pays for
+ * nothing but the question.
  * 
  * @section License
  * 
@@ -26,8 +34,82 @@
 #define ERROR_REPORTING__H
 
 #include <string>
+#include <vector>
 
 namespace jdi {
+  /// How severe a diagnostic is.
+  enum diagnostic_severity {
+    DS_WARNING, ///< The code may be understood wrongly, but reading goes on as normal.
+    DS_ERROR    ///< The code could not be understood.
+  };
+
+  /// What kind of problem a diagnostic reports. Each covers a family of messages, rather than one message.
+  enum diagnostic_id {
+    DIAG_OTHER,            ///< Anything without a kind of its own; such messages are built whole by whoever reports them.
+    DIAG_SYNTAX,           ///< Something other than was expected was read; the argument names what was.
+    DIAG_UNTERMINATED,     ///< A literal or a list of macro arguments runs off the end of the code.
+    DIAG_MACRO_DEFINITION, ///< A #define is malformed.
+    DIAG_MACRO_ARGUMENTS,  ///< A macro function was given the wrong number of arguments.
+    DIAG_CONDITIONAL,      ///< A conditional directive has no #if to belong to, or an #if no #endif.
+    DIAG_INCLUDE,          ///< An #include names no file, or one which could not be found.
+    DIAG_DIRECTIVE,        ///< A preprocessing directive is unknown, or is missing an operand.
+    DIAG_USER,             ///< An #error or #warning directive was obeyed.
+    DIAG_STRAY,            ///< A character was found where none such belongs.
+    DIAG_REDECLARATION,    ///< Something was declared again as something it was not before.
+    DIAG_MISUSE,           ///< A name was used as something it does not name, such as a type or a scope.
+    DIAG_TEMPLATE_ARGUMENTS, ///< A template was given the wrong number of parameters.
+    DIAG_CONCURRENCY,      ///< Another thread got somewhere first; the parse recovered.
+    DIAG_LIMIT,            ///< The parse reached one of its limits, and was stopped; see \c context::limit_parses.
+    DIAG_ID_COUNT          ///< The number of kinds of diagnostic.
+  };
+
+  /**
+    @struct diagnostic
+    @brief A single error or warning, as captured where it arose, without being formatted.
+
+    The message is a template in static storage. Each %s in it stands for the next string
+    argument, and each %d for the next number; if there are more %s than strings, the last
+    string is used again, and with no strings at all, %s is left alone. String arguments are
+    copied into storage inside the diagnostic, and cut short if they do not fit, so that
+    capturing one never allocates, and it may be copied about freely.
+
+    The location is that of \c jdip::resolve_source, with the file given by number; the
+    number stays good after the file is closed, and \c filename turns it back into a name.
+  **/
+  struct diagnostic {
+    diagnostic_severity severity; ///< Whether this is an error or a warning.
+    diagnostic_id id; ///< What kind of problem this reports.
+    const char *format; ///< The message, with %s and %d for the arguments; never freed.
+    unsigned file; ///< The number of the file in which this arose, or zero if unknown.
+    int line; ///< The line on which this arose, or -1 if unknown.
+    int pos; ///< The position in that line, or -1 if unknown.
+
+    static const unsigned max_strings = 3; ///< The most string arguments kept.
+    static const unsigned max_numbers = 2; ///< The most number arguments kept.
+    static const unsigned text_size = 120; ///< The room for the text of every string argument together.
+    unsigned char strings; ///< The number of string arguments given.
+    unsigned char numbers; ///< The number of number arguments given.
+    unsigned short ends[max_strings]; ///< The offset in \c text past the end of each string argument.
+    long number[max_numbers]; ///< Each number argument.
+    char text[text_size]; ///< The text of each string argument, back to back; not terminated.
+
+    /// Add a string argument, cutting it short if there is no room for all of it.
+    diagnostic &arg(const char *str, size_t len);
+    /// Add a string argument, cutting it short if there is no room for all of it.
+    diagnostic &arg(const std::string &str);
+    /// Add a number argument; past \c max_numbers, it is ignored.
+    diagnostic &arg(long num);
+
+    /// Format the message, substituting each argument.
+    std::string message() const;
+    /// Get the name of the file in which this arose, or the empty string.
+    std::string filename() const;
+
+    /// Construct with a severity, kind, and template, with no arguments and no location.
+    diagnostic(diagnostic_severity sev, diagnostic_id i, const char *fmt);
+    diagnostic(); ///< Construct an empty error, for the sake of containers.
+  };
+
   /// Abstract class for error handling and warning reporting.
   /// Implement this class yourself, or use \c default_error_handler.
   struct error_handler {
@@ -43,6 +125,13 @@ namespace jdi {
         prototype are passed.
     **/
     virtual void warning(std::string err, std::string filename = "", int line = -1, int pos = -1) = 0;
+    /** Method asked before anything of the given kind is captured, let alone reported. Returning
+        false lets the lexer and parser skip finding where it arose and what to say about it.
+        By default, everything is wanted. **/
+    virtual bool wants(diagnostic_severity severity, diagnostic_id id);
+    /** Method invoked with a captured diagnostic, once \c wants has agreed to it. By default,
+        the message is formatted and passed on to \c error or \c warning. **/
+    virtual void report(const diagnostic &d);
     /// Virtual destructor in case children have additional data types to free.
     virtual ~error_handler();
   };
@@ -56,6 +145,75 @@ namespace jdi {
     void warning(std::string err, std::string filename = "", int line = -1, int pos = -1);
   };
 
+  /// Class for holding errors and warnings to be handed to another error handler later.
+  /// Useful for collecting reports on one thread and delivering them on another.
+  struct deferred_error_handler: error_handler {
+    /// A single error or warning, as it was given to us.
+    struct report {
+      bool is_error; ///< True if this was reported as an error, false if as a warning.
+      std::string err, filename; ///< The message and the name of the file which caused it.
+      int line, pos; ///< The location of the error in that file.
+      report(bool e, std::string r, std::string f, int l, int p); ///< Construct with the works.
+    };
+    std::vector<report> reports; ///< Everything reported so far, in order.
+    unsigned error_count; ///< The number of reports which were errors.
+    
+    void error(std::string err, std::string filename = "", int line = -1, int pos = -1); ///< Store an error.
+    void warning(std::string err, std::string filename = "", int line = -1, int pos = -1); ///< Store a warning.
+    /// Hand each stored report, in order, to the given error handler.
+    void replay(error_handler *herr) const;
+    deferred_error_handler(); ///< Construct empty.
+  };
+
+  /**
+    @class diagnostic_ring
+    @brief Holds diagnostics, unformatted, in a ring of fixed size, for another thread to read.
+
+    One thread may report to the ring while one other reads from it, neither ever waiting on
+    the other, nor allocating anything. When the ring is full, whatever is reported is
+    dropped and counted, rather than making the reporting thread wait. Messages reported as
+    text, through \c error or \c warning, are kept as the argument of a \c DIAG_OTHER, and
+    so are cut short past \c diagnostic::text_size.
+
+    Kinds of diagnostic may be muted, after which \c wants refuses them, and they are never captured.
+  **/
+  class diagnostic_ring: public error_handler {
+    std::vector<diagnostic> slots; ///< The ring; its size is a power of two.
+    size_t mask; ///< One less than the size of the ring.
+    unsigned long muted[2]; ///< For each severity, one bit for each kind refused by \c wants.
+    // The reporter and the reader each keep to a cache line of their own, so neither's writes
+    // take the other's line away; each reads the other's count only when its own copy runs out.
+    char pad0[64]; ///< Keeps what follows off the line of what came before.
+    volatile size_t tail; ///< The count of diagnostics stored so far; written only by the reporter.
+    size_t seen_head; ///< The reporter's copy of \c head, as of when it last looked.
+    volatile unsigned long dropped_count; ///< The count of diagnostics dropped because the ring was full.
+    char pad1[64]; ///< Keeps the reporter's counts and the reader's on different lines.
+    volatile size_t head; ///< The count of diagnostics read so far; written only by the reader.
+    size_t seen_tail; ///< The reader's copy of \c tail, as of when it last looked.
+    char pad2[64]; ///< Keeps what follows off the reader's line.
+
+  public:
+    bool wants(diagnostic_severity severity, diagnostic_id id); ///< Refuse only what was muted.
+    void report(const diagnostic &d); ///< Store a diagnostic, or drop it if the ring is full.
+    void error(std::string err, std::string filename = "", int line = -1, int pos = -1); ///< Store an error given as text.
+    void warning(std::string err, std::string filename = "", int line = -1, int pos = -1); ///< Store a warning given as text.
+
+    /** Take the oldest diagnostic from the ring, if there is one.
+        @param d  Receives the diagnostic. [out]
+        @return Returns whether there was one. **/
+    bool pop(diagnostic &d);
+    /** Take every diagnostic from the ring, handing each the given handler wants to its \c report.
+        @return Returns the number taken, wanted or not. **/
+    size_t drain(error_handler *herr);
+    /// Get the number of diagnostics dropped so far because the ring was full.
+    unsigned long dropped() const;
+    /// Mute or unmute a kind of diagnostic, of one severity; muted diagnostics are refused by \c wants.
+    void mute(diagnostic_severity severity, diagnostic_id id, bool mute = true);
+
+    /// Construct with room for at least the given number of diagnostics, rounded up to a power of two.
+    diagnostic_ring(size_t capacity = 1024);
+  };
+
   /// A pointer to an instance of \c default_error_handler, for use wherever.
   extern default_error_handler *def_error_handler;
 }
@@ -29,7 +29,7 @@ namespace jdi {
     builtin = new context(0);
     add_gnu_declarators();
     builtin->load_standard_builtins();
-    builtin->output_types();
+    jdip::lexer_cpp::initialize();
   }
   
   void clean_up() {
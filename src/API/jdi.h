@@ -50,7 +50,10 @@
 **/
 
 namespace jdi {
-  /** Initialize JustDefineIt */
+  /** Initialize JustDefineIt.
+      Populates all shared tables. Once this returns, those tables are only read, and
+      distinct contexts may parse on separate threads at once. Configure \c builtin
+      before constructing contexts from it, and do not modify it during a parse. */
   void initialize();
   /** Clean up (uninitialize) JustDefineIt */
   void clean_up();
@@ -19,7 +19,10 @@
  * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
 **/
 #include "lexer_interface.h"
+#include <Parser/parse_stats.h>
+jdi::lexer::lexer(): clock(NULL) {}
 jdi::lexer::~lexer() {}
+void jdi::lexer::time_with(jdip::phase_clock *c) { clock = c; }
 
 using namespace jdip;
 
@@ -27,14 +30,14 @@ token_t lexer::get_token_in_scope(jdi::definition_scope *scope, error_handler *h
   token_t res = get_token(herr);
   
   if (res.type == TT_IDENTIFIER) {
-    const string name = res.content.toString();
-    definition *def = scope->look_up(name);
-    if (!def) {
-      #ifdef DEBUG_MODE
-        res.def = NULL;
-      #endif
-      return res;
+    const string name = res.toString();
+    definition *def;
+    {
+      phase_scope timing(clock, PHASE_LOOKUP);
+      def = scope->look_up(name);
     }
+    if (!def)
+      return res;
     res.def = def;
     
     if (def->flags & DEF_TYPENAME) {
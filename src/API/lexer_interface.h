@@ -29,6 +29,9 @@
 namespace jdi {
   struct lexer;
 }
+namespace jdip {
+  struct phase_clock;
+}
 
 #include <System/token.h>
 #include <API/error_reporting.h>
@@ -41,11 +44,18 @@ namespace jdi {
     members.
   **/
   struct lexer {
+    /// The clock timing the phases of the parse reading from this lexer, or NULL if it is not timed.
+    jdip::phase_clock *clock;
+    
     /** Read in a token from the open stream.
         @param herr  The error handler which will receive any lexing errors.
     **/
     virtual jdip::token_t get_token(error_handler *herr = def_error_handler) = 0;
     jdip::token_t get_token_in_scope(jdi::definition_scope *scope, error_handler *herr = def_error_handler);
+    /** Time the phases of lexing on the given clock from now on, as well as what the parser does.
+        @param c  The clock to time on, or NULL to stop timing. **/
+    virtual void time_with(jdip::phase_clock *c);
+    lexer(); ///< Construct, untimed.
     virtual ~lexer(); ///< Destruct and free any non-POD or pointer members.
   };
 }
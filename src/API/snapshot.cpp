@@ -0,0 +1,70 @@
+/**
+ * @file  snapshot.cpp
+ * @brief Source implementing the context snapshot publisher.
+ *
+ * @section License
+ *
+ * Copyright (C) 2012 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include <sched.h>
+#include "snapshot.h"
+#include <General/atomics.h>
+
+using namespace jdi;
+
+snapshot_publisher::reader::reader(snapshot_publisher &publisher): pub(publisher) {
+  for (;;) {
+    epoch = quick::atomic_get(pub.epoch);
+    quick::atomic_inc(pub.readers[epoch & 1]);
+    quick::atomic_fence(); // Our count must be seen before we check the epoch again
+    if (quick::atomic_get(pub.epoch) == epoch)
+      break;
+    quick::atomic_dec(pub.readers[epoch & 1]); // A publish slipped in; count ourselves under the new epoch
+  }
+  snap = quick::atomic_get(pub.current);
+}
+
+snapshot_publisher::reader::~reader() {
+  quick::atomic_dec(pub.readers[epoch & 1]);
+}
+
+void snapshot_publisher::publish(context *ct) {
+  pthread_mutex_lock(&writing);
+  context *old = current;
+  quick::atomic_set(current, ct);
+
+  // Readers entering from here on count under the new epoch and see the new context.
+  const unsigned old_epoch = epoch;
+  quick::atomic_inc(epoch);
+  quick::atomic_fence();
+
+  // Readers counted under the old epoch may hold the old context; wait them out.
+  while (quick::atomic_get(readers[old_epoch & 1]))
+    sched_yield();
+
+  delete old;
+  pthread_mutex_unlock(&writing);
+}
+
+snapshot_publisher::snapshot_publisher(context *initial): current(initial), epoch(0) {
+  readers[0] = readers[1] = 0;
+  pthread_mutex_init(&writing, NULL);
+}
+
+snapshot_publisher::~snapshot_publisher() {
+  delete current;
+  pthread_mutex_destroy(&writing);
+}
@@ -0,0 +1,93 @@
+/**
+ * @file  snapshot.h
+ * @brief Header declaring a means of publishing finished contexts to readers on other threads.
+ *
+ * A context cannot be searched safely while it is being parsed into. This file declares
+ * a class which holds the most recent context to have been finished, for any number of
+ * threads to search without locking, while the next one is built elsewhere. When a newer
+ * context is published, the old one is freed as soon as the last reader lets go of it.
+ *
+ * @section License
+ *
+ * Copyright (C) 2012 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef _SNAPSHOT__H
+#define _SNAPSHOT__H
+
+#include <pthread.h>
+#include <API/context.h>
+
+namespace jdi {
+  /**
+    @class snapshot_publisher
+    @brief Holds the latest finished context for lock-free reading by many threads.
+
+    Readers take a \c snapshot_publisher::reader, through which they may search the context
+    which was current when the reader was made. They never wait on anything. A writer parses
+    into a context of its own, then hands it to \c publish(), after which it is never again
+    modified; publishing waits until every reader of the previous context has finished, and
+    then frees that context.
+
+    This is done with two reader counts and an epoch which picks between them. Readers count
+    themselves under the current epoch; a writer swaps in its context, advances the epoch, and
+    waits for the count under the old epoch to fall to zero.
+  **/
+  class snapshot_publisher {
+    context *volatile current; ///< The context most recently published.
+    volatile unsigned epoch; ///< Incremented each time a context is published; its low bit picks a count from \c readers.
+    volatile unsigned readers[2]; ///< The number of readers which entered during an even or odd epoch, respectively.
+    pthread_mutex_t writing; ///< Held while publishing, so that writers take turns.
+
+    snapshot_publisher(const snapshot_publisher&); ///< Not copyable.
+    void operator=(const snapshot_publisher&); ///< Not copyable.
+
+  public:
+    /**
+      @class reader
+      @brief A guard granting read access to whichever context was current when it was made.
+             The context will not be freed while any reader refers to it.
+             Readers should be short-lived, as a publish can not finish while one is held.
+    **/
+    class reader {
+      snapshot_publisher &pub; ///< The publisher whose context we hold.
+      unsigned epoch; ///< The epoch under which we are counted.
+      const context *snap; ///< The context we hold.
+      reader(const reader&); ///< Not copyable.
+      void operator=(const reader&); ///< Not copyable.
+    public:
+      /// Get the context we hold, or NULL if nothing had been published. Nothing in it may be modified.
+      const context *get() const { return snap; }
+      const context *operator->() const { return snap; } ///< Access the context we hold.
+      const context &operator*() const { return *snap; } ///< Access the context we hold.
+      reader(snapshot_publisher &publisher); ///< Begin reading the current context of the given publisher.
+      ~reader(); ///< Finish reading, allowing the context to be freed if it has been replaced.
+    };
+
+    /** Make the given context current. The publisher takes ownership of the context, which must
+        not be parsed into or otherwise modified by anyone from here on. Returns once the context
+        it replaces has been freed; this waits on any readers of that context, so it must not be
+        invoked by a thread which holds a reader of this publisher.
+        @param ct  The finished context to publish, or NULL to publish nothing. **/
+    void publish(context *ct);
+
+    /// Construct, optionally publishing a first context. Takes ownership of the given context.
+    snapshot_publisher(context *initial = NULL);
+    /// Free the current context. There must be no readers left.
+    ~snapshot_publisher();
+  };
+}
+
+#endif
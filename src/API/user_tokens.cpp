@@ -24,30 +24,30 @@
 using namespace jdip;
 namespace jdi {
   jdip::token_t create_token_dec_literal(const char* val, int len, const char* filename, int line, int pos) {
-    return token_t(token_basics(TT_DECLITERAL,filename,line,pos), val, len);
+    return token_t(TT_DECLITERAL, pin_source(filename, line, pos), val, len);
   }
   jdip::token_t create_token_hex_literal(const char* val, int len, const char* filename, int line, int pos) {
-    return token_t(token_basics(TT_HEXLITERAL,filename,line,pos), val, len);
+    return token_t(TT_HEXLITERAL, pin_source(filename, line, pos), val, len);
   }
   jdip::token_t create_token_oct_literal(const char* val, int len, const char* filename, int line, int pos) {
-    return token_t(token_basics(TT_OCTLITERAL,filename,line,pos), val, len);
+    return token_t(TT_OCTLITERAL, pin_source(filename, line, pos), val, len);
   }
   jdip::token_t create_token_operator(const char* op, int len, const char* filename, int line, int pos) {
-    return token_t(token_basics(TT_OPERATOR,filename,line,pos), op, len);
+    return token_t(TT_OPERATOR, pin_source(filename, line, pos), op, len);
   }
   jdip::token_t create_token_from_definition(definition* def, const char* filename, int line, int pos) {
-    return token_t(token_basics(TT_DECLARATOR,filename,line,pos), def);
+    return token_t(TT_DECLARATOR, pin_source(filename, line, pos), def);
   }
   jdip::token_t create_token_opening_parenth(const char* filename, int line, int pos) {
-    return token_t(token_basics(TT_LEFTPARENTH,filename,line,pos));
+    return token_t(TT_LEFTPARENTH, pin_source(filename, line, pos));
   }
   jdip::token_t create_token_closing_parenth(const char* filename, int line, int pos) {
-    return token_t(token_basics(TT_RIGHTPARENTH,filename,line,pos));
+    return token_t(TT_RIGHTPARENTH, pin_source(filename, line, pos));
   }
   jdip::token_t create_token_colon(const char* filename, int line, int pos) {
-    return token_t(token_basics(TT_COLON,filename,line,pos));
+    return token_t(TT_COLON, pin_source(filename, line, pos));
   }
   jdip::token_t create_token_identifier(const char* name, int len, const char* filename, int line, int pos) {
-    return token_t(token_basics(TT_IDENTIFIER,filename,line,pos), name, len);
+    return token_t(TT_IDENTIFIER, pin_source(filename, line, pos), name, len);
   }
 }
@@ -0,0 +1,216 @@
+/**
+ * @file  watcher.cpp
+ * @brief Source implementing the service which keeps a tracking context up to date.
+ *
+ * @section License
+ *
+ * Copyright (C) 2012 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include "watcher.h"
+#include <General/atomics.h>
+#include <Parser/parse_batch.h>
+
+#ifdef __linux__
+  #include <cerrno>
+  #include <poll.h>
+  #include <unistd.h>
+  #include <sys/inotify.h>
+#endif
+
+using namespace std;
+using namespace jdi;
+
+#ifdef __linux__
+  /// The changes to a watched directory which may change a file of interest.
+  static const uint32_t watch_mask = IN_MODIFY | IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO
+                                   | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+
+  int context_watcher::start() {
+    if (running)
+      return 0;
+    notify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (notify_fd < 0) {
+      herr->error("Could not watch files: inotify is unavailable");
+      return 1;
+    }
+    if (pipe(wake_fds)) {
+      herr->error("Could not watch files: no pipe could be made to the watching thread");
+      close(notify_fd), notify_fd = -1;
+      return 1;
+    }
+
+    // Anything changed before we were watching will not be reported; catch it up now
+    tracking->reparse_changed(thread_count, herr);
+    rewatch();
+    publish();
+    if (pthread_create(&thread, NULL, run, this)) {
+      herr->error("Could not watch files: the watching thread could not be started");
+      close(notify_fd), notify_fd = -1;
+      close(wake_fds[0]), close(wake_fds[1]);
+      names.clear(), quick::atomic_set(watches, (size_t)0);
+      return 1;
+    }
+    running = true;
+    return 0;
+  }
+
+  void context_watcher::stop() {
+    if (!running)
+      return;
+    const char wake = 0;
+    while (write(wake_fds[1], &wake, 1) < 0 and errno == EINTR);
+    pthread_join(thread, NULL);
+    running = false;
+    close(notify_fd), notify_fd = -1; // Closing the instance drops every watch
+    close(wake_fds[0]), close(wake_fds[1]);
+    names.clear(), quick::atomic_set(watches, (size_t)0);
+  }
+
+  void *context_watcher::run(void *self) {
+    ((context_watcher*)self)->loop();
+    return NULL;
+  }
+
+  void context_watcher::loop() {
+    pollfd fds[2];
+    fds[0].fd = notify_fd, fds[0].events = POLLIN;
+    fds[1].fd = wake_fds[0], fds[1].events = POLLIN;
+    for (;;) {
+      if (poll(fds, 2, -1) < 0) {
+        if (errno == EINTR) continue;
+        herr->error("Stopped watching files: could not wait on changes");
+        return;
+      }
+      if (fds[1].revents)
+        return;
+      if (!drain())
+        continue;
+
+      // Wait for the burst to quiet down, but not forever, if something is forever writing
+      const unsigned long began = jdip::microtime(), limit = debounce_ms * 10000ul;
+      for (;;) {
+        const unsigned long waited = jdip::microtime() - began;
+        if (waited >= limit)
+          break;
+        const unsigned long left = (limit - waited + 999) / 1000;
+        const int n = poll(fds, 2, left < debounce_ms? left : debounce_ms);
+        if (n < 0 and errno == EINTR) continue;
+        if (n <= 0) break;
+        if (fds[1].revents)
+          return;
+        drain();
+      }
+      refresh();
+    }
+  }
+
+  bool context_watcher::drain() {
+    char buf[4096] __attribute__((aligned(__alignof__(inotify_event))));
+    bool relevant = false;
+    for (;;) {
+      const ssize_t len = read(notify_fd, buf, sizeof buf);
+      if (len <= 0)
+        break;
+      for (const char *p = buf; p < buf + len; ) {
+        const inotify_event *ev = (const inotify_event*)p;
+        p += sizeof(inotify_event) + ev->len;
+        if (ev->mask & (IN_Q_OVERFLOW | IN_DELETE_SELF | IN_MOVE_SELF)) {
+          // Changes were lost, or a directory went away; whatever is in it must be looked at again
+          relevant = true;
+          quick::atomic_inc(events);
+          continue;
+        }
+        if (!ev->len)
+          continue;
+        map<int, set<string> >::const_iterator it = names.find(ev->wd);
+        if (it != names.end() and it->second.find(ev->name) != it->second.end()) {
+          relevant = true;
+          quick::atomic_inc(events);
+        }
+      }
+    }
+    return relevant;
+  }
+
+  void context_watcher::rewatch() {
+    include_graph g;
+    tracking->get_dependencies(g);
+
+    // Files share directories; ask for each directory once
+    map<string, int> dirs;
+    map<int, set<string> > now;
+    for (size_t i = 0; i < g.files.size(); ++i) {
+      const string &f = g.files[i];
+      const size_t slash = f.rfind('/');
+      const string dir = slash == string::npos? "." : slash? f.substr(0, slash) : "/";
+      pair<map<string, int>::iterator, bool> ins = dirs.insert(pair<string, int>(dir, -1));
+      if (ins.second) {
+        ins.first->second = inotify_add_watch(notify_fd, dir.c_str(), watch_mask);
+        if (ins.first->second < 0)
+          herr->warning("Could not watch directory `" + dir + "'; changes to files in it will not be noticed", f, -1, -1);
+      }
+      if (ins.first->second >= 0)
+        now[ins.first->second].insert(f.substr(slash + 1));
+    }
+
+    for (map<int, set<string> >::iterator it = names.begin(); it != names.end(); ++it)
+      if (now.find(it->first) == now.end())
+        inotify_rm_watch(notify_fd, it->first);
+    names.swap(now);
+    quick::atomic_set(watches, names.size());
+  }
+#else
+  int context_watcher::start() {
+    herr->error("Could not watch files: this system does not support inotify");
+    return 1;
+  }
+  void context_watcher::stop() {}
+  void *context_watcher::run(void *) { return NULL; }
+  void context_watcher::loop() {}
+  bool context_watcher::drain() { return false; }
+  void context_watcher::rewatch() {}
+#endif
+
+void context_watcher::refresh() {
+  parse_report report;
+  quick::atomic_inc(reparses);
+  tracking->reparse_changed(thread_count, herr, &report);
+  if (report.files.empty())
+    return;
+  rewatch();
+  publish();
+}
+
+void context_watcher::publish() {
+  pub.publish(new context(*tracking));
+  quick::atomic_inc(publications);
+}
+
+unsigned long context_watcher::event_count() const { return quick::atomic_get(events); }
+unsigned long context_watcher::reparse_count() const { return quick::atomic_get(reparses); }
+unsigned long context_watcher::publish_count() const { return quick::atomic_get(publications); }
+size_t context_watcher::watch_count() const { return quick::atomic_get(watches); }
+
+context_watcher::context_watcher(context *ct, snapshot_publisher &publisher, unsigned debounce, unsigned threads, error_handler *errhandl):
+  tracking(ct), pub(publisher), herr(errhandl), debounce_ms(debounce), thread_count(threads), notify_fd(-1), running(false),
+  watches(0), events(0), reparses(0), publications(0) {
+  wake_fds[0] = wake_fds[1] = -1;
+}
+
+context_watcher::~context_watcher() {
+  stop();
+  delete tracking;
+}
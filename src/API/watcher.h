@@ -0,0 +1,113 @@
+/**
+ * @file  watcher.h
+ * @brief Header declaring a service which keeps a tracking context up to date as its files change.
+ *
+ * Rather than polling the modification time of every file a context has read, the watcher
+ * asks the system to report changes to them, through inotify. Changes tend to come in bursts,
+ * as an editor saves several files or writes one in several pieces, so the watcher waits for a
+ * burst to quiet down before it looks at anything. It then has the context parse again what
+ * changed, on a thread of its own, and publishes a copy of the result for readers to search.
+ *
+ * @section License
+ *
+ * Copyright (C) 2012 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef _WATCHER__H
+#define _WATCHER__H
+
+#include <map>
+#include <set>
+#include <string>
+#include <pthread.h>
+#include <API/context.h>
+#include <API/snapshot.h>
+#include <API/error_reporting.h>
+
+namespace jdi {
+  /**
+    @class context_watcher
+    @brief Watches every file read by a tracking context, and publishes the context anew when they change.
+
+    The watched context must already track its files, by \c context::track_files. Once the
+    watcher is started, that context belongs to the watcher's thread, and must not be used by
+    anyone else until the watcher is stopped. Readers search the copies it publishes instead.
+
+    The directory of each file is watched, rather than the file itself, so that a file which an
+    editor saves by writing another and renaming it over the first is still noticed. Only
+    changes to the files the context read are acted on. After any of them, the watcher waits
+    until nothing has changed for the debounce interval, or until ten intervals have passed,
+    then calls \c context::reparse_changed. If anything was parsed again, a copy of the context
+    is published, and the watches are brought up to date with the files it now reads.
+
+    Watching is only supported where inotify is; elsewhere, \c start fails.
+  **/
+  class context_watcher {
+    context *tracking; ///< The context being kept up to date, which we own.
+    snapshot_publisher &pub; ///< The publisher to which copies of the context are handed.
+    error_handler *herr; ///< The handler receiving whatever is reported while parsing again.
+    unsigned debounce_ms; ///< The number of milliseconds without a change to wait for before parsing.
+    unsigned thread_count; ///< The number of threads to parse on, as for \c context::reparse_changed.
+
+    int notify_fd; ///< The inotify instance, or -1 if not started.
+    int wake_fds[2]; ///< A pipe written to ask the thread to stop.
+    pthread_t thread; ///< The thread waiting on changes.
+    bool running; ///< Whether the thread has been started and not yet joined.
+    std::map<int, std::set<std::string> > names; ///< The names of the files of interest in each watched directory.
+
+    volatile size_t watches; ///< The number of directories watched.
+    volatile unsigned long events; ///< The number of changes seen to files of interest.
+    volatile unsigned long reparses; ///< The number of times the context was asked to parse again.
+    volatile unsigned long publications; ///< The number of copies published, including the first.
+
+    static void *run(void *self); ///< The body of the thread.
+    void loop(); ///< Wait on changes until asked to stop.
+    /// Read every pending event, returning whether any concerned a file of interest.
+    bool drain();
+    /// Parse again what changed, publishing the result if anything was.
+    void refresh();
+    /// Watch the directory of every file the context reads, and no other.
+    void rewatch();
+    void publish(); ///< Publish a copy of the context as it stands.
+
+    context_watcher(const context_watcher&); ///< Not copyable.
+    void operator=(const context_watcher&); ///< Not copyable.
+
+  public:
+    /** Start watching the files of the context, publishing a copy of it as it stands first.
+        @return Returns zero on success, or nonzero if the files can not be watched. **/
+    int start();
+    /// Stop watching, waiting for any parse underway to finish. Watching may be started again after.
+    void stop();
+
+    unsigned long event_count() const; ///< Get the number of changes seen so far to files of interest.
+    unsigned long reparse_count() const; ///< Get the number of times the context has been parsed again.
+    unsigned long publish_count() const; ///< Get the number of copies published so far, including the first.
+    size_t watch_count() const; ///< Get the number of directories being watched.
+
+    /** Construct, taking ownership of a context which tracks its files. Nothing is watched until \c start.
+        @param ct           The context to keep up to date.
+        @param publisher    The publisher to hand copies of the context to; it must outlive the watcher.
+        @param debounce     The number of milliseconds without a change to wait for before parsing again.
+        @param threads      The number of threads to parse on; zero uses one per online processor.
+        @param errhandl     The handler to receive whatever is reported while parsing again. **/
+    context_watcher(context *ct, snapshot_publisher &publisher, unsigned debounce = 100,
+                    unsigned threads = 0, error_handler *errhandl = def_error_handler);
+    /// Stop watching, and free the context.
+    ~context_watcher();
+  };
+}
+
+#endif
@@ -0,0 +1,55 @@
+/**
+ * @file  atomics.h
+ * @brief A tiny header wrapping the handful of atomic operations JDI needs.
+ *
+ * Only integer counters are covered here; the intent is to let reference counts
+ * and flags shared between contexts be manipulated from several threads at once
+ * without dragging in a threading library.
+ *
+ * @section License
+ *
+ * Copyright (C) 2012 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef _ATOMICS__H
+#define _ATOMICS__H
+
+namespace quick {
+  #if defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 7))
+    /// Atomically increment the given counter, returning the new value.
+    template<typename t> inline t atomic_inc(volatile t &x) { return __atomic_add_fetch(&x, 1, __ATOMIC_ACQ_REL); }
+    /// Atomically decrement the given counter, returning the new value.
+    template<typename t> inline t atomic_dec(volatile t &x) { return __atomic_sub_fetch(&x, 1, __ATOMIC_ACQ_REL); }
+    /// Read the given value with acquire semantics.
+    template<typename t> inline t atomic_get(const volatile t &x) { return __atomic_load_n(&x, __ATOMIC_ACQUIRE); }
+    /// Store to the given value with release semantics.
+    template<typename t> inline void atomic_set(volatile t &x, t v) { __atomic_store_n(&x, v, __ATOMIC_RELEASE); }
+    /// Store v to the given value if it still holds expected, returning whether it did.
+    template<typename t> inline bool atomic_cas(volatile t &x, t expected, t v) {
+      return __atomic_compare_exchange_n(&x, &expected, v, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+    }
+    /// Order all memory operations before this call before all of those after it.
+    inline void atomic_fence() { __atomic_thread_fence(__ATOMIC_SEQ_CST); }
+  #else
+    template<typename t> inline t atomic_inc(volatile t &x) { return __sync_add_and_fetch(&x, 1); }
+    template<typename t> inline t atomic_dec(volatile t &x) { return __sync_sub_and_fetch(&x, 1); }
+    template<typename t> inline t atomic_get(const volatile t &x) { __sync_synchronize(); return x; }
+    template<typename t> inline void atomic_set(volatile t &x, t v) { __sync_synchronize(); x = v; __sync_synchronize(); }
+    template<typename t> inline bool atomic_cas(volatile t &x, t expected, t v) { return __sync_bool_compare_and_swap(&x, expected, v); }
+    inline void atomic_fence() { __sync_synchronize(); }
+  #endif
+}
+
+#endif
@@ -26,9 +26,12 @@
 #include <fstream>
 #include <API/context.h>
 #include <System/lex_cpp.h>
+#include <System/lex_pipeline.h>
 #include <System/token.h>
 #include <General/debug_macros.h>
 #include "parse_context.h"
+#include "parse_budget.h"
+#include "parse_stats.h"
 #include "bodies.h"
 using namespace std;
 using namespace jdip;
@@ -37,8 +40,40 @@ using namespace jdip;
   This is the single most trivial function in the API. It makes a call to parse_stream, passing a
   new instance of the C++ lexer that ships with JDI, \c lex_cpp.
 **/
-int jdi::context::parse_C_stream(llreader &cfile, const char* fname, error_handler *errhandl) {
-  return parse_stream(fname? new lexer_cpp(cfile, macros, fname) : new lexer_cpp(cfile, macros), errhandl); // Invoke our common method with it
+int jdi::context::parse_C_stream(llreader &cfile, const char* fname, error_handler *errhandl, parse_stats *stats) {
+  lexer_cpp *source = fname? new lexer_cpp(cfile, macros, search_directories, fname) : new lexer_cpp(cfile, macros, search_directories);
+  if (harvesting) {
+    if (stats) stats->clear(); // Harvesting is not timed
+    return harvest_stream(source, errhandl);
+  }
+  source->memoize = memoizing;
+  source->budget = budget;
+  return parse_stream(source, errhandl, stats); // Invoke our common method with it
+}
+
+int jdi::context::parse_C_stream_pipelined(llreader &cfile, const char* fname, error_handler *errhandl, parse_stats *stats) {
+  lexer_cpp *source = fname? new lexer_cpp(cfile, macros, search_directories, fname) : new lexer_cpp(cfile, macros, search_directories);
+  if (harvesting) { // With no parser to keep busy, there is nothing to run alongside the lexer
+    if (stats) stats->clear();
+    return harvest_stream(source, errhandl);
+  }
+  source->memoize = memoizing;
+  source->budget = budget;
+  #if PARSE_STATS
+    if (stats) {
+      // The lexer gets a clock of its own, set before its thread starts, and read once it has finished
+      phase_clock lexing(stats);
+      source->time_with(&lexing);
+      lexer_pipeline *pipe = new lexer_pipeline(source);
+      const int res = parse_stream(pipe, errhandl, stats);
+      if (lex == pipe) { // Otherwise, the pipeline was refused and freed
+        lexing.finish();
+        source->time_with(NULL);
+      }
+      return res;
+    }
+  #endif
+  return parse_stream(new lexer_pipeline(source), errhandl);
 }
 
 /** @section Implementation
@@ -47,7 +82,7 @@ int jdi::context::parse_C_stream(llreader &cfile, const char* fname, error_handl
   call, \c handle_scope(), and then the other members of the derived \c context_parser
   class in \c jdip, which will be called from handle_scope.
 */
-int jdi::context::parse_stream(lexer *lang_lexer, error_handler *errhandl)
+int jdi::context::parse_stream(lexer *lang_lexer, error_handler *errhandl, parse_stats *stats)
 {
   if (errhandl)
     herr = errhandl;
@@ -67,6 +102,24 @@ int jdi::context::parse_stream(lexer *lang_lexer, error_handler *errhandl)
   }
   
   parse_open = true;
+  ending = PARSE_COMPLETE;
+  
+  // While the parse is limited, it reads through a lexer which runs dry once a limit is reached
+  error_handler *const given = herr;
+  budget_lexer limited(lex, budget);
+  if (budget)
+    budget->begin(herr), herr = budget, lex = &limited;
+  
+  #if PARSE_STATS
+    phase_clock *clock = NULL;
+    if (stats) {
+      stats->clear();
+      clock = new phase_clock(stats);
+      limited.source->time_with(clock), limited.time_with(clock);
+    }
+  #else
+    if (stats) stats->clear();
+  #endif
   
   token_t eoc; // An invalid token to appease the parameter chain.
   int res = ((context_parser*)this)->handle_scope(global, eoc);
@@ -89,6 +142,32 @@ int jdi::context::parse_stream(lexer *lang_lexer, error_handler *errhandl)
     #endif
   }
   
+  if (!pending.empty()) // Left by a statement which was abandoned
+    ((context_parser*)this)->flush_declarations(0, eoc.loc);
+  
+  if (budget) {
+    lex = limited.source, herr = given;
+    if (budget->spent()) {
+      limited.finish();
+      ending = parse_end(budget->ending);
+      if (herr->wants(DS_ERROR, DIAG_LIMIT)) {
+        diagnostic d(DS_ERROR, DIAG_LIMIT, "Stopped parsing here, as the parse was cancelled");
+        if (ending == PARSE_TOO_MANY_ERRORS)
+          d.format = "Stopped parsing here, after %d errors", d.arg((long)budget->errors);
+        else if (ending == PARSE_OUT_OF_TIME)
+          d.format = "Stopped parsing here, after %d microseconds", d.arg((long)budget->limits.max_usec);
+        token_t(TT_ENDOFCODE, limited.last).report(herr, d);
+      }
+      res = 1;
+    }
+  }
+  #if PARSE_STATS
+    if (clock) {
+      clock->finish();
+      lex->time_with(NULL);
+      delete clock;
+    }
+  #endif
   parse_open = false; // Now a parse can be called in this context again
   return res;
 }
@@ -212,11 +212,13 @@ namespace jdip {
     @param  scope  The scope from which the member is being accessed. [in-out]
     @param  token  The first token to handle, and the token structure into which the next unhandled token will be placed. [in-out]
     @param  flags  Flags known about this hypothetical type. [in]
+    @param  cp     The context parser, from which to learn whether the expression read is to be kept,
+                   or NULL to keep it. [in]
     @param  herr   Error handler to which errors will be reported. [in-out]
     
     @return A representation of the dependent member, or NULL if an error occurred.
   **/
-  definition_hypothetical* handle_hypothetical(lexer *lex, definition_scope *scope, token_t& token, unsigned flags, error_handler *herr);
+  definition_hypothetical* handle_hypothetical(lexer *lex, definition_scope *scope, token_t& token, unsigned flags, context_parser *cp, error_handler *herr);
   
   /**
     Read a string from code containing the name of an operator function, eg, `operator*', `operator[]', `operator.', `operator new[]'.
@@ -239,7 +241,6 @@ namespace jdip {
   */
   definition* read_qualified_definition(lexer *lex, definition_scope* scope, token_t &token, context_parser *cp, error_handler *herr);
   
-  extern definition* dangling_pointer;
   /**
     @class context_parser
     @brief A field-free utility class extending \c context, implementing the
@@ -263,6 +264,27 @@ namespace jdip {
     **/
     token_t read_next_token(definition_scope *scope);
     
+    /// Note that the declarator being read is to be skipped rather than declared, as \c retention asks.
+    void discard_declarator() { discarded = true; }
+    /// Return whether the named member of the given class was declared private and skipped, as \c retention asks.
+    bool skipped_private(definition *cls, const string &name) const {
+      return skipped_privates.find(pair<definition*, string>(cls, name)) != skipped_privates.end();
+    }
+    
+    /** Note that a declaration has been read, to be reported to the declaration handler once the
+        statement declaring it finishes. Nothing is noted if there is no handler, or if the scope
+        is not a namespace.
+        @param scope  The scope in which the declaration was made.
+        @param def    The definition declared.
+    **/
+    void note_declaration(definition_scope *scope, definition *def);
+    /** Report each declaration noted since the given mark to the declaration handler, freeing those
+        it consumes if it is so configured, and forget them.
+        @param mark   The number of declarations which were noted before the statement began.
+        @param start  The location of the first token of the statement.
+    **/
+    void flush_declarations(size_t mark, source_location start);
+    
     /**
       Parse a list of declarations, copying them into the given scope.
       
@@ -278,7 +300,7 @@ namespace jdip {
       
       @return Zero if no error occurred, a non-zero exit status otherwise.
     **/
-    int handle_declarators(definition_scope *scope, token_t& token, unsigned inherited_flags, definition* &res = dangling_pointer);
+    int handle_declarators(definition_scope *scope, token_t& token, unsigned inherited_flags, definition* &res);
     /**
       Parse a list of declarations assuming the given type, copying them into the given scope.
       
@@ -295,7 +317,7 @@ namespace jdip {
       
       @return Zero if no error occurred, a non-zero exit status otherwise.
     **/
-    int handle_declarators(definition_scope *scope, token_t& token, full_type& type, unsigned inherited_flags, definition* &res = dangling_pointer);
+    int handle_declarators(definition_scope *scope, token_t& token, full_type& type, unsigned inherited_flags, definition* &res);
     
     /**
       Parse a namespace definition.
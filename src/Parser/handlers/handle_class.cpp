@@ -31,7 +31,7 @@ static inline definition_class* insnew(definition_scope *const &scope, int inher
   decpair dins = scope->declare(classname);
   if (!dins.inserted) {
     if (dins.def->flags & DEF_TYPENAME) { // This error is displayed because if the class existed earlier when we were checking, we'd have gotten a different token.
-      token.report_error(herr, "Class `" + classname + "' instantiated inadvertently during parse by another thread. Freeing.");
+      token.report_error(herr, DIAG_CONCURRENCY, "Class `%s' instantiated inadvertently during parse by another thread. Freeing.", classname);
       delete ~dins.def;
     }
     else {
@@ -55,7 +55,6 @@ static inline definition_class* insnew(definition_scope *const &scope, int inher
   return nclass;
 }
 
-static unsigned anon_count = 1;
 jdi::definition_class* jdip::context_parser::handle_class(definition_scope *scope, token_t& token, int inherited_flags)
 {
   unsigned protection = 0;
@@ -84,11 +83,11 @@ jdi::definition_class* jdip::context_parser::handle_class(definition_scope *scop
   
   definition *dulldef = NULL;
   if (token.type == TT_IDENTIFIER) {
-    classname = token.content.toString();
+    classname = token.toString();
     token = read_next_token(scope);
   }
   else if (token.type == TT_DEFINITION) {
-    classname = token.content.toString();
+    classname = token.def->name;
     dulldef = token.def;
     token = read_next_token(scope);
   }
@@ -104,7 +103,7 @@ jdi::definition_class* jdip::context_parser::handle_class(definition_scope *scop
           if (dins.first->second->flags & DEF_CLASS)
             nclass = (definition_class*)dins.first->second;
           else {
-            token.report_error(herr, "Attempt to redeclare `" + classname + "' as class in this scope");
+            token.report_error(herr, DIAG_REDECLARATION, "Attempt to redeclare `%s' as class in this scope", classname);
             FATAL_RETURN(NULL);
             nclass = NULL;
           }
@@ -130,7 +129,7 @@ jdi::definition_class* jdip::context_parser::handle_class(definition_scope *scop
   {
     // We'd better have read a definition earlier, and it'd better have been a template.
     if (not(dulldef and (dulldef->flags & DEF_TEMPLATE))) {
-      token.report_error(herr, "Unexpected '<' token; `" + classname + "' is not a template type");
+      token.report_error(herr, DIAG_MISUSE, "Unexpected '<' token; `%s' is not a template type", classname);
       //cerr << dulldef << ": " << (dulldef? dulldef->name : "no definition by that name") << endl;
       return NULL;
     }
@@ -149,7 +148,7 @@ jdi::definition_class* jdip::context_parser::handle_class(definition_scope *scop
       definition_template *spec = temp->specialize(k, ts);
       if (spec->def) {
         if (not(spec->def->flags & DEF_CLASS)) {
-          token.report_error(herr, "Template `" + temp->name + "' does not name a class");
+          token.report_error(herr, DIAG_MISUSE, "Template `%s' does not name a class", temp->name);
           return NULL;
         }
         nclass = (definition_class*)spec->def;
@@ -199,12 +198,12 @@ jdi::definition_class* jdip::context_parser::handle_class(definition_scope *scop
           }
         }
         else {
-          token.report_error(herr, "Cannot redeclare template `" + dulldef->name + "' as class in this scope");
+          token.report_error(herr, DIAG_REDECLARATION, "Cannot redeclare template `%s' as class in this scope", dulldef->name);
           return NULL;
         }
       }
       else {
-        token.report_error(herr, "Cannot redeclare `" + dulldef->name + "' as class in this scope");
+        token.report_error(herr, DIAG_REDECLARATION, "Cannot redeclare `%s' as class in this scope", dulldef->name);
         return NULL;
       }
     }
@@ -222,7 +221,7 @@ jdi::definition_class* jdip::context_parser::handle_class(definition_scope *scop
         return NULL;
     }
     else if (already_complete) {
-      token.report_error(herr, "Attempting to add ancestors to previously defined class `" + classname + "'");
+      token.report_error(herr, DIAG_REDECLARATION, "Attempting to add ancestors to previously defined class `%s'", classname);
     }
     incomplete = 0;
     do {
@@ -240,7 +239,7 @@ jdi::definition_class* jdip::context_parser::handle_class(definition_scope *scop
       if (token.type != TT_DECLARATOR and token.type != TT_DEFINITION) {
         string err = "Ancestor class name expected";
         if (token.type == TT_DECLARATOR) err += "; `" + token.def->name + "' does not name a class";
-        if (token.type == TT_IDENTIFIER) err += "; `" + token.content.toString() + "' does not name a type";
+        if (token.type == TT_IDENTIFIER) err += "; `" + token.toString() + "' does not name a type";
         token.report_error(herr, err);
         return NULL;
       }
@@ -258,7 +257,8 @@ jdi::definition_class* jdip::context_parser::handle_class(definition_scope *scop
             return NULL;
           }
           else {
-            definition_hypothetical *h = new definition_hypothetical(ft.def->name, ft.def->parent, ft.def->flags, new AST(ft.def));
+            definition_hypothetical *h = new definition_hypothetical(ft.def->name, ft.def->parent, ft.def->flags,
+                                                                          retention & RETAIN_HYPOTHETICALS? new AST(ft.def) : NULL);
             ((definition_template*)((definition_tempscope*)def)->source)->dependents.push_back(h);
             ft.def = h;
           }
@@ -287,16 +287,17 @@ jdi::definition_class* jdip::context_parser::handle_class(definition_scope *scop
         return NULL;
     }
     else if (already_complete) {
-      token.report_error(herr, "Attempting to add members to previously defined class `" + classname + "'");
+      token.report_error(herr, DIAG_REDECLARATION, "Attempting to add members to previously defined class `%s'", classname);
       FATAL_RETURN(NULL);
     }
     nclass->flags &= ~DEF_INCOMPLETE;
     if (handle_scope(nclass, token, protection))
       FATAL_RETURN(NULL);
     if (token.type != TT_RIGHTBRACE) {
-      token.report_error(herr, "Expected closing brace to class `" + classname + "'");
+      token.report_error(herr, DIAG_SYNTAX, "Expected closing brace to class `%s'", classname);
       FATAL_RETURN(NULL);
     }
+    note_declaration(scope, nclass);
     token = read_next_token(scope);
   }
   else // Sometimes, it isn't okay to not specify a structure body.
@@ -35,10 +35,10 @@
 using namespace jdip;
 using namespace jdi;
 
-static unsigned anon_count = 0;
-namespace jdip { definition *dangling_pointer = NULL; }
 int jdip::context_parser::handle_declarators(definition_scope *scope, token_t& token, unsigned inherited_flags, definition* &res)
 {
+  discarded = false;
+  
   // Skip destructor tildes; log if we are a destructor
   bool dtor = token.type == TT_TILDE;
   if (dtor) token = read_next_token(scope);
@@ -83,6 +83,11 @@ int jdip::context_parser::handle_declarators(definition_scope *scope, token_t& t
 
 int jdip::context_parser::handle_declarators(definition_scope *scope, token_t& token, full_type &tp, unsigned inherited_flags, definition* &res)
 {
+  if (discarded) { // Its type and referencers have been read; what follows is read as usual
+    res = NULL;
+    goto extra_loop;
+  }
+  
   // Make sure we do indeed find ourselves at an identifier to declare.
   if (tp.refs.name.empty()) {
     const bool potentialc = (
@@ -110,7 +115,7 @@ int jdip::context_parser::handle_declarators(definition_scope *scope, token_t& t
     else if (token.type == TT_COLON) {
       if (scope->flags & DEF_CLASS) {
         char anonname[32];
-        sprintf(anonname,"<anonymousField%010d>",anon_count);
+        sprintf(anonname,"<anonymousField%010d>",anon_count++);
         tp.refs.name = anonname;
       }
       else
@@ -122,13 +127,20 @@ int jdip::context_parser::handle_declarators(definition_scope *scope, token_t& t
       rescope: {
         while (token.type == TT_SCOPE) {
           if (!(d->flags & DEF_SCOPE)) {
-            token.report_error(herr, "Cannot access `" + d->name + "' as scope");
+            token.report_error(herr, DIAG_MISUSE, "Cannot access `%s' as scope", d->name);
             FATAL_RETURN(1); break;
           }
           token = read_next_token((definition_scope*)d);
+          if (token.type == TT_IDENTIFIER and d->flags & DEF_CLASS and skipped_private(d, token.toString())) {
+            // The definition of a private member which was not kept; read past the rest of it
+            token = read_next_token(scope);
+            read_referencers_post(tp.refs, lex, token, (definition_scope*)d, this, herr);
+            res = NULL, discarded = true;
+            goto extra_loop;
+          }
           if (token.type != TT_DEFINITION and token.type != TT_DECLARATOR) {
             if (token.type == TT_IDENTIFIER)
-              token.report_errorf(herr, "Expected qualified-id before %s; `" + token.content.toString() + "' is not a member of `" + d->name + "'");
+              token.report_errorf(herr, "Expected qualified-id before %s; `" + token.toString() + "' is not a member of `" + d->name + "'");
             else
               token.report_errorf(herr, "Expected qualified-id before %s");
             FATAL_RETURN(1); break;
@@ -163,6 +175,14 @@ int jdip::context_parser::handle_declarators(definition_scope *scope, token_t& t
       return 0;
   }
   
+  // Constructors and destructors are kept, as their out-of-class definitions are found through the class
+  if (inherited_flags & DEF_PRIVATE and !(inherited_flags & DEF_TYPENAME) and scope->flags & DEF_CLASS
+      and tp.refs.name[0] != '<' and tp.refs.name[0] != '~' and !(retention & RETAIN_PRIVATE_MEMBERS)) {
+    skipped_privates.insert(pair<definition*, string>(scope, tp.refs.name));
+    res = NULL, discarded = true;
+    goto extra_loop;
+  }
+  
   {
     // Add it to our definitions map, without overwriting the existing member.
     decpair ins = ((definition_scope*)scope)->declare(tp.refs.name);
@@ -177,7 +197,7 @@ int jdip::context_parser::handle_declarators(definition_scope *scope, token_t& t
       if (ins.def->flags & (DEF_CLASS | DEF_UNION | DEF_ENUM)) { // If the original definition is a class
         decpair cins = declare_c_struct(tp.refs.name, ins.def); // Move that definition to the C structs list, so we can insert our definition in its place.
         if (!cins.inserted and cins.def != ins.def) {
-          token.report_error(herr, "Attempt to redeclare `" + tp.refs.name + "' failed due to conflicts");
+          token.report_error(herr, DIAG_REDECLARATION, "Attempt to redeclare `%s' failed due to conflicts", tp.refs.name);
           FATAL_RETURN(1);
         }
         else goto insert_anyway;
@@ -189,7 +209,7 @@ int jdip::context_parser::handle_declarators(definition_scope *scope, token_t& t
           res = ins.def = func;
         }
         else {
-          token.report_error(herr, "Redeclaration of `" + tp.refs.name + "' as a different kind of symbol");
+          token.report_error(herr, DIAG_REDECLARATION, "Redeclaration of `%s' as a different kind of symbol", tp.refs.name);
           token.report_error(herr, scope->parent? "In scope `" + scope->name + "'" : "At global scope");
           //cerr << ins.def->toString() << endl;
           return 3;
@@ -197,16 +217,17 @@ int jdip::context_parser::handle_declarators(definition_scope *scope, token_t& t
       }
       else if (ins.def->flags & DEF_FUNCTION) { // Handle function overloading
         if (tp.refs.empty() or tp.refs.top().type != ref_stack::RT_FUNCTION) {
-          token.report_error(herr, "Cannot declare `" + tp.refs.name + "' over existing function");
+          token.report_error(herr, DIAG_REDECLARATION, "Cannot declare `%s' over existing function", tp.refs.name);
           return 4;
         }
         definition_function* func = (definition_function*)ins.def;
-        arg_key k(func->referencers);
+        arg_key k(tp.refs); // Keyed by the parameters of the new overload, before they are consumed
         res = func->overload(k, new definition_function(tp.refs.name,scope,tp.def,tp.refs,tp.flags,DEF_TYPED | inherited_flags), herr);
       }
       else
         res = ins.def;
     }
+    note_declaration(scope, res);
   }
   
   extra_loop:
@@ -214,9 +235,9 @@ int jdip::context_parser::handle_declarators(definition_scope *scope, token_t& t
   {
     switch (token.type) {
       case TT_OPERATOR:
-          if (token.content.len != 1 or *token.content.str != '=') { // If this operator isn't =, this is a fatal error. No idea where we are.
+          if (token.len != 1 or *token.str != '=') { // If this operator isn't =, this is a fatal error. No idea where we are.
             case TT_GREATERTHAN: case TT_LESSTHAN:
-            token.report_error(herr, "Unexpected operator `" + token.content.toString() + "' at this point");
+            token.report_error(herr, DIAG_SYNTAX, "Unexpected operator `%s' at this point", token.toString());
             return 5;
           }
           else {
@@ -229,6 +250,7 @@ int jdip::context_parser::handle_declarators(definition_scope *scope, token_t& t
       case TT_COMMA:
           // Move past this comma
           token = read_next_token(scope);
+          discarded = false;
           
           // Read a new type
           read_referencers(tp.refs, tp, lex, token, scope, this, herr);
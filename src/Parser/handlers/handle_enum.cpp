@@ -33,7 +33,7 @@ static inline definition_enum* insnew(definition_scope *const &scope, int inheri
   decpair dins = scope->declare(classname);
   if (!dins.inserted) {
     if (dins.def->flags & DEF_TYPENAME) {
-      token.report_error(herr, "Enum `" + classname + "' instantiated inadvertently during parse by another thread. Freeing.");
+      token.report_error(herr, DIAG_CONCURRENCY, "Enum `%s' instantiated inadvertently during parse by another thread. Freeing.", classname);
       delete ~dins.def;
     }
     else {
@@ -46,7 +46,7 @@ static inline definition_enum* insnew(definition_scope *const &scope, int inheri
         #if FATAL_ERRORS
           return NULL;
         #else
-          token.report_error(herr, "Redeclaring `" + classname + "' as different kind of symbol.");
+          token.report_error(herr, DIAG_REDECLARATION, "Redeclaring `%s' as different kind of symbol.", classname);
           delete ~dins.def;
           goto my_else;
         #endif
@@ -58,7 +58,6 @@ static inline definition_enum* insnew(definition_scope *const &scope, int inheri
   return nclass;
 }
 
-static unsigned anon_count = 1;
 jdi::definition_enum* jdip::context_parser::handle_enum(definition_scope *scope, token_t& token, int inherited_flags)
 {
   dbg_assert(token.type == TT_ENUM);
@@ -72,7 +71,7 @@ jdi::definition_enum* jdip::context_parser::handle_enum(definition_scope *scope,
   unsigned incomplete = DEF_INCOMPLETE; // DEF_INCOMPLETE if this enum has a body, zero otherwise.
   
   if (token.type == TT_IDENTIFIER || token.type == TT_DEFINITION) {
-    classname = token.content.toString();
+    classname = token.type == TT_DEFINITION? token.def->name : token.toString();
     token = read_next_token(scope);
   }
   else if (token.type == TT_DECLARATOR) {
@@ -80,7 +79,7 @@ jdi::definition_enum* jdip::context_parser::handle_enum(definition_scope *scope,
     classname = nenum->name;
     if (not(nenum->flags & DEF_ENUM)) {
       if (nenum->parent == scope)
-        token.report_error(herr, "Attempt to redeclare `" + classname + "' as enum in this scope");
+        token.report_error(herr, DIAG_REDECLARATION, "Attempt to redeclare `%s' as enum in this scope", classname);
       nenum = NULL;
     }
     else {
@@ -106,7 +105,7 @@ jdi::definition_enum* jdip::context_parser::handle_enum(definition_scope *scope,
       return NULL;
     }
     else if (already_complete) {
-      token.report_error(herr, "Attempting to define type of previously defined enum `" + classname + "'");
+      token.report_error(herr, DIAG_REDECLARATION, "Attempting to define type of previously defined enum `%s'", classname);
     }
     incomplete = 0;
      
@@ -125,16 +124,16 @@ jdi::definition_enum* jdip::context_parser::handle_enum(definition_scope *scope,
   token = read_next_token(scope);
   while (token.type != TT_RIGHTBRACE) {
     if (token.type == TT_ENDOFCODE) {
-      token.report_error(herr, "Expected closing brace to enum `" + classname + "'");
+      token.report_error(herr, DIAG_SYNTAX, "Expected closing brace to enum `%s'", classname);
       return FATAL_ERRORS_T(NULL, nenum);
     }
     if (token.type != TT_IDENTIFIER)
       { token.report_error(herr, "Expected identifier at this point"); token = read_next_token(scope); continue; }
-    string cname(token.content.toString());
+    string cname(token.toString());
     
     token = read_next_token(scope);
     if (token.type == TT_OPERATOR) {
-      if (token.content.len != 1 or token.content.str[0] != '=') {
+      if (token.len != 1 or token.str[0] != '=') {
         token.report_error(herr, "Expected assignment operator `=' here before secondary operator");
       }
       token = read_next_token(scope);
@@ -161,10 +160,10 @@ jdi::definition_enum* jdip::context_parser::handle_enum(definition_scope *scope,
       if (sins.inserted)
         cins.first->second = sins.def = new definition_valued(cname, nenum, nenum->type, nenum->modifiers, 0, this_value);
       else
-        token.report_error(herr, "Declatation of constant `" + classname + "' in enumeration conflicts with definition in parent scope");
+        token.report_error(herr, DIAG_REDECLARATION, "Declatation of constant `%s' in enumeration conflicts with definition in parent scope", classname);
     }
     else
-      token.report_error(herr, "Redeclatation of constant `" + classname + "' in enumeration");
+      token.report_error(herr, DIAG_REDECLARATION, "Redeclatation of constant `%s' in enumeration", classname);
     
     ++this_value.val.i;
     
@@ -176,6 +175,7 @@ jdi::definition_enum* jdip::context_parser::handle_enum(definition_scope *scope,
       break;
     }
   }
+  note_declaration(scope, nenum);
   token = read_next_token(scope);
   
   nenum->flags |= incomplete;
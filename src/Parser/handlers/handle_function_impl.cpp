@@ -28,7 +28,7 @@
 #include "handle_function_impl.h"
 using namespace jdip;
 
-static void* code_ignorer(lexer *lex, token_t &token, definition_scope *, error_handler *herr) {
+void* skip_function_implementation(lexer *lex, token_t &token, definition_scope *, error_handler *herr) {
   if (token.type == TT_LEFTBRACE) {
     for (size_t bc = 0;;) {
       if (token.type == TT_LEFTBRACE) ++bc;
@@ -49,5 +49,5 @@ static void* code_ignorer(lexer *lex, token_t &token, definition_scope *, error_
 }
 static void do_nothing(void*) {}
 
-void* (*handle_function_implementation)(lexer *lex, token_t &token, definition_scope *scope, error_handler *herr) = code_ignorer;
+void* (*handle_function_implementation)(lexer *lex, token_t &token, definition_scope *scope, error_handler *herr) = skip_function_implementation;
 void  (*delete_function_implementation)(void* impl) = do_nothing;
@@ -44,6 +44,13 @@
 */
 extern void* (*handle_function_implementation)(jdi::lexer *lex, jdip::token_t &token, jdi::definition_scope *scope, jdi::error_handler *herr);
 
+/**
+  Read past function code content as \c handle_function_implementation would, keeping nothing.
+  This is the default for that pointer, and is used in its place when a context does not keep implementations.
+  @return Returns NULL.
+*/
+void* skip_function_implementation(jdi::lexer *lex, jdip::token_t &token, jdi::definition_scope *scope, jdi::error_handler *herr);
+
 /**
   Function pointer to handle freeing function code content as allocated by a corresponding
   call to handle_function_implementation. Invoked on destruct of the owning function definition.
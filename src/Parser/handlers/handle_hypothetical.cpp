@@ -23,7 +23,7 @@
 #include <API/compile_settings.h>
 
 namespace jdip {
-  definition_hypothetical* handle_hypothetical(lexer *lex, definition_scope *scope, token_t& token, unsigned flags, error_handler *herr) {
+  definition_hypothetical* handle_hypothetical(lexer *lex, definition_scope *scope, token_t& token, unsigned flags, context_parser *cp, error_handler *herr) {
     // Verify that we're in a template<> statement.
     definition_scope* temps;
     for (temps = scope; temps and not (temps->flags & (DEF_TEMPLATE | DEF_TEMPSCOPE)); temps = temps->parent);
@@ -35,11 +35,11 @@ namespace jdip {
     // We are in a template<> declaration. Insert our hypothetical 
     definition_template* temp = temps->flags & DEF_TEMPLATE? (definition_template*)temps : (definition_template*)((definition_tempscope*)temps)->source;
     if (!temp->flags & DEF_TEMPLATE) {
-      token.report_error(herr, "`" + temp->name + "' is not a template");
+      token.report_error(herr, DIAG_MISUSE, "`%s' is not a template", temp->name);
     }
     
-    AST *a = new AST();
-    if (a->parse_expression(token, lex, scope, precedence::scope, herr))
+    AST skipped, *a = !cp or cp->retained() & RETAIN_HYPOTHETICALS? new AST() : NULL;
+    if ((a? a : &skipped)->parse_expression(token, lex, scope, precedence::scope, herr))
       { FATAL_RETURN(1); }
     
     definition_hypothetical* h = new definition_hypothetical("<dependent member>", scope, flags, a);
@@ -36,7 +36,7 @@ int jdip::context_parser::handle_namespace(definition_scope *scope, token_t& tok
   else
   {
     // Copy the name and ensure it's a member of this scope.
-    string nsname(token.content.toString());
+    string nsname(token.toString());
     decpair dins = scope->declare(nsname);
     
     if (dins.inserted) // If a new definition key was created, then allocate a new namespace representation for it.
@@ -44,7 +44,7 @@ int jdip::context_parser::handle_namespace(definition_scope *scope, token_t& tok
     else {
       nscope = (definition_scope*)dins.def;
       if (not(dins.def->flags & DEF_NAMESPACE)) {
-        token.report_error(herr, "Attempting to redeclare `" + nsname + "' as a namespace");
+        token.report_error(herr, DIAG_REDECLARATION, "Attempting to redeclare `%s' as a namespace", nsname);
         return 1;
       }
     }
@@ -57,7 +57,7 @@ int jdip::context_parser::handle_namespace(definition_scope *scope, token_t& tok
   }
   if (handle_scope(nscope, token)) return 1;
   if (token.type != TT_RIGHTBRACE) {
-    token.report_error(herr, "Expected closing brace to namespace `" + nscope->name + "'");
+    token.report_error(herr, DIAG_SYNTAX, "Expected closing brace to namespace `%s'", nscope->name);
     return 1;
   }
   return 0;
@@ -27,14 +27,80 @@
 #include <System/builtins.h>
 #include <System/lex_buffer.h>
 #include <Parser/handlers/handle_function_impl.h>
+#include <System/source_map.h>
 #include <cstdio>
+using namespace jdip;
+using namespace jdi;
+
+void jdip::context_parser::note_declaration(definition_scope *scope, definition *def)
+{
+  if (hdecl and def and (scope == global or (scope->flags & DEF_NAMESPACE)))
+    pending.push_back(pending_declaration(def, scope));
+}
+
+/// Return whether nothing but its scope can refer to a definition, so that it may be freed.
+/// A definition named in an expression, such as a default argument read in the same statement, is kept.
+static bool droppable(const definition *def, const definition_scope *scope)
+{
+  if ((def->flags & (DEF_TYPENAME | DEF_TEMPLATE | DEF_REFERENCED)) or !(def->flags & DEF_TYPED))
+    return false;
+  definition_scope::defiter_c it = scope->members.find(def->name);
+  if (it == scope->members.end() or it->second != def)
+    return false;
+  if (def->flags & DEF_FUNCTION) {
+    const definition_function *f = (const definition_function*)def;
+    if (!f->template_overloads.empty() or f->overloads.size() > 1 or (f->overloads.size() == 1 and f->overloads.begin()->second != f))
+      return false;
+  }
+  return true;
+}
+
+void jdip::context_parser::flush_declarations(size_t mark, source_location start)
+{
+  declaration d;
+  d.line = d.pos = -1;
+  if (!resolve_source(start, d.filename, d.line, d.pos))
+    d.filename.clear(), d.line = d.pos = -1;
+  
+  for (size_t i = mark; i < pending.size(); ++i) {
+    definition *const def = pending[i].def;
+    if (!def) continue;
+    d.def = def;
+    d.scope = pending[i].scope;
+    if (def->flags & DEF_TYPED) {
+      definition_typed *t = (definition_typed*)def;
+      full_type ft(t->type, t->referencers, t->modifiers);
+      ft.refs.name = def->name;
+      d.type.swap(ft);
+    }
+    else {
+      full_type ft(def);
+      d.type.swap(ft);
+    }
+    if (!hdecl->declared(d) or !dropping or !droppable(def, d.scope))
+      continue;
+    
+    // A statement may declare the same thing twice; forget it everywhere before it is freed
+    for (size_t j = i + 1; j < pending.size(); ++j)
+      if (pending[j].def == def) pending[j].def = NULL;
+    d.scope->members.erase(def->name);
+    if ((def->flags & DEF_FUNCTION) and ((definition_function*)def)->implementation)
+      delete_function_implementation(((definition_function*)def)->implementation);
+    delete def;
+  }
+  pending.resize(mark, pending_declaration(NULL, NULL));
+}
 
 int jdip::context_parser::handle_scope(definition_scope *scope, token_t& token, unsigned inherited_flags)
 {
   definition* decl;
+  const size_t noted = pending.size(); // Declarations noted from here on were made within this scope
+  source_location start = 0;
   token = read_next_token(scope);
   for (;;)
   {
+    if (pending.size() == noted)
+      start = token.loc;
     switch (token.type)
     {
       case TT_TYPENAME:
@@ -51,12 +117,18 @@ int jdip::context_parser::handle_scope(definition_scope *scope, token_t& token,
           if (token.type != TT_SEMICOLON) {
             if (token.type == TT_LEFTBRACE || token.type == TT_ASM) {
               if (!(decl and decl->flags & DEF_FUNCTION)) {
-                token.report_error(herr, "Unexpected opening brace here; declaration is not a function");
-                FATAL_RETURN(1);
-                handle_function_implementation(lex,token,scope,herr);
+                if (discarded) // Its declaration was not kept, so neither is its body
+                  skip_function_implementation(lex,token,scope,herr);
+                else {
+                  token.report_error(herr, "Unexpected opening brace here; declaration is not a function");
+                  FATAL_RETURN(1);
+                  handle_function_implementation(lex,token,scope,herr);
+                }
               }
-              else
+              else if (retention & RETAIN_IMPLEMENTATIONS)
                 ((definition_function*)decl)->implementation = handle_function_implementation(lex,token,scope,herr);
+              else
+                skip_function_implementation(lex,token,scope,herr);
               if (token.type != TT_RIGHTBRACE && token.type != TT_SEMICOLON) {
                 token.report_error(herr, "Expected closing symbol to function");
                 continue;
@@ -151,7 +223,7 @@ int jdip::context_parser::handle_scope(definition_scope *scope, token_t& token,
       
       case TT_TYPEDEF:
         token = read_next_token(scope);
-        if (handle_declarators(scope,token,inherited_flags | DEF_TYPENAME)) FATAL_RETURN(1); break;
+        if (handle_declarators(scope,token,inherited_flags | DEF_TYPENAME,decl)) FATAL_RETURN(1); break;
       
       case TT_PUBLIC:
         if (scope->flags & DEF_CLASS) { inherited_flags &= ~(DEF_PRIVATE | DEF_PROTECTED); }
@@ -230,7 +302,7 @@ int jdip::context_parser::handle_scope(definition_scope *scope, token_t& token,
           goto case_TT_DECLARATOR;
       }
       case TT_IDENTIFIER: {
-          string tname(token.content.toString());
+          string tname(token.type == TT_DEFINITION? token.def->name : token.toString());
           if (tname == scope->name and (scope->flags & DEF_CLASS)) {
             token = read_next_token(scope);
             if (token.type != TT_LEFTPARENTH) {
@@ -246,7 +318,7 @@ int jdip::context_parser::handle_scope(definition_scope *scope, token_t& token,
               FATAL_RETURN(1);
             goto handled_declarator_block;
           }
-          token.report_error(herr, "Unexpected identifier in this scope; `" + tname + "' does not name a type");
+          token.report_error(herr, DIAG_MISUSE, "Unexpected identifier in this scope; `%s' does not name a type", tname);
         } break;
       
       case TT_TEMPLATE:
@@ -308,6 +380,9 @@ int jdip::context_parser::handle_scope(definition_scope *scope, token_t& token,
       case TT_ENDOFCODE:
         return 0;
     }
+    // Report what this statement declared before reading on, in case the handler frees any of it
+    if (pending.size() > noted)
+      flush_declarations(noted, start);
     token = read_next_token(scope);
   }
 }
@@ -50,11 +50,11 @@ int context_parser::handle_template(definition_scope *scope, token_t& token, uns
     if (token.type == TT_TYPENAME || token.type == TT_CLASS || token.type == TT_STRUCT) {
       token = lex->get_token(herr);
       if (token.type == TT_IDENTIFIER) {
-        pname = token.content.toString();
+        pname = token.toString();
         token = read_next_token(&hijack);
       }
       if (token.type == TT_OPERATOR) {
-        if (token.content.len != 1 or *token.content.str != '=')
+        if (token.len != 1 or *token.str != '=')
           token.report_error(herr, "Unexpected operator here; value must be denoted by '='");
         token = read_next_token(&hijack);
         full_type fts = read_fulltype(lex, token, &hijack, this, herr);
@@ -72,7 +72,7 @@ int context_parser::handle_template(definition_scope *scope, token_t& token, uns
       pname = ft.refs.name;
       value val;
       if (token.type == TT_OPERATOR) {
-        if (token.content.len != 1 or *token.content.str != '=')
+        if (token.len != 1 or *token.str != '=')
           token.report_error(herr, "Unexpected operator here; value must be denoted by '='");
         token = read_next_token(scope);
         AST a;
@@ -112,18 +112,23 @@ int context_parser::handle_template(definition_scope *scope, token_t& token, uns
       return 1;
     }
     if (nd) {
-      token.report_error(herr, "Cannot declare `" + nd->name + "' as abstract template type");
+      token.report_error(herr, DIAG_MISUSE, "Cannot declare `%s' as abstract template type", nd->name);
       IF_FATAL(if (!hijack.referenced) delete temp; return 1);
     }
   } else if (token.type == TT_DECLARATOR || token.type == TT_DECFLAG || token.type == TT_DECLTYPE || token.type == TT_DEFINITION || token.type == TT_TYPENAME) {
-    if (handle_declarators(&hijack,token,inherited_flags, nd) or !nd) {
+    if (handle_declarators(&hijack,token,inherited_flags, nd) or (!nd and !discarded)) {
       if (!hijack.referenced) delete temp;
       return 1;
     }
+    if (!nd and token.type == TT_LEFTBRACE) // The member it defines was not kept; nor is this
+      skip_function_implementation(lex, token, scope, herr);
     definition *fdef = nd;
     while (fdef and fdef->flags & DEF_TEMPLATE) fdef = ((definition_template*)fdef)->def;
     if (fdef and fdef->flags & DEF_FUNCTION && token.type == TT_LEFTBRACE) {
-      ((definition_function*)nd)->implementation = handle_function_implementation(lex, token, scope, herr);
+      if (retention & RETAIN_IMPLEMENTATIONS)
+        ((definition_function*)nd)->implementation = handle_function_implementation(lex, token, scope, herr);
+      else
+        skip_function_implementation(lex, token, scope, herr);
       if (token.type != TT_RIGHTBRACE) {
         token.report_errorf(herr, "Expected closing brace to function body before %s");
         FATAL_RETURN(1);
@@ -173,7 +178,7 @@ int context_parser::handle_template(definition_scope *scope, token_t& token, uns
       else if (redec->flags & DEF_FUNCTION)
         ((definition_function*)redec)->overload(temp);
       else {
-        token.report_error(herr, "Attempt to redeclare `" + temp->name + "' as template");
+        token.report_error(herr, DIAG_REDECLARATION, "Attempt to redeclare `%s' as template", temp->name);
         delete temp; return ERROR_CODE;
       }
     }
@@ -191,7 +196,7 @@ int context_parser::handle_template(definition_scope *scope, token_t& token, uns
         delete retemp;
       }
       else {
-        token.report_error(herr, "Cannot redeclare `" + temp->name + "' as template: invalid specialization");
+        token.report_error(herr, DIAG_REDECLARATION, "Cannot redeclare `%s' as template: invalid specialization", temp->name);
         delete temp; return ERROR_CODE;
       }
     }
@@ -200,5 +205,6 @@ int context_parser::handle_template(definition_scope *scope, token_t& token, uns
       return ERROR_CODE;
     }
   }
+  else note_declaration(scope, temp);
   return 0;
 }
@@ -33,7 +33,7 @@ static inline definition_union* insnew(definition_scope *const &scope, int inher
   decpair dins = scope->declare(classname);
   if (!dins.inserted) {
     if (dins.def->flags & DEF_TYPENAME) {
-      token.report_error(herr, "Union `" + classname + "' instantiated inadvertently during parse by another thread. Freeing.");
+      token.report_error(herr, DIAG_CONCURRENCY, "Union `%s' instantiated inadvertently during parse by another thread. Freeing.", classname);
       delete ~dins.def;
     }
     else {
@@ -57,7 +57,6 @@ static inline definition_union* insnew(definition_scope *const &scope, int inher
   return nclass;
 }
 
-static unsigned anon_count = 1;
 jdi::definition_union* jdip::context_parser::handle_union(definition_scope *scope, token_t& token, int inherited_flags)
 {
   #ifdef DEBUG_MODE
@@ -82,7 +81,7 @@ jdi::definition_union* jdip::context_parser::handle_union(definition_scope *scop
   // Non-NULL  True               True            Complete class in another scope; can be redeclared (reallocated and reimplemented) in this scope.
   
   if (token.type == TT_IDENTIFIER || token.type == TT_DEFINITION) {
-    classname = token.content.toString();
+    classname = token.type == TT_DEFINITION? token.def->name : token.toString();
     token = read_next_token(scope);
   }
   else if (token.type == TT_DECLARATOR)
@@ -94,12 +93,12 @@ jdi::definition_union* jdip::context_parser::handle_union(definition_scope *scop
       if (nclass->parent == scope) {
         pair<definition_scope::defiter, bool> dins = c_structs.insert(pair<string,definition*>(classname, NULL));
         if (dins.second)
-          dins.first->second = nclass = new definition_union(classname, scope, DEF_INCOMPLETE);
+          dins.first->second = nclass = new definition_union(classname, scope, DEF_UNION | DEF_TYPENAME | DEF_INCOMPLETE);
         else {
           if (dins.first->second->flags & DEF_UNION)
             nclass = (definition_union*)dins.first->second;
           else {
-            token.report_error(herr, "Attempt to redeclare `" + classname + "' as union in this scope");
+            token.report_error(herr, DIAG_REDECLARATION, "Attempt to redeclare `%s' as union in this scope", classname);
             FATAL_RETURN(NULL);
             nclass = NULL;
           }
@@ -125,7 +124,7 @@ jdi::definition_union* jdip::context_parser::handle_union(definition_scope *scop
       return NULL;
   
   if (token.type == TT_COLON) {
-    token.report_error(herr, "Attempting to add ancestors to previously defined class `" + classname + "'");
+    token.report_error(herr, DIAG_REDECLARATION, "Attempting to add ancestors to previously defined class `%s'", classname);
     FATAL_RETURN(NULL);
     do token = read_next_token(scope);
     while (token.type != TT_LEFTBRACE && token.type != TT_SEMICOLON && token.type != TT_ENDOFCODE);
@@ -140,13 +139,14 @@ jdi::definition_union* jdip::context_parser::handle_union(definition_scope *scop
         return NULL;
     }
     else if (already_complete) {
-      token.report_error(herr, "Attempting to add members to previously defined union `" + classname + "'");
+      token.report_error(herr, DIAG_REDECLARATION, "Attempting to add members to previously defined union `%s'", classname);
     }
     if (handle_scope(nclass, token, 0)) FATAL_RETURN(NULL);
     if (token.type != TT_RIGHTBRACE) {
-      token.report_error(herr, "Expected closing brace to union `" + classname + "'");
+      token.report_error(herr, DIAG_SYNTAX, "Expected closing brace to union `%s'", classname);
       FATAL_RETURN(NULL);
     }
+    note_declaration(scope, nclass);
     token = read_next_token(scope);
   }
   
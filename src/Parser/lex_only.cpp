@@ -0,0 +1,216 @@
+/**
+ * @file  lex_only.cpp
+ * @brief Source implementing \c context::lex_C_stream, which reads tokens without parsing them,
+ *        and \c context::scan_includes and the harvest of macros alone, which read only directives.
+ *
+ * Tools which only need tokens, such as highlighters, would otherwise have to poll
+ * \c lexer::get_token, one virtual call and one whole \c token_t at a time. Here, the C++
+ * lexer is driven directly, and each token is reduced to the fields such tools use, appended
+ * to one array for each field. Tools which only need the #include graph, such as build systems,
+ * need no tokens at all; for them, the lexer reads nothing but directives. Nor do tools which
+ * only need the macros a set of headers defines, which a context harvesting only macros reads
+ * the same way.
+ *
+ * @section License
+ *
+ * Copyright (C) 2012 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include <map>
+#include <API/context.h>
+#include <System/lex_cpp.h>
+#include <System/builtins.h>
+#include <System/source_map.h>
+using namespace std;
+using namespace jdi;
+using namespace jdip;
+
+const unsigned token_array::no_file;
+
+void include_graph::clear() {
+  files.clear();
+  edges.clear();
+}
+
+void token_array::clear() {
+  types.clear();
+  offsets.clear();
+  lengths.clear();
+  files.clear();
+  filenames.clear();
+}
+
+namespace {
+  /// Passes everything reported on to another handler, counting the errors.
+  struct error_counter: error_handler {
+    error_handler *herr; ///< The handler to pass reports to.
+    unsigned errors; ///< The number of errors passed on so far.
+    void error(string err, string filename, int line, int pos) { ++errors; herr->error(err, filename, line, pos); }
+    void warning(string err, string filename, int line, int pos) { herr->warning(err, filename, line, pos); }
+    error_counter(error_handler *h): herr(h), errors(0) {}
+  };
+
+  /** Appends tokens to a \c token_array, finding the file of each from its location.
+      Tokens come in long runs from the same file, so the range of the last file found is
+      kept, and the source map is only asked again when a token falls outside of it. **/
+  struct token_sink {
+    token_array &dest; ///< The arrays being filled.
+    map<string, unsigned> ids; ///< The index in \c dest.filenames of each file name seen so far.
+    source_location start; ///< The first location of the file last found.
+    unsigned size; ///< The number of locations in the file last found; zero before any is.
+    unsigned file; ///< The index of the file last found, or \c token_array::no_file.
+
+    /// Find the file holding the given location, for this and the tokens after it.
+    void find(source_location loc) {
+      string fn;
+      if (!find_source(loc, fn, start, size)) {
+        start = loc, size = 1, file = token_array::no_file;
+        return;
+      }
+      pair<map<string, unsigned>::iterator, bool> ins = ids.insert(make_pair(fn, (unsigned)dest.filenames.size()));
+      if (ins.second)
+        dest.filenames.push_back(fn);
+      file = ins.first->second;
+    }
+
+    /// Append a token which was read from a file, or from the expansion of a macro.
+    inline void add(const token_t &t) {
+      if (t.loc - start >= size)
+        find(t.loc);
+      dest.types.push_back(t.type);
+      dest.offsets.push_back(t.loc - start);
+      dest.lengths.push_back(t.len);
+      dest.files.push_back(file);
+    }
+
+    token_sink(token_array &d): dest(d), start(0), size(0), file(token_array::no_file) {}
+  };
+
+  /// Give an identifier read without the lexer the type the lexer would have given it.
+  TOKEN_TYPE classify(const macro_token &mt) {
+    if (mt.token.type != TT_IDENTIFIER)
+      return mt.token.type;
+    const string name((const char*)mt.token.str, mt.token.len);
+    lexer_cpp::keyword_map::const_iterator kwit = lexer_cpp::keywords.find(name);
+    if (kwit != lexer_cpp::keywords.end())
+      return kwit->second == TT_INVALID? TT_IDENTIFIER : kwit->second;
+    tf_iter tfit = builtin_declarators.find(name);
+    if (tfit != builtin_declarators.end())
+      return (tfit->second->usage & UF_STANDALONE_FLAG) == UF_PRIMITIVE? TT_DECLARATOR : TT_DECFLAG;
+    return TT_IDENTIFIER;
+  }
+}
+
+int jdi::context::lex_C_stream(llreader &cfile, token_array &dest, const char* fname, bool preprocess, error_handler *errhandl)
+{
+  if (errhandl)
+    herr = errhandl;
+  if (parse_open) {
+    herr->error("Attempted to invoke lexer while parse is in progress in another thread");
+    return -1;
+  }
+
+  dest.clear();
+  const char *name = fname? fname : "stdcall/file.cpp";
+  if (!preprocess) {
+    vector<macro_token> toks;
+    lexer_cpp::tokenize(cfile.data, cfile.length, 0, toks);
+    dest.filenames.push_back(name);
+    dest.types.reserve(toks.size()), dest.offsets.reserve(toks.size());
+    dest.lengths.reserve(toks.size()), dest.files.reserve(toks.size());
+    for (size_t i = 0; i < toks.size(); ++i) {
+      dest.types.push_back(classify(toks[i]));
+      dest.offsets.push_back((const char*)toks[i].token.str - cfile.data);
+      dest.lengths.push_back(toks[i].token.len);
+      dest.files.push_back(0);
+    }
+    return 0;
+  }
+
+  parse_open = true;
+  error_counter counter(herr);
+  token_sink sink(dest);
+  {
+    lexer_cpp cpp(cfile, macros, search_directories, name);
+    cpp.memoize = memoizing;
+    // Named outright, so that the call is not dispatched through the lexer's virtual table
+    for (token_t t = cpp.lexer_cpp::get_token(&counter); t.type != TT_ENDOFCODE; t = cpp.lexer_cpp::get_token(&counter))
+      sink.add(t);
+  }
+  parse_open = false;
+  return counter.errors;
+}
+
+int jdi::context::scan_includes(llreader &cfile, include_graph &dest, const char* fname, error_handler *errhandl)
+{
+  if (errhandl)
+    herr = errhandl;
+  if (parse_open) {
+    herr->error("Attempted to invoke lexer while parse is in progress in another thread");
+    return -1;
+  }
+  
+  dest.clear();
+  const char *name = fname? fname : "stdcall/file.cpp";
+  parse_open = true;
+  error_counter counter(herr);
+  {
+    lexer_cpp cpp(cfile, macros, search_directories, name);
+    cpp.read_directives(&counter);
+    
+    // Number each file as it is first named, and find the line of each directive while its file is still open
+    map<string, unsigned> ids;
+    ids[name] = 0;
+    dest.files.push_back(name);
+    dest.edges.reserve(cpp.includes.size());
+    for (size_t i = 0; i < cpp.includes.size(); ++i) {
+      const lexer_cpp::include_site &inc = cpp.includes[i];
+      include_graph::edge e;
+      pair<map<string, unsigned>::iterator, bool> from = ids.insert(make_pair(inc.from, (unsigned)dest.files.size()));
+      if (from.second)
+        dest.files.push_back(inc.from);
+      pair<map<string, unsigned>::iterator, bool> to = ids.insert(make_pair(inc.to, (unsigned)dest.files.size()));
+      if (to.second)
+        dest.files.push_back(inc.to);
+      e.from = from.first->second, e.to = to.first->second;
+      string fn; int pos = -1;
+      e.line = -1;
+      resolve_source(inc.at, fn, e.line, pos);
+      dest.edges.push_back(e);
+    }
+  }
+  parse_open = false;
+  return counter.errors;
+}
+
+int jdi::context::harvest_stream(lexer_cpp *source, error_handler *errhandl)
+{
+  if (errhandl)
+    herr = errhandl;
+  if (parse_open) {
+    herr->error("Attempted to invoke lexer while parse is in progress in another thread");
+    delete source;
+    return -1;
+  }
+  
+  // Kept as a parse keeps its lexer, so that the #includes obeyed can be tracked
+  delete lex;
+  lex = source;
+  parse_open = true;
+  error_counter counter(herr);
+  source->read_directives(&counter);
+  parse_open = false;
+  return counter.errors;
+}
@@ -0,0 +1,139 @@
+/**
+ * @file  parse_batch.cpp
+ * @brief Source implementing the parallel batch parser, \c context::parse_C_files.
+ *
+ * Each file is parsed into a context of its own, copied from the context on which
+ * the batch was invoked. Since contexts share nothing mutable, the parses are run
+ * on as many threads as are requested. The resulting contexts are then merged back
+ * into the invoking context on the calling thread.
+ *
+ * @section License
+ *
+ * Copyright (C) 2012 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include <vector>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <General/atomics.h>
+#include "parse_batch.h"
+using namespace std;
+using namespace jdi;
+using namespace jdip;
+
+unsigned long jdip::microtime() {
+  timeval t; gettimeofday(&t, NULL);
+  return t.tv_sec * 1000000ul + t.tv_usec;
+}
+
+namespace {
+  /// The state shared by all threads in a batch.
+  struct batch {
+    const vector<string> &filenames;
+    vector<batch_slot> &slots;
+    const context &base;
+    volatile unsigned next; ///< The index of the next file to be claimed by a thread.
+    batch(const vector<string> &fns, vector<batch_slot> &s, const context &b): filenames(fns), slots(s), base(b), next(0) {}
+  };
+
+  void *batch_worker(void *param) {
+    batch &b = *(batch*)param;
+    for (;;) {
+      const unsigned i = quick::atomic_inc(b.next) - 1;
+      if (i >= b.filenames.size())
+        break;
+      batch_slot &slot = b.slots[i];
+      unsigned long start = microtime();
+      slot.ct = new context(b.base);
+      llreader f(b.filenames[i].c_str());
+      if (f.is_open())
+        slot.result = slot.ct->parse_C_stream(f, b.filenames[i].c_str(), &slot.herr);
+      else {
+        slot.herr.error("Could not open file for parse", b.filenames[i], -1, -1);
+        slot.result = -1;
+      }
+      slot.usec = microtime() - start;
+    }
+    return NULL;
+  }
+}
+
+unsigned jdip::parse_batch(const vector<string> &filenames, const context &base, unsigned thread_count, vector<batch_slot> &dest)
+{
+  if (!thread_count) {
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    thread_count = ncpu < 1? 1 : ncpu;
+  }
+  if (thread_count > filenames.size())
+    thread_count = filenames.size();
+
+  dest.clear();
+  dest.resize(filenames.size());
+  batch b(filenames, dest, base);
+  vector<pthread_t> threads(thread_count);
+
+  unsigned started = 0;
+  for (; started < thread_count; ++started)
+    if (pthread_create(&threads[started], NULL, batch_worker, &b))
+      break;
+  if (!started) // Nothing would start; do the work ourself.
+    batch_worker(&b);
+  for (unsigned i = 0; i < started; ++i)
+    pthread_join(threads[i], NULL);
+  return started? started : 1;
+}
+
+int jdi::context::parse_C_files(const vector<string> &filenames, unsigned thread_count, error_handler *errhandl, parse_report *report)
+{
+  if (errhandl)
+    herr = errhandl;
+  if (parse_open) {
+    herr->error("Attempted to invoke parser while parse is in progress in another thread");
+    return filenames.size();
+  }
+
+  vector<batch_slot> slots;
+  parse_open = true; // Our copies are being made from us; hold still
+  unsigned long start = microtime();
+  const unsigned started = parse_batch(filenames, *this, thread_count, slots);
+  unsigned long parse_usec = microtime() - start;
+  parse_open = false;
+
+  int failures = 0;
+  start = microtime();
+  for (size_t i = 0; i < slots.size(); ++i) {
+    slots[i].herr.replay(herr);
+    if (slots[i].result) ++failures;
+    merge(*slots[i].ct);
+    delete slots[i].ct;
+  }
+  unsigned long merge_usec = microtime() - start;
+
+  if (report) {
+    report->files.resize(filenames.size());
+    for (size_t i = 0; i < filenames.size(); ++i) {
+      report->files[i].filename = filenames[i];
+      report->files[i].result = slots[i].result;
+      report->files[i].error_count = slots[i].herr.error_count;
+      report->files[i].parse_usec = slots[i].usec;
+    }
+    report->thread_count = started;
+    report->parse_usec = parse_usec;
+    report->merge_usec = merge_usec;
+  }
+
+  return failures;
+}
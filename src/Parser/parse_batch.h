@@ -0,0 +1,59 @@
+/**
+ * @file  parse_batch.h
+ * @brief Header declaring the thread pool behind \c context::parse_C_files.
+ *
+ * The pool parses each of a list of files into a copy of some base context, and leaves
+ * merging the results to the caller, which may not want them merged right away.
+ *
+ * @section License
+ *
+ * Copyright (C) 2012 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef _PARSE_BATCH__H
+#define _PARSE_BATCH__H
+
+#include <string>
+#include <vector>
+#include <API/context.h>
+#include <API/error_reporting.h>
+
+namespace jdip {
+  using namespace jdi;
+
+  /// The state of one file in a batch; written only by the thread which claims it.
+  struct batch_slot {
+    context *ct; ///< The context into which the file was parsed, which the caller must free.
+    deferred_error_handler herr; ///< Everything reported while parsing the file.
+    int result; ///< The value returned by the parse, or -1 if the file could not be opened.
+    unsigned long usec; ///< Microseconds spent on this file.
+    batch_slot(): ct(NULL), result(0), usec(0) {}
+  };
+
+  /** Parse each of a list of files into a copy of a base context, on a pool of threads,
+      each thread taking the next unparsed file as it becomes free. The base must not be
+      modified until this returns.
+      @param filenames     The files to be read in.
+      @param base          The context to copy for each file.
+      @param thread_count  The number of threads to parse on; zero uses one per online processor.
+      @param dest          Receives one slot for each file, in the order the files were given. [out]
+      @return Returns the number of threads which did the parsing. **/
+  unsigned parse_batch(const std::vector<std::string> &filenames, const context &base, unsigned thread_count, std::vector<batch_slot> &dest);
+
+  /// Read the wall clock, in microseconds.
+  unsigned long microtime();
+}
+
+#endif
@@ -0,0 +1,80 @@
+/**
+ * @file  parse_budget.cpp
+ * @brief Source implementing the limits on a parse underway.
+ *
+ * @section License
+ *
+ * Copyright (C) 2012 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include "parse_budget.h"
+#include "parse_batch.h"
+using namespace jdip;
+
+parse_budget::parse_budget(const parse_limits &l): limits(l), herr(def_error_handler), errors(0), deadline(0), ending(PARSE_COMPLETE) {}
+
+void parse_budget::begin(error_handler *handler) {
+  herr = handler;
+  errors = 0;
+  deadline = limits.max_usec? microtime() + limits.max_usec : 0;
+  quick::atomic_set(ending, (int)PARSE_COMPLETE);
+  check(); // A parse cancelled before it begins reads nothing
+}
+
+bool parse_budget::check() {
+  if (spent())
+    return true;
+  if (limits.cancel and quick::atomic_get(*limits.cancel))
+    quick::atomic_set(ending, (int)PARSE_CANCELLED);
+  else if (deadline and microtime() >= deadline)
+    quick::atomic_set(ending, (int)PARSE_OUT_OF_TIME);
+  return spent();
+}
+
+bool parse_budget::count_error() {
+  if (spent())
+    return false;
+  if (limits.max_errors and ++errors >= limits.max_errors)
+    quick::atomic_set(ending, (int)PARSE_TOO_MANY_ERRORS);
+  return true;
+}
+
+bool parse_budget::wants(diagnostic_severity severity, diagnostic_id id) {
+  return !spent() and herr->wants(severity, id);
+}
+void parse_budget::report(const diagnostic &d) {
+  if (d.severity == DS_ERROR? count_error() : !spent())
+    herr->report(d);
+}
+void parse_budget::error(std::string err, std::string filename, int line, int pos) {
+  if (count_error())
+    herr->error(err, filename, line, pos);
+}
+void parse_budget::warning(std::string err, std::string filename, int line, int pos) {
+  if (!spent())
+    herr->warning(err, filename, line, pos);
+}
+
+token_t budget_lexer::get_token(error_handler *herr) {
+  if (budget->spent() or (!--countdown and (countdown = interval, budget->check())))
+    return token_t(TT_ENDOFCODE, last);
+  const token_t res = source->get_token(herr);
+  last = res.loc;
+  return res;
+}
+
+void budget_lexer::finish() {
+  while (source->get_token(budget).type != TT_ENDOFCODE);
+}
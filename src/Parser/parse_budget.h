@@ -0,0 +1,96 @@
+/**
+ * @file  parse_budget.h
+ * @brief Header declaring what is left of the limits on a parse underway; see \c context::limit_parses.
+ *
+ * Nothing in the parser can be stopped from outside: it reads tokens until it runs out. So a
+ * parse is stopped by running it out of tokens. The lexer the parse reads from is wrapped in
+ * one which checks the limits every so often, and once any is reached, gives nothing but the
+ * end of the code. Every handler then closes whatever it has open as it would at the end of a
+ * truncated file, and the parse returns, leaving the context consistent. What the handlers
+ * report while closing up is not passed on, as it concerns code which was never read.
+ *
+ * The C++ lexer also looks before it opens an #included file, and once the limits are reached,
+ * reads nothing more itself; where it runs ahead on a thread of its own, this is how that thread
+ * learns to stop.
+ *
+ * @section License
+ *
+ * Copyright (C) 2012 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef _PARSE_BUDGET__H
+#define _PARSE_BUDGET__H
+
+#include <API/context.h>
+#include <API/lexer_interface.h>
+#include <API/error_reporting.h>
+#include <General/atomics.h>
+
+namespace jdip {
+  using namespace jdi;
+
+  /**
+    What is left of the limits on a parse. While the parse runs, this stands between the parser
+    and its error handler, counting errors, and passing nothing on once the parse is stopped.
+  **/
+  struct parse_budget: error_handler {
+    parse_limits limits; ///< The limits on each parse.
+    error_handler *herr; ///< The handler of the parse underway, to which reports are passed on.
+    unsigned errors; ///< The number of errors reported so far in the parse underway.
+    unsigned long deadline; ///< The wall-clock time, in microseconds, past which the parse is stopped; zero for none.
+    volatile int ending; ///< Zero while the parse may run on; otherwise, the \c parse_end it stopped with.
+
+    /// Begin a parse reporting to the given handler, with the whole of each limit left; it is stopped
+    /// at once if it was cancelled already.
+    void begin(error_handler *handler);
+    /// Check the clock and the cancellation flag, stopping the parse if either says to.
+    /// May be called from any thread. @return Returns whether the parse is stopped.
+    bool check();
+    /// Return whether the parse has been stopped. May be called from any thread.
+    bool spent() const { return quick::atomic_get(ending); }
+
+    bool wants(diagnostic_severity severity, diagnostic_id id); ///< Refuse everything once stopped.
+    void report(const diagnostic &d); ///< Count and pass on a diagnostic.
+    void error(std::string err, std::string filename = "", int line = -1, int pos = -1); ///< Count and pass on an error.
+    void warning(std::string err, std::string filename = "", int line = -1, int pos = -1); ///< Pass on a warning.
+
+    /// Construct with the given limits; nothing is counted until \c begin.
+    parse_budget(const parse_limits &l);
+
+  private:
+    /// Count an error, stopping the parse if that was one too many. @return Returns whether to pass it on.
+    bool count_error();
+  };
+
+  /// A lexer giving the tokens of another until the budget of its parse is spent, and the end of the code after.
+  struct budget_lexer: lexer {
+    lexer *source; ///< The lexer whose tokens are given.
+    parse_budget *budget; ///< The budget checked.
+    unsigned countdown; ///< The number of tokens left to give before the clock is checked again.
+    source_location last; ///< Where the last token given was read.
+
+    static const unsigned interval = 256; ///< The number of tokens given between checks of the clock.
+
+    /// Give the next token of the source, or the end of the code if the budget is spent.
+    token_t get_token(error_handler *herr = def_error_handler);
+    /// Read the source to its end, having stopped early, so that nothing is left running behind it.
+    void finish();
+
+    /// Construct wrapping the given lexer, which is not owned.
+    budget_lexer(lexer *src, parse_budget *b): source(src), budget(b), countdown(interval), last(0) {}
+  };
+}
+
+#endif
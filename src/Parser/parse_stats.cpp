@@ -0,0 +1,208 @@
+/**
+ * @file  parse_stats.cpp
+ * @brief Source implementing the clock which times the phases of a parse, and \c parse_stats.
+ *
+ * @section License
+ *
+ * Copyright (C) 2012 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include <ctime>
+#include <iomanip>
+#include <algorithm>
+#include <sys/time.h>
+#include "parse_stats.h"
+using namespace std;
+using namespace jdip;
+
+double jdip::phase_time() {
+  #ifdef CLOCK_MONOTONIC
+    timespec t;
+    if (!clock_gettime(CLOCK_MONOTONIC, &t))
+      return t.tv_sec * 1e6 + t.tv_nsec / 1e3;
+  #endif
+  timeval tv; gettimeofday(&tv, NULL);
+  return tv.tv_sec * 1e6 + tv.tv_usec;
+}
+
+phase_clock::phase_clock(parse_stats *dest): stats(dest), began(phase_time()), last(began), expanded_macros(0) {
+  for (int i = 0; i < PHASE_COUNT; ++i)
+    usec[i] = 0, count[i] = 0;
+  phases.push_back(PHASE_OTHER);
+  count[PHASE_OTHER] = 1;
+  const expansion_count none = { NULL, 0 };
+  expansions.assign(64, none);
+}
+
+phase_clock::~phase_clock() {
+  release_expansions();
+}
+
+void phase_clock::count_new(const macro_type *macro, size_t slot) {
+  macro_type::retain(macro);
+  expansions[slot].macro = macro, expansions[slot].count = 1;
+  if (++expanded_macros * 2 <= expansions.size())
+    return;
+  // Rehash into a table twice the size
+  const expansion_count none = { NULL, 0 };
+  vector<expansion_count> old(expansions.size() * 2, none);
+  old.swap(expansions);
+  const size_t mask = expansions.size() - 1;
+  for (size_t i = 0; i < old.size(); ++i)
+    if (old[i].macro) {
+      size_t at = ((size_t)old[i].macro >> 4) & mask;
+      while (expansions[at].macro)
+        at = (at + 1) & mask;
+      expansions[at] = old[i];
+    }
+}
+
+void phase_clock::release_expansions() {
+  for (size_t i = 0; i < expansions.size(); ++i)
+    if (expansions[i].macro)
+      macro_type::free(expansions[i].macro), expansions[i].macro = NULL;
+  expanded_macros = 0;
+}
+
+void phase_clock::enter(parse_phase phase) {
+  const double now = phase_time();
+  usec[phases.back()] += now - last;
+  last = now;
+  phases.push_back(phase);
+  ++count[phase];
+}
+
+void phase_clock::leave() {
+  const double now = phase_time();
+  usec[phases.back()] += now - last;
+  last = now;
+  if (phases.size() > 1)
+    phases.pop_back();
+}
+
+void phase_clock::enter_file(const char *filename) {
+  pair<map<string, size_t>::iterator, bool> ins = file_index.insert(pair<string, size_t>(filename, files.size()));
+  if (ins.second) {
+    parse_stats::file_stats f;
+    f.filename = filename;
+    f.opened = 0;
+    f.inclusive_usec = f.exclusive_usec = 0;
+    files.push_back(f);
+    inclusive.push_back(0), exclusive.push_back(0);
+  }
+  ++files[ins.first->second].opened;
+  const file_frame frame = { ins.first->second, phase_time(), 0 };
+  frames.push_back(frame);
+}
+
+void phase_clock::leave_file() {
+  if (frames.empty())
+    return;
+  const file_frame &f = frames.back();
+  const double spent = phase_time() - f.start;
+  inclusive[f.file] += spent;
+  exclusive[f.file] += spent - f.children;
+  frames.pop_back();
+  if (!frames.empty())
+    frames.back().children += spent;
+}
+
+void phase_clock::finish() {
+  while (phases.size() > 1)
+    leave();
+  leave();
+  while (!frames.empty())
+    leave_file();
+  
+  const unsigned long wall = (unsigned long)(last - began);
+  if (wall > stats->usec)
+    stats->usec = wall;
+  for (int i = 0; i < PHASE_COUNT; ++i)
+    stats->phases[i].usec += (unsigned long)usec[i], stats->phases[i].count += count[i];
+  for (size_t i = 0; i < files.size(); ++i) {
+    size_t at = 0;
+    while (at < stats->files.size() and stats->files[at].filename != files[i].filename)
+      ++at;
+    if (at == stats->files.size())
+      stats->files.push_back(files[i]);
+    else
+      stats->files[at].opened += files[i].opened;
+    stats->files[at].inclusive_usec += (unsigned long)inclusive[i];
+    stats->files[at].exclusive_usec += (unsigned long)exclusive[i];
+  }
+  for (size_t i = 0; i < expansions.size(); ++i)
+    if (expansions[i].macro)
+      stats->expansions[expansions[i].macro->name] += expansions[i].count;
+  release_expansions();
+}
+
+namespace jdi {
+  parse_stats::parse_stats() { clear(); }
+  
+  void parse_stats::clear() {
+    usec = 0;
+    for (int i = 0; i < PHASE_COUNT; ++i)
+      phases[i].usec = phases[i].count = 0;
+    files.clear();
+    expansions.clear();
+  }
+  
+  const char *parse_stats::phase_name(parse_phase phase) {
+    switch (phase) {
+      case PHASE_OTHER:        return "other";
+      case PHASE_IO:           return "I/O";
+      case PHASE_DIRECTIVES:   return "directives";
+      case PHASE_CONDITIONALS: return "#if evaluation";
+      case PHASE_MACROS:       return "macro expansion";
+      case PHASE_DECLARATORS:  return "declarators";
+      case PHASE_LOOKUP:       return "scope lookup";
+      case PHASE_COUNT:
+      default:                 return "unknown";
+    }
+  }
+  
+  /// Order files by exclusive time, the costliest first.
+  static bool costlier(const parse_stats::file_stats *a, const parse_stats::file_stats *b) {
+    return a->exclusive_usec > b->exclusive_usec;
+  }
+  /// Order macros by expansions, the most expanded first.
+  static bool more_expanded(const pair<unsigned long, const string*> &a, const pair<unsigned long, const string*> &b) {
+    return a.first > b.first;
+  }
+  
+  void parse_stats::print(ostream &out, size_t limit) const {
+    out << "Parsed in " << usec << " microseconds." << endl;
+    for (int i = 0; i < PHASE_COUNT; ++i)
+      out << "  " << left << setw(16) << phase_name(parse_phase(i)) << right << setw(10) << phases[i].usec
+          << " usec" << setw(10) << phases[i].count << " times" << endl;
+    
+    vector<const file_stats*> costliest;
+    for (size_t i = 0; i < files.size(); ++i)
+      costliest.push_back(&files[i]);
+    sort(costliest.begin(), costliest.end(), costlier);
+    out << files.size() << " files read; the costliest, by exclusive time:" << endl;
+    for (size_t i = 0; i < costliest.size() and i < limit; ++i)
+      out << "  " << setw(10) << costliest[i]->exclusive_usec << " usec" << setw(10) << costliest[i]->inclusive_usec
+          << " inclusive, opened " << costliest[i]->opened << " times: " << costliest[i]->filename << endl;
+    
+    vector< pair<unsigned long, const string*> > most;
+    for (map<string, unsigned long>::const_iterator it = expansions.begin(); it != expansions.end(); ++it)
+      most.push_back(pair<unsigned long, const string*>(it->second, &it->first));
+    sort(most.begin(), most.end(), more_expanded);
+    out << most.size() << " macros expanded; the most expanded:" << endl;
+    for (size_t i = 0; i < most.size() and i < limit; ++i)
+      out << "  " << setw(10) << most[i].first << " times: " << *most[i].second << endl;
+  }
+}
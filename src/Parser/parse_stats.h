@@ -0,0 +1,121 @@
+/**
+ * @file  parse_stats.h
+ * @brief Header declaring the clock which times the phases of a parse into a \c parse_stats.
+ *
+ * Each thread taking part in a parse keeps a clock of its own. The clock keeps a stack of the
+ * phases entered, and each time a phase is entered or left, the time since the clock was last
+ * read is charged to the phase on top; so each phase is charged only what was spent in it, and
+ * not in phases within it. Files are timed likewise, on a stack of their own. Nothing is written
+ * to the \c parse_stats until the clock is finished, on the parser's thread, once the thread it
+ * timed has finished with it.
+ *
+ * Where \c PARSE_STATS is 0, the scoped timers placed through the lexer and parser compile to
+ * nothing, and no clock is ever made.
+ *
+ * @section License
+ *
+ * Copyright (C) 2012 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef _PARSE_STATS__H
+#define _PARSE_STATS__H
+
+#include <map>
+#include <string>
+#include <vector>
+#include <API/context.h>
+#include <API/compile_settings.h>
+
+#if PARSE_STATS
+  /// Include the given statement only where parses may be timed.
+  #define PARSE_STATS_ONLY(x) x
+#else
+  #define PARSE_STATS_ONLY(x)
+#endif
+
+namespace jdip {
+  using namespace jdi;
+
+  /// Read a steady clock, in microseconds from some fixed point.
+  double phase_time();
+
+  /// Times the phases of a parse on one thread, and the files and macros that thread reads.
+  struct phase_clock {
+    void enter(parse_phase phase); ///< Charge the time since the clock was last read to the current phase, and enter another.
+    void leave(); ///< Charge the time since the clock was last read to the current phase, and return to the one before.
+    void enter_file(const char *filename); ///< Begin timing a file just opened, within the file open before.
+    void leave_file(); ///< Finish timing the innermost open file.
+    /// Count an expansion of the given macro; it is named only once the clock is finished.
+    void expanded(const macro_type *macro) {
+      for (size_t i = ((size_t)macro >> 4) & (expansions.size() - 1);; i = (i + 1) & (expansions.size() - 1)) {
+        if (expansions[i].macro == macro) { ++expansions[i].count; return; }
+        if (!expansions[i].macro) { count_new(macro, i); return; }
+      }
+    }
+    /// Stop the clock, leaving every phase and file still open, and add what was timed to the stats.
+    void finish();
+    /// Start the clock, in no phase but \c PHASE_OTHER, with no file open.
+    /// @param dest  The stats to add what is timed to, once finished.
+    phase_clock(parse_stats *dest);
+    /// Release any macro counted, if the clock was never finished.
+    ~phase_clock();
+
+  private:
+    /// A file open, and how long was spent in files it included.
+    struct file_frame {
+      size_t file; ///< The index of the file in \c files.
+      double start; ///< When the file was opened.
+      double children; ///< The time spent in files it included, while it was open.
+    };
+    parse_stats *stats; ///< The stats to add to when finished.
+    double began; ///< When the clock was started.
+    double last; ///< When the clock was last read.
+    double usec[PHASE_COUNT]; ///< The time charged to each phase so far.
+    unsigned long count[PHASE_COUNT]; ///< The number of times each phase has been entered.
+    std::vector<unsigned char> phases; ///< The phases entered and not yet left, innermost last.
+    std::vector<file_frame> frames; ///< The files open, innermost last.
+    std::vector<parse_stats::file_stats> files; ///< Each file opened, in order; times are filled in once finished.
+    std::vector<double> inclusive; ///< The time spent in each file, including files it included.
+    std::vector<double> exclusive; ///< The time spent in each file, not including files it included.
+    std::map<std::string, size_t> file_index; ///< The index in \c files of each file name.
+    /// The number of times one macro was expanded.
+    struct expansion_count {
+      const macro_type *macro; ///< The macro, retained until the clock is finished, or NULL in a free slot.
+      unsigned long count; ///< The number of times it was expanded.
+    };
+    /// Each macro expanded, hashed by address with linear probing; the size is a power of two, kept at
+    /// least twice the number of macros counted.
+    std::vector<expansion_count> expansions;
+    size_t expanded_macros; ///< The number of macros counted in \c expansions.
+    void count_new(const macro_type *macro, size_t slot); ///< Count the first expansion of a macro, in the free slot given.
+    void release_expansions(); ///< Release every macro counted, and empty \c expansions.
+    
+    phase_clock(const phase_clock&); ///< Clocks retain the macros they count, and are not copied.
+    phase_clock &operator=(const phase_clock&); ///< Clocks retain the macros they count, and are not copied.
+  };
+
+  /// Times the phase of a parse in which it is constructed, until it is destroyed; does nothing without a clock.
+  struct phase_scope {
+    #if PARSE_STATS
+      phase_clock *const clock; ///< The clock timing the phase, or NULL.
+      phase_scope(phase_clock *c, parse_phase phase): clock(c) { if (clock) clock->enter(phase); }
+      ~phase_scope() { if (clock) clock->leave(); }
+    #else
+      phase_scope(phase_clock*, parse_phase) {}
+    #endif
+  };
+}
+
+#endif
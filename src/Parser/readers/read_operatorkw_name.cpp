@@ -6,7 +6,7 @@ string jdip::read_operatorkw_name(lexer* lex, token_t &token, definition_scope *
   string res;
   token = lex->get_token_in_scope(scope, herr);
   if (token.type == TT_OPERATOR or token.type == TT_LESSTHAN or token.type == TT_GREATERTHAN or token.type == TT_TILDE) {
-    res = "operator" + token.content.toString();
+    res = "operator" + token.toString();
     token = lex->get_token_in_scope(scope, herr);
   }
   else if (token.type == TT_LEFTBRACKET) {
@@ -27,7 +27,7 @@ definition* jdip::read_qualified_definition(lexer *lex, definition_scope* scope,
         }
       }
       else {
-        token.report_error(herr, "Template `" + token.def->name + "' cannot be used as a type");
+        token.report_error(herr, DIAG_MISUSE, "Template `%s' cannot be used as a type", token.def->name);
         //cerr << token.def->toString();
         return FATAL_TERNARY(NULL,res);
       }
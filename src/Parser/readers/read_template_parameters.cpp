@@ -64,7 +64,7 @@ int jdip::read_template_parameters(arg_key &argk, definition_template *temp, lex
     }
   }
   if (args_given > temp->params.size()) {
-      token.report_error(herr, "Too many template parameters provided to `" + temp->toString(0,0) + "'");
+      token.report_error(herr, DIAG_TEMPLATE_ARGUMENTS, "Too many template parameters provided to `%s'", temp->toString(0,0));
       FATAL_RETURN(1);
   }
   int bad_params = 0;
@@ -27,12 +27,14 @@
 #include <General/parse_basics.h>
 #include <General/debug_macros.h>
 #include <Parser/parse_context.h>
+#include <Parser/parse_stats.h>
 #include <System/builtins.h>
 #include <cstdio>
 using namespace jdip;
 using namespace jdi;
 
 full_type jdip::read_fulltype(lexer *lex, token_t &token, definition_scope *scope, context_parser *cp, error_handler *herr) {
+  phase_scope timing(lex->clock, PHASE_DECLARATORS);
   full_type ft = read_type(lex, token, scope, cp, herr);
   if (ft.def)
     jdip::read_referencers(ft.refs, ft, lex, token, scope, cp, herr);
@@ -74,12 +76,12 @@ full_type jdip::read_type(lexer *lex, token_t &token, definition_scope *scope, c
             else if (scope->flags & DEF_TEMPSCOPE and ((definition_template*)rdef)->def == scope->parent)
               rdef = scope->parent;
             else {
-              token.report_error(herr, "Invalid use of template `" + rdef->name + "'");
+              token.report_error(herr, DIAG_MISUSE, "Invalid use of template `%s'", rdef->name);
               return NULL;
             }
           }
           else {
-            token.report_error(herr, "Expected type name here; `" + rdef->name + "' does not name a type");
+            token.report_error(herr, DIAG_MISUSE, "Expected type name here; `%s' does not name a type", rdef->name);
             return NULL;
           }
         }
@@ -90,12 +92,12 @@ full_type jdip::read_type(lexer *lex, token_t &token, definition_scope *scope, c
       }
       else if (token.type == TT_TYPENAME) {
         token = lex->get_token_in_scope(scope, herr);
-        if (not(rdef = handle_hypothetical(lex, scope, token, DEF_TYPENAME, herr)))
+        if (not(rdef = handle_hypothetical(lex, scope, token, DEF_TYPENAME, cp, herr)))
           return full_type();
       }
       else {
         if (token.type == TT_IDENTIFIER or token.type == TT_DEFINITION)
-          token.report_error(herr,"Type name expected here; `" + token.content.toString() + "' does not name a type");
+          token.report_error(herr,"Type name expected here; `" + (token.type == TT_DEFINITION? token.def->name : token.toString()) + "' does not name a type");
         else
           token.report_errorf(herr,"Type name expected here before %s");
         return full_type();
@@ -170,7 +172,7 @@ full_type jdip::read_type(lexer *lex, token_t &token, definition_scope *scope, c
     else if (token.type == TT_TYPENAME) {
       //if (!cp) { token.report_error(herr, "Cannot use dependent type in this context"); return full_type(); }
       token = lex->get_token_in_scope(scope);
-      rdef = handle_hypothetical(lex, scope, token, DEF_TYPENAME, herr);
+      rdef = handle_hypothetical(lex, scope, token, DEF_TYPENAME, cp, herr);
     }
     if (rdef == NULL)
     {
@@ -205,7 +207,7 @@ int jdip::read_referencers(ref_stack &refs, const full_type& ft, lexer *lex, tok
         if (((ft.def == scope) // If the definition is this scope
             or ((scope->flags & DEF_TEMPSCOPE) and ft.def == scope->parent) // Or we're in a template and the definition is the parent of this scope
             or ((ft.def->flags & DEF_TEMPLATE) and ((definition_template*)ft.def)->def == scope) // Or our definition is the template whose scope we are in
-          ) and (token.type != TT_OPERATOR or token.content.len != 1 or *token.content.str != '*'))
+          ) and (token.type != TT_OPERATOR or token.len != 1 or *token.str != '*'))
         {
           if (read_function_params(refs, lex, token, scope, cp, herr)) return 1;
           ref_stack appme; int res = read_referencers_post(appme, lex, token, scope, cp, herr);
@@ -230,10 +232,17 @@ int jdip::read_referencers(ref_stack &refs, const full_type& ft, lexer *lex, tok
         token = lex->get_token_in_scope(scope);
         if (token.type == TT_SCOPE) {
           if (!(d->flags & DEF_SCOPE)) {
-            token.report_error(herr, "Cannot access `" + d->name + "' as scope");
+            token.report_error(herr, DIAG_MISUSE, "Cannot access `%s' as scope", d->name);
             return 1;
           }
           token = lex->get_token_in_scope((definition_scope*)d, herr);
+          if (token.type == TT_IDENTIFIER and d->flags & DEF_CLASS and cp and cp->skipped_private(d, token.toString())) {
+            // The definition of a private member which was not kept; read past it, within its class
+            cp->discard_declarator();
+            token = lex->get_token_in_scope((definition_scope*)d, herr);
+            ref_stack appme; int res = read_referencers_post(appme, lex, token, (definition_scope*)d, cp, herr);
+            refs.append_c(appme); return res;
+          }
           if (token.type != TT_DEFINITION and token.type != TT_DECLARATOR) {
             token.report_errorf(herr, "Expected qualified-id before %s");
             return 1;
@@ -258,7 +267,7 @@ int jdip::read_referencers(ref_stack &refs, const full_type& ft, lexer *lex, tok
         refs.append_c(appme); return res;
       }
       case TT_IDENTIFIER: {// The name associated with this type
-        refs.name = token.content.toString();
+        refs.name = token.toString();
         token = lex->get_token_in_scope(scope);
         ref_stack appme; int res = read_referencers_post(appme, lex, token, scope, cp, herr);
         refs.append_c(appme); return res;
@@ -272,8 +281,8 @@ int jdip::read_referencers(ref_stack &refs, const full_type& ft, lexer *lex, tok
       
       
       case TT_OPERATOR: // Could be an asterisk or ampersand
-        if ((token.content.str[0] == '&' or token.content.str[0] == '*') and token.content.len == 1) {
-          refs.push(token.content.str[0] == '&'? ref_stack::RT_REFERENCE : ref_stack::RT_POINTERTO);
+        if ((token.str[0] == '&' or token.str[0] == '*') and token.len == 1) {
+          refs.push(token.str[0] == '&'? ref_stack::RT_REFERENCE : ref_stack::RT_POINTERTO);
           break;
         } goto default_; // Else overflow
       
@@ -339,8 +348,8 @@ int jdip::read_referencers_post(ref_stack &refs, lexer *lex, token_t &token, def
       continue;
       
       case TT_OPERATOR: // Could be an asterisk or ampersand
-        if ((token.content.str[0] == '&' or token.content.str[0] == '*') and token.content.len == 1) {
-          refs.push(token.content.str[0] == '&'? ref_stack::RT_REFERENCE : ref_stack::RT_POINTERTO);
+        if ((token.str[0] == '&' or token.str[0] == '*') and token.len == 1) {
+          refs.push(token.str[0] == '&'? ref_stack::RT_REFERENCE : ref_stack::RT_POINTERTO);
           break;
         } goto default_; // Else overflow
       
@@ -373,6 +382,48 @@ int jdip::read_referencers_post(ref_stack &refs, lexer *lex, token_t &token, def
   }
 }
 
+/** Read past a default argument without building anything, as skip_function_implementation reads past
+    a body: every token up to the comma or closing parenthesis which ends it, outside any brackets.
+    A template named just before a left triangle bracket opens a list of template arguments, whose
+    commas are its own, as the expression parser would read them. **/
+static void skip_default_argument(lexer *lex, token_t &token, definition_scope *scope, error_handler *herr)
+{
+  vector<size_t> angles; // The bracket depth at which each open list of template arguments began
+  definition *named = NULL, *qualifier = NULL; // What the last token named, and the scope named before it, if any
+  for (size_t depth = 0; token.type != TT_ENDOFCODE; ) {
+    const TOKEN_TYPE tt = token.type;
+    if (tt == TT_LEFTPARENTH or tt == TT_LEFTBRACKET or tt == TT_LEFTBRACE)
+      ++depth;
+    else if (tt == TT_RIGHTPARENTH or tt == TT_RIGHTBRACKET or tt == TT_RIGHTBRACE) {
+      if (!depth)
+        return;
+      while (!angles.empty() and angles.back() == depth)
+        angles.pop_back();
+      --depth;
+    }
+    else if ((tt == TT_COMMA and angles.empty()) or tt == TT_SEMICOLON) {
+      if (!depth)
+        return;
+    }
+    else if (tt == TT_LESSTHAN) {
+      if (named and (named->flags & DEF_TEMPLATE))
+        angles.push_back(depth);
+    }
+    else if (tt == TT_GREATERTHAN) {
+      if (!angles.empty() and angles.back() == depth)
+        angles.pop_back();
+    }
+    definition *const last = named;
+    // What follows a scope is named within it, not within the scope the lexer looks in
+    if (qualifier and (tt == TT_DEFINITION or tt == TT_DECLARATOR or tt == TT_IDENTIFIER))
+      named = ((definition_scope*)qualifier)->look_up(token.toString());
+    else
+      named = tt == TT_DEFINITION or tt == TT_DECLARATOR? token.def : NULL;
+    qualifier = tt == TT_SCOPE and last and (last->flags & DEF_SCOPE)? last : NULL;
+    token = lex->get_token_in_scope(scope, herr);
+  }
+}
+
 int jdip::read_function_params(ref_stack &refs, lexer *lex, token_t &token, definition_scope *scope, context_parser *cp, error_handler *herr)
 {
   ref_stack::parameter_ct params;
@@ -391,15 +442,19 @@ int jdip::read_function_params(ref_stack &refs, lexer *lex, token_t &token, defi
     param.swap_in(a); // Give it our read-in full type (including ref stack, which is costly to copy)
     param.variadic = cp? cp->variadics.find(param.def) != cp->variadics.end() : false;
     if (token.type == TT_OPERATOR) {
-      if (token.content.len != 1 or *token.content.str != '=') {
+      if (token.len != 1 or *token.str != '=') {
         token.report_errorf(herr, "Unexpected operator at this point; expected '=' or ')' before %s");
         FATAL_RETURN(1);
       }
-      else {
+      else if (!cp or cp->retained() & RETAIN_DEFAULT_ARGUMENTS) {
         param.default_value = new AST;
         token = lex->get_token_in_scope(scope, herr);
         param.default_value->parse_expression(token, lex, scope, precedence::comma+1, herr);
       }
+      else { // Read past it, keeping nothing
+        token = lex->get_token_in_scope(scope, herr);
+        skip_default_argument(lex, token, scope, herr);
+      }
     }
     params.throw_on(param);
     
@@ -0,0 +1,280 @@
+/**
+ * @file  reparse.cpp
+ * @brief Source implementing the tracking of parsed files, and \c context::reparse_changed.
+ *
+ * @section License
+ *
+ * Copyright (C) 2012 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include <set>
+#include <sys/stat.h>
+#include <API/context.h>
+#include <System/source_map.h>
+#include <System/token_cache.h>
+#include "parse_batch.h"
+#include "reparse.h"
+using namespace std;
+using namespace jdi;
+using namespace jdip;
+
+bool jdip::restamp_file(const string &path, file_stamp &stamp)
+{
+  struct stat st;
+  if (stat(path.c_str(), &st)) {
+    const bool was = stamp.present;
+    stamp = file_stamp();
+    return was;
+  }
+  if (stamp.present and st.st_mtime == stamp.mtime and (size_t)st.st_size == stamp.size)
+    return false;
+
+  llreader f(path.c_str());
+  file_stamp now;
+  now.present = f.is_open();
+  now.mtime = st.st_mtime;
+  now.size = now.present? f.length : 0;
+  now.hash = now.present? hash_text(f.data, f.length) : 0;
+  const bool changed = now.present != stamp.present or now.size != stamp.size or now.hash != stamp.hash;
+  stamp = now;
+  return changed;
+}
+
+unsigned dependency_tracker::file_id(const string &path)
+{
+  pair<map<string, unsigned>::iterator, bool> ins = ids.insert(make_pair(path, (unsigned)files.size()));
+  if (ins.second) {
+    tracked_file f;
+    f.path = path;
+    restamp_file(path, f.stamp);
+    files.push_back(f);
+  }
+  return ins.first->second;
+}
+
+void dependency_tracker::record(tracked_unit &unit, const lexer_cpp *lex)
+{
+  unit.files.clear();
+  unit.edges.clear();
+  set<unsigned> seen;
+  unit.files.push_back(file_id(unit.filename));
+  seen.insert(unit.files[0]);
+  if (!lex)
+    return;
+
+  unit.edges.reserve(lex->includes.size());
+  for (size_t i = 0; i < lex->includes.size(); ++i) {
+    const lexer_cpp::include_site &inc = lex->includes[i];
+    include_graph::edge e;
+    e.from = file_id(inc.from);
+    e.to = file_id(inc.to);
+    if (seen.insert(e.to).second)
+      unit.files.push_back(e.to);
+    string fn; int pos = -1;
+    e.line = -1;
+    resolve_source(inc.at, fn, e.line, pos);
+    unit.edges.push_back(e);
+  }
+}
+
+void dependency_tracker::prune()
+{
+  vector<tracked_file> kept;
+  vector<unsigned> renumber(files.size(), ~0u);
+  for (size_t u = 0; u < units.size(); ++u)
+    for (size_t i = 0; i < units[u].files.size(); ++i) {
+      const unsigned f = units[u].files[i];
+      if (renumber[f] == ~0u) {
+        renumber[f] = kept.size();
+        kept.push_back(files[f]);
+      }
+    }
+  bool same = kept.size() == files.size();
+  for (size_t i = 0; same and i < renumber.size(); ++i)
+    same = renumber[i] == i;
+  if (same)
+    return;
+
+  for (size_t u = 0; u < units.size(); ++u) {
+    for (size_t i = 0; i < units[u].files.size(); ++i)
+      units[u].files[i] = renumber[units[u].files[i]];
+    for (size_t i = 0; i < units[u].edges.size(); ++i)
+      units[u].edges[i].from = renumber[units[u].edges[i].from],
+      units[u].edges[i].to = renumber[units[u].edges[i].to];
+  }
+  files.swap(kept);
+  ids.clear();
+  for (size_t i = 0; i < files.size(); ++i)
+    ids[files[i].path] = i;
+}
+
+dependency_tracker::dependency_tracker(const context &b): base(new context(b)) {}
+
+dependency_tracker::~dependency_tracker() {
+  for (size_t i = 0; i < units.size(); ++i)
+    delete units[i].ct;
+  delete base;
+}
+
+int jdi::context::track_files(const vector<string> &filenames, unsigned thread_count, error_handler *errhandl, parse_report *report)
+{
+  if (errhandl)
+    herr = errhandl;
+  if (parse_open) {
+    herr->error("Attempted to invoke parser while parse is in progress in another thread");
+    return filenames.size();
+  }
+
+  if (!tracker)
+    tracker = new dependency_tracker(*this);
+
+  // Files already tracked are left to reparse_changed
+  vector<string> fresh;
+  for (size_t i = 0; i < filenames.size(); ++i) {
+    bool known = false;
+    for (size_t u = 0; u < tracker->units.size() and !known; ++u)
+      known = tracker->units[u].filename == filenames[i];
+    for (size_t j = 0; j < fresh.size() and !known; ++j)
+      known = fresh[j] == filenames[i];
+    if (!known)
+      fresh.push_back(filenames[i]);
+  }
+
+  vector<batch_slot> slots;
+  unsigned long start = microtime();
+  const unsigned started = parse_batch(fresh, *tracker->base, thread_count, slots);
+  unsigned long parse_usec = microtime() - start;
+
+  int failures = 0;
+  start = microtime();
+  for (size_t i = 0; i < slots.size(); ++i) {
+    slots[i].herr.replay(herr);
+    if (slots[i].result) ++failures;
+    tracked_unit unit;
+    unit.filename = fresh[i];
+    unit.ct = slots[i].ct;
+    tracker->record(unit, (const lexer_cpp*)unit.ct->lex);
+    delete unit.ct->lex; unit.ct->lex = NULL; // The lexer is kept only until the lines of its #includes are found
+    tracker->units.push_back(unit);
+    context copied(*unit.ct); // Merging guts its source; the unit is kept for the next rebuild
+    merge(copied);
+  }
+  unsigned long merge_usec = microtime() - start;
+
+  if (report) {
+    report->files.resize(fresh.size());
+    for (size_t i = 0; i < fresh.size(); ++i) {
+      report->files[i].filename = fresh[i];
+      report->files[i].result = slots[i].result;
+      report->files[i].error_count = slots[i].herr.error_count;
+      report->files[i].parse_usec = slots[i].usec;
+    }
+    report->thread_count = started;
+    report->parse_usec = parse_usec;
+    report->merge_usec = merge_usec;
+  }
+  return failures;
+}
+
+int jdi::context::reparse_changed(unsigned thread_count, error_handler *errhandl, parse_report *report)
+{
+  if (errhandl)
+    herr = errhandl;
+  if (parse_open) {
+    herr->error("Attempted to invoke parser while parse is in progress in another thread");
+    return -1;
+  }
+  if (report)
+    report->files.clear(), report->thread_count = 0, report->parse_usec = report->merge_usec = 0;
+  if (!tracker)
+    return 0;
+
+  vector<bool> changed(tracker->files.size());
+  bool any = false;
+  for (size_t i = 0; i < tracker->files.size(); ++i)
+    any |= changed[i] = restamp_file(tracker->files[i].path, tracker->files[i].stamp);
+  if (!any)
+    return 0;
+
+  vector<size_t> stale;
+  vector<string> filenames;
+  for (size_t u = 0; u < tracker->units.size(); ++u)
+    for (size_t i = 0; i < tracker->units[u].files.size(); ++i)
+      if (changed[tracker->units[u].files[i]]) {
+        stale.push_back(u);
+        filenames.push_back(tracker->units[u].filename);
+        break;
+      }
+
+  vector<batch_slot> slots;
+  unsigned long start = microtime();
+  const unsigned started = parse_batch(filenames, *tracker->base, thread_count, slots);
+  unsigned long parse_usec = microtime() - start;
+
+  int failures = 0;
+  start = microtime();
+  for (size_t i = 0; i < slots.size(); ++i) {
+    slots[i].herr.replay(herr);
+    if (slots[i].result) ++failures;
+    tracked_unit &unit = tracker->units[stale[i]];
+    delete unit.ct;
+    unit.ct = slots[i].ct;
+    tracker->record(unit, (const lexer_cpp*)unit.ct->lex);
+    delete unit.ct->lex; unit.ct->lex = NULL;
+  }
+  tracker->prune();
+
+  // Anything merged from a stale unit may be referred to by anything else; start over from the base
+  context rebuilt(*tracker->base);
+  for (size_t u = 0; u < tracker->units.size(); ++u) {
+    context copied(*tracker->units[u].ct);
+    rebuilt.merge(copied);
+  }
+  swap(rebuilt);
+  unsigned long merge_usec = microtime() - start;
+
+  if (report) {
+    report->files.resize(filenames.size());
+    for (size_t i = 0; i < filenames.size(); ++i) {
+      report->files[i].filename = filenames[i];
+      report->files[i].result = slots[i].result;
+      report->files[i].error_count = slots[i].herr.error_count;
+      report->files[i].parse_usec = slots[i].usec;
+    }
+    report->thread_count = started;
+    report->parse_usec = parse_usec;
+    report->merge_usec = merge_usec;
+  }
+  return failures;
+}
+
+void jdi::context::get_dependencies(include_graph &dest) const
+{
+  dest.clear();
+  if (!tracker)
+    return;
+  dest.files.reserve(tracker->files.size());
+  for (size_t i = 0; i < tracker->files.size(); ++i)
+    dest.files.push_back(tracker->files[i].path);
+
+  // Units including the same headers obey the same #includes; list each once
+  set< pair<pair<unsigned, unsigned>, int> > seen;
+  for (size_t u = 0; u < tracker->units.size(); ++u)
+    for (size_t i = 0; i < tracker->units[u].edges.size(); ++i) {
+      const include_graph::edge &e = tracker->units[u].edges[i];
+      if (seen.insert(make_pair(make_pair(e.from, e.to), e.line)).second)
+        dest.edges.push_back(e);
+    }
+}
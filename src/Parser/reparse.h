@@ -0,0 +1,101 @@
+/**
+ * @file  reparse.h
+ * @brief Header declaring what a context keeps of the files it tracks, for \c context::reparse_changed.
+ *
+ * What a header defines depends on every macro and definition which came before it was
+ * included, so the definitions of one header cannot be re-harvested alone. The smallest
+ * piece which can be is a tracked file with everything it includes: a translation unit.
+ * Each is parsed into a context of its own, copied from what the tracking context held
+ * before it tracked anything; that unit context holds, and so tags, every definition and
+ * macro harvested from the file. The tracking context is the merge of all of them.
+ *
+ * Every file a unit read is stamped with its modification time, size, and a hash of its
+ * text. When a file's time or size moves, it is read again, and if its text is not what
+ * it was, each unit which read it is parsed again, and the units are merged anew. A file
+ * newly placed earlier in the search path, or newly created where an #include had failed,
+ * is not noticed.
+ *
+ * @section License
+ *
+ * Copyright (C) 2012 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef _REPARSE__H
+#define _REPARSE__H
+
+#include <map>
+#include <string>
+#include <vector>
+#include <ctime>
+#include <API/context.h>
+#include <System/lex_cpp.h>
+
+namespace jdip {
+  using namespace jdi;
+
+  /// What a file held when it was last read.
+  struct file_stamp {
+    bool present; ///< Whether the file could be read at all.
+    time_t mtime; ///< The time the file was last modified.
+    size_t size; ///< The number of bytes in the file.
+    size_t hash; ///< A hash of the text of the file, by \c hash_text.
+    file_stamp(): present(false), mtime(0), size(0), hash(0) {}
+  };
+
+  /** Stamp a file with what it holds now.
+      @param path   The path of the file.
+      @param stamp  The stamp last taken of the file, which is updated. If the file's time and size
+                    have not moved since, its text is not read again. [in-out]
+      @return Returns whether the file now holds something other than it did. **/
+  bool restamp_file(const std::string &path, file_stamp &stamp);
+
+  /// A file read by any tracked unit.
+  struct tracked_file {
+    std::string path; ///< The path of the file, as it was opened.
+    file_stamp stamp; ///< What the file held when it was last read.
+  };
+
+  /// A tracked file, with the context into which it was parsed.
+  struct tracked_unit {
+    std::string filename; ///< The name of the file, as given.
+    context *ct; ///< The context holding every definition and macro harvested from the file.
+    std::vector<unsigned> files; ///< The index of each file read, once each, beginning with this one.
+    std::vector<include_graph::edge> edges; ///< Each #include obeyed, between the files above.
+    tracked_unit(): ct(NULL) {}
+  };
+
+  /// Everything a context keeps of the files it tracks.
+  struct dependency_tracker {
+    context *base; ///< What the tracking context held before it tracked anything, from which each unit is copied.
+    std::vector<tracked_file> files; ///< Every file read by any unit.
+    std::map<std::string, unsigned> ids; ///< The index in \c files of each path.
+    std::vector<tracked_unit> units; ///< Each tracked file, in the order they were first given.
+
+    /// Find the index of a file, stamping it if it is new.
+    unsigned file_id(const std::string &path);
+    /** Take note of what a unit read, from the lexer which read it. The lexer must not yet be
+        freed, as the line of each #include is found from it.
+        @param unit  The unit, whose file list and edges are replaced.
+        @param lex   The lexer which read it, or NULL if its file could not be opened. **/
+    void record(tracked_unit &unit, const lexer_cpp *lex);
+    /// Drop each file no longer read by any unit, numbering the rest in the order the units read them.
+    void prune();
+
+    dependency_tracker(const context &b); ///< Begin tracking with a copy of the given context as the base.
+    ~dependency_tracker(); ///< Free the base and every unit.
+  };
+}
+
+#endif
@@ -159,6 +159,117 @@ namespace jdi {
     }
     remap(n);
   }
+  /// Record each member of one scope as replaced by the member of the same name in another, recursively.
+  static void map_members(definition_scope *from, definition_scope *to, definition::remap_set &n) {
+    for (definition_scope::defiter it = from->members.begin(); it != from->members.end(); ++it) {
+      definition_scope::defiter ex = to->members.find(it->first);
+      if (ex == to->members.end() or ex->second == it->second) continue;
+      n[it->second] = ex->second;
+      if ((it->second->flags & DEF_SCOPE) and (ex->second->flags & DEF_SCOPE))
+        map_members((definition_scope*)it->second, (definition_scope*)ex->second, n);
+    }
+  }
+  bool definition_scope::complete_from(definition_scope *from, remap_set &n, vector<definition*> &moved) {
+    const unsigned kind = DEF_CLASS | DEF_UNION | DEF_TEMPLATE;
+    if (!(flags & DEF_INCOMPLETE) or (from->flags & DEF_INCOMPLETE) or !(flags & DEF_CLASS)
+    or  (flags & kind) != (from->flags & kind) or (flags & DEF_TEMPLATE) or !members.empty())
+      return false;
+    members.swap(from->members);
+    std::swap(using_front, from->using_front), std::swap(using_back, from->using_back);
+    using_general.swap(from->using_general);
+    for (defiter it = members.begin(); it != members.end(); ++it)
+      it->second->parent = this;
+    if (!(flags & DEF_UNION))
+      ((definition_class*)this)->ancestors.swap(((definition_class*)from)->ancestors);
+    flags &= ~DEF_INCOMPLETE;
+    from->flags |= DEF_INCOMPLETE;
+    n[from] = this;
+    moved.push_back(this); // What was taken may refer to anything left behind in the other context
+    return true;
+  }
+  
+  /// A function declared in two scopes being merged, whose overloads are merged once everything else is.
+  struct overloaded_pair {
+    definition_scope *from; ///< The scope which declared \c theirs, and owns it.
+    definition_function *ours, *theirs; ///< The function kept, and the one whose overloads are merged into it.
+  };
+  
+  /// Absorb the members of one scope into another, as \c definition_scope::absorb, leaving functions declared in both for later.
+  static void absorb_members(definition_scope *into, definition_scope* from, definition::remap_set &n, vector<definition*> &moved,
+                             vector<overloaded_pair> &overloaded) {
+    for (definition_scope::defiter it = from->members.begin(); it != from->members.end(); ) {
+      definition_scope::inspair dest = into->members.insert(definition_scope::entry(it->first,it->second));
+      if (dest.second) {
+        it->second->parent = into;
+        moved.push_back(it->second);
+        from->members.erase(it++);
+        continue;
+      }
+      definition *ours = dest.first->second, *theirs = it->second;
+      if (ours != theirs) {
+        n[theirs] = ours;
+        if ((ours->flags & DEF_NAMESPACE) and (theirs->flags & DEF_NAMESPACE))
+          absorb_members((definition_scope*)ours, (definition_scope*)theirs, n, moved, overloaded);
+        else if ((ours->flags & DEF_SCOPE) and (theirs->flags & DEF_SCOPE)) {
+          if (!((definition_scope*)ours)->complete_from((definition_scope*)theirs, n, moved))
+            map_members((definition_scope*)theirs, (definition_scope*)ours, n);
+        }
+        else if ((ours->flags & DEF_FUNCTION) and (theirs->flags & DEF_FUNCTION)
+             and !((ours->flags | theirs->flags) & DEF_TEMPLATE)) {
+          const overloaded_pair op = { from, (definition_function*)ours, (definition_function*)theirs };
+          overloaded.push_back(op);
+        }
+      }
+      ++it;
+    }
+  }
+  
+  /** Merge the overloads of a function into those of another of the same name. Each overload whose
+      parameters, once remapped, are not already declared is moved; the rest are remapped to ours. **/
+  static void merge_overloads(const overloaded_pair &op, definition::remap_set &n, vector<definition*> &moved) {
+    definition_function *ours = op.ours, *theirs = op.theirs;
+    n.erase(theirs);
+    theirs->remap(n); // Their parameters now name our types where both declared them
+    bool adopted = false;
+    for (definition_function::overload_iter it = theirs->overloads.begin(); it != theirs->overloads.end(); ) {
+      definition_function *fn = it->second;
+      arg_key key(fn->referencers);
+      definition_function::overload_iter ex = ours->overloads.find(key);
+      if (ex != ours->overloads.end()) {
+        n[fn] = ex->second;
+        if (!ex->second->implementation)
+          ex->second->implementation = fn->implementation, fn->implementation = NULL;
+        ++it;
+        continue;
+      }
+      ours->overloads.insert(pair<arg_key, definition_function*>(key, fn));
+      fn->parent = ours->parent;
+      moved.push_back(fn);
+      if (fn == theirs) // It now belongs to ours, along with whatever overloads it still holds
+        adopted = true, ++it;
+      else
+        theirs->overloads.erase(it++);
+    }
+    if (adopted)
+      op.from->members.erase(theirs->name);
+    for (size_t i = 0; i < theirs->template_overloads.size(); ++i) {
+      const string sig = theirs->template_overloads[i]->toString();
+      bool known = false;
+      for (size_t j = 0; j < ours->template_overloads.size() and !known; ++j)
+        known = ours->template_overloads[j]->toString() == sig;
+      if (known) continue;
+      ours->template_overloads.push_back(theirs->template_overloads[i]);
+      moved.push_back(theirs->template_overloads[i]);
+      theirs->template_overloads.erase(theirs->template_overloads.begin() + i--);
+    }
+  }
+  
+  void definition_scope::absorb(definition_scope* from, remap_set &n, vector<definition*> &moved) {
+    vector<overloaded_pair> overloaded;
+    absorb_members(this, from, n, moved, overloaded);
+    for (size_t i = 0; i < overloaded.size(); ++i)
+      merge_overloads(overloaded[i], n, moved);
+  }
   definition_scope::definition_scope(): definition("",NULL,DEF_SCOPE), using_front(NULL), using_back(NULL) { }
   definition_scope::definition_scope(const definition_scope&): definition() {
     // TODO: Implement
@@ -214,7 +325,7 @@ namespace jdi {
     return ins.first->second;
   }
   bool arg_key::operator<(const arg_key& other) const {
-    for (arg_key::node *i = values, *j = other.values; j != other.endv; ++i) {
+    for (arg_key::node *i = values, *j = other.values; j != other.endv; ++i, ++j) {
       if (i == endv) return true;
       if (i->type == AKT_VALUE) {
         if (j->type != AKT_VALUE) return false;
@@ -420,7 +531,7 @@ namespace jdi {
     }
     for (using_node *un = using_front; un; un = un->next) {
       remap_set::const_iterator ex = n.find(un->use);
-      if (ex == n.end())
+      if (ex != n.end())
         un->use = (definition_scope*)ex->second;
     }
     for (defiter it = using_general.begin(); it != using_general.end(); ++it) {
@@ -552,8 +663,13 @@ namespace jdi {
   definition *definition_function::duplicate(remap_set &n) {
     ref_stack dup; dup.copy(referencers);
     definition_function* res = new definition_function(name, parent, type, dup, modifiers, flags);
-    res->overloads = overloads;
     n[this] = res;
+    // The constructor listed the copy as its own overload; each other overload is owned, so it is copied, too
+    for (overload_iter it = overloads.begin(); it != overloads.end(); ++it)
+      if (it->second != this)
+        res->overloads[it->first] = (definition_function*)it->second->duplicate(n);
+    for (vector<definition_template*>::iterator it = template_overloads.begin(); it != template_overloads.end(); ++it)
+      res->template_overloads.push_back((definition_template*)(*it)->duplicate(n));
     return res;
   }
   
@@ -573,7 +689,7 @@ namespace jdi {
   
   definition* definition_template::duplicate(remap_set &n) {
     definition_template* res = new definition_template(name, parent, flags);
-    res->def = def->duplicate(n);
+    res->def = def? def->duplicate(n) : NULL;
     res->specializations = specializations;
     res->instantiations = instantiations;
     res->params.reserve(params.size());
@@ -584,6 +700,7 @@ namespace jdi {
       n[it->second] = nd; it->second = (definition_template*)nd;
     }
     for (institer it = res->instantiations.begin(); it != res->instantiations.end(); ++it) {
+      if (!it->second) continue; // Instantiations are recorded without definitions of their own
       definition *nd = it->second->duplicate(n);
       n[it->second] = nd; it->second = nd;
     }
@@ -598,6 +715,13 @@ namespace jdi {
     return res;
   }
   
+  definition* definition_valued::duplicate(remap_set &n) {
+    definition_valued* res = new definition_valued(name, parent, type, modifiers, flags, value_of);
+    res->referencers.copy(referencers);
+    n[this] = res;
+    return res;
+  }
+  
   definition* definition_union::duplicate(remap_set &n) {
     definition_union* res = new definition_union(name, parent, flags);
     res->definition_scope::copy(this);
@@ -610,7 +734,7 @@ namespace jdi {
   }
   
   definition* definition_hypothetical::duplicate(remap_set &n) {
-    definition_hypothetical* res = new definition_hypothetical(name, parent, flags, new AST(*def));
+    definition_hypothetical* res = new definition_hypothetical(name, parent, flags, def? new AST(*def) : NULL);
     n[this] = res; return res;
   }
   
@@ -27,6 +27,8 @@
 
 #include <General/quickreference.h>
 
+namespace jdip { struct image_writer; }
+
 namespace jdi {
   /** Flags given to a definition to describe its type simply and quickly. **/
   enum DEF_FLAGS
@@ -49,7 +51,8 @@ namespace jdi {
     DEF_PRIVATE =      1 << 15, ///< This definition was declared as a private member.
     DEF_PROTECTED =    1 << 16, ///< This definition was declared as a protected member.
     DEF_INCOMPLETE =   1 << 17, ///< This definition was declared but not implemented.
-    DEF_ATOMIC =       1 << 18  ///< This is a global definition for objects of a fixed size, such as primitives.
+    DEF_ATOMIC =       1 << 18, ///< This is a global definition for objects of a fixed size, such as primitives.
+    DEF_REFERENCED =   1 << 19  ///< An expression refers to this definition, so it must outlive its scope's claim on it.
   };
   
   struct definition;
@@ -306,6 +309,7 @@ namespace jdi {
     value value_of; ///< The constant value of this definition.
     definition_valued(); ///< Default constructor; invalidates value.
     
+    virtual definition* duplicate(remap_set &n);
     virtual string toString(unsigned levels = unsigned(-1), unsigned indent = 0);
     
     //definition_valued(string vname, definition *parnt, definition* type, unsigned int flags, value &val); ///< Construct with a value and type.
@@ -350,6 +354,27 @@ namespace jdi {
     void dump(definition_scope* to);
     /** Copy content from another definition. **/
     void copy(const definition_scope* from);
+    /** Move content from another definition, keeping what is already declared here.
+        Members of \p from not declared in this scope are removed from it and adopted by this scope.
+        Members declared in both are left in \p from and recorded in \p n as replaced by ours;
+        namespaces declared in both are absorbed recursively. A class of ours which was only
+        declared takes the body of theirs, by \c complete_from. The overloads of a function
+        declared in both are merged, once everything else is: those whose parameters are declared
+        in both are replaced by ours, and the rest are moved. The moved members may still refer
+        to what was left behind, so \c remap(n) must be called on each of them once done.
+        @param from   The scope to take members from. [in-out]
+        @param n      A remap set to receive the correspondence of duplicated definitions. [out]
+        @param moved  A vector to receive each definition taken from \p from. [out]
+    **/
+    void absorb(definition_scope* from, remap_set &n, vector<definition*> &moved);
+    /** If this is a class or union which was declared but never given a body, and \p from is the
+        same kind of class with one, take its members and ancestors, leaving it incomplete.
+        @param from   The complete class, recorded in \p n as replaced by this one. [in-out]
+        @param n      A remap set to receive the correspondence. [out]
+        @param moved  Receives this class, which must be remapped once done, as what it took may
+                      refer to what was left behind. [out]
+        @return Returns whether the body was taken. **/
+    bool complete_from(definition_scope *from, remap_set &n, vector<definition*> &moved);
     /** Swap content with another definition. **/
     void swap(definition_scope* with);
     
@@ -394,6 +419,7 @@ namespace jdi {
     virtual ~definition_scope();
     
     protected:
+      friend struct jdip::image_writer;
       /// First linked list entry
       using_node *using_front;
       /// Final linked list entry
@@ -549,7 +575,7 @@ namespace jdi {
     depends on an abstract parent or scope.
   */
   struct definition_hypothetical: definition_class {
-    AST *def;
+    AST *def; ///< The expression naming the type, or NULL if the parsing context did not keep it.
     virtual definition* duplicate(remap_set &n);
     virtual void remap(const remap_set &n);
     virtual size_t size_of();
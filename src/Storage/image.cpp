@@ -0,0 +1,1069 @@
+/**
+ * @file  image.cpp
+ * @brief Source implementing binary context images.
+ *
+ * @section License
+ *
+ * Copyright (C) 2013 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include <new>
+#include <cstdio>
+#include <cstring>
+#include "image.h"
+#include <API/context.h>
+#include <API/AST_operator.h>
+#include <System/builtins.h>
+#include <System/token_cache.h>
+
+#ifdef _WIN32
+  #include <fstream>
+#else
+  #include <fcntl.h>
+  #include <unistd.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+#endif
+
+namespace jdip {
+  static const char image_magic[8] = { 'J', 'D', 'I', 'I', 'M', 'A', 'G', 'E' };
+
+  /// Bit flags marking which optional fields of AST nodes this build keeps.
+  static const unsigned image_features = 0
+  #ifndef NO_ERROR_REPORTING
+    | 1
+    #ifndef NO_ERROR_POSITION
+    | 2
+    #endif
+  #endif
+  ;
+
+  /// The kinds of definition which derive from definition_scope, as a mask for image_reader::get_definition.
+  static const unsigned scope_kinds = 1 << IK_SCOPE | 1 << IK_CLASS | 1 << IK_UNION | 1 << IK_TEMPSCOPE | 1 << IK_HYPOTHETICAL;
+  /// The kinds of definition which derive from definition_class.
+  static const unsigned class_kinds = 1 << IK_CLASS | 1 << IK_HYPOTHETICAL;
+
+  /// The kinds of AST node, in an image.
+  enum image_ast_kind {
+    AN_NULL, AN_NODE, AN_DEFINITION, AN_SCOPE, AN_TYPE, AN_UNARY, AN_SIZEOF, AN_CAST,
+    AN_BINARY, AN_TERNARY, AN_PARAMETERS, AN_ARRAY, AN_NEW, AN_DELETE, AN_SUBSCRIPT
+  };
+
+  image_kind image_kind_of(const definition *d) {
+    if (d == &arg_key::abstract)
+      return IK_ABSTRACT;
+    if (!d->parent and (d->flags & DEF_TYPENAME)) {
+      prim_iter p = builtin_primitives.find(d->name);
+      if (p != builtin_primitives.end() and p->second == d)
+        return IK_PRIMITIVE;
+    }
+    // Order matters; hypotheticals, for instance, copy the flags of whatever they stand in for.
+    const unsigned f = d->flags;
+    if (f & DEF_HYPOTHETICAL) return IK_HYPOTHETICAL;
+    if (f & DEF_TEMPSCOPE) return IK_TEMPSCOPE;
+    if (f & DEF_TEMPLATE) return IK_TEMPLATE;
+    if (f & DEF_FUNCTION) return IK_FUNCTION;
+    if (f & DEF_ENUM) return IK_ENUM;
+    if (f & DEF_VALUED) return IK_VALUED;
+    if (f & DEF_TYPED) return IK_TYPED;
+    if (f & DEF_UNION) return IK_UNION;
+    if (f & DEF_CLASS) return IK_CLASS;
+    if (f & DEF_SCOPE) return IK_SCOPE;
+    return IK_DEFINITION;
+  }
+
+  //========================================================================================================
+  //======: Writer :========================================================================================
+  //========================================================================================================
+
+  image_writer::image_writer(): out(&trailer) {}
+
+  void image_writer::put_uint(unsigned long x) {
+    while (x >= 0x80) {
+      *out += char((x & 0x7F) | 0x80);
+      x >>= 7;
+    }
+    *out += char(x);
+  }
+  void image_writer::put_int(long x) {
+    put_uint(x < 0? ((unsigned long)~x << 1) | 1 : (unsigned long)x << 1);
+  }
+  void image_writer::put_string(const string &s) {
+    put_uint(s.length());
+    *out += s;
+  }
+
+  void image_writer::put_definition(definition *d) {
+    if (!d) {
+      put_uint(0);
+      return;
+    }
+    std::pair<std::map<const definition*, size_t>::iterator, bool> ins = ids.insert(std::pair<const definition*, size_t>(d, order.size()));
+    if (ins.second) {
+      const image_kind kind = image_kind_of(d);
+      order.push_back(d);
+      kinds.push_back(kind);
+      string *was = out;
+      out = &defs;
+      put_uint(kind);
+      put_uint(d->flags);
+      put_string(d->name);
+      out = was;
+    }
+    put_uint(ins.first->second + 1);
+  }
+
+  void image_writer::put_value(const value &v) {
+    put_uint(v.type);
+    switch (v.type) {
+      case VT_DOUBLE: out->append((const char*)&v.val.d, sizeof(double)); break;
+      case VT_INTEGER: put_int(v.val.i); break;
+      case VT_STRING: put_string(v.val.s); break;
+      case VT_NONE: default: break;
+    }
+  }
+
+  void image_writer::put_full_type(const full_type &ft) {
+    put_definition(ft.def);
+    put_refs(ft.refs);
+    put_int(ft.flags);
+  }
+
+  void image_writer::put_refs(const ref_stack &rs) {
+    put_string(rs.name);
+    size_t count = 0;
+    for (ref_stack::iterator it = rs.begin(); it; ++it)
+      ++count;
+    put_uint(count);
+    for (ref_stack::iterator it = rs.begin(); it; ++it) {
+      put_uint(it->type);
+      if (it->type == ref_stack::RT_ARRAYBOUND)
+        put_uint(it->arraysize());
+      else if (it->type == ref_stack::RT_FUNCTION) {
+        const ref_stack::parameter_ct &params = ((ref_stack::node_func*)*it)->params;
+        put_uint(params.size());
+        for (size_t i = 0; i < params.size(); ++i) {
+          put_full_type(params[i]);
+          put_uint(params[i].variadic);
+          put_ast(params[i].default_value);
+        }
+      }
+    }
+  }
+
+  void image_writer::put_arg_key(const arg_key &k) {
+    arg_key &key = const_cast<arg_key&>(k); // arg_key offers no const iteration
+    put_uint(key.end() - key.begin());
+    for (arg_key::node *n = key.begin(); n != key.end(); ++n) {
+      put_uint(n->type);
+      if (n->type == arg_key::AKT_FULLTYPE)
+        put_full_type(n->ft());
+      else if (n->type == arg_key::AKT_VALUE)
+        put_value(n->val());
+    }
+  }
+
+  /// Writes each kind of AST node, dispatched by the node itself.
+  struct image_writer::ast_writer: ConstASTOperator {
+    image_writer &w; ///< The writer to write to.
+    void operate(const AST::AST_Node *x, void *) {
+      w.put_uint(AN_NODE); w.put_ast_common(x);
+    }
+    void operate_Definition(const AST::AST_Node_Definition *x, void *) {
+      w.put_uint(AN_DEFINITION); w.put_ast_common(x);
+      w.put_definition(x->def);
+    }
+    void operate_Scope(const AST::AST_Node_Scope *x, void *) {
+      w.put_uint(AN_SCOPE); w.put_ast_common(x);
+      w.put_ast_node(x->left); w.put_ast_node(x->right);
+    }
+    void operate_Type(const AST::AST_Node_Type *x, void *) {
+      w.put_uint(AN_TYPE); w.put_ast_common(x);
+      w.put_full_type(x->dec_type);
+    }
+    void operate_Unary(const AST::AST_Node_Unary *x, void *) {
+      w.put_uint(AN_UNARY); w.put_ast_common(x);
+      w.put_ast_node(x->operand); w.put_uint(x->prefix);
+    }
+    void operate_sizeof(const AST::AST_Node_sizeof *x, void *) {
+      w.put_uint(AN_SIZEOF); w.put_ast_common(x);
+      w.put_ast_node(x->operand); w.put_uint(x->prefix); w.put_uint(x->negate);
+    }
+    void operate_Cast(const AST::AST_Node_Cast *x, void *) {
+      w.put_uint(AN_CAST); w.put_ast_common(x);
+      w.put_ast_node(x->operand); w.put_uint(x->prefix); w.put_full_type(x->cast_type);
+    }
+    void operate_Binary(const AST::AST_Node_Binary *x, void *) {
+      w.put_uint(AN_BINARY); w.put_ast_common(x);
+      w.put_ast_node(x->left); w.put_ast_node(x->right);
+    }
+    void operate_Ternary(const AST::AST_Node_Ternary *x, void *) {
+      w.put_uint(AN_TERNARY); w.put_ast_common(x);
+      w.put_ast_node(x->exp); w.put_ast_node(x->left); w.put_ast_node(x->right);
+    }
+    void operate_Parameters(const AST::AST_Node_Parameters *x, void *) {
+      w.put_uint(AN_PARAMETERS); w.put_ast_common(x);
+      w.put_ast_node(x->func);
+      w.put_uint(x->params.size());
+      for (size_t i = 0; i < x->params.size(); ++i)
+        w.put_ast_node(x->params[i]);
+    }
+    void operate_Array(const AST::AST_Node_Array *x, void *) {
+      w.put_uint(AN_ARRAY); w.put_ast_common(x);
+      w.put_uint(x->elements.size());
+      for (size_t i = 0; i < x->elements.size(); ++i)
+        w.put_ast_node(x->elements[i]);
+    }
+    void operate_new(const AST::AST_Node_new *x, void *) {
+      w.put_uint(AN_NEW); w.put_ast_common(x);
+      w.put_full_type(x->type); w.put_ast_node(x->position); w.put_ast_node(x->bound);
+    }
+    void operate_delete(const AST::AST_Node_delete *x, void *) {
+      w.put_uint(AN_DELETE); w.put_ast_common(x);
+      w.put_ast_node(x->operand); w.put_uint(x->prefix); w.put_uint(x->array);
+    }
+    void operate_Subscript(const AST::AST_Node_Subscript *x, void *) {
+      w.put_uint(AN_SUBSCRIPT); w.put_ast_common(x);
+      w.put_ast_node(x->left); w.put_ast_node(x->index);
+    }
+    ast_writer(image_writer &writer): w(writer) {}
+  };
+
+  void image_writer::put_ast_common(const AST::AST_Node *n) {
+    put_uint(n->type);
+    put_string(n->content);
+    put_int(n->precedence);
+    #ifndef NO_ERROR_REPORTING
+      put_string(n->filename);
+      put_int(n->linenum);
+      #ifndef NO_ERROR_POSITION
+        put_int(n->pos);
+      #endif
+    #endif
+  }
+
+  void image_writer::put_ast_node(const AST::AST_Node *n) {
+    if (!n) {
+      put_uint(AN_NULL);
+      return;
+    }
+    ast_writer aw(*this);
+    n->operate(&aw, NULL);
+  }
+
+  void image_writer::put_ast(const AST *ast) {
+    put_uint(ast != NULL);
+    if (ast) {
+      put_uint(ast->tt_greater_is_op);
+      put_ast_node(ast->root);
+    }
+  }
+
+  void image_writer::put_macro(const macro_type *m) {
+    put_string(m->name);
+    put_int(m->argc);
+    if (m->argc < 0) {
+      put_string(((const macro_scalar*)m)->value);
+      return;
+    }
+    const macro_function *mf = (const macro_function*)m;
+    put_uint(mf->args.size());
+    for (size_t i = 0; i < mf->args.size(); ++i)
+      put_string(mf->args[i]);
+    put_string(mf->definiens);
+  }
+
+  void image_writer::put_scope(const definition_scope *s) {
+    put_uint(s->members.size());
+    for (definition_scope::defiter_c it = s->members.begin(); it != s->members.end(); ++it) {
+      put_string(it->first);
+      put_definition(it->second);
+      holders.insert(std::pair<const definition*, definition_scope*>(it->second, const_cast<definition_scope*>(s)));
+    }
+    put_uint(s->using_general.size());
+    for (definition_scope::defiter_c it = s->using_general.begin(); it != s->using_general.end(); ++it) {
+      put_string(it->first);
+      put_definition(it->second);
+    }
+    size_t count = 0;
+    for (definition_scope::using_node *un = s->using_front; un; un = un->next)
+      ++count;
+    put_uint(count);
+    for (definition_scope::using_node *un = s->using_front; un; un = un->next)
+      put_definition(un->use);
+  }
+
+  void image_writer::put_body(definition *d, image_kind kind) {
+    switch (kind) {
+      case IK_TYPED: case IK_VALUED: case IK_FUNCTION: case IK_ENUM: {
+          definition_typed *t = (definition_typed*)d;
+          put_definition(t->type);
+          put_refs(t->referencers);
+          put_uint(t->modifiers);
+          if (kind == IK_VALUED)
+            put_value(((definition_valued*)d)->value_of);
+          else if (kind == IK_FUNCTION) {
+            definition_function *f = (definition_function*)d;
+            put_uint(f->overloads.size());
+            for (definition_function::overload_iter it = f->overloads.begin(); it != f->overloads.end(); ++it) {
+              put_arg_key(it->first);
+              put_definition(it->second);
+            }
+            put_uint(f->template_overloads.size());
+            for (size_t i = 0; i < f->template_overloads.size(); ++i)
+              put_definition(f->template_overloads[i]);
+          }
+          else if (kind == IK_ENUM) {
+            definition_enum *e = (definition_enum*)d;
+            put_uint(e->constants.size());
+            for (definition_scope::defiter it = e->constants.begin(); it != e->constants.end(); ++it) {
+              put_string(it->first);
+              put_definition(it->second);
+            }
+          }
+        } break;
+      case IK_SCOPE: case IK_UNION:
+          put_scope((definition_scope*)d);
+        break;
+      case IK_CLASS: case IK_HYPOTHETICAL: {
+          definition_class *c = (definition_class*)d;
+          put_scope(c);
+          put_uint(c->ancestors.size());
+          for (size_t i = 0; i < c->ancestors.size(); ++i) {
+            put_uint(c->ancestors[i].protection);
+            put_definition(c->ancestors[i].def);
+          }
+          if (kind == IK_HYPOTHETICAL)
+            put_ast(((definition_hypothetical*)d)->def);
+        } break;
+      case IK_TEMPSCOPE: {
+          definition_tempscope *ts = (definition_tempscope*)d;
+          put_scope(ts);
+          put_definition(ts->source);
+          put_uint(ts->referenced);
+        } break;
+      case IK_TEMPLATE: {
+          definition_template *t = (definition_template*)d;
+          put_definition(t->def);
+          put_uint(t->params.size());
+          for (size_t i = 0; i < t->params.size(); ++i)
+            put_definition(t->params[i]);
+          put_uint(t->specializations.size());
+          for (definition_template::speciter it = t->specializations.begin(); it != t->specializations.end(); ++it) {
+            put_arg_key(it->first);
+            put_definition(it->second);
+          }
+          put_uint(t->instantiations.size());
+          for (definition_template::institer it = t->instantiations.begin(); it != t->instantiations.end(); ++it) {
+            put_arg_key(it->first);
+            put_definition(it->second);
+          }
+          put_uint(t->dependents.size());
+          for (size_t i = 0; i < t->dependents.size(); ++i)
+            put_definition(t->dependents[i]);
+        } break;
+      case IK_DEFINITION: case IK_PRIMITIVE: case IK_ABSTRACT: case IK_COUNT: default:
+        break;
+    }
+  }
+
+  void image_writer::put_definitions() {
+    string *was = out;
+    out = &body;
+    // Writing one definition may list more, so the list can grow as we go.
+    for (size_t i = 0; i < order.size(); ++i)
+      put_body(order[i], (image_kind)kinds[i]);
+    // A parent is not necessarily still alive; it may be a scope that was only used during parsing,
+    // such as the temporary scope of a template. Parents are only followed if we already know them.
+    for (size_t i = 0; i < order.size(); ++i) {
+      if (kinds[i] == IK_PRIMITIVE or kinds[i] == IK_ABSTRACT)
+        continue;
+      definition *parent = order[i]->parent;
+      if (parent and ids.find(parent) == ids.end()) {
+        std::map<const definition*, definition_scope*>::iterator h = holders.find(order[i]);
+        parent = h == holders.end()? NULL : h->second;
+      }
+      put_definition(parent);
+    }
+    out = was;
+  }
+
+  string image_writer::image() const {
+    image_writer head;
+    head.trailer.append(image_magic, sizeof(image_magic));
+    head.put_uint(image_version);
+    head.put_uint(sizeof(long));
+    head.put_uint(sizeof(size_t));
+    head.put_uint(image_features);
+    head.put_uint(order.size());
+    const string payload = defs + body + trailer;
+    head.put_uint(hash_text(payload.data(), payload.length()));
+    return head.trailer + payload;
+  }
+
+  //========================================================================================================
+  //======: Reader :========================================================================================
+  //========================================================================================================
+
+  image_reader::image_reader(const char *data, size_t size): failed(false), why(), at(data), end(data + size) {}
+
+  void image_reader::fail(const string &reason) {
+    if (!failed)
+      failed = true, why = reason;
+  }
+
+  bool image_reader::at_end() const {
+    return at == end;
+  }
+
+  unsigned long image_reader::get_uint() {
+    unsigned long res = 0;
+    for (unsigned shift = 0; ; shift += 7) {
+      if (failed or at >= end or shift >= 8 * sizeof(unsigned long)) {
+        fail(at >= end? "Image is truncated" : "Image contains a number too large for this platform");
+        return 0;
+      }
+      const unsigned char b = *at++;
+      res |= (unsigned long)(b & 0x7F) << shift;
+      if (!(b & 0x80))
+        return res;
+    }
+  }
+  long image_reader::get_int() {
+    const unsigned long x = get_uint();
+    return (x & 1)? ~long(x >> 1) : long(x >> 1);
+  }
+  string image_reader::get_string() {
+    const size_t len = get_uint();
+    if (failed) return string();
+    if (len > size_t(end - at)) {
+      fail("Image is truncated");
+      return string();
+    }
+    string res(at, len);
+    at += len;
+    return res;
+  }
+
+  size_t image_reader::get_ref(unsigned kind_mask) {
+    const size_t ref = get_uint();
+    if (!ref)
+      return 0;
+    if (ref > defs.size()) {
+      fail("Image refers to a definition it does not contain");
+      return 0;
+    }
+    if (!(kind_mask & (1u << kinds[ref - 1]))) {
+      fail("Image refers to a definition of the wrong kind");
+      return 0;
+    }
+    return ref;
+  }
+  definition *image_reader::get_definition(unsigned kind_mask) {
+    const size_t ref = get_ref(kind_mask);
+    return ref? defs[ref - 1] : NULL;
+  }
+  definition *image_reader::get_owned(size_t owner, unsigned kind_mask) {
+    const size_t ref = get_ref(kind_mask);
+    if (!ref)
+      return NULL;
+    if (ref != owner) { // A function lists itself among its overloads without owning itself
+      if (kinds[ref - 1] == IK_PRIMITIVE or kinds[ref - 1] == IK_ABSTRACT)
+        fail("Image gives an owner to a built-in definition");
+      else if (owners[ref - 1])
+        fail("Image gives a definition more than one owner");
+      else
+        owners[ref - 1] = owner;
+    }
+    return failed? NULL : defs[ref - 1];
+  }
+  definition *image_reader::get_root(unsigned kind_mask) {
+    return get_owned(context_owner, kind_mask);
+  }
+
+  void image_reader::check_owners() {
+    for (size_t i = 0; i < defs.size() and !failed; ++i) {
+      if (kinds[i] == IK_PRIMITIVE or kinds[i] == IK_ABSTRACT)
+        continue;
+      // Each step leads to a different owner unless the owners form a loop, which no step can leave
+      size_t steps = 0;
+      for (size_t o = i + 1; o != context_owner; o = owners[o - 1])
+        if (!owners[o - 1] or ++steps > defs.size()) {
+          fail(owners[o - 1]? "Image gives definitions owners which own one another" : "Image contains a definition which nothing owns");
+          break;
+        }
+    }
+  }
+
+  void image_reader::get_value(value &v) {
+    switch (get_uint()) {
+      case VT_NONE: break;
+      case VT_DOUBLE: {
+          double d;
+          if (size_t(end - at) < sizeof(double)) { fail("Image is truncated"); break; }
+          memcpy(&d, at, sizeof(double));
+          at += sizeof(double);
+          new(&v) value(d);
+        } break;
+      case VT_INTEGER: new(&v) value(get_int()); break;
+      case VT_STRING: {
+          const string s = get_string();
+          char *str = new char[s.length() + 1];
+          memcpy(str, s.c_str(), s.length() + 1);
+          new(&v) value((const char*)str);
+        } break;
+      default: fail("Image contains a value of unknown type");
+    }
+  }
+
+  void image_reader::get_full_type(full_type &ft) {
+    ft.def = get_definition();
+    get_refs(ft.refs);
+    ft.flags = get_int();
+  }
+
+  void image_reader::get_refs(ref_stack &rs) {
+    rs.name = get_string();
+    for (size_t n = get_uint(); n-- and !failed; ) {
+      const unsigned long type = get_uint();
+      switch (type) {
+        case ref_stack::RT_POINTERTO: case ref_stack::RT_REFERENCE: {
+            ref_stack one;
+            one.push((ref_stack::ref_type)type);
+            rs.prepend_c(one);
+          } break;
+        case ref_stack::RT_ARRAYBOUND:
+            rs.push_array(get_uint());
+          break;
+        case ref_stack::RT_FUNCTION: {
+            ref_stack::parameter_ct params;
+            for (size_t p = get_uint(); p-- and !failed; ) {
+              ref_stack::parameter param;
+              get_full_type(param);
+              param.variadic = get_uint();
+              param.default_value = get_ast();
+              params.throw_on(param);
+            }
+            rs.push_func(params);
+          } break;
+        default:
+          fail("Image contains a referencer of unknown type");
+      }
+    }
+  }
+
+  arg_key *image_reader::get_arg_key() {
+    const size_t n = get_uint();
+    if (n > size_t(end - at)) { // Each argument takes at least a byte
+      fail("Image is truncated");
+      return NULL;
+    }
+    arg_key *res = new arg_key(n);
+    for (arg_key::node *i = res->begin(); i != res->end() and !failed; ++i) {
+      switch (get_uint()) {
+        case arg_key::AKT_NONE: break;
+        case arg_key::AKT_FULLTYPE: {
+            full_type ft;
+            get_full_type(ft);
+            res->swap_final_type(i - res->begin(), ft);
+          } break;
+        case arg_key::AKT_VALUE: {
+            value v;
+            get_value(v);
+            res->put_value(i - res->begin(), v);
+          } break;
+        default:
+          fail("Image contains a template argument of unknown type");
+      }
+    }
+    return res;
+  }
+
+  AST *image_reader::get_ast() {
+    if (!get_uint())
+      return NULL;
+    AST *res = new AST();
+    res->tt_greater_is_op = get_uint();
+    res->root = get_ast_node();
+    return res;
+  }
+
+  AST::AST_Node *image_reader::get_ast_node() {
+    const unsigned long kind = get_uint();
+    if (failed or kind == AN_NULL)
+      return NULL;
+
+    AST::AST_Node *res;
+    switch (kind) {
+      case AN_NODE:       res = new AST::AST_Node(); break;
+      case AN_DEFINITION: res = new AST::AST_Node_Definition(NULL); break;
+      case AN_SCOPE:      res = new AST::AST_Node_Scope(NULL, NULL, string()); break;
+      case AN_TYPE:       { full_type none; res = new AST::AST_Node_Type(none); } break;
+      case AN_UNARY:      res = new AST::AST_Node_Unary(NULL); break;
+      case AN_SIZEOF:     res = new AST::AST_Node_sizeof(NULL, false); break;
+      case AN_CAST:       res = new AST::AST_Node_Cast(NULL); break;
+      case AN_BINARY:     res = new AST::AST_Node_Binary(NULL, NULL); break;
+      case AN_TERNARY:    res = new AST::AST_Node_Ternary(NULL, NULL, NULL); break;
+      case AN_PARAMETERS: res = new AST::AST_Node_Parameters(); break;
+      case AN_ARRAY:      res = new AST::AST_Node_Array(); break;
+      case AN_NEW:        res = new AST::AST_Node_new(); break;
+      case AN_DELETE:     res = new AST::AST_Node_delete(NULL, false); break;
+      case AN_SUBSCRIPT:  res = new AST::AST_Node_Subscript(); break;
+      default:
+        fail("Image contains an expression node of unknown type");
+        return NULL;
+    }
+
+    res->type = (AST::AST_TYPE)get_uint();
+    res->content = get_string();
+    res->precedence = get_int();
+    #ifndef NO_ERROR_REPORTING
+      res->filename = get_string();
+      res->linenum = get_int();
+      #ifndef NO_ERROR_POSITION
+        res->pos = get_int();
+      #endif
+    #endif
+
+    #define child(x) if (((x) = get_ast_node())) (x)->parent = res
+    switch (kind) {
+      case AN_DEFINITION:
+          ((AST::AST_Node_Definition*)res)->def = get_definition();
+        break;
+      case AN_SCOPE: case AN_BINARY: {
+          AST::AST_Node_Binary *b = (AST::AST_Node_Binary*)res;
+          child(b->left); child(b->right);
+        } break;
+      case AN_TYPE:
+          get_full_type(((AST::AST_Node_Type*)res)->dec_type);
+        break;
+      case AN_UNARY: case AN_SIZEOF: case AN_CAST: case AN_DELETE: {
+          AST::AST_Node_Unary *u = (AST::AST_Node_Unary*)res;
+          child(u->operand);
+          u->prefix = get_uint();
+          if (kind == AN_SIZEOF) ((AST::AST_Node_sizeof*)res)->negate = get_uint();
+          else if (kind == AN_CAST) get_full_type(((AST::AST_Node_Cast*)res)->cast_type);
+          else if (kind == AN_DELETE) ((AST::AST_Node_delete*)res)->array = get_uint();
+        } break;
+      case AN_TERNARY: {
+          AST::AST_Node_Ternary *t = (AST::AST_Node_Ternary*)res;
+          child(t->exp); child(t->left); child(t->right);
+        } break;
+      case AN_PARAMETERS: {
+          AST::AST_Node_Parameters *p = (AST::AST_Node_Parameters*)res;
+          child(p->func);
+          for (size_t n = get_uint(); n-- and !failed; ) {
+            AST::AST_Node *param;
+            child(param);
+            p->params.push_back(param);
+          }
+        } break;
+      case AN_ARRAY: {
+          AST::AST_Node_Array *a = (AST::AST_Node_Array*)res;
+          for (size_t n = get_uint(); n-- and !failed; ) {
+            AST::AST_Node *element;
+            child(element);
+            a->elements.push_back(element);
+          }
+        } break;
+      case AN_NEW: {
+          AST::AST_Node_new *n = (AST::AST_Node_new*)res;
+          get_full_type(n->type);
+          child(n->position); child(n->bound);
+        } break;
+      case AN_SUBSCRIPT: {
+          AST::AST_Node_Subscript *s = (AST::AST_Node_Subscript*)res;
+          child(s->left); child(s->index);
+        } break;
+      case AN_NODE: default:
+        break;
+    }
+    #undef child
+    return res;
+  }
+
+  const macro_type *image_reader::get_macro() {
+    const string name = get_string();
+    const long argc = get_int();
+    if (argc < 0)
+      return new macro_scalar(name, get_string());
+
+    vector<string> args;
+    for (size_t n = get_uint(); n-- and !failed; )
+      args.push_back(get_string());
+    if (argc != (long)args.size() and argc != (long)args.size() + 1) {
+      fail("Image contains a macro with a bad parameter count");
+      return NULL;
+    }
+    // The definiens is split up again, rather than stored split, as its tokens point into it.
+    // Any errors in it were reported when it was first defined.
+    deferred_error_handler quiet;
+    return new macro_function(name, args, get_string(), argc > (long)args.size(), &quiet);
+  }
+
+  definition *image_reader::make_definition(image_kind kind, unsigned flags, const string &name) {
+    definition *res;
+    switch (kind) {
+      case IK_DEFINITION:   res = new definition(name, NULL, flags); break;
+      case IK_TYPED:        res = new definition_typed(name, NULL, NULL, 0, flags); break;
+      case IK_VALUED:       { value none; res = new definition_valued(name, NULL, NULL, 0, flags, none); } break;
+      case IK_FUNCTION:     { // Functions must be born with parameters; the real ones are read with the rest.
+          ref_stack rf;
+          ref_stack::parameter_ct none;
+          rf.push_func(none);
+          res = new definition_function(name, NULL, NULL, rf, 0, flags);
+        } break;
+      case IK_ENUM:         res = new definition_enum(name, NULL, flags); break;
+      case IK_SCOPE:        res = new definition_scope(name, NULL, flags); break;
+      case IK_CLASS:        res = new definition_class(name, NULL, flags); break;
+      case IK_UNION:        res = new definition_union(name, NULL, flags); break;
+      case IK_TEMPLATE:     res = new definition_template(name, NULL, flags); break;
+      case IK_TEMPSCOPE:    res = new definition_tempscope(name, NULL, flags, NULL); break;
+      case IK_HYPOTHETICAL: res = new definition_hypothetical(name, NULL, flags, NULL); break;
+      case IK_PRIMITIVE: {
+          prim_iter p = builtin_primitives.find(name);
+          if (p == builtin_primitives.end()) {
+            fail("Image uses unknown primitive type `" + name + "'");
+            return NULL;
+          }
+          return p->second;
+        }
+      case IK_ABSTRACT:
+        return &arg_key::abstract;
+      case IK_COUNT: default:
+        fail("Image contains a definition of unknown kind");
+        return NULL;
+    }
+    res->flags = flags; // Constructors add flags of their own; keep exactly what was written
+    return res;
+  }
+
+  void image_reader::get_scope(size_t id) {
+    definition_scope *s = (definition_scope*)defs[id - 1];
+    for (size_t n = get_uint(); n-- and !failed; ) {
+      const string name = get_string();
+      s->members.insert(definition_scope::entry(name, get_owned(id)));
+    }
+    for (size_t n = get_uint(); n-- and !failed; ) {
+      const string name = get_string();
+      s->using_general.insert(definition_scope::entry(name, get_definition()));
+    }
+    for (size_t n = get_uint(); n-- and !failed; )
+      if (definition *use = get_definition(scope_kinds))
+        s->use_namespace((definition_scope*)use);
+  }
+
+  void image_reader::get_body(size_t id) {
+    definition *const d = defs[id - 1];
+    const image_kind kind = (image_kind)kinds[id - 1];
+    switch (kind) {
+      case IK_TYPED: case IK_VALUED: case IK_FUNCTION: case IK_ENUM: {
+          definition_typed *t = (definition_typed*)d;
+          t->type = get_definition();
+          ref_stack refs;
+          get_refs(refs);
+          t->referencers.swap(refs);
+          t->modifiers = get_uint();
+          if (kind == IK_VALUED)
+            get_value(((definition_valued*)d)->value_of);
+          else if (kind == IK_FUNCTION) {
+            definition_function *f = (definition_function*)d;
+            f->overloads.clear();
+            for (size_t n = get_uint(); n-- and !failed; ) {
+              arg_key *k = get_arg_key();
+              definition *o = get_owned(id, 1 << IK_FUNCTION);
+              if (k and o)
+                f->overloads.insert(std::pair<arg_key, definition_function*>(*k, (definition_function*)o));
+              delete k;
+            }
+            for (size_t n = get_uint(); n-- and !failed; )
+              if (definition *o = get_owned(id, 1 << IK_TEMPLATE))
+                f->template_overloads.push_back((definition_template*)o);
+          }
+          else if (kind == IK_ENUM) {
+            definition_enum *e = (definition_enum*)d;
+            for (size_t n = get_uint(); n-- and !failed; ) {
+              const string name = get_string();
+              e->constants.insert(definition_scope::entry(name, get_definition()));
+            }
+          }
+        } break;
+      case IK_SCOPE: case IK_UNION:
+          get_scope(id);
+        break;
+      case IK_CLASS: case IK_HYPOTHETICAL: {
+          definition_class *c = (definition_class*)d;
+          get_scope(id);
+          for (size_t n = get_uint(); n-- and !failed; ) {
+            const unsigned protection = get_uint();
+            if (definition *a = get_definition(class_kinds))
+              c->ancestors.push_back(definition_class::ancestor(protection, (definition_class*)a));
+          }
+          if (kind == IK_HYPOTHETICAL)
+            ((definition_hypothetical*)d)->def = get_ast();
+        } break;
+      case IK_TEMPSCOPE: {
+          definition_tempscope *ts = (definition_tempscope*)d;
+          get_scope(id);
+          ts->source = get_definition();
+          ts->referenced = get_uint();
+        } break;
+      case IK_TEMPLATE: {
+          definition_template *t = (definition_template*)d;
+          t->def = get_owned(id);
+          for (size_t n = get_uint(); n-- and !failed; )
+            t->params.push_back(get_owned(id));
+          for (size_t n = get_uint(); n-- and !failed; ) {
+            arg_key *k = get_arg_key();
+            definition *s = get_owned(id, 1 << IK_TEMPLATE);
+            if (k and s)
+              t->specializations.insert(std::pair<arg_key, definition_template*>(*k, (definition_template*)s));
+            delete k;
+          }
+          for (size_t n = get_uint(); n-- and !failed; ) {
+            arg_key *k = get_arg_key();
+            definition *i = get_definition();
+            if (k)
+              t->instantiations.insert(std::pair<arg_key, definition*>(*k, i));
+            delete k;
+          }
+          for (size_t n = get_uint(); n-- and !failed; )
+            if (definition *h = get_owned(id, 1 << IK_HYPOTHETICAL))
+              t->dependents.push_back((definition_hypothetical*)h);
+        } break;
+      case IK_DEFINITION: case IK_PRIMITIVE: case IK_ABSTRACT: case IK_COUNT: default:
+        break;
+    }
+  }
+
+  bool image_reader::get_definitions() {
+    if (size_t(end - at) < sizeof(image_magic) or memcmp(at, image_magic, sizeof(image_magic))) {
+      fail("File is not a JustDefineIt image");
+      return false;
+    }
+    at += sizeof(image_magic);
+    if (get_uint() != image_version)
+      fail("Image was written by a different version of JustDefineIt");
+    if (get_uint() != sizeof(long) or get_uint() != sizeof(size_t))
+      fail("Image was written on a different platform");
+    if (get_uint() != image_features)
+      fail("Image was written by a build with different error reporting options");
+
+    const size_t count = get_uint();
+    const size_t checksum = get_uint();
+    if (!failed and checksum != hash_text(at, end - at))
+      fail("Image is corrupt; its checksum does not match its contents");
+    if (!failed and count > size_t(end - at) / 3) // Each listing takes at least three bytes
+      fail("Image is truncated");
+    if (failed)
+      return false;
+
+    defs.reserve(count);
+    kinds.reserve(count);
+    owners.assign(count, 0);
+    for (size_t i = 0; i < count and !failed; ++i) {
+      const unsigned long kind = get_uint();
+      const unsigned flags = get_uint();
+      const string name = get_string();
+      definition *d = make_definition(kind < IK_COUNT? (image_kind)kind : IK_COUNT, flags, name);
+      if (!d) break;
+      defs.push_back(d);
+      kinds.push_back(kind);
+    }
+    for (size_t i = 0; i < defs.size() and !failed; ++i)
+      get_body(i + 1);
+    for (size_t i = 0; i < defs.size() and !failed; ++i)
+      if (kinds[i] != IK_PRIMITIVE and kinds[i] != IK_ABSTRACT)
+        defs[i]->parent = (definition_scope*)get_definition();
+
+    if (failed) {
+      discard_definitions();
+      return false;
+    }
+    return true;
+  }
+
+  void image_reader::disown(definition *d, image_kind kind) {
+    switch (kind) {
+      case IK_FUNCTION:
+          ((definition_function*)d)->overloads.clear();
+          ((definition_function*)d)->template_overloads.clear();
+        break;
+      case IK_SCOPE: case IK_CLASS: case IK_UNION: case IK_TEMPSCOPE: case IK_HYPOTHETICAL:
+          ((definition_scope*)d)->members.clear();
+        break;
+      case IK_TEMPLATE: {
+          definition_template *t = (definition_template*)d;
+          t->def = NULL;
+          t->params.clear();
+          t->specializations.clear();
+          t->dependents.clear();
+        } break;
+      case IK_DEFINITION: case IK_TYPED: case IK_VALUED: case IK_ENUM:
+      case IK_PRIMITIVE: case IK_ABSTRACT: case IK_COUNT: default:
+        break;
+    }
+  }
+
+  void image_reader::discard_definitions() {
+    // Definitions own one another, so none may free any other; each is emptied, then freed alone.
+    for (size_t i = 0; i < defs.size(); ++i)
+      disown(defs[i], (image_kind)kinds[i]);
+    for (size_t i = 0; i < defs.size(); ++i)
+      if (kinds[i] != IK_PRIMITIVE and kinds[i] != IK_ABSTRACT)
+        delete defs[i];
+    defs.clear();
+    kinds.clear();
+    owners.clear();
+  }
+}
+
+//==========================================================================================================
+//======: Context interface :===============================================================================
+//==========================================================================================================
+
+using namespace jdi;
+using namespace jdip;
+
+int context::save_image(const char *filename) const {
+  image_writer w;
+  w.put_definition(global);
+  w.put_uint(c_structs.size());
+  for (map<string, definition*>::const_iterator it = c_structs.begin(); it != c_structs.end(); ++it) {
+    w.put_string(it->first);
+    w.put_definition(it->second);
+  }
+  w.put_uint(variadics.size());
+  for (set<definition*>::const_iterator it = variadics.begin(); it != variadics.end(); ++it)
+    w.put_definition(*it);
+  w.put_uint(macros.size());
+  for (macro_iter_c it = macros.begin(); it != macros.end(); ++it) {
+    w.put_string(it->first);
+    w.put_macro(it->second);
+  }
+  w.put_uint(search_directories.size());
+  for (size_t i = 0; i < search_directories.size(); ++i)
+    w.put_string(search_directories[i]);
+  w.put_uint(anon_count);
+  w.put_definitions();
+
+  const string image = w.image();
+  FILE *f = fopen(filename, "wb");
+  if (!f)
+    return 1;
+  const bool written = fwrite(image.data(), 1, image.length(), f) == image.length();
+  return (fclose(f) or !written)? 2 : 0;
+}
+
+namespace {
+  /// A file mapped into memory, read-only, for as long as this lives.
+  struct mapped_image {
+    const char *data; ///< The contents of the file, or NULL if it could not be read.
+    size_t size; ///< The size of the file.
+    #ifdef _WIN32
+      mapped_image(const char *filename): data(NULL), size(0) {
+        std::ifstream f(filename, std::ios::in | std::ios::binary);
+        if (!f.is_open()) return;
+        f.seekg(0, std::ios::end);
+        size = f.tellg();
+        f.seekg(0, std::ios::beg);
+        char *buf = new char[size];
+        if (f.read(buf, size)) data = buf;
+        else delete[] buf;
+      }
+      ~mapped_image() { delete[] data; }
+    #else
+      mapped_image(const char *filename): data(NULL), size(0) {
+        const int fd = open(filename, O_RDONLY);
+        if (fd == -1) return;
+        struct stat st;
+        if (!fstat(fd, &st) and st.st_size > 0) {
+          void *m = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+          if (m != MAP_FAILED)
+            data = (const char*)m, size = st.st_size;
+        }
+        close(fd);
+      }
+      ~mapped_image() { if (data) munmap((void*)data, size); }
+    #endif
+  };
+}
+
+int context::load_image(const char *filename, error_handler *errhandl) {
+  if (errhandl)
+    herr = errhandl;
+  if (parse_open) {
+    herr->error("Cannot load an image into a context while a parse is active");
+    return 1;
+  }
+
+  mapped_image file(filename);
+  if (!file.data) {
+    herr->error("Could not open image for reading", filename);
+    return 1;
+  }
+
+  image_reader r(file.data, file.size);
+  if (!r.get_definitions()) {
+    herr->error(r.why, filename);
+    return 2;
+  }
+
+  definition *ng = r.get_root(1 << IK_SCOPE);
+  map<string, definition*> ncs;
+  for (size_t n = r.get_uint(); n-- and !r.failed; ) {
+    const string name = r.get_string();
+    ncs.insert(pair<string, definition*>(name, r.get_root()));
+  }
+  set<definition*> nvs;
+  for (size_t n = r.get_uint(); n-- and !r.failed; )
+    nvs.insert(r.get_definition());
+  macro_map nms;
+  for (size_t n = r.get_uint(); n-- and !r.failed; ) {
+    const string name = r.get_string();
+    if (const macro_type *m = r.get_macro())
+      if (!nms.insert(pair<string, const macro_type*>(name, m)).second)
+        macro_type::free(m);
+  }
+  vector<string> nsd;
+  for (size_t n = r.get_uint(); n-- and !r.failed; )
+    nsd.push_back(r.get_string());
+  const unsigned nac = r.get_uint();
+
+  if (!r.failed and (!ng or !r.at_end()))
+    r.why = "Image is malformed", r.failed = true;
+  r.check_owners();
+  if (r.failed) {
+    for (macro_iter it = nms.begin(); it != nms.end(); ++it)
+      macro_type::free(it->second);
+    r.discard_definitions();
+    herr->error(r.why, filename);
+    return 2;
+  }
+
+  delete global;
+  for (map<string,definition*>::iterator it = c_structs.begin(); it != c_structs.end(); ++it)
+    delete it->second;
+  dump_macros();
+
+  global = (definition_scope*)ng;
+  c_structs.swap(ncs);
+  variadics.swap(nvs);
+  skipped_privates.clear();
+  macros.swap(nms);
+  search_directories.swap(nsd);
+  anon_count = nac;
+  return 0;
+}
@@ -0,0 +1,217 @@
+/**
+ * @file  image.h
+ * @brief Header declaring the readers and writers of binary context images.
+ *
+ * An image holds everything a \c jdi::context has parsed: the full definition tree, the
+ * macro table, and the search directories. Reading one back is much faster than parsing
+ * the headers which produced it. See \c jdi::context::save_image and \c load_image.
+ *
+ * @section Format
+ *
+ * An image begins with a magic string, a version, and the sizes of the few types which
+ * vary between platforms. All numbers after that are unsigned LEB128 varints; signed
+ * numbers are zigzag encoded first. Strings are a length followed by their bytes.
+ *
+ * Definitions are numbered in the order they are first referred to; a reference to a
+ * definition is its number plus one, and zero is NULL. The image lists the kind, flags,
+ * and name of every definition first, so that the reader can allocate all of them before
+ * reading the contents of any, and then the contents of each in the same order. Built-in
+ * primitives are listed by name only, and are resolved against those of the reader.
+ *
+ * Parents come last. A parent which is not otherwise in the image, such as the temporary
+ * scope of a template which has since been freed, is replaced by the scope that lists the
+ * definition as a member, if any. Function implementations are not kept.
+ *
+ * @section License
+ *
+ * Copyright (C) 2013 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef _IMAGE__H
+#define _IMAGE__H
+
+#include <map>
+#include <string>
+#include <vector>
+#include <Storage/definition.h>
+#include <System/macros.h>
+#include <API/AST.h>
+
+namespace jdip {
+  using namespace jdi;
+
+  /// The version of the image format; bump this whenever anything written changes.
+  static const unsigned image_version = 3;
+
+  /// The kinds of definition an image can hold, one for each class deriving from \c jdi::definition.
+  enum image_kind {
+    IK_DEFINITION,   ///< A plain \c jdi::definition.
+    IK_TYPED,        ///< A \c jdi::definition_typed.
+    IK_VALUED,       ///< A \c jdi::definition_valued.
+    IK_FUNCTION,     ///< A \c jdi::definition_function.
+    IK_ENUM,         ///< A \c jdi::definition_enum.
+    IK_SCOPE,        ///< A \c jdi::definition_scope.
+    IK_CLASS,        ///< A \c jdi::definition_class.
+    IK_UNION,        ///< A \c jdi::definition_union.
+    IK_TEMPLATE,     ///< A \c jdi::definition_template.
+    IK_TEMPSCOPE,    ///< A \c jdi::definition_tempscope.
+    IK_HYPOTHETICAL, ///< A \c jdi::definition_hypothetical.
+    IK_PRIMITIVE,    ///< A built-in \c jdi::definition_atomic, stored by name.
+    IK_ABSTRACT,     ///< The \c jdi::arg_key::abstract sentinel.
+    IK_COUNT         ///< The number of kinds above.
+  };
+
+  /// Determine which class the given definition is an instance of, from its flags.
+  image_kind image_kind_of(const definition *d);
+
+  /**
+    @brief Writes a context into a binary image.
+
+    Everything is written to one of three buffers: the definition list, the definition
+    contents, and the trailer. These are joined in that order by \c image(), behind a
+    header which carries a checksum of all three.
+  **/
+  struct image_writer {
+    /// Write an unsigned number.
+    void put_uint(unsigned long x);
+    /// Write a signed number.
+    void put_int(long x);
+    /// Write a string.
+    void put_string(const string &s);
+    /// Write a reference to the given definition, listing it if it has not been seen before.
+    void put_definition(definition *d);
+    /// Write a value of any type.
+    void put_value(const value &v);
+    /// Write a type, with its referencers and flags.
+    void put_full_type(const full_type &ft);
+    /// Write a stack of referencers, including any function parameters and their defaults.
+    void put_refs(const ref_stack &rs);
+    /// Write a template argument key.
+    void put_arg_key(const arg_key &k);
+    /// Write an AST, which may be NULL.
+    void put_ast(const AST *ast);
+    /// Write a macro, of either kind.
+    void put_macro(const macro_type *m);
+
+    /** Write the contents of every definition listed so far, and of any they refer to,
+        followed by the parent of each. Everything else is written to the trailer. **/
+    void put_definitions();
+    /// Join everything written into a complete image.
+    string image() const;
+
+    image_writer(); ///< Construct, writing into the trailer.
+
+  private:
+    string defs; ///< The kind, flags, and name of each definition, in order of first reference.
+    string body; ///< The contents of each definition, in the same order.
+    string trailer; ///< Everything written after the definitions.
+    string *out; ///< The buffer being written to.
+    std::map<const definition*, size_t> ids; ///< The number of each definition listed.
+    vector<definition*> order; ///< Each definition listed, by number.
+    vector<unsigned char> kinds; ///< The kind of each definition listed.
+    std::map<const definition*, definition_scope*> holders; ///< The first scope found to list each definition as a member.
+
+    struct ast_writer; ///< Writes each kind of AST node; see image.cpp.
+    /// Write an AST node and its children, which may be NULL.
+    void put_ast_node(const AST::AST_Node *n);
+    /// Write the fields common to every AST node.
+    void put_ast_common(const AST::AST_Node *n);
+    /// Write the members of a scope, its using declarations, and its used namespaces.
+    void put_scope(const definition_scope *s);
+    /// Write the contents of the given definition, of the given kind.
+    void put_body(definition *d, image_kind kind);
+  };
+
+  /**
+    @brief Reads a context from a binary image.
+
+    The reader never reads past the end of the image. If anything in it is malformed,
+    \c failed is set, and every read from then on returns zero or NULL. Nothing is
+    allocated until the checksum in the header matches the rest of the image, and a
+    definition is only accepted if exactly one scope, function, template, or the
+    context itself owns it, so that freeing the result frees each definition once.
+  **/
+  struct image_reader {
+    bool failed; ///< True once anything read has been found wrong.
+    string why; ///< A description of what was found wrong.
+
+    /// Read an unsigned number.
+    unsigned long get_uint();
+    /// Read a signed number.
+    long get_int();
+    /// Read a string.
+    string get_string();
+    /// Read a reference to a definition, which must be of one of the kinds in the given mask of (1 << image_kind).
+    definition *get_definition(unsigned kinds = ~0u);
+    /// Read a reference to a definition which the context itself is to own, as \c get_definition.
+    definition *get_root(unsigned kinds = ~0u);
+    /// Read a value into the given value, which must be empty.
+    void get_value(value &v);
+    /// Read a type into the given type, which must be empty.
+    void get_full_type(full_type &ft);
+    /// Read a stack of referencers into the given stack, which must be empty.
+    void get_refs(ref_stack &rs);
+    /// Read a template argument key; the result must be freed.
+    arg_key *get_arg_key();
+    /// Read an AST, which may be NULL; the result must be freed.
+    AST *get_ast();
+    /// Read a macro; the result must be released with \c macro_type::free.
+    const macro_type *get_macro();
+
+    /** Read the header and the list of definitions and allocate each, then read the contents
+        and parent of each. On failure, everything allocated is freed.
+        @return Returns whether the definitions were read completely. **/
+    bool get_definitions();
+    /// Free everything allocated by \c get_definitions, for when the rest of the image turns out to be bad.
+    void discard_definitions();
+    /// Return whether everything in the image has been read.
+    bool at_end() const;
+    /** Check that every definition read has exactly one owner, and that following owners
+        from any definition leads to the context. Fails the image otherwise. **/
+    void check_owners();
+
+    /** Begin reading an image held in memory.
+        @param data  The image; it must outlive the reader.
+        @param size  The size of the image, in bytes. **/
+    image_reader(const char *data, size_t size);
+
+  private:
+    const char *at; ///< The next byte to be read.
+    const char *end; ///< The end of the image.
+    vector<definition*> defs; ///< Each definition allocated, by number.
+    vector<unsigned char> kinds; ///< The kind of each definition allocated.
+    vector<size_t> owners; ///< The number of the owner of each definition, \c context_owner, or zero if none is known yet.
+    static const size_t context_owner = ~size_t(0); ///< Marks a definition owned by the context itself.
+
+    /// Mark the image bad, with a reason, unless it has already been marked so.
+    void fail(const string &reason);
+    /// Read an AST node and its children, which may be NULL.
+    AST::AST_Node *get_ast_node();
+    /// Read a reference to a definition as a number, zero for NULL, checking it as \c get_definition does.
+    size_t get_ref(unsigned kinds);
+    /// Read a reference to a definition which the definition numbered \p owner owns, unless it is that definition.
+    definition *get_owned(size_t owner, unsigned kinds = ~0u);
+    /// Read the members of the scope numbered \p id, its using declarations, and its used namespaces.
+    void get_scope(size_t id);
+    /// Allocate an empty definition of the given kind.
+    definition *make_definition(image_kind kind, unsigned flags, const string &name);
+    /// Read the contents of the definition numbered \p id.
+    void get_body(size_t id);
+    /// Empty the containers of the given definition without freeing their contents.
+    static void disown(definition *d, image_kind kind);
+  };
+}
+
+#endif
@@ -55,7 +55,19 @@ namespace jdi {
   
   ref_stack::node* ref_stack::node::duplicate() {
     if (type == RT_ARRAYBOUND) return new node_array(NULL,((node_array*)this)->bound);
-    if (type == RT_FUNCTION) return new node_func(NULL,((node_func*)this)->params);
+    if (type == RT_FUNCTION) {
+      // The node consumes what it is given; the parameters copied into it must be its own
+      const parameter_ct &from = ((node_func*)this)->params;
+      parameter_ct ps;
+      for (size_t i = 0; i < from.size(); ++i) {
+        parameter p;
+        p.copy(from[i]);
+        p.variadic = from[i].variadic;
+        p.default_value = from[i].default_value? from[i].default_value->duplicate() : NULL;
+        ps.throw_on(p);
+      }
+      return new node_func(NULL,ps);
+    }
     return new node(NULL,type);
   }
   
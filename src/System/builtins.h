@@ -145,6 +145,9 @@ namespace jdip {
     A map of flags and primitives to their usage and absolute type.
     This map *only* contains flags. Types can be aliased through typedef,
     and as such must be represented in a /c jdi::context.
+    
+    These maps are populated by \c jdi::initialize() and are only searched thereafter,
+    so parsers on separate threads may share them. Do not add to them while parsing.
     @see jdi::USAGE_FLAG
     @see jdi::builtin
   **/
@@ -0,0 +1,295 @@
+/**
+ * @file header_memo.cpp
+ * @brief Source implementing the memos of #included headers, and the traces from which they are made.
+ *
+ * @section License
+ *
+ * Copyright (C) 2012 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include "header_memo.h"
+#include <pthread.h>
+#include <General/atomics.h>
+
+using namespace std;
+using namespace jdi;
+using namespace jdip;
+
+const unsigned memo_token::no_file;
+
+namespace {
+  typedef map<string, vector<const header_memo*> > memo_map; ///< Maps the path of each header to its memos, oldest first.
+
+  pthread_mutex_t memo_lock = PTHREAD_MUTEX_INITIALIZER; ///< Held while anything below is used.
+  memo_map memos; ///< The memos looked through for each header, each held by the store.
+  const size_t memos_per_header = 8; ///< The most memos looked through for one header.
+
+  /// Take the memos of earlier texts of a header out of its list, into those to release; the store must be locked.
+  void drop_stale(vector<const header_memo*> &list, const raw_file *header, vector<const header_memo*> &dropped) {
+    size_t kept = 0;
+    for (size_t i = 0; i < list.size(); ++i)
+      if (list[i]->header == header)
+        list[kept++] = list[i];
+      else
+        dropped.push_back(list[i]);
+    list.resize(kept);
+  }
+
+  /// Release each of a list of memos, once the store is unlocked.
+  void release_all(const vector<const header_memo*> &dropped) {
+    for (size_t i = 0; i < dropped.size(); ++i)
+      release_header_memo(dropped[i]);
+  }
+
+  /// Return whether two macros, either of which may be NULL for none, would expand the same.
+  bool same_macro(const macro_type *a, const macro_type *b) {
+    if (a == b)
+      return true;
+    if (!a or !b or a->argc != b->argc or a->name != b->name)
+      return false;
+    return a->toString() == b->toString();
+  }
+
+  /// Free each macro held in a list of states.
+  void free_states(macro_states &states) {
+    for (size_t i = 0; i < states.size(); ++i)
+      if (states[i].second)
+        macro_type::free(states[i].second);
+    states.clear();
+  }
+}
+
+bool header_memo::matches(const macro_map &macros, const vector<string> &sdirs, const string &found_in) const
+{
+  if (found_in != sdir or sdirs != search_directories)
+    return false;
+  for (size_t i = 0; i < reads.size(); ++i) {
+    macro_iter_c mi = macros.find(reads[i].first);
+    if (!same_macro(mi == macros.end()? NULL : mi->second, reads[i].second))
+      return false;
+  }
+  return true;
+}
+
+header_memo::~header_memo() {
+  free_states(reads);
+  free_states(writes);
+  if (header)
+    release_tokens(header);
+  for (size_t i = 0; i < files.size(); ++i)
+    release_tokens(files[i].raw);
+}
+
+void jdip::find_header_memos(const raw_file *header, vector<const header_memo*> &dest)
+{
+  dest.clear();
+  vector<const header_memo*> dropped;
+  pthread_mutex_lock(&memo_lock);
+  memo_map::iterator it = memos.find(header->path);
+  if (it != memos.end()) {
+    drop_stale(it->second, header, dropped);
+    dest.assign(it->second.rbegin(), it->second.rend());
+    for (size_t i = 0; i < dest.size(); ++i)
+      retain_header_memo(dest[i]);
+  }
+  pthread_mutex_unlock(&memo_lock);
+  release_all(dropped);
+}
+
+void jdip::add_header_memo(header_memo *memo)
+{
+  vector<const header_memo*> dropped;
+  pthread_mutex_lock(&memo_lock);
+  vector<const header_memo*> &list = memos[memo->header->path];
+  drop_stale(list, memo->header, dropped);
+  if (list.size() >= memos_per_header) {
+    dropped.push_back(list.front());
+    list.erase(list.begin());
+  }
+  list.push_back(memo);
+  pthread_mutex_unlock(&memo_lock);
+  release_all(dropped);
+}
+
+void jdip::drop_header_memo(const header_memo *memo)
+{
+  bool found = false;
+  pthread_mutex_lock(&memo_lock);
+  memo_map::iterator it = memos.find(memo->header->path);
+  if (it != memos.end())
+    for (size_t i = 0; i < it->second.size() and !found; ++i)
+      if (it->second[i] == memo)
+        it->second.erase(it->second.begin() + i), found = true;
+  pthread_mutex_unlock(&memo_lock);
+  if (found)
+    release_header_memo(memo);
+}
+
+void jdip::retain_header_memo(const header_memo *memo) {
+  quick::atomic_inc(memo->refc);
+}
+void jdip::release_header_memo(const header_memo *memo) {
+  if (!quick::atomic_dec(memo->refc))
+    delete memo;
+}
+
+void jdip::clear_header_memos()
+{
+  memo_map held;
+  pthread_mutex_lock(&memo_lock);
+  held.swap(memos);
+  pthread_mutex_unlock(&memo_lock);
+  for (memo_map::iterator it = held.begin(); it != held.end(); ++it)
+    release_all(it->second);
+}
+
+header_trace::header_trace(const raw_file *hdr, const string &found_in, size_t dp, size_t conds, unsigned reps, size_t tfrom, size_t ffrom, size_t xfrom, size_t ifrom):
+  header(hdr), sdir(found_in), depth(dp), conditionals(conds), reports(reps), tokens_from(tfrom), files_from(ffrom), text_from(xfrom), includes_from(ifrom), valid(true) {}
+
+header_trace::~header_trace() {
+  for (map<string, const macro_type*>::iterator it = reads.begin(); it != reads.end(); ++it)
+    if (it->second)
+      macro_type::free(it->second);
+}
+
+void header_trace::read(const string &name, const macro_type *value)
+{
+  // Most names are looked at many times; only the first look, before any write, tells what the header needs
+  map<string, const macro_type*>::iterator it = reads.lower_bound(name);
+  if (it != reads.end() and it->first == name)
+    return;
+  if (writes.find(name) != writes.end())
+    return;
+  reads.insert(it, make_pair(name, value));
+  if (value)
+    macro_type::retain(value);
+}
+
+void header_trace::absorb(const header_trace &inner)
+{
+  for (map<string, const macro_type*>::const_iterator it = inner.reads.begin(); it != inner.reads.end(); ++it)
+    read(it->first, it->second);
+  writes.insert(inner.writes.begin(), inner.writes.end());
+}
+
+void header_trace::absorb(const header_memo &inner)
+{
+  for (size_t i = 0; i < inner.reads.size(); ++i)
+    read(inner.reads[i].first, inner.reads[i].second);
+  for (size_t i = 0; i < inner.writes.size(); ++i)
+    writes.insert(inner.writes[i].first);
+}
+
+void header_log::add_file(source_location base, const string &path, const raw_file *raw)
+{
+  logged_file f;
+  f.base = base;
+  f.size = raw->text.length + 1;
+  f.file.path = path;
+  f.file.raw = raw;
+  files.push_back(f);
+}
+
+unsigned header_log::find_file(source_location loc)
+{
+  if (!loc)
+    return memo_token::no_file;
+  if (last < files.size() and loc - files[last].base < files[last].size)
+    return last;
+  for (size_t i = files.size(); i--; )
+    if (loc - files[i].base < files[i].size)
+      return last = i;
+  return memo_token::no_file;
+}
+
+void header_log::add_token(const token_t &t)
+{
+  memo_token mt;
+  mt.token = t;
+  mt.text = memo_token::no_file;
+  mt.file = find_file(t.loc);
+  if (mt.file != memo_token::no_file)
+    mt.token.loc = t.loc - files[mt.file].base;
+  if (t.type != TT_DECLARATOR and t.type != TT_DECFLAG and t.str) {
+    mt.text = text.length();
+    text.append((const char*)t.str, t.len);
+  }
+  tokens.push_back(mt);
+}
+
+void header_log::add_include(source_location at)
+{
+  memo_include mi;
+  mi.from = find_file(at);
+  mi.offset = mi.from == memo_token::no_file? 0 : at - files[mi.from].base;
+  mi.to = files.size();
+  includes.push_back(mi);
+}
+
+header_memo *header_log::make_memo(const header_trace &trace, const macro_map &macros, const vector<string> &sdirs, const string &sdir_after) const
+{
+  header_memo *res = new header_memo();
+  retain_tokens(res->header = trace.header);
+  res->search_directories = sdirs;
+  res->sdir = trace.sdir;
+  res->sdir_after = sdir_after;
+  for (size_t i = trace.files_from; i < files.size(); ++i) {
+    retain_tokens(files[i].file.raw);
+    res->files.push_back(files[i].file);
+  }
+
+  res->tokens.reserve(tokens.size() - trace.tokens_from);
+  for (size_t i = trace.tokens_from; i < tokens.size(); ++i) {
+    memo_token mt = tokens[i];
+    if (mt.file != memo_token::no_file) {
+      if (mt.file < trace.files_from)
+        return release_header_memo(res), (header_memo*)NULL;
+      mt.file -= trace.files_from;
+    }
+    if (mt.text != memo_token::no_file)
+      mt.text -= trace.text_from;
+    res->tokens.push_back(mt);
+  }
+  res->text.assign(text, trace.text_from, string::npos);
+  for (size_t i = trace.includes_from; i < includes.size(); ++i) {
+    memo_include mi = includes[i];
+    if (mi.from == memo_token::no_file or mi.from < trace.files_from)
+      return release_header_memo(res), (header_memo*)NULL;
+    mi.from -= trace.files_from, mi.to -= trace.files_from;
+    res->includes.push_back(mi);
+  }
+
+  for (map<string, const macro_type*>::const_iterator it = trace.reads.begin(); it != trace.reads.end(); ++it) {
+    if (it->second)
+      macro_type::retain(it->second);
+    res->reads.push_back(*it);
+  }
+  for (set<string>::const_iterator it = trace.writes.begin(); it != trace.writes.end(); ++it) {
+    macro_iter_c mi = macros.find(*it);
+    const macro_type *now = mi == macros.end()? NULL : mi->second;
+    if (now)
+      macro_type::retain(now);
+    res->writes.push_back(make_pair(*it, now));
+  }
+  return res;
+}
+
+void header_log::clear() {
+  tokens.clear();
+  text.clear();
+  files.clear();
+  includes.clear();
+  last = 0;
+}
@@ -0,0 +1,183 @@
+/**
+ * @file header_memo.h
+ * @brief Header declaring the memos of #included headers, and the traces from which they are made.
+ *
+ * Most headers preprocess to the same tokens every time they are included, because the
+ * macros they look at have the same values every time. While a lexer set to memoize reads
+ * a header, it traces which macros the header looks at, by #if, #ifdef, defined(), or by
+ * expanding them, and what each held; which macros it defines or undefines; which files
+ * it includes; and every token it produces. When the header ends, that is kept as a memo.
+ * A later #include of the same text, by any lexer, when each macro looked at holds what it
+ * held then, makes the same definitions and produces the same tokens, which are returned
+ * without reading the header again.
+ *
+ * A header is only memoized if reading it reported nothing, and left the conditionals it
+ * was included within as it found them. The files a memo includes are checked to hold the
+ * same text before it is used; a file newly placed earlier in the search path is not noticed.
+ *
+ * Memos are shared by every lexer, on every thread. They are never changed once they are
+ * made, and are only freed by \c clear_header_memos.
+ *
+ * @section License
+ *
+ * Copyright (C) 2012 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef _HEADER_MEMO__H
+#define _HEADER_MEMO__H
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <System/token.h>
+#include <System/macros.h>
+#include <System/token_cache.h>
+
+namespace jdip {
+  /// A token produced by a memoized header, placed relative to the files of the memo.
+  struct memo_token {
+    /// The token; its location is an offset into its file, unless it is in none.
+    /// Its string is not kept, but rebuilt from \c text when the token is replayed.
+    token_t token;
+    unsigned file; ///< The index of the token's file in the memo, or \c no_file if its location is kept as it was.
+    unsigned text; ///< The offset of the token's text in the text of the memo, or \c no_file if it has none.
+    static const unsigned no_file = ~0u; ///< Marks a location which is not in any file of the memo.
+  };
+
+  /// A file opened while a header was read; the first is the header itself.
+  struct memo_file {
+    std::string path; ///< The path by which the file was opened.
+    const raw_file *raw; ///< The cached text of the file, held by the memo.
+  };
+
+  /// An #include obeyed while a header was read, placed relative to the files of the memo.
+  struct memo_include {
+    unsigned from; ///< The index of the including file.
+    unsigned offset; ///< The offset of the directive in that file.
+    unsigned to; ///< The index of the included file.
+  };
+
+  /// A list of macro names with what each held, or NULL where the macro was not defined.
+  typedef std::vector< std::pair<std::string, const macro_type*> > macro_states;
+
+  /// Everything a header did when it was read with some values of the macros it looked at.
+  struct header_memo {
+    /// The number of holders of this memo: the store, while it is looked through, and each lexer
+    /// replaying it, whose tokens point into its \c text. It is freed once none are left. This
+    /// count must only be modified through \c retain_header_memo and \c release_header_memo.
+    mutable volatile unsigned refc;
+    const raw_file *header; ///< The cached text of the header, held by the memo.
+    std::vector<std::string> search_directories; ///< The search directories it was read with.
+    std::string sdir; ///< The search directory it was found in, which #include_next continues from.
+    std::string sdir_after; ///< The search directory last loaded by the time it ended.
+    macro_states reads; ///< Each macro looked at, with what it held when the header was included.
+    macro_states writes; ///< Each macro defined or undefined, with what it held when the header ended.
+    std::vector<memo_file> files; ///< Each file opened, in order.
+    std::vector<memo_include> includes; ///< Each #include obeyed, in order.
+    std::vector<memo_token> tokens; ///< Each token produced, in order.
+    std::string text; ///< The text of each token, one after another.
+
+    /// Return whether the header would do the same again, given these macros and search directories.
+    bool matches(const jdi::macro_map &macros, const std::vector<std::string> &sdirs, const std::string &found_in) const;
+    header_memo(): refc(1), header(NULL) {} ///< Construct held once, by whoever made the memo.
+    ~header_memo(); ///< Release every macro and cached file held.
+  };
+
+  /** Find every memo of a header, newest first. Memos of an earlier text of the same file can
+      never match again, and are dropped.
+      @param header  The cached text of the header.
+      @param dest    The vector to receive the memos, each retained for the caller, who must give
+                     each to \c release_header_memo; it is cleared first. [out] **/
+  void find_header_memos(const raw_file *header, std::vector<const header_memo*> &dest);
+  /// Keep a memo, taking over the caller's hold on it. Only a few memos are looked through for
+  /// each header; the oldest is dropped to make room for another.
+  void add_header_memo(header_memo *memo);
+  /// Stop looking through a memo, such as one including a file whose text has since changed.
+  void drop_header_memo(const header_memo *memo);
+  /// Add a holder to a memo; safe to call while other threads retain or release it.
+  void retain_header_memo(const header_memo *memo);
+  /// Remove a holder from a memo, freeing it if none are left; safe to call while other threads retain or release it.
+  void release_header_memo(const header_memo *memo);
+  /// Drop every memo; each is freed once no lexer holds it.
+  void clear_header_memos();
+
+  /// What is known so far of a header which a lexer is reading, to be made into a memo at its end.
+  struct header_trace {
+    const raw_file *header; ///< The cached text of the header.
+    std::string sdir; ///< The search directory it was found in.
+    size_t depth; ///< The number of files the lexer has open while reading the header itself.
+    size_t conditionals; ///< The number of conditionals open where the header was included.
+    unsigned reports; ///< The number of errors and warnings the lexer had reported when the header was included.
+    size_t tokens_from; ///< The index in the lexer's \c header_log of the header's first token.
+    size_t files_from; ///< The index in the lexer's \c header_log of the header's own file.
+    size_t text_from; ///< The offset in the lexer's \c header_log of the text of the header's first token.
+    size_t includes_from; ///< The index in the lexer's \c header_log of the first #include within the header.
+    bool valid; ///< Cleared if something the header did cannot be memoized.
+    /// Each macro looked at which had not already been written, with what it held, retained.
+    std::map<std::string, const macro_type*> reads;
+    std::set<std::string> writes; ///< Each macro defined or undefined.
+
+    /// Note that the given macro was looked at, holding the given value.
+    void read(const std::string &name, const macro_type *value);
+    /// Note that the given macro was defined or undefined.
+    void write(const std::string &name) { writes.insert(name); }
+    /// Take on what a header included by this one looked at and wrote.
+    void absorb(const header_trace &inner);
+    /// Take on what a memoized header replayed by this one looked at and wrote.
+    void absorb(const header_memo &inner);
+
+    /// Begin tracing a header which has just been opened.
+    header_trace(const raw_file *hdr, const std::string &sdir, size_t depth,
+                 size_t conditionals, unsigned reports, size_t tokens_from, size_t files_from, size_t text_from, size_t includes_from);
+    ~header_trace(); ///< Release every macro held.
+  };
+
+  /**
+    @brief Every token a lexer produces while any header is traced, and the files they came from.
+
+    Traces of nested headers share one log; each memo is made from the end of the log, from
+    where its header began. The log is emptied once no header is traced.
+  **/
+  struct header_log {
+    /// A file opened while a header was traced.
+    struct logged_file {
+      source_location base; ///< The location of the first character of the file.
+      unsigned size; ///< The number of locations in the file.
+      memo_file file; ///< The path and cached text of the file.
+    };
+    std::vector<memo_token> tokens; ///< Each token produced, placed within the files of the log.
+    std::string text; ///< The text of each token, one after another.
+    std::vector<logged_file> files; ///< Each file opened, in order.
+    std::vector<memo_include> includes; ///< Each #include obeyed, placed within the files of the log.
+    size_t last; ///< The index in \c files of the file of the last token, where the next is likely to be.
+
+    /// Note a file opened, whose text was given the range of locations at \p base.
+    void add_file(source_location base, const std::string &path, const raw_file *raw);
+    /// Note a token produced.
+    void add_token(const token_t &t);
+    /// Note an #include obeyed at the given location, of the file next to be added.
+    void add_include(source_location at);
+    /// Find the file of the log holding a location, returning \c memo_token::no_file if none does.
+    unsigned find_file(source_location loc);
+    /** Make a memo from a trace which has ended.
+        @return Returns the memo, or NULL if a token was placed in a file opened before the header. **/
+    header_memo *make_memo(const header_trace &trace, const jdi::macro_map &macros, const std::vector<std::string> &sdirs, const std::string &sdir_after) const;
+    void clear(); ///< Empty the log.
+    header_log(): last(0) {} ///< Construct empty.
+  };
+}
+
+#endif
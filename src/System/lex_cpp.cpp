@@ -28,10 +28,15 @@
 #include <General/parse_basics.h>
 #include <General/debug_macros.h>
 #include <Parser/parse_context.h>
+#include <Parser/parse_budget.h>
+#include <Parser/parse_stats.h>
 #include <System/builtins.h>
 #include <API/context.h>
 #include <API/AST.h>
 #include <cstring>
+#include <deque>
+#include <algorithm>
+#include <iterator>
 
 #include <API/compile_settings.h>
 
@@ -49,35 +54,18 @@ static inline bool strbw(const char* s1, const char (&s2)[7]) { return *s1 == *s
 static inline bool strbw(const char* s1, const char (&s2)[11]){ return *s1 == *s2 and s1[1] == s2[1] and s1[2] == s2[2] and s1[3] == s2[3] and s1[4] == s2[4] and s1[5] == s2[5] and s1[6] == s2[6] and s1[7] == s2[7] and s1[8] == s2[8] and s1[9] == s2[9] and (!is_letterd(s1[10])); }
 static inline bool strbw(char s) { return !is_letterd(s); }
 
-void lexer_cpp::skip_comment()
-{
-  #if ALLOW_MULTILINE_COMMENTS
-  while (++pos < length and cfile[pos] != '\n' and cfile[pos] != '\r') if (cfile[pos] == '\\') {
-    if (cfile[++pos] == '\n') ++line, lpos = pos;
-    else if (cfile[pos] == '\r') pos += cfile[pos+1] == '\n', ++line, lpos = pos;
-  }
-  #else
-  while (++pos < length and cfile[pos] != '\n' and cfile[pos] != '\r');
-  #endif
-}
-
 static inline void skip_comment(const char* cfile, size_t &pos, size_t length)
 {
   #if ALLOW_MULTILINE_COMMENTS
-  while (++pos < length and cfile[pos] != '\n' and cfile[pos] != '\r') if (cfile[pos] == '\\') ++pos;
+  while (++pos < length and cfile[pos] != '\n' and cfile[pos] != '\r') if (cfile[pos] == '\\')
+    if (cfile[++pos] == '\r' and cfile[pos+1] == '\n') ++pos;
   #else
   while (++pos < length and cfile[pos] != '\n' and cfile[pos] != '\r');
   #endif
 }
 
-inline void lexer_cpp::skip_multiline_comment()
-{
-  if (cfile[pos++] == '/')
-    ++pos; // Skip one more char so we don't break on /*/
-  do if (pos >= length) return;
-    else if (cfile[pos] == '\n' or (cfile[pos] == '\r' and cfile[pos+1] != '\n')) ++line, lpos = pos;
-    while (cfile[pos++] != '*' or cfile[pos] != '/');
-  ++pos;
+void lexer_cpp::skip_comment() {
+  ::skip_comment(cfile, pos, length);
 }
 
 static inline void skip_multiline_comment(const char* cfile, size_t &pos, size_t length)
@@ -87,25 +75,40 @@ static inline void skip_multiline_comment(const char* cfile, size_t &pos, size_t
   ++pos;
 }
 
+inline void lexer_cpp::skip_multiline_comment() {
+  ::skip_multiline_comment(cfile, pos, length);
+}
+
 void lexer_cpp::skip_string(error_handler *herr)
 {
   register const char endc = cfile[pos];
   while (++pos < length and cfile[pos] != endc)
   {
     if (cfile[pos] == '\\') {
-      if (cfile[++pos] == '\n') ++line, lpos = pos;
-      else if (cfile[pos] == '\r') {
-        if (cfile[++pos] != '\n') --pos;
-        ++line, lpos = pos; 
-      }
+      if (cfile[++pos] == '\r' and cfile[pos+1] == '\n') ++pos;
     }
     else if (cfile[pos] == '\n' or cfile[pos] == '\r') {
-      herr->error("Unterminated string literal", filename, line, pos-lpos);
+      report_error(herr, "Unterminated string literal", pos, DIAG_UNTERMINATED);
       break;
     }
   }
   if (cfile[pos] != endc)
-    herr->error("Unterminated string literal", filename, line, pos-lpos);
+    report_error(herr, "Unterminated string literal", pos, DIAG_UNTERMINATED);
+}
+
+/// Skip a string as lexer_cpp::skip_string does, returning whether it would report no error.
+static inline bool skip_string_line(const char* cfile, size_t &pos, size_t length)
+{
+  register const char endc = cfile[pos];
+  while (++pos < length and cfile[pos] != endc)
+  {
+    if (cfile[pos] == '\\') {
+      if (cfile[++pos] == '\r' and cfile[pos+1] == '\n') ++pos;
+    }
+    else if (cfile[pos] == '\n' or cfile[pos] == '\r')
+      return false;
+  }
+  return pos < length;
 }
 
 static inline void skip_string(const char* cfile, size_t &pos, size_t length)
@@ -119,8 +122,8 @@ static inline void skip_string(const char* cfile, size_t &pos, size_t length)
 void lexer_cpp::skip_whitespace()
 {
   while (pos < length) {
-    while (cfile[pos] == ' ' or cfile[pos] == '\t') if (++pos >= length) return ++line, lpos = pos, void();
-    if (cfile[pos] == '\n' or (cfile[pos] == '\r' and cfile[pos+1] != '\n')) { ++line; lpos = pos++; continue; }
+    while (cfile[pos] == ' ' or cfile[pos] == '\t') if (++pos >= length) return;
+    if (cfile[pos] == '\n' or cfile[pos] == '\r') { ++pos; continue; }
     if (cfile[pos] == '/') {
       if (cfile[++pos] == '/') { skip_comment(); continue; }
       if (cfile[pos] == '*') { skip_multiline_comment(); continue; }
@@ -143,6 +146,41 @@ static inline void skip_whitespace(const char* cfile, size_t &pos, size_t length
   }
 }
 
+void lexer_cpp::report_error(error_handler *herr, string error, size_t at) const
+{
+  if (!herr->wants(DS_ERROR, DIAG_OTHER))
+    return;
+  string fn(filename);
+  int l = -1, p = -1;
+  resolve_source(here(at), fn, l, p);
+  herr->error(error, fn, l, p);
+}
+
+void lexer_cpp::report_warning(error_handler *herr, string warning, size_t at) const
+{
+  if (!herr->wants(DS_WARNING, DIAG_OTHER))
+    return;
+  string fn(filename);
+  int l = -1, p = -1;
+  resolve_source(here(at), fn, l, p);
+  herr->warning(warning, fn, l, p);
+}
+
+void lexer_cpp::report_error(error_handler *herr, const char *error, size_t at, diagnostic_id id) const
+{
+  if (!herr->wants(DS_ERROR, id))
+    return;
+  diagnostic d(DS_ERROR, id, error);
+  report(herr, d, at);
+}
+
+void lexer_cpp::report(error_handler *herr, diagnostic &d, size_t at) const
+{
+  if (!resolve_source(here(at), d.file, d.line, d.pos))
+    d.file = source_id(filename);
+  herr->report(d);
+}
+
 /// Space-saving macro to skip comments and string literals.
 #define skip_noncode(cond) {\
   if (cfile[pos] == '/') \
@@ -150,145 +188,185 @@ static inline void skip_whitespace(const char* cfile, size_t &pos, size_t length
     else if (cfile[pos+1] == '/') { skip_comment(); cond; } else {} \
   else if (cfile[pos] == '"' or cfile[pos] == '\'') { skip_string(herr), ++pos; cond; } }
 
-/// Space-saving static macro to skip comments and string literals.
-#define _skip_noncode(cond) {\
-  if (cfile[pos] == '/') \
-    if (cfile[pos+1] == '*') { ::skip_multiline_comment(cfile, pos, length); cond; } \
-    else if (cfile[pos+1] == '/') { ::skip_comment(cfile, pos, length); cond; } else {} \
-  else if (cfile[pos] == '"' or cfile[pos] == '\'') { ::skip_string(cfile, pos, length), ++pos; cond; } }
 
 
 void lexer_cpp::enter_macro(macro_scalar* ms)
 {
+  ++expansion_count;
+  PARSE_STATS_ONLY(if (clock) clock->expanded(ms));
   if (ms->value.empty()) return;
-  openfile of(filename, sdir, line, lpos, *this);
+  const source_location at = here(pos);
+  openfile of(filename, base, site, raw, *this, arena.top());
   files.enswap(of);
+  site = at, base = 0, raw = raw_cursor();
   filename = ms->name.c_str();
   this->encapsulate(ms->value);
-  line = lpos = pos = 0;
+  pos = 0;
   ++open_macro_count;
 }
 
-string lexer_cpp::_flatten(const string param, const macro_map& macros, const token_t &errep, error_handler *herr)
-{
-  const char* s;
-  string result = param;
-  const char* begin = param.c_str();
-  for (const char* i = begin; *i; ) {
-    bool id = is_letterd(*i);
-    s = i; while (is_letterd(*i)) ++i;
-    if (id)
-    {
-      if (is_letter(*s)) {
-        while (is_useless(*i)) ++i;
-        if (*i == '(') {
-          string name(s,i);
-          macro_iter_c mac = macros.find(name);
-          if (mac != macros.end() and mac->second->argc != -1) {
-            vector<string> arguments;
-            size_t p = i - begin;
-            const macro_function* mf = (macro_function*)mac->second;
-            parse_macro_params(mf, macros, begin, p, param.length(), arguments, errep, herr);
-            char *buf, *bufe;
-            mf->parse(arguments, buf, bufe, errep, herr);
-            i = begin + p;
-            result.replace(s-begin, i-s, buf, bufe-buf);
-            delete[] buf;
-          }
-        }
+namespace {
+  /**
+    Expands the calls to macro functions within text, such as the arguments to another call,
+    writing the result out in a single pass. The spans and pre-expanded text of arguments are
+    kept in one buffer for each depth of nesting, which is reused by every call at that depth.
+  **/
+  struct call_flattener {
+    const macro_map &macros; ///< The macros to expand.
+    const token_t &errep; ///< A token to use to report errors.
+    error_handler *herr; ///< The error handler to report errors to.
+    header_trace *trace; ///< The trace to note each macro looked up in, or NULL.
+    std::deque< vector<macro_span> > spans; ///< The arguments found at each depth.
+    std::deque<string> texts; ///< The pre-expanded arguments at each depth.
+    size_t depth; ///< The current depth of nesting.
+    
+    /// Append text to a string, expanding each call within it.
+    void flatten(const char *text, size_t length, string &dest);
+    /// Append the expansion of a call to a string; see \c lexer_cpp::expand_macro_call.
+    bool expand(const macro_function *mf, vector<macro_span> &args, string &dest);
+    
+    call_flattener(const macro_map &m, const token_t &e, error_handler *h, header_trace *t): macros(m), errep(e), herr(h), trace(t), depth(0) {}
+  };
+  
+  void call_flattener::flatten(const char *text, size_t length, string &dest)
+  {
+    size_t copied = 0; // The end of the text already appended
+    for (size_t pos = 0; pos < length; ) {
+      if (text[pos] == '"' or text[pos] == '\'') {
+        ::skip_string(text, pos, length), ++pos;
+        continue;
       }
+      if (!is_letterd(text[pos])) {
+        ++pos;
+        continue;
+      }
+      const size_t spos = pos;
+      while (++pos < length and is_letterd(text[pos]));
+      if (!is_letter(text[spos]))
+        continue;
+      
+      size_t ppos = pos;
+      while (ppos < length and is_useless(text[ppos])) ++ppos;
+      if (ppos >= length or text[ppos] != '(')
+        continue;
+      const string name(text + spos, pos - spos);
+      macro_iter_c mi = macros.find(name);
+      if (trace)
+        trace->read(name, mi == macros.end()? NULL : mi->second);
+      if (mi == macros.end() or mi->second->argc < 0)
+        continue;
+      
+      const macro_function *mf = (const macro_function*)mi->second;
+      if (spans.size() <= depth)
+        spans.resize(depth + 1);
+      vector<macro_span> &args = spans[depth];
+      if (!lexer_cpp::find_macro_params(mf, text, ppos, length, args, errep, herr))
+        continue;
+      dest.append(text + copied, spos - copied);
+      copied = expand(mf, args, dest)? ppos : spos; // A bad call is left as it was written
+      pos = ppos;
     }
-    else ++i;
+    dest.append(text + copied, length - copied);
+  }
+  
+  bool call_flattener::expand(const macro_function *mf, vector<macro_span> &args, string &dest)
+  {
+    const size_t named = mf->args.size();
+    if (args.size() == 1 and !mf->argc) {
+      size_t i = 0;
+      while (i < args[0].len and is_useless(args[0].str[i])) ++i;
+      if (i == args[0].len)
+        args.clear(); // Nothing was given to a function taking nothing
+    }
+    if (args.size() + 1 < named)
+      return errep.report_error(herr, DIAG_MACRO_ARGUMENTS, "Too few arguments to macro function `%s': provided %d, requested %d",
+                                mf->name, args.size(), named), false;
+    if (args.size() > named and named == (size_t)mf->argc)
+      return errep.report_error(herr, DIAG_MACRO_ARGUMENTS, "Too many arguments to macro function `%s'", mf->name), false;
+    args.resize(mf->argc); // A missing last argument, or variadic argument, is empty
+    
+    // Expand each argument onto the end of this depth's buffer, then point the spans into it
+    if (texts.size() <= depth)
+      texts.resize(depth + 1);
+    string &text = texts[depth];
+    text.clear();
+    ++depth;
+    for (size_t i = 0; i < args.size(); ++i) {
+      const size_t start = text.length();
+      flatten(args[i].str, args[i].len, text);
+      args[i] = macro_span(NULL, start); // Only the offset is known until the buffer stops growing
+    }
+    --depth;
+    for (size_t i = 0; i < args.size(); ++i) {
+      const size_t start = args[i].len, end = i + 1 < args.size()? args[i+1].len : text.length();
+      args[i] = macro_span(text.c_str() + start, end - start);
+    }
+    
+    mf->substitute(args.empty()? NULL : &args[0], dest);
+    return true;
   }
-  return result;
 }
 
-bool lexer_cpp::parse_macro_params(const macro_function* mf, const macro_map &macros, const char* cfile, size_t &pos, size_t length, vector<string>& dest, const token_t &errep, error_handler *herr)
+bool lexer_cpp::find_macro_params(const macro_function* mf, const char* cfile, size_t &pos, size_t length, vector<macro_span>& dest, const token_t &errep, error_handler *herr)
 {
-  ::skip_whitespace(cfile, pos, length);
-  
+  dest.clear();
   size_t pspos = ++pos;
-  dest.reserve(mf->argc);
   
-  // Read the parameters into our argument vector
-  int nestcnt = 1;
-  while (pos < length and nestcnt > 0) {
-    if (cfile[pos] == ',' and nestcnt == 1) {
-      dest.push_back(_flatten(string(cfile+pspos, pos-pspos), macros, errep, herr));
-      pspos = ++pos;
-      _skip_noncode(continue);
-      continue;
-    } else if (cfile[pos] == ')') { if (--nestcnt) ++pos; continue; }
-      else if (cfile[pos] == '(') ++nestcnt;
-      else if (cfile[pos] == '"' or cfile[pos] == '\'') 
-        ::skip_string(cfile, pos, length);
-    ++pos; _skip_noncode(continue);
+  // Split the parameters at each comma outside nested parentheses, save those within the variadic argument
+  for (int nestcnt = 1; pos < length; ++pos) {
+    if (cfile[pos] == '"' or cfile[pos] == '\'')
+      ::skip_string(cfile, pos, length);
+    else if (cfile[pos] == '(')
+      ++nestcnt;
+    else if (cfile[pos] == ')') {
+      if (!--nestcnt) break;
+    }
+    else if (cfile[pos] == ',' and nestcnt == 1 and (dest.size() + 1 < (size_t)mf->argc or mf->args.size() == (size_t)mf->argc)) {
+      dest.push_back(macro_span(cfile + pspos, pos - pspos));
+      pspos = pos + 1;
+    }
   }
-  if (pos >= length or cfile[pos] != ')') {
-    errep.report_error(herr, "Unterminated parameters to macro function");
+  if (pos >= length) {
+    errep.report_error(herr, "Unterminated parameters to macro function", DIAG_UNTERMINATED);
     return false;
   }
   
-  if (pos > pspos) // If there was a parameter
-    dest.push_back(_flatten(string(cfile+pspos, pos-pspos), macros, errep, herr)); // Nab the final parameter
+  dest.push_back(macro_span(cfile + pspos, pos - pspos)); // Nab the final parameter
   ++pos; // Don't get bitten in the ass by the closing parenthesis after the file pop.
   return true;
 }
 
-bool lexer_cpp::parse_macro_params(const macro_function* mf, vector<string>& dest, error_handler *herr)
+bool lexer_cpp::expand_macro_call(const macro_function* mf, vector<macro_span>& args, const macro_map &macros, string &dest, const token_t &errep, error_handler *herr, header_trace *trace)
 {
-  skip_whitespace();
-  
-  size_t pspos = ++pos;
-  dest.reserve(mf->argc);
-  
-  // Read the parameters into our argument vector
-  int nestcnt = 1;
-  while (pos < length and nestcnt > 0) {
-    if (cfile[pos] == ',' and nestcnt == 1) {
-      dest.push_back(_flatten(string(cfile+pspos, pos-pspos), macros, token_t(token_basics(TT_INVALID, filename, line, pos)), herr));
-      pspos = ++pos;
-      skip_noncode(continue);
-      continue;
-    } else if (cfile[pos] == ')') { if (--nestcnt) ++pos; continue; }
-      else if (cfile[pos] == '(') ++nestcnt;
-      else if (cfile[pos] == '"' or cfile[pos] == '\'') 
-        skip_string(herr);
-    ++pos; skip_noncode(continue);
-  }
-  if (pos >= length or cfile[pos] != ')') {
-    herr->error("Unterminated parameters to macro function", filename, line, pos - lpos);
-    return false;
-  }
-  
-  if (pos > pspos) // If there was a parameter
-    dest.push_back(_flatten(string(cfile+pspos, pos-pspos), macros, token_t(token_basics(TT_INVALID, filename, line, pos)), herr)); // Nab the final parameter
-  ++pos; // Don't get bitten in the ass by the closing parenthesis after the file pop.
-  return true;
+  call_flattener cf(macros, errep, herr, trace);
+  return cf.expand(mf, args, dest);
 }
 
 bool lexer_cpp::parse_macro_function(const macro_function* mf, error_handler *herr)
 {
-  const size_t spos = pos, slpos = lpos, sline = line;
+  const size_t spos = pos;
   skip_whitespace(); // Move to the next "token"
-  if (pos >= length or cfile[pos] != '(') { pos = spos, lpos = slpos, line = sline; return false; }
+  if (pos >= length or cfile[pos] != '(') { pos = spos; return false; }
   
-  vector<string> params;
-  parse_macro_params(mf, params, herr);
+  const token_t errep(TT_INVALID, here(pos));
+  vector<macro_span> params;
+  substituted.clear();
+  if (!find_macro_params(mf, cfile, pos, length, params, errep, herr)
+  or  !expand_macro_call(mf, params, macros, substituted, errep, herr, traces.empty()? NULL : traces.back()))
+    return true;
+  ++expansion_count;
+  PARSE_STATS_ONLY(if (clock) clock->expanded(mf));
+  if (substituted.empty())
+    return true;
   
   // Enter the macro
-  openfile of(filename, sdir, line, lpos, *this);
+  openfile of(filename, base, site, raw, *this, arena.top());
   files.enswap(of);
-  alias(files.top().file);
-  char *buf, *bufe;
-  if (!mf->parse(params, buf, bufe, token_t(token_basics(TT_INVALID,filename,line,lpos-pos)), herr)) {
-    this->consume(files.top().file);
-    files.pop();
-    return true;
-  }
-  this->consume(buf, bufe-buf);
+  site = errep.loc, base = 0, raw = raw_cursor();
+  char *buf = arena.allocate(substituted.length());
+  memcpy(buf, substituted.c_str(), substituted.length());
+  this->alias(buf, substituted.length());
   filename = mf->name.c_str();
-  lpos = line = 0;
   return true;  
 }
 
@@ -303,7 +381,7 @@ string lexer_cpp::read_preprocessor_args(error_handler *herr)
       break;
     }
     if (cfile[pos] == '\n' or cfile[pos] == '\r') return "";
-    if (cfile[pos] == '\\' and (cfile[++pos] == '\n' or (cfile[pos] == '\r' and (cfile[++pos] == '\n' or --pos)))) { lpos = pos++; ++line; }
+    if (cfile[pos] == '\\' and (cfile[++pos] == '\n' or (cfile[pos] == '\r' and (cfile[++pos] == '\n' or --pos)))) ++pos;
     break;
   }
   string res;
@@ -318,7 +396,7 @@ string lexer_cpp::read_preprocessor_args(error_handler *herr)
         skip_multiline_comment(); spos = pos; continue; }
     }
     if (cfile[pos] == '\'' or cfile[pos] == '"') skip_string(herr), ++pos;
-    else if (cfile[pos] == '\\' and (cfile[++pos] == '\n' or (cfile[pos] == '\r' and (cfile[++pos] == '\n' or --pos)))) { lpos = pos++; ++line; }
+    else if (cfile[pos] == '\\' and (cfile[++pos] == '\n' or (cfile[pos] == '\r' and (cfile[++pos] == '\n' or --pos)))) ++pos;
     else ++pos;
   }
   res += string(cfile+spos,pos-spos);
@@ -347,6 +425,7 @@ string lexer_cpp::read_preprocessor_args(error_handler *herr)
 **/
 void lexer_cpp::handle_preprocessor(error_handler *herr)
 {
+  phase_scope timing(clock, PHASE_DIRECTIVES);
   top:
   bool variadic = false; // Whether this function is variadic
   while (cfile[pos] == ' ' or cfile[pos] == '\t') ++pos;
@@ -413,11 +492,13 @@ void lexer_cpp::handle_preprocessor(error_handler *herr)
       size_t i = 0;
       while (is_useless(argstr[i])) ++i;
       if (!is_letter(argstr[i])) {
-        herr->error("Expected macro definiendum at this point", filename, line, pos-lpos);
+        report_error(herr, "Expected macro definiendum at this point", pos, DIAG_MACRO_DEFINITION);
       }
       const size_t nsi = i;
       while (is_letterd(argstr[++i]));
       pair<macro_iter, bool> mins = macros.insert(pair<string,macro_type*>(argstrs.substr(nsi,i-nsi),NULL));
+      if (!traces.empty())
+        traces.back()->write(mins.first->first);
       
       if (argstr[i] == '(') {
         vector<string> paramlist;
@@ -428,11 +509,11 @@ void lexer_cpp::handle_preprocessor(error_handler *herr)
               variadic = true, i += 3;
               while (is_useless(argstr[i])) ++i;
               if (argstr[i] != ')')
-                herr->error("Expected end of parameters after variadic", filename, line, pos-lpos);
+                report_error(herr, "Expected end of parameters after variadic", pos, DIAG_MACRO_DEFINITION);
               break;
             }
             else {
-              herr->error("Expected parameter name for macro declaration", filename, line, pos-lpos);
+              report_error(herr, "Expected parameter name for macro declaration", pos, DIAG_MACRO_DEFINITION);
               break;
             }
           }
@@ -449,16 +530,16 @@ void lexer_cpp::handle_preprocessor(error_handler *herr)
             i += 2; while (is_useless(argstr[++i]));
             variadic = true;
             if (argstr[i] == ')') break;
-            herr->error("Expected closing parenthesis at this point; further parameters not allowed following variadic", filename, line, pos-lpos);
+            report_error(herr, "Expected closing parenthesis at this point; further parameters not allowed following variadic", pos, DIAG_MACRO_DEFINITION);
           }
           else
-            herr->error("Expected comma or closing parenthesis at this point", filename, line, pos-lpos);
+            report_error(herr, "Expected comma or closing parenthesis at this point", pos, DIAG_MACRO_DEFINITION);
         }
         
         if (!mins.second) { // If no insertion was made; ie, the macro existed already.
         //  if ((size_t)mins.first->second->argc != paramlist.size())
         //    herr->warning("Redeclaring macro function `" + mins.first->first + '\'', filename, line, pos-lpos);
-          macro_type::free(mins.first->second);
+          release_macro(mins.first->second);
           mins.first->second = NULL;
         }
         mins.first->second = new macro_function(mins.first->first,paramlist, argstrs.substr(++i), variadic, herr);
@@ -468,7 +549,7 @@ void lexer_cpp::handle_preprocessor(error_handler *herr)
         if (!mins.second) { // If no insertion was made; ie, the macro existed already.
         //  if (mins.first->second->argc != -1 or ((macro_scalar*)mins.first->second)->value != argstr.substr(i))
         //    herr->warning("Redeclaring macro `" + mins.first->first + '\'', filename, line, pos-lpos);
-          macro_type::free(mins.first->second);
+          release_macro(mins.first->second);
           mins.first->second = NULL;
         }
         while (is_useless(argstr[i])) ++i;
@@ -477,13 +558,15 @@ void lexer_cpp::handle_preprocessor(error_handler *herr)
     } break;
     case_error: {
         string emsg = read_preprocessor_args(herr);
-        if (conditionals.empty() or conditionals.top().is_true)
-          herr->error(token_basics("#error " + emsg,filename,line,pos-lpos));
+        if ((conditionals.empty() or conditionals.top().is_true) and herr->wants(DS_ERROR, DIAG_USER)) {
+          diagnostic d(DS_ERROR, DIAG_USER, "#error %s");
+          report(herr, d.arg(emsg), pos);
+        }
       } break;
       break;
     case_elif:
         if (conditionals.empty())
-          herr->error(token_basics("Unexpected #elif directive; no matching #if",filename,line,pos-lpos));
+          report_error(herr, "Unexpected #elif directive; no matching #if", pos, DIAG_CONDITIONAL);
         else {
           if (conditionals.top().is_true)
             conditionals.top().is_true = conditionals.top().can_be_true = false;
@@ -497,7 +580,7 @@ void lexer_cpp::handle_preprocessor(error_handler *herr)
       break;
     case_elifdef:
         if (conditionals.empty())
-          herr->error(token_basics("Unexpected #elifdef directive; no matching #if",filename,line,pos-lpos));
+          report_error(herr, "Unexpected #elifdef directive; no matching #if", pos, DIAG_CONDITIONAL);
         else {
           if (conditionals.top().is_true)
             conditionals.top().is_true = conditionals.top().can_be_true = false;
@@ -511,7 +594,7 @@ void lexer_cpp::handle_preprocessor(error_handler *herr)
       break;
     case_elifndef:
         if (conditionals.empty())
-          herr->error(token_basics("Unexpected #elifndef directive; no matching #if",filename,line,pos-lpos));
+          report_error(herr, "Unexpected #elifndef directive; no matching #if", pos, DIAG_CONDITIONAL);
         else {
           if (conditionals.top().is_true)
             conditionals.top().is_true = conditionals.top().can_be_true = false;
@@ -525,7 +608,7 @@ void lexer_cpp::handle_preprocessor(error_handler *herr)
       break;
     case_else:
         if (conditionals.empty())
-          herr->error(token_basics("Unexpected #else directive; no matching #if",filename,line,pos-lpos));
+          report_error(herr, "Unexpected #else directive; no matching #if", pos, DIAG_CONDITIONAL);
         else {
           if (conditionals.top().is_true)
             conditionals.top().is_true = conditionals.top().can_be_true = false;
@@ -535,22 +618,25 @@ void lexer_cpp::handle_preprocessor(error_handler *herr)
       break;
     case_endif:
         if (conditionals.empty())
-          return herr->error(token_basics("Unexpected #endif directive: no open conditionals.",filename,line,pos-lpos));
+          return report_error(herr, "Unexpected #endif directive: no open conditionals.", pos, DIAG_CONDITIONAL);
         conditionals.pop();
       break;
     case_if: 
         if (conditionals.empty() or conditionals.top().is_true) {
+          phase_scope evaluating(clock, PHASE_CONDITIONALS);
           mlex->update();
           
           AST a;
-          if (a.parse_expression(mlex, herr) or !a.eval()) {
-            token_t res;
-            render_ast(a, "if_directives");
-            conditionals.push(condition(0,1));
-            break;
-          }
+          const size_t open_files = files.size();
+          const bool is_true = !a.parse_expression(mlex, herr) and a.eval();
+          
+          // An error can leave macros entered by the expression open, and the rest of the line unread
+          while (files.size() > open_files)
+            pop_file();
+          while (pos < length and cfile[pos] != '\n' and cfile[pos] != '\r') ++pos;
+          
           render_ast(a, "if_directives");
-          conditionals.push(condition(1,0));
+          conditionals.push(is_true? condition(1,0) : condition(0,1));
         }
         else
           conditionals.push(condition(0,0));
@@ -558,14 +644,14 @@ void lexer_cpp::handle_preprocessor(error_handler *herr)
     case_ifdef: {
         while (is_useless(cfile[pos])) ++pos;
         if (!is_letter(cfile[pos])) {
-          herr->error("Expected identifier to check against macros",filename,line,pos);
+          report_error(herr, "Expected identifier to check against macros", pos, DIAG_DIRECTIVE);
           break;
         }
         const size_t msp = pos;
         while (is_letterd(cfile[++pos]));
         string macro(cfile+msp, pos-msp);
         if (conditionals.empty() or conditionals.top().is_true) {
-          if (macros.find(macro) == macros.end()) {
+          if (find_macro(macro) == macros.end()) {
             token_t res;
             conditionals.push(condition(0,1));
             break;
@@ -578,14 +664,14 @@ void lexer_cpp::handle_preprocessor(error_handler *herr)
     case_ifndef: {
         while (is_useless(cfile[pos])) ++pos;
         if (!is_letter(cfile[pos])) {
-          herr->error("Expected identifier to check against macros",filename,line,pos);
+          report_error(herr, "Expected identifier to check against macros", pos, DIAG_DIRECTIVE);
           break;
         }
         const size_t msp = pos;
         while (is_letterd(cfile[++pos]));
         string macro(cfile+msp, pos-msp);
         if (conditionals.empty() or conditionals.top().is_true) {
-          if (macros.find(macro) != macros.end()) {
+          if (find_macro(macro) != macros.end()) {
             token_t res;
             conditionals.push(condition(0,1));
             break;
@@ -611,13 +697,16 @@ void lexer_cpp::handle_preprocessor(error_handler *herr)
         if (!incnext and fnfind[0] == '"')
           chklocal = true, match = '"';
         else if (fnfind[0] != '<') {
-          herr->error("Expected filename inside <> or \"\" delimiters", filename, line, pos - lpos);
+          report_error(herr, "Expected filename inside <> or \"\" delimiters", pos, DIAG_INCLUDE);
           break;
         }
         fnfind[0] = '/';
         for (size_t i = 0; i < fnfind.length(); ++i)
           if (fnfind[i] == match) { fnfind.erase(i); break; }
         
+        if (budget and budget->check())
+          break; // The parse is over; whatever is included would not be read
+        
         if (files.size() > 9000) {
           herr->error("Nested include count is OVER NINE THOUSAAAAAAAAND. Not including another.");
           break;
@@ -625,29 +714,52 @@ void lexer_cpp::handle_preprocessor(error_handler *herr)
         
         string incfn, fdir = sdir;
         llreader incfile;
-        if (chklocal)
-          incfile.open((incfn = path + fnfind).c_str());
-        for (size_t i = 0; i < builtin->search_dir_count(); ++i) {
-          if (incfile.is_open()) break;
-          if (!incnext)
-            incfile.open((incfn = (fdir = builtin->search_dir(i)) + fnfind).c_str());
-          else
-            incnext = sdir != builtin->search_dir(i);
+        {
+          phase_scope searching(clock, PHASE_IO);
+          if (chklocal)
+            incfile.open((incfn = path + fnfind).c_str());
+          for (size_t i = 0; i < search_directories.size(); ++i) {
+            if (incfile.is_open()) break;
+            if (!incnext)
+              incfile.open((incfn = (fdir = search_directories[i]) + fnfind).c_str());
+            else
+              incnext = sdir != search_directories[i];
+          }
         }
         if (!incfile.is_open()) {
-          herr->error("Could not find " + fnfind.substr(1), filename, line, pos-lpos);
+          if (!herr->wants(DS_ERROR, DIAG_INCLUDE))
+            break;
+          diagnostic d(DS_ERROR, DIAG_INCLUDE, "Could not find %s");
+          report(herr, d.arg(fnfind.data() + 1, fnfind.length() - 1), pos);
           if (chklocal) cerr << "  Checked " << path << endl;
-          for (size_t i = 0; !incfile.is_open() and i < builtin->search_dir_count(); ++i)
-            cerr << "  Checked " << builtin->search_dir(i) << endl;
+          for (size_t i = 0; !incfile.is_open() and i < search_directories.size(); ++i)
+            cerr << "  Checked " << search_directories[i] << endl;
           break;
         }
         
-        openfile of(filename, sdir = fdir, line, lpos, *this);
+        const raw_file *cached = cache_tokens(incfn, incfile);
+        cached_files.push_back(cached);
+        const include_site inc = { filename, incfn, here(pspos) };
+        includes.push_back(inc);
+        if (!traces.empty())
+          memo_log.add_include(inc.at);
+        if (memoize and at_top and replay_header(cached, fdir))
+          break;
+        openfile of(filename, sdir = fdir, base, site, raw, *this);
         files.enswap(of);
         pair<set<string>::iterator, bool> fi = visited_files.insert(incfn);
         filename = fi.first->c_str();
-        this->consume(incfile);
-        line = 1;
+        PARSE_STATS_ONLY(if (clock) clock->enter_file(filename));
+        this->alias(cached->text);
+        raw = raw_cursor(cached);
+        sources.push_back(base = open_source(filename, data, length, &cached->breaks));
+        if (memoize) {
+          if (at_top)
+            traces.push_back(new header_trace(cached, fdir, files.size(), conditionals.size(), reports,
+                                              memo_log.tokens.size(), memo_log.files.size(), memo_log.text.length(), memo_log.includes.size()));
+          if (!traces.empty())
+            memo_log.add_file(base, incfn, cached);
+        }
       } break;
     case_line:
       break;
@@ -668,13 +780,16 @@ void lexer_cpp::handle_preprocessor(error_handler *herr)
         
         while (is_useless(cfile[pos])) ++pos;
         if (!is_letter(cfile[pos]))
-          herr->error("Expected macro identifier at this point", filename, line, pos);
+          report_error(herr, "Expected macro identifier at this point", pos, DIAG_DIRECTIVE);
         else {
           const size_t nspos = pos;
           while (is_letterd(cfile[++pos]));
-          macro_iter mdel = macros.find(string(cfile+nspos,pos-nspos));
+          const string name(cfile+nspos,pos-nspos);
+          if (!traces.empty())
+            traces.back()->write(name);
+          macro_iter mdel = macros.find(name);
           if (mdel != macros.end()) {
-            macro_type::free(mdel->second);
+            release_macro(mdel->second);
             macros.erase(mdel);
           }
         }
@@ -683,14 +798,57 @@ void lexer_cpp::handle_preprocessor(error_handler *herr)
       break;
     case_warning: {
         string wmsg = read_preprocessor_args(herr);
-        if (conditionals.empty() or conditionals.top().is_true)
-          herr->warning(token_basics("#warning " + wmsg,filename,line,pos-lpos));
+        if ((conditionals.empty() or conditionals.top().is_true) and herr->wants(DS_WARNING, DIAG_USER)) {
+          diagnostic d(DS_WARNING, DIAG_USER, "#warning %s");
+          report(herr, d.arg(wmsg), pos);
+        }
       } break;
   }
+  // A header which closes or flips a conditional it was included within cannot be replayed alone
+  for (size_t i = traces.size(); i-- and traces[i]->conditionals >= conditionals.size(); )
+    if (traces[i]->conditionals > conditionals.size() or (!conditionals.empty() and !conditionals.top().is_true))
+      traces[i]->valid = false;
   if (conditionals.empty() or conditionals.top().is_true)
     return;
   
-  // skip_to_macro:
+  if (skip_to_macro(herr))
+    goto top;
+  report_error(herr, "Expected closing preprocessors before end of code", pos, DIAG_CONDITIONAL);
+  return;
+  
+  failout:
+    while (is_letterd(cfile[pos])) ++pos;
+    if (herr->wants(DS_ERROR, DIAG_DIRECTIVE)) {
+      diagnostic d(DS_ERROR, DIAG_DIRECTIVE, "Invalid preprocessor directive `%s'");
+      report(herr, d.arg(cfile + pspos, pos - pspos), pos);
+    }
+    while (pos < length and cfile[pos] != '\n' and cfile[pos] != '\r') ++pos;
+}
+
+/// Move an index into a sorted list of offsets up to the first at or after the given position.
+/// The position seldom moves back, so the list is only searched afresh when it has.
+static size_t seek_offset(const vector<unsigned> &offsets, size_t from, size_t pos) {
+  if (from and offsets[from - 1] >= pos)
+    return lower_bound(offsets.begin(), offsets.end(), pos) - offsets.begin();
+  while (from < offsets.size() and offsets[from] < pos)
+    ++from;
+  return from;
+}
+
+bool lexer_cpp::skip_to_macro(error_handler *herr)
+{
+  // With the file's tokens cached, go straight to the next directive, unless something
+  // reading the characters between here and there would report is in the way
+  if (raw_in_step()) {
+    const raw_file &rf = *raw.file;
+    raw.directive = seek_offset(rf.directives, raw.directive, pos);
+    const size_t next = raw.directive == rf.directives.size()? length : rf.directives[raw.directive];
+    raw.error = seek_offset(rf.errors, raw.error, pos);
+    if (raw.error == rf.errors.size() or rf.errors[raw.error] >= next) {
+      pos = next;
+      return pos < length? ++pos, true : false;
+    }
+  }
   while (pos < length) {
     while (pos < length and cfile[pos] != '\n' and cfile[pos] != '\r') {
       skip_noncode(continue);
@@ -698,29 +856,130 @@ void lexer_cpp::handle_preprocessor(error_handler *herr)
     }
     if (pos >= length)
       break;
-    while (is_useless(cfile[pos])) {
-      if (cfile[pos] == '\n') lpos = pos++, ++line;
-      else if (cfile[pos] == '\r' and (cfile[++pos] == '\n' or --pos)) lpos = pos++, ++line;
-      else ++pos;
-    }
+    while (is_useless(cfile[pos])) ++pos;
     if (cfile[pos] == '#')
-      { ++pos; goto top; }
+      return ++pos, true;
+  }
+  return false;
+}
+
+void lexer_cpp::read_directives(error_handler *herr)
+{
+  at_top = false;
+  for (;;) {
+    if (!pos) { // skip_to_macro only looks for directives after the end of a line
+      while (pos < length and is_useless(cfile[pos])) ++pos;
+      if (pos < length and cfile[pos] == '#') {
+        ++pos;
+        handle_preprocessor(herr);
+        continue;
+      }
+    }
+    if (skip_to_macro(herr))
+      handle_preprocessor(herr);
+    else if (pop_file())
+      return;
   }
-  herr->error("Expected closing preprocessors before end of code",filename,line,pos-lpos);
-  return;
-  
-  failout:
-    while (is_letterd(cfile[pos])) ++pos;
-    string ppname(cfile + pspos, pos - pspos);
-    herr->error(token_basics("Invalid preprocessor directive `" + ppname + "'",filename,line,pos-lpos));
-    while (pos < length and cfile[pos] != '\n' and cfile[pos] != '\r') ++pos;
 }
 
 #include <cstdio>
-token_t lexer_cpp::get_token(error_handler *herr)
+
+/**
+  Read a number, or any symbol other than a pound, a quote, or a backslash, which callers
+  handle themselves; slashes beginning comments must also have been handled already.
+  Returns a TT_INVALID token, without moving, if there is no such symbol here.
+**/
+static inline token_t read_symbol(const char* cfile, size_t &pos, size_t length, source_location at)
 {
-  get_token_top:
+  if (is_digit(cfile[pos])) {
+    if (cfile[pos] == '0') { // Check if the number is hexadecimal or octal.
+      if (cfile[++pos] == 'x') { // Check if the number is hexadecimal.
+        // Yes, it is hexadecimal.
+        const size_t sp = pos;
+        while (++pos < length and is_hexdigit(cfile[pos]));
+        while (pos < length and is_letter(cfile[pos])) pos++; // Include the flags, like ull
+        return token_t(TT_HEXLITERAL, at, cfile+sp, pos-sp);  
+      }
+      // Turns out, it's octal.
+      const size_t sp = --pos;
+      while (++pos < length and is_hexdigit(cfile[pos]));
+      while (pos < length and is_letter(cfile[pos])) pos++; // Include the flags, like ull
+      return token_t(TT_OCTLITERAL, at, cfile+sp, pos-sp);
+    }
+    // Turns out, it's decimal.
+    handle_decimal:
+    const size_t sp = pos;
+    while (++pos < length and is_digit(cfile[pos]));
+    if (cfile[pos] == '.')
+      while (++pos < length and is_digit(cfile[pos]));
+    if (cfile[pos] == 'e' or cfile[pos] == 'E') { // Accept exponents
+      if (cfile[++pos] == '-') ++pos;
+      while (pos < length and is_digit(cfile[pos])) ++pos;
+    }
+    while (pos < length and is_letter(cfile[pos])) ++pos; // Include the flags, like ull
+    return token_t(TT_DECLITERAL, at, cfile+sp, pos-sp);
+  }
   
+  const size_t spos = pos;
+  switch (cfile[pos++])
+  {
+    case ';':
+      return token_t(TT_SEMICOLON, at, cfile+spos, 1);
+    case ',':
+      return token_t(TT_COMMA, at, cfile+spos, 1);
+    case '+': case '-':
+      pos += cfile[pos] == cfile[spos] or cfile[pos] == '=' or (cfile[pos] == '>' and cfile[spos] == '-');
+      pos += (cfile[pos-1] == '>' and cfile[pos] == '*');
+      return token_t(TT_OPERATOR, at, cfile+spos, pos-spos);
+    case '=': pos += cfile[pos] == cfile[spos];
+      return token_t(TT_OPERATOR, at, cfile+spos, pos-spos);
+    case '&': case '|':  case '!':
+      pos += cfile[pos] == cfile[spos] || cfile[pos] == '=';
+      return token_t(TT_OPERATOR, at, cfile+spos, pos-spos);
+    case '~':
+      if (cfile[pos] == '=')
+        return token_t(TT_OPERATOR, at, cfile+spos, ++pos-spos);
+      return token_t(TT_TILDE, at, cfile+spos, pos-spos);
+    case '%': case '*': case '/': case '^':
+      if (cfile[pos] == '=')
+        return token_t(TT_OPERATOR, at, cfile+spos, ++pos-spos);
+      return token_t(TT_OPERATOR, at, cfile+spos, pos-spos);
+    case '>': case '<':
+      pos += cfile[pos] == cfile[spos]; pos += cfile[pos] == '=';
+      return token_t((pos-spos==1?cfile[spos]=='<'?TT_LESSTHAN:TT_GREATERTHAN:TT_OPERATOR), at, cfile+spos, pos-spos);
+    case ':':
+      pos += cfile[pos] == cfile[spos];
+      return token_t(pos - spos == 1 ? TT_COLON : TT_SCOPE, at, cfile+spos, pos-spos);
+    case '?':
+      return token_t(TT_OPERATOR, at, cfile+spos, pos-spos);
+    
+    case '.':
+        if (is_digit(cfile[pos]))
+          goto handle_decimal;
+        else if (cfile[pos] == '.') {
+          if (cfile[++pos] == '.')
+            return token_t(TT_ELLIPSIS, at, cfile+spos, ++pos - spos);
+          else
+            --pos;
+        }
+        pos += cfile[pos] == '*';
+      return token_t(TT_OPERATOR, at, cfile+spos, pos-spos);
+    
+    case '(': return token_t(TT_LEFTPARENTH, at, cfile+spos, 1);
+    case '[': return token_t(TT_LEFTBRACKET, at, cfile+spos, 1);
+    case '{': return token_t(TT_LEFTBRACE, at, cfile+spos, 1);
+    case '}': return token_t(TT_RIGHTBRACE, at, cfile+spos, 1);
+    case ']': return token_t(TT_RIGHTBRACKET, at, cfile+spos, 1);
+    case ')': return token_t(TT_RIGHTPARENTH, at, cfile+spos, 1);
+    
+    default:
+      pos = spos;
+      return token_t();
+  }
+}
+
+token_t lexer_cpp::read_token(error_handler *herr, bool pop)
+{
   #ifdef DEBUG_MODE
     static int number_of_times_GDB_has_dropped_its_ass = 0;
     ++number_of_times_GDB_has_dropped_its_ass;
@@ -728,15 +987,30 @@ token_t lexer_cpp::get_token(error_handler *herr)
   
   for (;;) // Loop until we find something or hit world's end
   {
-    if (pos >= length) goto POP_FILE;
+    // Replay the cached tokens of this file, if it has any, reading by hand where they say to
+    if (raw_in_step()) {
+      const vector<raw_token> &toks = raw.file->tokens;
+      if (raw.at >= toks.size())
+        pos = length; // Only whitespace and comments are left
+      else {
+        const raw_token &t = toks[raw.at++];
+        if (t.type != TT_INVALID)
+          return pos = t.offset + t.len, token_t(TOKEN_TYPE(t.type), here(t.offset), cfile + t.offset, t.len);
+        pos = t.offset;
+      }
+    }
     
-    // Skip all whitespace
-    while (is_useless(cfile[pos])) {
-      if (cfile[pos] == '\n') ++line, lpos = pos;
-      if (cfile[pos] == '\r') { ++line; lpos = pos; if (cfile[++pos] != '\n') --pos; }
-      if (++pos >= length) goto POP_FILE;
+    if (pos >= length) {
+      if (!pop or pop_file())
+        return token_t(TT_ENDOFCODE, here(pos));
+      continue;
     }
     
+    // Skip all whitespace
+    while (is_useless(cfile[pos]))
+      if (++pos >= length) break;
+    if (pos >= length) continue;
+    
     //============================================================================================
     //====: Check for and handle comments. :======================================================
     //============================================================================================
@@ -746,9 +1020,9 @@ token_t lexer_cpp::get_token(error_handler *herr)
       if (cfile[pos] == '/') { skip_comment(); continue; }
       if (cfile[pos] == '=') {
         ++pos;
-        return  token_t(token_basics(TT_OPERATOR,filename,line,pos-lpos), cfile+pos-2, 2);
+        return  token_t(TT_OPERATOR, here(pos-2), cfile+pos-2, 2);
       }
-      return token_t(token_basics(TT_OPERATOR,filename,line,pos-lpos), cfile+pos-1,1);
+      return token_t(TT_OPERATOR, here(pos-1), cfile+pos-1,1);
     }
     
     //============================================================================================
@@ -761,193 +1035,531 @@ token_t lexer_cpp::get_token(error_handler *herr)
       while (++pos < length and is_letterd(cfile[pos]));
       if (cfile[spos] == 'L' and pos - spos == 1 and cfile[pos] == '\'') {
         skip_string(herr);
-        return token_t(token_basics(TT_CHARLITERAL,filename,line,spos-lpos), cfile + spos, ++pos-spos);
-      }
-      
-      string fn(cfile + spos, cfile + pos); // We'll need a copy of this thing for lookup purposes
-      
-      macro_iter mi = macros.find(fn);
-      if (mi != macros.end()) {
-        domacro_mi:
-        if (mi->second->argc < 0) {
-          bool already_open = false; // Test if we're in this macro already
-          quick::stack<openfile>::iterator it = files.begin();
-          for (unsigned i = 0; i < open_macro_count; ++i)
-            if (it->filename == fn) { already_open = true; break; }
-            else --it;
-          if (!already_open) {
-            enter_macro((macro_scalar*)mi->second);
-            continue;
-          }
-        }
-        else {
-          if (parse_macro_function((macro_function*)mi->second, herr))
-            continue;
-        }
+        return token_t(TT_CHARLITERAL, here(spos), cfile + spos, ++pos-spos);
       }
-      
-      keyword_map::iterator kwit = keywords.find(fn);
-      if (kwit != keywords.end()) {
-        if (kwit->second == TT_INVALID) {
-          mi = kludge_map.find(fn);
-          #ifdef DEBUG_MODE
-          if (mi == kludge_map.end())
-            cerr << "SYSTEM ERROR! KEYWORD `" << fn << "' IS DEFINED AS INVALID" << endl;
-          #endif
-          goto domacro_mi;
-        }
-        return token_t(token_basics(kwit->second,filename,line,spos-lpos));
-      }
-      
-      tf_iter tfit = builtin_declarators.find(fn);
-      if (tfit != builtin_declarators.end()) {
-        if ((tfit->second->usage & UF_STANDALONE_FLAG) == UF_PRIMITIVE)
-          return token_t(token_basics(TT_DECLARATOR,filename,line,spos-lpos), tfit->second->def);
-        return token_t(token_basics(TT_DECFLAG,filename,line,spos-lpos), (definition*)tfit->second);
-      }
-      
-      return token_t(token_basics(TT_IDENTIFIER,filename,line,spos-lpos), cfile + spos, fn.length());
+      return token_t(TT_IDENTIFIER, here(spos), cfile + spos, pos-spos);
     }
     
     //============================================================================================
-    //====: Not at an identifier. Maybe at a number? :============================================
+    //====: Not at an identifier. Find out where we are. :========================================
     //============================================================================================
     
-    if (is_digit(cfile[pos])) {
-      if (cfile[pos] == '0') { // Check if the number is hexadecimal or octal.
-        if (cfile[++pos] == 'x') { // Check if the number is hexadecimal.
-          // Yes, it is hexadecimal.
-          const size_t sp = pos;
-          while (++pos < length and is_hexdigit(cfile[pos]));
-          while (pos < length and is_letter(cfile[pos])) pos++; // Include the flags, like ull
-          return token_t(token_basics(TT_HEXLITERAL,filename,line,pos-lpos), cfile+sp, pos-sp);  
-        }
-        // Turns out, it's octal.
-        const size_t sp = --pos;
-        while (++pos < length and is_hexdigit(cfile[pos]));
-        while (pos < length and is_letter(cfile[pos])) pos++; // Include the flags, like ull
-        return token_t(token_basics(TT_OCTLITERAL,filename,line,pos-lpos), cfile+sp, pos-sp);
-      }
-      // Turns out, it's decimal.
-      handle_decimal:
-      const size_t sp = pos;
-      while (++pos < length and is_digit(cfile[pos]));
-      if (cfile[pos] == '.')
-        while (++pos < length and is_digit(cfile[pos]));
-      if (cfile[pos] == 'e' or cfile[pos] == 'E') { // Accept exponents
-        if (cfile[++pos] == '-') ++pos;
-        while (pos < length and is_digit(cfile[pos])) ++pos;
-      }
-      while (pos < length and is_letter(cfile[pos])) ++pos; // Include the flags, like ull
-      return token_t(token_basics(TT_DECLITERAL,filename,line,pos-lpos), cfile+sp, pos-sp);
-    }
-    
-    //============================================================================================
-    //====: Not at a number. Find out where we are. :=============================================
-    //============================================================================================
+    token_t res = read_symbol(cfile, pos, length, here(pos));
+    if (res.type != TT_INVALID)
+      return res;
     
     const size_t spos = pos;
     switch (cfile[pos++])
     {
-      case ';':
-        return token_t(token_basics(TT_SEMICOLON,filename,line,spos-lpos));
-      case ',':
-        return token_t(token_basics(TT_COMMA,filename,line,spos-lpos));
-      case '+': case '-':
-        pos += cfile[pos] == cfile[spos] or cfile[pos] == '=' or (cfile[pos] == '>' and cfile[spos] == '-');
-        pos += (cfile[pos-1] == '>' and cfile[pos] == '*');
-        return token_t(token_basics(TT_OPERATOR,filename,line,spos-lpos), cfile+spos, pos-spos);
-      case '=': pos += cfile[pos] == cfile[spos];
-        return token_t(token_basics(TT_OPERATOR,filename,line,spos-lpos), cfile+spos, pos-spos);
-      case '&': case '|':  case '!':
-        pos += cfile[pos] == cfile[spos] || cfile[pos] == '=';
-        return token_t(token_basics(TT_OPERATOR,filename,line,spos-lpos), cfile+spos, pos-spos);
-      case '~':
-        if (cfile[pos] == '=')
-          return token_t(token_basics(TT_OPERATOR,filename,line,spos-lpos), cfile+spos, ++pos-spos);
-        return token_t(token_basics(TT_TILDE,filename,line,spos-lpos), cfile+spos, pos-spos);
-      case '%': case '*': case '/': case '^':
-        if (cfile[pos] == '=')
-          return token_t(token_basics(TT_OPERATOR,filename,line,spos-lpos), cfile+spos, ++pos-spos);
-        return token_t(token_basics(TT_OPERATOR,filename,line,spos-lpos), cfile+spos, pos-spos);
-      case '>': case '<':
-        pos += cfile[pos] == cfile[spos]; pos += cfile[pos] == '=';
-        return token_t(token_basics((pos-spos==1?cfile[spos]=='<'?TT_LESSTHAN:TT_GREATERTHAN:TT_OPERATOR),filename,line,spos-lpos), cfile+spos, pos-spos);
-      case ':':
-        pos += cfile[pos] == cfile[spos];
-        return token_t(token_basics(pos - spos == 1 ? TT_COLON : TT_SCOPE,filename,line,spos-lpos), cfile+spos, pos-spos);
-      case '?':
-        return token_t(token_basics(TT_OPERATOR,filename,line,spos-lpos), cfile+spos, pos-spos);
-      
-      case '.':
-          if (is_digit(cfile[pos]))
-            goto handle_decimal;
-          else if (cfile[pos] == '.') {
-            if (cfile[++pos] == '.')
-              return token_t(token_basics(TT_ELLIPSIS,filename,line,spos-lpos), cfile+spos, pos++ - spos);
-            else
-              pos -= 2;
-          }
-          pos += cfile[pos] == '*';
-        return token_t(token_basics(TT_OPERATOR,filename,line,spos-lpos), cfile+spos, pos-spos);
-      
-      case '(': return token_t(token_basics(TT_LEFTPARENTH,filename,line,spos-lpos));
-      case '[': return token_t(token_basics(TT_LEFTBRACKET,filename,line,spos-lpos));
-      case '{': return token_t(token_basics(TT_LEFTBRACE,  filename,line,spos-lpos));
-      case '}': return token_t(token_basics(TT_RIGHTBRACE,  filename,line,spos-lpos));
-      case ']': return token_t(token_basics(TT_RIGHTBRACKET,filename,line,spos-lpos));
-      case ')': return token_t(token_basics(TT_RIGHTPARENTH,filename,line,spos-lpos));
-      
       case '#':
+        at_top = pop;
         handle_preprocessor(herr);
-        goto get_token_top; // Unoptimized tail call leads to death and destruction
+        if (replay)
+          return token_t(); // The memoized header is read by get_token
+        continue;
       
       case '\\':
         if (cfile[pos] != '\n' and cfile[pos] != '\r')
-          herr->error("Stray backslash", filename, line, pos-lpos);
+          report_error(herr, "Stray backslash", pos, DIAG_STRAY);
         continue;
       
-      case '"': {
-        --pos; skip_string(herr);
-        return token_t(token_basics(TT_STRINGLITERAL,filename,line,spos-lpos), cfile + spos, ++pos-spos);
-      }
-      
-      case '\'': {
+      case '"': case '\'': {
         --pos; skip_string(herr);
-        return token_t(token_basics(TT_STRINGLITERAL,filename,line,spos-lpos), cfile + spos, ++pos-spos);
+        return token_t(TT_STRINGLITERAL, here(spos), cfile + spos, ++pos-spos);
       }
       
       default: {
         char errbuf[320];
         sprintf(errbuf, "Unrecognized symbol (char)0x%02X '%c'", (int)cfile[spos], cfile[spos]);
         herr->error(errbuf);
-        return token_t(token_basics(TT_INVALID,filename,line,pos-lpos++));
+        return token_t(TT_INVALID, here(spos), cfile + spos, 1);
       }
     }
   }
+}
+
+namespace {
+  /// Passes everything reported on to another handler, counting each report.
+  struct report_counter: error_handler {
+    error_handler *herr; ///< The handler to pass reports to.
+    unsigned &count; ///< The count of reports passed on.
+    void error(string err, string filename, int line, int pos) { ++count; herr->error(err, filename, line, pos); }
+    void warning(string err, string filename, int line, int pos) { ++count; herr->warning(err, filename, line, pos); }
+    report_counter(error_handler *h, unsigned &c): herr(h), count(c) {}
+  };
+}
+
+token_t lexer_cpp::get_token(error_handler *herr)
+{
+  if (budget and budget->spent())
+    return token_t(TT_ENDOFCODE, here(pos));
+  if (!memoize)
+    return read_expanded(herr);
+  report_counter counter(herr, reports);
+  const token_t res = read_expanded(&counter);
+  if (!traces.empty())
+    memo_log.add_token(res);
+  return res;
+}
+
+token_t lexer_cpp::read_expanded(error_handler *herr)
+{
+  for (;;) // Loop until we find something that isn't a macro
+  {
+    pp_token t;
+    while (expansion_depth and expansions[expansion_depth - 1].done())
+      --expansion_depth;
+    if (expansion_depth)
+      t = expansions[expansion_depth - 1].read();
+    else {
+      if (replay) {
+        if (replay_at < replay->tokens.size()) {
+          const memo_token &mt = replay->tokens[replay_at++];
+          token_t res = mt.token;
+          if (mt.file != memo_token::no_file)
+            res.loc += replay_bases[mt.file];
+          if (mt.text != memo_token::no_file)
+            res.str = replay->text.data() + mt.text;
+          return res;
+        }
+        replay = NULL;
+      }
+      if (arena.in_use() or !released.empty())
+        release_expansions();
+      t.token = read_token(herr, true);
+      if (replay)
+        continue;
+      t.hideset = 0;
+    }
+    if (t.token.type != TT_IDENTIFIER)
+      return t.token;
+    
+    const string fn((const char*)t.token.str, t.token.len); // We'll need a copy of this thing for lookup purposes
+    
+    macro_iter mi = find_macro(fn);
+    if (mi != macros.end() and !hidesets.contains(t.hideset, mi->second) and expand_macro(mi->second, t, 0, true, herr))
+      continue;
+    
+    keyword_map::iterator kwit = keywords.find(fn);
+    if (kwit != keywords.end()) {
+      if (kwit->second == TT_INVALID) {
+        mi = kludge_map.find(fn);
+        #ifdef DEBUG_MODE
+        if (mi == kludge_map.end())
+          cerr << "SYSTEM ERROR! KEYWORD `" << fn << "' IS DEFINED AS INVALID" << endl;
+        #endif
+        if (mi != kludge_map.end() and !hidesets.contains(t.hideset, mi->second) and expand_macro(mi->second, t, 0, true, herr))
+          continue;
+        return t.token;
+      }
+      t.token.type = kwit->second;
+      return t.token;
+    }
+    
+    tf_iter tfit = builtin_declarators.find(fn);
+    if (tfit != builtin_declarators.end()) {
+      if ((tfit->second->usage & UF_STANDALONE_FLAG) == UF_PRIMITIVE)
+        t.token.type = TT_DECLARATOR, t.token.def = tfit->second->def;
+      else
+        t.token.type = TT_DECFLAG, t.token.def = (definition*)tfit->second;
+    }
+    return t.token;
+  }
+}
+
+bool lexer_cpp::next_token(pp_token &res, size_t floor, bool from_file, error_handler *herr)
+{
+  while (expansion_depth > floor and expansions[expansion_depth - 1].done())
+    --expansion_depth;
+  if (expansion_depth > floor)
+    return res = expansions[expansion_depth - 1].read(), true;
+  if (!from_file)
+    return false;
+  res.token = read_token(herr, false);
+  res.hideset = 0;
+  return res.token.type != TT_ENDOFCODE;
+}
+
+bool lexer_cpp::next_is_lparen(size_t floor, bool from_file)
+{
+  while (expansion_depth > floor and expansions[expansion_depth - 1].done())
+    --expansion_depth;
+  if (expansion_depth > floor) {
+    expansion &e = expansions[expansion_depth - 1];
+    if (e.peek().token.type != TT_LEFTPARENTH)
+      return false;
+    e.read();
+    return true;
+  }
+  if (!from_file)
+    return false;
+  const size_t spos = pos;
+  skip_whitespace(); // Move to the next "token"
+  if (pos < length and cfile[pos] == '(')
+    return ++pos, true;
+  pos = spos;
+  return false;
+}
+
+/// Join the text of the given tokens, separating with a space any which were not adjacent where they were read.
+static void spell(const vector<pp_token> &toks, string &dest)
+{
+  for (size_t i = 0; i < toks.size(); ++i) {
+    const token_t &t = toks[i].token;
+    if (i and toks[i-1].token.str + toks[i-1].token.len != t.str)
+      dest += ' ';
+    dest.append((const char*)t.str, t.len);
+  }
+}
+
+/**
+  @section Implementation
   
-  cerr << "UNREACHABLE BLOCK REACHED" << endl;
-  return token_t(TT_INVALID,filename,line,pos-lpos++);
+  This follows the usual algorithm for expanding macros with hide-sets. The hide-set of
+  each token from a scalar is that of the name which invoked it, plus the scalar. The
+  hide-set of each token from a function is the intersection of those of its name and of
+  the parenthesis closing its arguments, plus the function, plus the hide-set of the
+  token itself if it came from an argument. Each argument is expanded fully on its own
+  before it is substituted.
   
-  POP_FILE: // This block was created instead of a helper function to piss Rusky off.
-  if (pop_file())
-    return token_t(token_basics(TT_ENDOFCODE,filename,line,pos-lpos));
+  Functions which use '#' or '##' are instead expanded by \c macro_function::parse, from
+  the text of their unexpanded arguments, and the result is tokenized afresh.
+**/
+bool lexer_cpp::expand_macro(const macro_type *m, const pp_token &name, size_t floor, bool from_file, error_handler *herr)
+{
+  phase_scope timing(clock, PHASE_MACROS);
+  if (m->argc < 0) {
+    ++expansion_count;
+    PARSE_STATS_ONLY(if (clock) clock->expanded(m));
+    const vector<macro_token> &toks = m->get_tokens();
+    if (!toks.empty()) {
+      expansion &e = push_expansion();
+      e.at = &toks[0], e.end = e.at + toks.size();
+      e.hideset = hidesets.add(name.hideset, m);
+      e.site = name.token.loc;
+    }
+    return true;
+  }
+  
+  const macro_function *mf = (const macro_function*)m;
+  if (!next_is_lparen(floor, from_file))
+    return false;
+  
+  // Read the arguments, splitting them at each comma outside nested parentheses, save
+  // those within the variadic argument
+  ++expanding;
+  vector< vector<pp_token> > args(1);
+  pp_token t;
+  for (int nestcnt = 1;;) {
+    if (!next_token(t, floor, from_file, herr)) {
+      name.token.report_error(herr, "Unterminated parameters to macro function", DIAG_UNTERMINATED);
+      return --expanding, true;
+    }
+    if (t.token.type == TT_LEFTPARENTH) ++nestcnt;
+    else if (t.token.type == TT_RIGHTPARENTH) { if (!--nestcnt) break; }
+    else if (t.token.type == TT_COMMA and nestcnt == 1 and (args.size() < (size_t)mf->argc or mf->args.size() == (size_t)mf->argc)) {
+      args.push_back(vector<pp_token>());
+      continue;
+    }
+    args.back().push_back(t);
+  }
+  while (expansion_depth > floor and expansions[expansion_depth - 1].done())
+    --expansion_depth; // Let what the arguments were read from be reused while they are expanded
   
-  size_t sz = 0;
-  for (quick::stack<openfile>::iterator it = files.begin(); it != files.end(); ++it) ++sz;
-  return get_token(herr);
+  const size_t named = mf->args.size();
+  if (args.size() == 1 and args[0].empty() and !mf->argc)
+    args.clear(); // Nothing was given to a function taking nothing
+  if (args.size() + 1 < named) {
+    name.token.report_error(herr, DIAG_MACRO_ARGUMENTS, "Too few arguments to macro function `%s': provided %d, requested %d",
+                            mf->name, args.size(), named);
+    return --expanding, true;
+  }
+  if (args.size() > named and named == (size_t)mf->argc) {
+    name.token.report_error(herr, DIAG_MACRO_ARGUMENTS, "Too many arguments to macro function `%s'", mf->name);
+    return --expanding, true;
+  }
+  args.resize(mf->argc); // A missing last argument, or variadic argument, is empty
+  
+  const unsigned hs = hidesets.add(hidesets.intersect(name.hideset, t.hideset), mf);
+  vector<pp_token> result;
+  if (mf->by_token) {
+    vector< vector<pp_token> > expanded(args.size());
+    vector<bool> have_expanded(args.size(), false);
+    const vector<macro_token> &toks = mf->get_tokens();
+    for (size_t i = 0; i < toks.size(); ++i) {
+      const macro_token &mt = toks[i];
+      if (mt.arg < 0)
+        result.push_back(pp_token(mt.token, hs, name.token.loc));
+      else {
+        if (!have_expanded[mt.arg])
+          expand_argument(args[mt.arg], expanded[mt.arg], herr), have_expanded[mt.arg] = true;
+        const vector<pp_token> &arg = expanded[mt.arg];
+        result.reserve(result.size() + arg.size());
+        unsigned from = 0, to = hs; // Runs of tokens tend to share a hide-set; unite each run once
+        for (size_t j = 0; j < arg.size(); ++j) {
+          if (arg[j].hideset != from)
+            from = arg[j].hideset, to = hidesets.unite(from, hs);
+          result.push_back(pp_token(arg[j].token, to));
+        }
+      }
+    }
+  }
+  else {
+    // Spell the arguments out one after another, then point a span at each
+    spelling.clear();
+    vector<macro_span> spans(args.size());
+    for (size_t i = 0; i < args.size(); ++i) {
+      spans[i].len = spelling.length();
+      spell(args[i], spelling);
+    }
+    for (size_t i = 0; i < args.size(); ++i) {
+      const size_t start = spans[i].len, end = i + 1 < args.size()? spans[i+1].len : spelling.length();
+      spans[i] = macro_span(spelling.c_str() + start, end - start);
+    }
+    
+    substituted.clear();
+    mf->substitute(spans.empty()? NULL : &spans[0], substituted);
+    if (!substituted.empty()) {
+      char *buf = arena.allocate(substituted.length());
+      memcpy(buf, substituted.c_str(), substituted.length());
+      vector<macro_token> toks;
+      tokenize(buf, substituted.length(), name.token.loc, toks);
+      result.reserve(toks.size());
+      for (size_t i = 0; i < toks.size(); ++i)
+        result.push_back(pp_token(toks[i].token, hs));
+    }
+  }
+  
+  --expanding, ++expansion_count;
+  PARSE_STATS_ONLY(if (clock) clock->expanded(m));
+  if (!result.empty())
+    push_expansion().tokens.swap(result);
+  return true;
+}
+
+void lexer_cpp::expand_argument(vector<pp_token> &arg, vector<pp_token> &dest, error_handler *herr)
+{
+  if (arg.empty())
+    return;
+  const size_t floor = expansion_depth;
+  dest.reserve(arg.size());
+  push_expansion().tokens.swap(arg);
+  vector<pp_token>().swap(arg); // Free what was swapped out, rather than hold it through nested expansions
+  pp_token t;
+  while (next_token(t, floor, false, herr)) {
+    if (t.token.type == TT_IDENTIFIER) {
+      macro_iter mi = find_macro(string((const char*)t.token.str, t.token.len));
+      if (mi != macros.end() and !hidesets.contains(t.hideset, mi->second) and expand_macro(mi->second, t, floor, false, herr))
+        continue;
+    }
+    dest.push_back(t);
+  }
+}
+
+expansion &lexer_cpp::push_expansion()
+{
+  if (expansion_depth == expansions.size())
+    expansions.push_back(expansion());
+  expansion &e = expansions[expansion_depth++];
+  e.at = e.end = NULL;
+  e.tokens.clear();
+  e.next = 0;
+  return e;
+}
+
+void lexer_cpp::release_expansions()
+{
+  if (retired)
+    arena.retire(retired);
+  else
+    arena.release(expansion_arena::mark());
+  
+  vector<const macro_type*> rel;
+  rel.swap(released);
+  for (size_t i = 0; i < rel.size(); ++i)
+    release_macro(rel[i]);
+}
+
+/// Order a cached token before every position past its start.
+static bool raw_token_before(const raw_token &t, size_t pos) { return t.offset < pos; }
+
+bool lexer_cpp::raw_in_step()
+{
+  if (!raw.file)
+    return false;
+  const vector<raw_token> &toks = raw.file->tokens;
+  if (raw.at < toks.size() and toks[raw.at].offset < pos)
+    raw.at = lower_bound(toks.begin() + raw.at, toks.end(), pos, raw_token_before) - toks.begin();
+  if (raw.at and toks[raw.at - 1].offset + toks[raw.at - 1].len > pos)
+    raw.file = NULL; // What was read by hand ended within a token
+  return raw.file;
+}
+
+/// Append a token to those of a cache entry.
+static inline void add_raw(raw_file &dest, TOKEN_TYPE type, size_t offset, size_t len) {
+  raw_token t;
+  if (len >> 24) // Too long to cache; have it read by hand
+    type = TT_INVALID, len = 1;
+  t.offset = offset, t.len = len, t.type = type;
+  dest.tokens.push_back(t);
+}
+
+/// Mark a place in the text of a cache entry which must be read by hand, for reporting an error.
+static inline void add_raw_error(raw_file &dest, size_t offset) {
+  add_raw(dest, TT_INVALID, offset, 1);
+  dest.errors.push_back(offset);
+}
+
+void lexer_cpp::scan_raw(const char *cfile, size_t length, raw_file &dest)
+{
+  dest.tokens.reserve(length / 5);
+  size_t pos = 0;
+  bool line_start = true; // Whether only whitespace precedes this position on its line
+  while (pos < length)
+  {
+    if (is_useless(cfile[pos])) {
+      if (cfile[pos] == '\n' or cfile[pos] == '\r')
+        line_start = true;
+      ++pos;
+      continue;
+    }
+    const bool first = line_start;
+    line_start = false;
+    const size_t spos = pos;
+    
+    if (cfile[pos] == '/') {
+      if (cfile[++pos] == '*') { ::skip_multiline_comment(cfile, pos, length); continue; }
+      if (cfile[pos] == '/') { ::skip_comment(cfile, pos, length); continue; }
+      if (cfile[pos] == '=') ++pos;
+      add_raw(dest, TT_OPERATOR, spos, pos - spos);
+      continue;
+    }
+    
+    if (is_letter(cfile[pos])) {
+      while (++pos < length and is_letterd(cfile[pos]));
+      if (cfile[spos] == 'L' and pos - spos == 1 and cfile[pos] == '\'') {
+        if (skip_string_line(cfile, pos, length))
+          add_raw(dest, TT_CHARLITERAL, spos, ++pos - spos);
+        else
+          add_raw_error(dest, spos), ++pos;
+      }
+      else
+        add_raw(dest, TT_IDENTIFIER, spos, pos - spos);
+      continue;
+    }
+    
+    token_t res = read_symbol(cfile, pos, length, 0);
+    if (res.type != TT_INVALID) {
+      add_raw(dest, res.type, (const char*)res.str - cfile, res.len);
+      continue;
+    }
+    
+    switch (cfile[pos++])
+    {
+      case '#':
+          if (first)
+            dest.directives.push_back(spos);
+          add_raw(dest, TT_INVALID, spos, 1);
+        break;
+      case '\\':
+          if (cfile[pos] != '\n' and cfile[pos] != '\r')
+            add_raw_error(dest, spos);
+        break;
+      case '"': case '\'':
+          if (skip_string_line(cfile, --pos, length))
+            add_raw(dest, TT_STRINGLITERAL, spos, ++pos - spos);
+          else
+            add_raw_error(dest, spos), ++pos;
+        break;
+      default:
+          add_raw_error(dest, spos);
+        break;
+    }
+  }
+}
+
+void lexer_cpp::tokenize(const char *cfile, size_t length, source_location at, vector<macro_token> &dest)
+{
+  size_t pos = 0;
+  while (pos < length)
+  {
+    if (is_useless(cfile[pos]))
+      ++pos;
+    else if (cfile[pos] == '/' and cfile[pos+1] == '*')
+      ::skip_multiline_comment(cfile, pos, length);
+    else if (cfile[pos] == '/' and cfile[pos+1] == '/')
+      ::skip_comment(cfile, pos, length);
+    else if (is_letter(cfile[pos])) {
+      const size_t spos = pos;
+      while (++pos < length and is_letterd(cfile[pos]));
+      if (cfile[spos] == 'L' and pos - spos == 1 and cfile[pos] == '\'') {
+        ::skip_string(cfile, pos, length);
+        pos += pos < length;
+        dest.push_back(macro_token(token_t(TT_CHARLITERAL, at, cfile + spos, pos-spos)));
+      }
+      else
+        dest.push_back(macro_token(token_t(TT_IDENTIFIER, at, cfile + spos, pos-spos)));
+    }
+    else {
+      token_t t = read_symbol(cfile, pos, length, at);
+      const size_t spos = pos;
+      if (t.type != TT_INVALID)
+        dest.push_back(macro_token(t));
+      else if (cfile[pos] == '#') {
+        pos += 1 + (cfile[pos+1] == '#');
+        dest.push_back(macro_token(token_t(pos - spos == 1? TTM_TOSTRING : TTM_CONCAT, at, cfile + spos, pos-spos)));
+      }
+      else if (cfile[pos] == '"' or cfile[pos] == '\'') {
+        ::skip_string(cfile, pos, length);
+        pos += pos < length;
+        dest.push_back(macro_token(token_t(TT_STRINGLITERAL, at, cfile + spos, pos-spos)));
+      }
+      else if (cfile[pos++] != '\\') // Stray backslashes are dropped; anything else unknown is kept, to be rejected by the parser
+        dest.push_back(macro_token(token_t(TT_INVALID, at, cfile + spos, 1)));
+    }
+  }
+}
+
+bool lexer_cpp::pastes(const char *cfile, size_t length)
+{
+  for (size_t pos = 0; pos < length; ++pos) {
+    if (cfile[pos] == '"' or cfile[pos] == '\'')
+      ::skip_string(cfile, pos, length);
+    else if (cfile[pos] == '/' and cfile[pos+1] == '*')
+      ::skip_multiline_comment(cfile, pos, length), --pos;
+    else if (cfile[pos] == '/' and cfile[pos+1] == '/')
+      ::skip_comment(cfile, pos, length);
+    else if (cfile[pos] == '#')
+      return true;
+  }
+  return false;
 }
 
 bool lexer_cpp::pop_file() {
   if (files.empty())
     return true;
   
-  // Close whatever file we have open now
-  close();
+  if (!traces.empty() and traces.back()->depth == files.size())
+    end_trace();
   
-  // Fetch data from top item
+  // Close whatever file we have open now, unless someone may still be looking at it; files
+  // are kept until the lexer is destroyed, so that locations in them can still be resolved,
+  // but no token read from the expansion of a macro within an #if outlives the directive
   openfile& of = files.top();
-  line = of.line, lpos = of.lpos;
+  if (!of.macro) {
+    llreader *done = new llreader();
+    done->consume(*this);
+    finished.push_back(done);
+    PARSE_STATS_ONLY(if (clock) clock->leave_file());
+  }
+  else
+    close();
+  if (of.macro)
+    arena.release(of.text);
+  
+  // Fetch data from top item
+  base = of.base, site = of.site;
+  raw = of.raw;
   filename = of.filename;
   consume(of.file);
   
@@ -961,83 +1573,284 @@ bool lexer_cpp::pop_file() {
   return false;
 }
 
+macro_iter lexer_cpp::find_macro(const string &name) {
+  macro_iter mi = macros.find(name);
+  if (!traces.empty())
+    traces.back()->read(name, mi == macros.end()? NULL : mi->second);
+  return mi;
+}
+
+bool lexer_cpp::replay_header(const raw_file *header, const string &found_in)
+{
+  vector<const header_memo*> memos;
+  find_header_memos(header, memos);
+  const header_memo *memo = NULL;
+  for (size_t i = 0; i < memos.size() and !memo; ++i) {
+    if (!memos[i]->matches(macros, search_directories, found_in))
+      continue;
+    // The header itself was just read; make sure each file it included also holds the same text
+    memo = memos[i];
+    for (size_t f = 1; memo and f < memo->files.size(); ++f) {
+      llreader incfile(memo->files[f].path.c_str());
+      if (!incfile.is_open()) {
+        memo = NULL;
+        continue;
+      }
+      const raw_file *now = cache_tokens(memo->files[f].path, incfile);
+      cached_files.push_back(now);
+      if (now != memo->files[f].raw)
+        drop_header_memo(memo), memo = NULL; // That file has changed since; the memo can never match again
+    }
+  }
+  for (size_t i = 0; i < memos.size(); ++i)
+    if (memos[i] != memo)
+      release_header_memo(memos[i]);
+  if (!memo)
+    return false;
+  replayed.push_back(memo);
+  
+  // Do to the macros what the header did, and place its files as it would have
+  if (!traces.empty())
+    traces.back()->absorb(*memo);
+  for (size_t i = 0; i < memo->writes.size(); ++i) {
+    const macro_type *value = memo->writes[i].second;
+    if (value)
+      macro_type::retain(value);
+    macro_iter mi = macros.find(memo->writes[i].first);
+    if (mi != macros.end()) {
+      release_macro(mi->second);
+      if (value)
+        mi->second = value;
+      else
+        macros.erase(mi);
+    }
+    else if (value)
+      macros.insert(make_pair(memo->writes[i].first, value));
+  }
+  replay_bases.clear();
+  for (size_t i = 0; i < memo->files.size(); ++i) {
+    const memo_file &f = memo->files[i];
+    const char *name = visited_files.insert(f.path).first->c_str();
+    sources.push_back(open_source(name, f.raw->text.data, f.raw->text.length, &f.raw->breaks));
+    replay_bases.push_back(sources.back());
+  }
+  const size_t logged = memo_log.files.size();
+  for (size_t i = 0; i < memo->includes.size(); ++i) {
+    const memo_include &mi = memo->includes[i];
+    const include_site inc = { memo->files[mi.from].path, memo->files[mi.to].path, replay_bases[mi.from] + mi.offset };
+    includes.push_back(inc);
+    if (!traces.empty())
+      memo_log.includes.push_back(mi), memo_log.includes.back().from += logged, memo_log.includes.back().to += logged;
+  }
+  if (!traces.empty())
+    for (size_t i = 0; i < memo->files.size(); ++i)
+      memo_log.add_file(replay_bases[i], memo->files[i].path, memo->files[i].raw);
+  sdir = memo->sdir_after;
+  replay = memo, replay_at = 0;
+  return true;
+}
+
+void lexer_cpp::end_trace()
+{
+  header_trace *trace = traces.back();
+  traces.pop_back();
+  if (trace->valid and trace->reports == reports and trace->conditionals == conditionals.size()) {
+    header_memo *memo = memo_log.make_memo(*trace, macros, search_directories, sdir);
+    if (memo)
+      add_header_memo(memo);
+  }
+  if (!traces.empty())
+    traces.back()->absorb(*trace);
+  else
+    memo_log.clear();
+  delete trace;
+}
+
+void lexer_cpp::release_macro(const macro_type *macro) {
+  if (expansion_depth or expanding)
+    released.push_back(macro);
+  else if (retired)
+    retired->macros.push_back(macro);
+  else
+    macro_type::free(macro);
+}
+
+expansion_arena::mark::mark(): block(0), used(0) {}
+
+char *expansion_arena::allocate(size_t size) {
+  while (at.block < blocks.size() and blocks[at.block].size - at.used < size)
+    ++at.block, at.used = 0; // Whatever is left of this block is too small; move on to the next
+  if (at.block == blocks.size()) {
+    block b;
+    b.size = blocks.empty()? 4096 : blocks.back().size * 2;
+    if (b.size < size) b.size = size;
+    b.data = new char[b.size];
+    blocks.push_back(b);
+    at.used = 0;
+  }
+  char *res = blocks[at.block].data + at.used;
+  at.used += size;
+  return res;
+}
+
+expansion_arena::mark expansion_arena::top() const {
+  return at;
+}
+
+void expansion_arena::release(const mark &m) {
+  at = m;
+}
+
+void expansion_arena::retire(retired_storage *storage) {
+  for (size_t i = 0; i < blocks.size() and (i < at.block or (i == at.block and at.used)); ++i) {
+    llreader *done = new llreader();
+    done->consume(blocks[i].data, blocks[i].size);
+    storage->files.push_back(done);
+    blocks[i].data = NULL;
+  }
+  size_t kept = 0;
+  for (size_t i = 0; i < blocks.size(); ++i)
+    if (blocks[i].data)
+      blocks[kept++] = blocks[i];
+  blocks.resize(kept);
+  at = mark();
+}
+
+bool expansion_arena::in_use() const {
+  return at.block or at.used;
+}
+
+expansion_arena::expansion_arena() {}
+expansion_arena::~expansion_arena() {
+  for (size_t i = 0; i < blocks.size(); ++i)
+    delete[] blocks[i].data;
+}
+
+bool retired_storage::empty() const {
+  return files.empty() and macros.empty();
+}
+retired_storage::~retired_storage() {
+  for (size_t i = 0; i < files.size(); ++i)
+    delete files[i];
+  for (size_t i = 0; i < macros.size(); ++i)
+    macro_type::free(macros[i]);
+}
+
 macro_map lexer_cpp::kludge_map;
 lexer_cpp::keyword_map lexer_cpp::keywords;
-lexer_cpp::lexer_cpp(llreader &input, macro_map &pmacros, const char *fname): macros(pmacros), filename(fname), line(1), lpos(0), open_macro_count(0), mlex(new lexer_macro(this))
+lexer_cpp::lexer_cpp(llreader &input, macro_map &pmacros, const char *fname): macros(pmacros), search_directories(builtin->get_search_directories()), filename(fname), site(0), open_macro_count(0), expansion_depth(0), expanding(0), expansion_count(0), retired(NULL), memoize(false), budget(NULL), at_top(false), reports(0), replay(NULL), replay_at(0), mlex(new lexer_macro(this))
 {
   consume(input); // We are also an llreader. Consume the given one using the inherited method.
-  if (keywords.empty()) {
-    keywords["asm"] = TT_ASM;
-    keywords["__asm"] = TT_ASM;
-    keywords["__asm__"] = TT_ASM;
-    keywords["class"] = TT_CLASS;
-    keywords["decltype"] = TT_DECLTYPE;
-    keywords["enum"] = TT_ENUM;
-    keywords["extern"] = TT_EXTERN;
-    keywords["namespace"] = TT_NAMESPACE;
-    keywords["operator"] = TT_OPERATORKW;
-    keywords["private"] = TT_PRIVATE;
-    keywords["protected"] = TT_PROTECTED;
-    keywords["public"] = TT_PUBLIC;
-    keywords["sizeof"] = TT_SIZEOF;
-    keywords["__is_empty"] = TT_ISEMPTY;
-    keywords["struct"] = TT_STRUCT;
-    keywords["template"] = TT_TEMPLATE;
-    keywords["typedef"] = TT_TYPEDEF;
-    keywords["typename"] = TT_TYPENAME;
-    keywords["union"] = TT_UNION;
-    keywords["using"] = TT_USING;
-    keywords["new"] = TT_NEW;
-    keywords["delete"] = TT_DELETE;
-    
-    // GNU Extensions
-    keywords["__attribute__"] = TT_INVALID;
-    keywords["__extension__"] = TT_INVALID;
-    keywords["__typeof__"] = TT_INVALID;
-    keywords["__typeof"] = TT_INVALID;
-   // keywords["__restrict"] = TT_INVALID;
-    
-    // MinGW Fuckery
-    keywords["__MINGW_IMPORT"] = TT_INVALID;
-    
-    // C++ Extensions
-    keywords["false"] = TT_INVALID;
-    keywords["true"] = TT_INVALID;
-    
-    string x(1,'x');
-    kludge_map.clear();
-    context::global_macros().swap(kludge_map);
-    builtin->add_macro_func("__attribute__", x, string(), false);
-    builtin->add_macro_func("__typeof__", x, string("int"), false);
-    builtin->add_macro_func("__typeof", x, string("int"), false);
-    builtin->add_macro("__extension__", string());
-    builtin->add_macro("__MINGW_IMPORT", string());
-    builtin->add_macro("false", string(1,'0'));
-    builtin->add_macro("true", string(1,'1'));
-    context::global_macros().swap(kludge_map);
-  }
+  sources.push_back(base = open_source(filename, data, length));
 }
+lexer_cpp::lexer_cpp(llreader &input, macro_map &pmacros, const vector<string> &sdirs, const char *fname): macros(pmacros), search_directories(sdirs), filename(fname), site(0), open_macro_count(0), expansion_depth(0), expanding(0), expansion_count(0), retired(NULL), memoize(false), budget(NULL), at_top(false), reports(0), replay(NULL), replay_at(0), mlex(new lexer_macro(this))
+{
+  consume(input);
+  sources.push_back(base = open_source(filename, data, length));
+}
+
 lexer_cpp::~lexer_cpp() {
   delete mlex;
+  for (size_t i = 0; i < traces.size(); ++i)
+    delete traces[i];
+  expansion_depth = expanding = 0;
+  release_expansions();
+  for (size_t i = 0; i < sources.size(); ++i)
+    release_source(sources[i]);
+  for (size_t i = 0; i < finished.size(); ++i)
+    delete finished[i];
+  for (size_t i = 0; i < replayed.size(); ++i)
+    release_header_memo(replayed[i]);
+  for (size_t i = 0; i < cached_files.size(); ++i)
+    release_tokens(cached_files[i]);
 }
 
+void lexer_cpp::time_with(phase_clock *c) {
+  clock = c;
+  PARSE_STATS_ONLY(if (clock) clock->enter_file(filename));
+}
+
+void lexer_cpp::initialize() {
+  if (!keywords.empty())
+    return;
+  keywords["asm"] = TT_ASM;
+  keywords["__asm"] = TT_ASM;
+  keywords["__asm__"] = TT_ASM;
+  keywords["class"] = TT_CLASS;
+  keywords["decltype"] = TT_DECLTYPE;
+  keywords["enum"] = TT_ENUM;
+  keywords["extern"] = TT_EXTERN;
+  keywords["namespace"] = TT_NAMESPACE;
+  keywords["operator"] = TT_OPERATORKW;
+  keywords["private"] = TT_PRIVATE;
+  keywords["protected"] = TT_PROTECTED;
+  keywords["public"] = TT_PUBLIC;
+  keywords["sizeof"] = TT_SIZEOF;
+  keywords["__is_empty"] = TT_ISEMPTY;
+  keywords["struct"] = TT_STRUCT;
+  keywords["template"] = TT_TEMPLATE;
+  keywords["typedef"] = TT_TYPEDEF;
+  keywords["typename"] = TT_TYPENAME;
+  keywords["union"] = TT_UNION;
+  keywords["using"] = TT_USING;
+  keywords["new"] = TT_NEW;
+  keywords["delete"] = TT_DELETE;
+  
+  // GNU Extensions
+  keywords["__attribute__"] = TT_INVALID;
+  keywords["__extension__"] = TT_INVALID;
+  keywords["__typeof__"] = TT_INVALID;
+  keywords["__typeof"] = TT_INVALID;
+ // keywords["__restrict"] = TT_INVALID;
+  
+  // MinGW Fuckery
+  keywords["__MINGW_IMPORT"] = TT_INVALID;
+  
+  // C++ Extensions
+  keywords["false"] = TT_INVALID;
+  keywords["true"] = TT_INVALID;
+  
+  string x(1,'x');
+  kludge_map.clear();
+  context::global_macros().swap(kludge_map);
+  builtin->add_macro_func("__attribute__", x, string(), false);
+  builtin->add_macro_func("__typeof__", x, string("int"), false);
+  builtin->add_macro_func("__typeof", x, string("int"), false);
+  builtin->add_macro("__extension__", string());
+  builtin->add_macro("__MINGW_IMPORT", string());
+  builtin->add_macro("false", string(1,'0'));
+  builtin->add_macro("true", string(1,'1'));
+  context::global_macros().swap(kludge_map);
+}
 void lexer_cpp::cleanup() {
+  clear_header_memos();
+  clear_token_cache();
   keywords.clear();
   for (macro_iter it = kludge_map.begin(); it != kludge_map.end(); ++it)
     macro_type::free(it->second);
   kludge_map.clear();
 }
 
-openfile::openfile() {}
-openfile::openfile(const char* fname): filename(fname), line(0), lpos(0) {}
-openfile::openfile(const char* fname, string sdir, size_t line_num, size_t line_pos, llreader &consume): filename(fname), searchdir(sdir), line(line_num), lpos(line_pos) { file.consume(consume); }
+openfile::openfile(): base(0), site(0), macro(false) {}
+openfile::openfile(const char* fname): filename(fname), base(0), site(0), macro(false) {}
+openfile::openfile(const char* fname, string sdir, source_location start, source_location at, const raw_cursor &cursor, llreader &consume):
+  filename(fname), searchdir(sdir), base(start), site(at), raw(cursor), macro(false) { file.consume(consume); }
+openfile::openfile(const char* fname, source_location start, source_location at, const raw_cursor &cursor, llreader &consume, const expansion_arena::mark &text_mark):
+  filename(fname), base(start), site(at), raw(cursor), macro(true), text(text_mark) { file.consume(consume); }
 void openfile::swap(openfile &f) {
   { register const char* tmpl = filename;
   filename = f.filename, f.filename = tmpl; }
   searchdir.swap(f.searchdir);
-  register size_t tmpl = line;
-  line = f.line, f.line = tmpl;
-  tmpl = lpos, lpos = f.lpos, f.lpos = tmpl;
+  { register const source_location tmpb = base;
+  base = f.base, f.base = tmpb; }
+  { register const source_location tmps = site;
+  site = f.site, f.site = tmps; }
+  { const raw_cursor tmpr = raw;
+  raw = f.raw, f.raw = tmpr; }
+  { register const bool tmpm = macro;
+  macro = f.macro, f.macro = tmpm; }
+  { const expansion_arena::mark tmpt = text;
+  text = f.text, f.text = tmpt; }
   llreader tmpr;
   tmpr.consume(file);
   file.consume(f.file);
@@ -1058,12 +1871,12 @@ token_t lexer_macro::get_token(error_handler *herr)
   {
     if (pos >= length) {
       if (lcpp->pop_file())
-        return token_t(token_basics(TT_ENDOFCODE,lcpp->filename,lcpp->line,pos-lcpp->lpos));
+        return token_t(TT_ENDOFCODE, lcpp->here(pos));
       update(); continue;
     }
     // Skip all whitespace
     if (cfile[pos] == ' ' or cfile[pos] == '\t') { ++pos; continue; }
-    if (cfile[pos] == '\n' or cfile[pos] == '\r') return token_t(token_basics(TT_ENDOFCODE,lcpp->filename,lcpp->line,pos-lcpp->lpos));
+    if (cfile[pos] == '\n' or cfile[pos] == '\r') return token_t(TT_ENDOFCODE, lcpp->here(pos));
     
     //============================================================================================
     //====: Check for and handle comments. :======================================================
@@ -1074,9 +1887,9 @@ token_t lexer_macro::get_token(error_handler *herr)
         if (cfile[pos] == '/') { lcpp->skip_comment(); continue; }
         if (cfile[pos] == '*') { lcpp->skip_multiline_comment(); continue; }
         if (cfile[pos] == '=')
-          return token_t(token_basics(TT_OPERATOR,lcpp->filename,lcpp->line,pos-lcpp->lpos), cfile+pos-1, 2);
+          return token_t(TT_OPERATOR, lcpp->here(pos), cfile+pos-1, 2);
       }
-      return token_t(token_basics(TT_OPERATOR,lcpp->filename,lcpp->line,pos-lcpp->lpos), cfile+pos-1,1);
+      return token_t(TT_OPERATOR, lcpp->here(pos), cfile+pos-1,1);
     }
     
     //============================================================================================
@@ -1091,7 +1904,7 @@ token_t lexer_macro::get_token(error_handler *herr)
       
       if (*sp == 'L' and cfile+pos - sp == 1 and cfile[pos] == '\'') {
         lcpp->skip_string(herr);
-        return token_t(token_basics(TT_CHARLITERAL,lcpp->filename,lcpp->line,sspos-lcpp->lpos), sp, ++pos - sspos);
+        return token_t(TT_CHARLITERAL, lcpp->here(sspos), sp, ++pos - sspos);
       }
       
       string fn(sp, cfile + pos); // We'll need a copy of this thing for lookup purposes
@@ -1104,7 +1917,7 @@ token_t lexer_macro::get_token(error_handler *herr)
         if (endpar) while (is_useless_macros(cfile[++pos]));
         
         if (!is_letter(cfile[pos])) {
-          herr->error("Expected identifier to look up as macro", lcpp->filename,lcpp->line,pos-lcpp->lpos);
+          lcpp->report_error(herr, "Expected identifier to look up as macro", pos, DIAG_DIRECTIVE);
           continue;
         }
         
@@ -1114,14 +1927,14 @@ token_t lexer_macro::get_token(error_handler *herr)
         
         if (endpar) {
           while (is_useless_macros(cfile[pos])) ++pos;
-          if (cfile[pos] != ')') herr->error("Expected ending parenthesis for defined()", lcpp->filename,lcpp->line,pos-lcpp->lpos);
+          if (cfile[pos] != ')') lcpp->report_error(herr, "Expected ending parenthesis for defined()", pos, DIAG_DIRECTIVE);
           pos++;
         }
         
-        return token_t(token_basics(TT_DECLITERAL,lcpp->filename,lcpp->line,pos-lcpp->lpos), lcpp->macros.find(macro)==lcpp->macros.end()? zero : one, 1);
+        return token_t(TT_DECLITERAL, lcpp->here(pos), lcpp->find_macro(macro)==lcpp->macros.end()? zero : one, 1);
       }
       
-      macro_iter mi = lcpp->macros.find(fn);
+      macro_iter mi = lcpp->find_macro(fn);
       if (mi != lcpp->macros.end()) {
         if (mi->second->argc < 0) {
           lcpp->enter_macro((macro_scalar*)mi->second);
@@ -1136,7 +1949,7 @@ token_t lexer_macro::get_token(error_handler *herr)
         }
       }
       
-      return token_t(token_basics(TT_DECLITERAL,lcpp->filename,lcpp->line,pos-lcpp->lpos), zero, 1);
+      return token_t(TT_DECLITERAL, lcpp->here(pos), zero, 1);
     }
     
     //============================================================================================
@@ -1150,13 +1963,13 @@ token_t lexer_macro::get_token(error_handler *herr)
           const size_t sp = pos;
           while (++pos < length and is_hexdigit(cfile[pos]));
           while (pos < length and is_letter(cfile[pos])) pos++; // Include the flags, like ull
-          return token_t(token_basics(TT_HEXLITERAL,lcpp->filename,lcpp->line,pos-lcpp->lpos), cfile+sp, pos-sp);  
+          return token_t(TT_HEXLITERAL, lcpp->here(pos), cfile+sp, pos-sp);  
         }
         // Turns out, it's octal.
         const size_t sp = --pos;
         while (++pos < length and is_hexdigit(cfile[pos]));
         while (pos < length and is_letter(cfile[pos])) pos++; // Include the flags, like ull
-        return token_t(token_basics(TT_OCTLITERAL,lcpp->filename,lcpp->line,pos-lcpp->lpos), cfile+sp, pos-sp);
+        return token_t(TT_OCTLITERAL, lcpp->here(pos), cfile+sp, pos-sp);
       }
       // Turns out, it's decimal.
       const size_t sp = pos;
@@ -1166,7 +1979,7 @@ token_t lexer_macro::get_token(error_handler *herr)
         while (pos < length and is_digit(cfile[pos])) ++pos;
       }
       while (pos < length and is_letter(cfile[pos])) ++pos; // Include the flags, like ull
-      return token_t(token_basics(TT_DECLITERAL,lcpp->filename,lcpp->line,pos-lcpp->lpos), cfile+sp, pos-sp);
+      return token_t(TT_DECLITERAL, lcpp->here(pos), cfile+sp, pos-sp);
     }
     
     
@@ -1178,61 +1991,136 @@ token_t lexer_macro::get_token(error_handler *herr)
     switch (cfile[pos++])
     {
       case ';':
-        return token_t(token_basics(TT_SEMICOLON,lcpp->filename,lcpp->line,spos-lcpp->lpos));
+        return token_t(TT_SEMICOLON, lcpp->here(spos));
       case ',':
-        return token_t(token_basics(TT_COMMA,lcpp->filename,lcpp->line,spos-lcpp->lpos));
+        return token_t(TT_COMMA, lcpp->here(spos));
       case '+': case '-':
         pos += cfile[pos] == cfile[spos] or cfile[pos] == '=';
-        return token_t(token_basics(TT_OPERATOR,lcpp->filename,lcpp->line,spos-lcpp->lpos), cfile+spos, pos-spos);
+        return token_t(TT_OPERATOR, lcpp->here(spos), cfile+spos, pos-spos);
       case '=': pos += cfile[pos] == cfile[spos]; case '*': case '/': case '^':
-        return token_t(token_basics(TT_OPERATOR,lcpp->filename,lcpp->line,spos-lcpp->lpos), cfile+spos, pos-spos);
+        return token_t(TT_OPERATOR, lcpp->here(spos), cfile+spos, pos-spos);
       case '&': case '|':  case '!':
         pos += cfile[pos] == cfile[spos] || cfile[pos] == '=';
-        return token_t(token_basics(TT_OPERATOR,lcpp->filename,lcpp->line,spos-lcpp->lpos), cfile+spos, pos-spos);
+        return token_t(TT_OPERATOR, lcpp->here(spos), cfile+spos, pos-spos);
       case '~': case '%':
         if (cfile[pos] == '=')
-          return token_t(token_basics(TT_OPERATOR,lcpp->filename,lcpp->line,spos-lcpp->lpos), cfile+spos, ++pos-spos);
-        return token_t(token_basics(TT_TILDE,lcpp->filename,lcpp->line,spos-lcpp->lpos), cfile+spos, pos-spos);
+          return token_t(TT_OPERATOR, lcpp->here(spos), cfile+spos, ++pos-spos);
+        return token_t(TT_TILDE, lcpp->here(spos), cfile+spos, pos-spos);
       case '>': case '<':
         pos += cfile[pos] == cfile[spos]; pos += cfile[pos] == '=';
-        return token_t(token_basics(TT_OPERATOR,lcpp->filename,lcpp->line,spos-lcpp->lpos), cfile+spos, pos-spos);
+        return token_t(TT_OPERATOR, lcpp->here(spos), cfile+spos, pos-spos);
       case ':':
         pos += cfile[pos] == cfile[spos];
-        return token_t(token_basics(pos - spos == 1 ? TT_COLON : TT_SCOPE,lcpp->filename,lcpp->line,spos-lcpp->lpos), cfile+spos, pos-spos);
+        return token_t(pos - spos == 1 ? TT_COLON : TT_SCOPE, lcpp->here(spos), cfile+spos, pos-spos);
       case '?':
-        return token_t(token_basics(TT_OPERATOR,lcpp->filename,lcpp->line,spos-lcpp->lpos), cfile+spos, pos-spos);
+        return token_t(TT_OPERATOR, lcpp->here(spos), cfile+spos, pos-spos);
         
-      case '(': return token_t(token_basics(TT_LEFTPARENTH,lcpp->filename,lcpp->line,spos-lcpp->lpos));
-      case '[': return token_t(token_basics(TT_LEFTBRACKET,lcpp->filename,lcpp->line,spos-lcpp->lpos));
-      case '{': return token_t(token_basics(TT_LEFTBRACE,  lcpp->filename,lcpp->line,spos-lcpp->lpos));
-      case '}': return token_t(token_basics(TT_RIGHTBRACE,  lcpp->filename,lcpp->line,spos-lcpp->lpos));
-      case ']': return token_t(token_basics(TT_RIGHTBRACKET,lcpp->filename,lcpp->line,spos-lcpp->lpos));
-      case ')': return token_t(token_basics(TT_RIGHTPARENTH,lcpp->filename,lcpp->line,spos-lcpp->lpos));
+      case '(': return token_t(TT_LEFTPARENTH, lcpp->here(spos));
+      case '[': return token_t(TT_LEFTBRACKET, lcpp->here(spos));
+      case '{': return token_t(TT_LEFTBRACE, lcpp->here(spos));
+      case '}': return token_t(TT_RIGHTBRACE, lcpp->here(spos));
+      case ']': return token_t(TT_RIGHTBRACKET, lcpp->here(spos));
+      case ')': return token_t(TT_RIGHTPARENTH, lcpp->here(spos));
       
       case '#':
           if (cfile[pos] == '#')
-            return token_t(token_basics(TTM_CONCAT,lcpp->filename,lcpp->line,spos-lcpp->lpos));
-        return token_t(token_basics(TTM_TOSTRING,lcpp->filename,lcpp->line,spos-lcpp->lpos));
+            return token_t(TTM_CONCAT, lcpp->here(spos));
+        return token_t(TTM_TOSTRING, lcpp->here(spos));
       
       case '\\':
           if (cfile[pos] == '\n' or (cfile[pos] == '\r' and (cfile[++pos] == '\n' or pos--)))
-            lcpp->lpos = pos++, ++lcpp->line;
+            ++pos;
         return get_token(herr);
         
       case '\"': {
         --pos; lcpp->skip_string(herr);
-        return token_t(token_basics(TT_STRINGLITERAL,lcpp->filename,lcpp->line,spos-lcpp->lpos), cfile + spos, ++pos-spos);
+        return token_t(TT_STRINGLITERAL, lcpp->here(spos), cfile + spos, ++pos-spos);
       }
       case '\'': {
         --pos; lcpp->skip_string(herr);
-        return token_t(token_basics(TT_STRINGLITERAL,lcpp->filename,lcpp->line,spos-lcpp->lpos), cfile + spos, ++pos-spos);
+        return token_t(TT_STRINGLITERAL, lcpp->here(spos), cfile + spos, ++pos-spos);
       }
       
       default:
-        return token_t(token_basics(TT_INVALID,lcpp->filename,lcpp->line,pos-lcpp->lpos++));
+        return token_t(TT_INVALID, lcpp->here(pos));
     }
   }
 }
 
+hideset_pool::hideset_pool(): sets(1) {
+  numbers[hideset()] = 0;
+}
+
+unsigned hideset_pool::number(const hideset &hs) {
+  pair<map<hideset, unsigned>::iterator, bool> ins = numbers.insert(pair<hideset, unsigned>(hs, sets.size()));
+  if (ins.second)
+    sets.push_back(hs);
+  return ins.first->second;
+}
+
+hideset_pool::pair_memo::pair_memo(): count(0) {
+  const entry none = { 0, 0, 0, false };
+  entries.assign(64, none);
+}
+
+hideset_pool::pair_memo::entry &hideset_pool::pair_memo::slot(size_t a, size_t b) {
+  size_t h = a * 0x9E3779B1u ^ b * 0x85EBCA77u;
+  h ^= h >> 16;
+  const size_t mask = entries.size() - 1;
+  for (size_t i = h & mask;; i = (i + 1) & mask)
+    if (!entries[i].used or (entries[i].a == a and entries[i].b == b))
+      return entries[i];
+}
+
+unsigned hideset_pool::pair_memo::fill(entry &e, size_t a, size_t b, unsigned result) {
+  e.a = a, e.b = b, e.result = result, e.used = true;
+  if (++count * 2 > entries.size()) { // Rehash into a table twice the size
+    const entry none = { 0, 0, 0, false };
+    vector<entry> old(entries.size() * 2, none);
+    old.swap(entries);
+    for (size_t i = 0; i < old.size(); ++i)
+      if (old[i].used)
+        slot(old[i].a, old[i].b) = old[i];
+  }
+  return result;
+}
+
+unsigned hideset_pool::add(unsigned hs, const macro_type *m) {
+  pair_memo::entry &e = added.slot(hs, (size_t)m);
+  if (e.used)
+    return e.result;
+  hideset res = sets[hs];
+  hideset::iterator it = lower_bound(res.begin(), res.end(), m);
+  if (it == res.end() or *it != m)
+    res.insert(it, m);
+  return added.fill(e, hs, (size_t)m, number(res));
+}
+
+unsigned hideset_pool::unite(unsigned a, unsigned b) {
+  if (a == b or !b) return a;
+  if (!a) return b;
+  pair_memo::entry &e = united.slot(a, b);
+  if (e.used)
+    return e.result;
+  hideset res;
+  set_union(sets[a].begin(), sets[a].end(), sets[b].begin(), sets[b].end(), back_inserter(res));
+  return united.fill(e, a, b, number(res));
+}
+
+unsigned hideset_pool::intersect(unsigned a, unsigned b) {
+  if (a == b) return a;
+  if (!a or !b) return 0;
+  pair_memo::entry &e = intersected.slot(a, b);
+  if (e.used)
+    return e.result;
+  hideset res;
+  set_intersection(sets[a].begin(), sets[a].end(), sets[b].begin(), sets[b].end(), back_inserter(res));
+  return intersected.fill(e, a, b, number(res));
+}
+
+bool hideset_pool::contains(unsigned hs, const macro_type *m) const {
+  return hs and binary_search(sets[hs].begin(), sets[hs].end(), m);
+}
+
 lexer_cpp::condition::condition() {}
 lexer_cpp::condition::condition(bool t, bool cbt): is_true(t), can_be_true(cbt) {}
@@ -32,53 +32,291 @@ namespace jdip {
   struct lexer_macro;
 }
 
+#include <map>
 #include <set>
+#include <deque>
 #include <string>
 #include <API/lexer_interface.h>
 #include <General/quickstack.h>
 #include <General/llreader.h>
 #include <API/context.h>
+#include <System/token_cache.h>
+#include <System/header_memo.h>
 
 namespace jdip {
   using namespace jdi;
+  struct retired_storage;
+  struct parse_budget;
+  
+  /**
+    @brief A stack of buffers holding the text of macro expansions.
+    
+    Buffers are carved one after another out of large blocks, and are released in the
+    reverse of the order they were allocated, by returning to a \c mark taken earlier.
+    Blocks are kept for reuse until the arena is destroyed.
+  **/
+  struct expansion_arena {
+    /// A position in the arena, to which it can later be returned.
+    struct mark {
+      size_t block; ///< The index of the block being allocated from.
+      size_t used; ///< The number of bytes of that block allocated.
+      mark(); ///< Construct a mark at the bottom of the arena.
+    };
+    
+    /// Allocate a buffer of the given size.
+    char *allocate(size_t size);
+    /// Return the current position, to release to later.
+    mark top() const;
+    /// Release every buffer allocated since the given mark was taken.
+    void release(const mark &m);
+    /// Release every buffer, handing the blocks holding them to the given storage to be
+    /// freed once nothing points into them, and begin again with no blocks.
+    void retire(retired_storage *storage);
+    /// Return whether any buffer is allocated.
+    bool in_use() const;
+    
+    expansion_arena(); ///< Construct, holding no blocks.
+    ~expansion_arena(); ///< Free every block.
+    
+  private:
+    struct block {
+      char *data; ///< The contents of this block.
+      size_t size; ///< The size of this block, in bytes.
+    };
+    vector<block> blocks; ///< Each block allocated, in order of use.
+    mark at; ///< The current position.
+    expansion_arena(const expansion_arena&); ///< Arenas are not copyable.
+    void operator=(const expansion_arena&); ///< Arenas are not copyable.
+  };
+  
+  /// How far a lexer has replayed the cached tokens of the file it has open.
+  struct raw_cursor {
+    const raw_file *file; ///< The cached tokens of the open file, or NULL to read its characters instead.
+    size_t at; ///< The index in \c file->tokens of the next token which has not been read.
+    size_t directive; ///< The index in \c file->directives of the next directive which has not been passed.
+    size_t error; ///< The index in \c file->errors of the next error which has not been passed.
+    raw_cursor(): file(NULL), at(0), directive(0), error(0) {} ///< Construct reading characters.
+    raw_cursor(const raw_file *f): file(f), at(0), directive(0), error(0) {} ///< Construct replaying a file from its start.
+  };
+  
   /**
-    @brief An extension of \c llreader which also stores information about the
-           current line number and the position of the last line break.
+    @brief An extension of \c llreader which also stores the name of the file and
+           the locations of its text.
   **/
   struct openfile {
     const char* filename; ///< The name of the open file.
     string searchdir; ///< The search directory from which this file was included, or the empty string.
-    size_t line; ///< The index of the current line.
-    size_t lpos; ///< The position of the most recent line break.
+    source_location base; ///< The location of the first character of this file, or zero in a macro's expansion.
+    source_location site; ///< In a macro's expansion, the location given to each token read.
+    raw_cursor raw; ///< How far the cached tokens of this file had been replayed.
     llreader file; ///< The llreader of this file.
+    /// True if what was opened above this is a macro's expansion rather than an #included file.
+    bool macro;
+    /// If \c macro is set, the position in the lexer's \c expansion_arena to release to when
+    /// the expansion is popped.
+    expansion_arena::mark text;
     openfile(); ///< Default constructor.
     openfile(const char* fname); ///< Construct a new openfile at position 0 with the given filename.
     /// Construct a new openfile with the works.
     /// @param fname     The name of the file in use
     /// @param sdir      The search directory from which this file was included, or the empty string
-    /// @param line_num  The number of the line, to store
-    /// @param line_pos  The position of the last newline, to store
+    /// @param start     The location of the first character of the file, to store
+    /// @param at        The location given to tokens of a macro's expansion, to store
+    /// @param cursor    How far the cached tokens of the file had been replayed, to store
+    /// @param consume   The llreader to consume for storage
+    openfile(const char* fname, string sdir, source_location start, source_location at, const raw_cursor &cursor, llreader &consume);
+    /// Construct the record of what is open beneath a macro's expansion; no search directory is kept.
+    /// @param fname     The name of the file in use
+    /// @param start     The location of the first character of the file, to store
+    /// @param at        The location given to tokens of a macro's expansion, to store
+    /// @param cursor    How far the cached tokens of the file had been replayed, to store
     /// @param consume   The llreader to consume for storage
-    openfile(const char* fname, string sdir, size_t line_num, size_t line_pos, llreader &consume);
+    /// @param text_mark The position in the lexer's arena at which the expansion's text begins
+    openfile(const char* fname, source_location start, source_location at, const raw_cursor &cursor, llreader &consume, const expansion_arena::mark &text_mark);
     void swap(openfile&); ///< Swap with another openfile.
   };
   
+  /**
+    @brief Storage for whatever a lexer has finished with, but which tokens it has
+           already returned may still point into.
+  **/
+  struct retired_storage {
+    vector<llreader*> files; ///< Readers of blocks of macro expansions which have been read to the end.
+    vector<const macro_type*> macros; ///< Macros which have been #undef'd or redefined.
+    bool empty() const; ///< Return whether nothing has been retired.
+    ~retired_storage(); ///< Close each file and release each macro.
+  };
+  
+  /**
+    @brief Numbers the hide-sets of tokens produced by expanding macros.
+    
+    A token's hide-set names the macros whose expansion produced it, and which it may
+    therefore not expand again; this is what stops a macro from expanding within itself.
+    Each distinct set is stored once, so that a token need only carry its number. The
+    empty set is numbered zero, as are tokens read straight from a file.
+  **/
+  struct hideset_pool {
+    /// Return the number of the given set with the given macro added.
+    unsigned add(unsigned hs, const macro_type *m);
+    /// Return the number of the union of the given sets.
+    unsigned unite(unsigned a, unsigned b);
+    /// Return the number of the intersection of the given sets.
+    unsigned intersect(unsigned a, unsigned b);
+    /// Return whether the given set contains the given macro.
+    bool contains(unsigned hs, const macro_type *m) const;
+    hideset_pool(); ///< Construct, holding only the empty set.
+    
+  private:
+    typedef vector<const macro_type*> hideset; ///< A set of macros, sorted by address.
+    /// The result of each operation done so far on a pair of operands, hashed with linear probing;
+    /// these are looked up for nearly every token a macro produces.
+    struct pair_memo {
+      struct entry {
+        size_t a, b; ///< The operands.
+        unsigned result; ///< The number of the set the operation gave.
+        bool used; ///< False in a free entry.
+      };
+      /// Return the entry holding the result for the given operands, or the free one where it belongs.
+      entry &slot(size_t a, size_t b);
+      /// Fill a free entry given by \c slot, returning the result; the entry may not be used afterward.
+      unsigned fill(entry &e, size_t a, size_t b, unsigned result);
+      pair_memo(); ///< Construct remembering nothing.
+    private:
+      vector<entry> entries; ///< The table; its size is a power of two, kept at least twice \c count.
+      size_t count; ///< The number of entries used.
+    };
+    vector<hideset> sets; ///< Each set, by number.
+    map<hideset, unsigned> numbers; ///< The number of each set.
+    pair_memo added; ///< The result of each \c add done so far, by set number and macro.
+    pair_memo united; ///< The result of each \c unite done so far.
+    pair_memo intersected; ///< The result of each \c intersect done so far.
+    /// Return the number of the given set, numbering it if it is new.
+    unsigned number(const hideset &hs);
+  };
+  
+  /// A token produced by expanding a macro, with the number of its hide-set.
+  struct pp_token {
+    token_t token; ///< The token itself.
+    unsigned hideset; ///< The number of its hide-set, in the \c hideset_pool of the lexer which produced it.
+    pp_token() {} ///< Construct without initializing.
+    pp_token(const token_t &t, unsigned hs): token(t), hideset(hs) {} ///< Construct from a token and the number of its hide-set.
+    /// Construct from a token read from a macro, the number of its hide-set, and the location of the macro's name.
+    pp_token(const token_t &t, unsigned hs, source_location at): token(t), hideset(hs) { token.loc = at; }
+  };
+  
+  /**
+    @brief The tokens produced by expanding a macro, which a \c lexer_cpp has yet to read.
+    
+    The definiens of a scalar is read straight out of the macro, as every token in it has
+    the same hide-set. The expansion of a macro function is substituted into \c tokens.
+  **/
+  struct expansion {
+    const macro_token *at; ///< The next token of a scalar's definiens to read.
+    const macro_token *end; ///< The end of the scalar's definiens.
+    unsigned hideset; ///< The hide-set of every token from \c at.
+    source_location site; ///< The location given to every token from \c at: that of the macro's name.
+    vector<pp_token> tokens; ///< The substituted tokens of a macro function, read after any from \c at.
+    size_t next; ///< The index in \c tokens of the next to read.
+    
+    /// Return whether every token has been read.
+    bool done() const { return at == end and next >= tokens.size(); }
+    /// Return the next token, without reading it.
+    pp_token peek() const { return at != end? pp_token(at->token, hideset, site) : tokens[next]; }
+    /// Read the next token.
+    pp_token read() { return at != end? pp_token((at++)->token, hideset, site) : tokens[next++]; }
+  };
+  
   /**
     @brief An implementation of \c jdi::lexer for lexing C++. Handles preprocessing
            seamlessly, returning only relevant tokens.
   **/
   struct lexer_cpp: lexer, llreader {
     virtual token_t get_token(error_handler *herr = def_error_handler);
+    /// Time this lexer's phases with the given clock, beginning with the file it was given; NULL stops timing.
+    virtual void time_with(jdip::phase_clock *c);
+    /// Read the next token, expanding macros and looking up identifiers, as \c get_token does
+    /// once it has seen to the tracing of headers being memoized.
+    token_t read_expanded(error_handler *herr);
     quick::stack<openfile> files; ///< The files we have open, in the order we included them.
     macro_map &macros; ///< Reference to the \c jdi::macro_map which will be used to store and retrieve macros.
+    const vector<string> &search_directories; ///< The #include search directories, in the order they are to be searched.
     
     const char* filename; ///< The name of the open file.
     string sdir; ///< The last loaded search directory.
-    size_t line; ///< The current line number in the file
-    size_t lpos; ///< The index in the file of the most recent line break.
+    source_location base; ///< The location of the first character of the open file, or zero in a macro's expansion.
+    source_location site; ///< In a macro's expansion, the location given to each token read: that of the macro's name.
+    vector<source_location> sources; ///< The location of each file opened, whose ranges are released with the lexer.
+    vector<const raw_file*> cached_files; ///< The cached text of each file opened or replayed, held until the lexer is destroyed.
+    vector<llreader*> finished; ///< Readers of included files which have been read to the end, kept so their locations resolve.
+    /// Return the location of the given position in the open file.
+    source_location here(size_t at) const { return base? base + at : site; }
+    raw_cursor raw; ///< How far the cached tokens of the open file have been replayed.
+    /** Bring \c raw up to \c pos, after the open file has been read by hand. If \c pos is not
+        where the cached tokens would have left off, stop replaying them for the rest of the file.
+        @return Returns whether the cached tokens are still being replayed. **/
+    bool raw_in_step();
+    /// Report an error at the given position in the open file; lines are only counted now.
+    void report_error(error_handler *herr, string error, size_t at) const;
+    /// Report a warning at the given position in the open file.
+    void report_warning(error_handler *herr, string warning, size_t at) const;
+    /// Report an error needing no formatting at the given position, unless the handler does not want it.
+    void report_error(error_handler *herr, const char *error, size_t at, diagnostic_id id = DIAG_OTHER) const;
+    /// Locate a diagnostic at the given position in the open file and pass it on; ask \c error_handler::wants first.
+    void report(error_handler *herr, diagnostic &d, size_t at) const;
     
     unsigned open_macro_count;
     
+    /** Macro expansions which have yet to be read, innermost last; these are read before the
+        open file. Entries past \c expansion_depth are finished, and kept only for their storage. **/
+    std::deque<expansion> expansions;
+    size_t expansion_depth; ///< The number of entries in \c expansions which are in use.
+    unsigned expanding; ///< The number of calls to \c expand_macro in progress.
+    /// The number of macros expanded so far, in code and in #if expressions alike; those expanded
+    /// within a memoized header which is replayed are not expanded again, and so are not counted.
+    unsigned long expansion_count;
+    hideset_pool hidesets; ///< The hide-sets of tokens produced by expanding macros.
+    /// The text of macros expanded as text: that of each function using '#' or '##', which
+    /// expanded tokens point into and which is released once no expansion is open, and that of
+    /// each expansion opened as a file while evaluating an #if, released when it is popped.
+    expansion_arena arena;
+    string spelling; ///< Reused to spell out the arguments to a function using '#' or '##'.
+    string substituted; ///< Reused to substitute those arguments into the function.
+    /// Macros removed while expansions were open, which expanded tokens may still point into.
+    /// These are released once no expansion is open.
+    vector<const macro_type*> released;
+    
+    /** Set this when tokens may be held after the lexer has moved on, such as when the lexer
+        runs ahead on another thread. When non-NULL, files which are read to the end and macros
+        which are removed are put here instead of being freed; whoever set this must free them
+        once no token can refer to them. **/
+    retired_storage *retired;
+    
+    /// Set to memoize each header this lexer reads, and to replay those memoized already,
+    /// by this lexer or another, where they would do the same again; see \c header_memo.
+    bool memoize;
+    /// The limits of the parse this lexer feeds, or NULL if it is not limited. Once they are spent, no
+    /// more #included files are read, and nothing but the end of the code is returned.
+    parse_budget *budget;
+    /// True while handling a directive read between tokens, rather than within the arguments to a
+    /// macro; only headers included from such directives are memoized or replayed.
+    bool at_top;
+    unsigned reports; ///< The number of errors and warnings reported so far, counted while \c memoize is set.
+    vector<header_trace*> traces; ///< The headers being traced, innermost last.
+    header_log memo_log; ///< Every token returned while any header is traced.
+    const header_memo *replay; ///< The memo being replayed in place of a header, or NULL.
+    vector<const header_memo*> replayed; ///< Each memo replayed, whose text tokens point into, held until the lexer is destroyed.
+    size_t replay_at; ///< The index in \c replay->tokens of the next token to return.
+    vector<source_location> replay_bases; ///< The location given to the first character of each file of \c replay.
+    /// Look up a macro, noting that it was looked at by the header being traced, if any.
+    macro_iter find_macro(const string &name);
+    /** Begin replaying a memo of a header which has just been found, if one would do the same again.
+        @param header    The cached text of the header.
+        @param found_in  The search directory in which it was found.
+        @return Returns whether a memo is being replayed; if not, the header should be read. **/
+    bool replay_header(const raw_file *header, const string &found_in);
+    /// Finish tracing the innermost header, which has been read to its end, memoizing it if it can be.
+    void end_trace();
+    
     /// Map of string to token type; a map-of-keywords type.
     typedef map<string,TOKEN_TYPE> keyword_map;
     /// List of C++ keywords, mapped to the type of their token.
@@ -87,14 +325,24 @@ namespace jdip {
     /// This is a map of macros to add bare-minimal support for a number of compiler-specific builtins.
     static macro_map kludge_map;
     
+    /// Static initializer; populates \c keywords and \c kludge_map. Called once from \c jdi::initialize(),
+    /// after which both maps are only read, so that lexers on separate threads may share them.
+    static void initialize();
     /// Static cleanup function; safe to call without a matching init.
     static void cleanup();
     
-    /** Sole constructor; consumes an llreader and attaches a new \c lex_macro.
+    /** Construct a lexer searching the #include directories of the \c builtin context.
+        Consumes an llreader and attaches a new \c lex_macro.
         @param input    The file from which to read definitions. This file will be manipulated by the system.
         @param pmacros  A \c jdi::macro_map which will receive and be probed for macros.
     **/
     lexer_cpp(llreader& input, macro_map &pmacros, const char *fname = "stdcall/file.cpp");
+    /** Construct a lexer with its own list of #include directories.
+        @param input    The file from which to read definitions. This file will be manipulated by the system.
+        @param pmacros  A \c jdi::macro_map which will receive and be probed for macros.
+        @param sdirs    The #include search directories to use; must outlive the lexer.
+    **/
+    lexer_cpp(llreader& input, macro_map &pmacros, const vector<string> &sdirs, const char *fname = "stdcall/file.cpp");
     /** Destructor; free the attached macro lexer. **/
     ~lexer_cpp();
     
@@ -108,6 +356,53 @@ namespace jdip {
     **/
     void handle_preprocessor(error_handler *herr);
     
+    /** Read the next token from the open file, handling any preprocessor directives before it,
+        but neither expanding macros nor looking up identifiers, which are returned as TT_IDENTIFIER.
+        @param herr  The error handler to which problems with the code are reported.
+        @param pop   Whether to move on to the including file at the end of this one; if false,
+                     TT_ENDOFCODE is returned instead. **/
+    token_t read_token(error_handler *herr, bool pop);
+    /** Read the next token, without expanding it, from the innermost unfinished expansion
+        above \c floor or, if there is none and \p from_file is set, from the open file.
+        @return Returns false if there was nothing to read. **/
+    bool next_token(pp_token &res, size_t floor, bool from_file, error_handler *herr);
+    /// Read a left parenthesis, if the next token from the same places as \c next_token is one.
+    /// @return Returns whether a parenthesis was read.
+    bool next_is_lparen(size_t floor, bool from_file);
+    /** Expand a macro, reading any arguments it takes from the same places as \c next_token,
+        and open its expansion for reading.
+        @param m     The macro to expand.
+        @param name  The token which named the macro.
+        @return Returns false if the macro is a function, but no arguments were given to it. **/
+    bool expand_macro(const macro_type *m, const pp_token &name, size_t floor, bool from_file, error_handler *herr);
+    /// Fully expand the given argument to a macro function, on its own, into the given vector.
+    /// The argument is emptied, its tokens being moved into an expansion to be read.
+    void expand_argument(vector<pp_token> &arg, vector<pp_token> &dest, error_handler *herr);
+    /// Open a new, empty expansion for reading, and return it.
+    expansion &push_expansion();
+    /// Release or retire the \c arena and \c released macros; there must be no open expansion.
+    void release_expansions();
+    
+    /** Split the given text into tokens, as it would be lexed, but with no preprocessing.
+        Identifiers are left as TT_IDENTIFIER; '#' and '##' are given as TTM_TOSTRING and TTM_CONCAT.
+        Each token points into the given text, which must be null-terminated and must outlive them.
+        @param text      The text to tokenize.
+        @param length    The length of the text.
+        @param at        The location to give as the origin of each token.
+        @param dest      The vector to which the tokens are appended [out]. **/
+    static void tokenize(const char *text, size_t length, source_location at, vector<macro_token> &dest);
+    /// Return whether the given text would hold a '#' or '##' if it were split by \c tokenize,
+    /// without splitting it; that is, whether it has a pound sign outside of strings and comments.
+    static bool pastes(const char *text, size_t length);
+    /** Split the text of a file into tokens for the \c token_cache, as \c read_token would, but
+        without obeying any directive: each pound sign is marked to be read by hand, and the
+        directive is split into tokens like any other code. So is each place where \c read_token
+        would report an error, so that the report is made whenever the file is replayed.
+        @param text    The text of the file.
+        @param length  The length of the text.
+        @param dest    The entry whose tokens, directives, and errors are to be filled. [out] **/
+    static void scan_raw(const char *text, size_t length, raw_file &dest);
+    
     /// Utility function to skip a single-line comment; invoke with pos indicating one of the slashes.
     void skip_comment();
     /// Utility function to skip a multi-line comment; invoke with pos indicating the starting slash.
@@ -118,9 +413,15 @@ namespace jdip {
     inline void skip_whitespace();
     /// Function used by the preprocessor to read in macro parameters in compliance with ISO.
     string read_preprocessor_args(error_handler *herr);
-    /** Second-order utility function to skip lines until a preprocessor
-        directive is encountered, then invoke the handler on the directive it found. **/
-    void skip_to_macro(error_handler *herr);
+    /** Second-order utility function to skip lines until a preprocessor directive is
+        encountered, as code within a false conditional is skipped, leaving the position
+        just after its pound sign for \c handle_preprocessor.
+        @return Returns false if the open file ended first. **/
+    bool skip_to_macro(error_handler *herr);
+    /** Read to the end of all input, obeying each directive as \c read_token would, but
+        skipping everything between directives as code within a false conditional is skipped,
+        without splitting it into tokens. This is what an include scanner needs. **/
+    void read_directives(error_handler *herr);
     
     /// Enter a scalar macro, if it has any content.
     /// @param ms   The macro scalar to enter.
@@ -132,30 +433,44 @@ namespace jdip {
     /// @param herr An error handler in case of parameter mismatch or non-terminated literals
     /// @return Returns whether parameters were encountered and parsed.
     bool parse_macro_function(const macro_function* mf, error_handler *herr);
-    /// Parse for parameters to a given macro function, if there are any.
-    /// This call should be made while the position is just after the macro name.
-    /// @param mf    The macro function to parse.
-    /// @param dest  The vector to receive the individual parameters [out].
-    /// @param herr  An error handler in case of parameter mismatch or non-terminated literals.
-    /// @return Returns whether parameters were encountered and parsed.
-    bool parse_macro_params(const macro_function* mf, vector<string>& dest, error_handler *herr);
-    /// Parse for parameters to a given macro function, if there are any.
-    /// This call should be made while the position is just after the macro name.
-    /// @param mf    The macro function to parse.
+    /// Find the arguments to a macro function, leaving them where they are.
+    /// This call should be made while the position is at the opening parenthesis.
+    /// @param mf    The macro function whose arguments are being found.
     /// @param cfile The buffer to read from.
-    /// @param pos   The position in the buffer to read; modified as used [in-out].
+    /// @param pos   The position in the buffer to read; moved past the closing parenthesis [in-out].
     /// @param len   The length of the given buffer.
-    /// @param dest  The vector to receive the individual parameters [out].
+    /// @param dest  The vector to receive a span of each argument; excess arguments to a variadic function are left in its last [out].
     /// @param errep A token to use to report errors [in].
-    /// @param herr  An error handler in case of parameter mismatch or non-terminated literals.
-    /// @return Returns whether parameters were encountered and parsed.
-    static bool parse_macro_params(const macro_function* mf, const macro_map &macros, const char* cfile, size_t &pos, size_t length, vector<string>& dest, const token_t &errep, error_handler *herr);
+    /// @param herr  An error handler in case of non-terminated parameters.
+    /// @return Returns whether the parameters were terminated.
+    static bool find_macro_params(const macro_function* mf, const char* cfile, size_t &pos, size_t length, vector<macro_span>& dest, const token_t &errep, error_handler *herr);
+    /// Expand a call to a macro function, after expanding any calls within its arguments, in one pass over each.
+    /// @param mf     The macro function called.
+    /// @param args   The arguments found by \c find_macro_params; these are overwritten.
+    /// @param macros The macros to expand within the arguments.
+    /// @param dest   The string to append the expansion to [out].
+    /// @param errep  A token to use to report errors [in].
+    /// @param herr   An error handler in case of parameter mismatch.
+    /// @param trace  The trace of the header being read, to note each macro looked up in, or NULL.
+    /// @return Returns whether the call was expanded; nothing is appended if the number of arguments was wrong.
+    static bool expand_macro_call(const macro_function* mf, vector<macro_span>& args, const macro_map &macros, string &dest, const token_t &errep, error_handler *herr, header_trace *trace = NULL);
     
     /// Pop the currently open file or active macro.
     /// @return Returns whether the end of all input has been reached.
     bool pop_file();
+    /// Free a macro which has been removed from the macro map, or retire it if \c retired is set.
+    /// While expansions are open, the macro is kept in \c released instead.
+    void release_macro(const macro_type *macro);
     
     set<string> visited_files; ///< For record and reporting purposes only.
+    /// An #include directive which was obeyed.
+    struct include_site {
+      string from; ///< The name of the including file.
+      string to; ///< The path of the included file.
+      source_location at; ///< The location of the directive.
+    };
+    /// Each #include obeyed, in the order they were read, including those within replayed headers.
+    vector<include_site> includes;
   protected:
     /// Storage mechanism for conditionals, such as #if, #ifdef, and #1ifndef
     struct condition {
@@ -164,8 +479,6 @@ namespace jdip {
       condition(bool,bool); ///< Convenience constructor.
       condition(); ///< Default constructor.
     };
-    /// FLatten a macro parameter, evaluating nested macro functions.
-    static string _flatten(string param, const macro_map& macros, const token_t &errep, error_handler *herr);
     quick::stack<condition> conditionals; ///< Our conditional levels (one for each nested #if*)
     lexer_macro *mlex; ///< The macro lexer that will be passed to the AST builder for #if directives.
   };
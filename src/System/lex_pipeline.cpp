@@ -0,0 +1,116 @@
+/**
+ * @file lex_pipeline.cpp
+ * @brief Source implementing the pipelined lexer.
+ *
+ * @section License
+ *
+ * Copyright (C) 2012 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include <sched.h>
+#include "lex_pipeline.h"
+#include <General/atomics.h>
+
+using namespace jdip;
+
+lexer_pipeline::lexer_pipeline(lexer_cpp *src, size_t capacity):
+  source(src), ring(NULL), mask(1), head(0), tail(0), stopping(0), finished(false), running(false)
+{
+  while (mask < capacity) mask <<= 1;
+  ring = new slot[mask];
+  --mask;
+  source->retired = new retired_storage();
+  running = !pthread_create(&producer, NULL, run, this);
+  if (!running) { // Lex on the parser's thread, then, like anyone else.
+    delete source->retired;
+    source->retired = NULL;
+  }
+}
+
+lexer_pipeline::~lexer_pipeline() {
+  if (running) {
+    quick::atomic_set(stopping, 1u);
+    pthread_join(producer, NULL);
+    for (size_t i = head; i != tail; ++i)
+      discard(ring[i & mask]);
+  }
+  delete[] ring;
+  retired_storage *r = source->retired;
+  delete source;
+  delete r;
+}
+
+void *lexer_pipeline::run(void *pipeline) {
+  ((lexer_pipeline*)pipeline)->produce();
+  return NULL;
+}
+
+void lexer_pipeline::produce() {
+  deferred_error_handler *reports = new deferred_error_handler();
+  for (;;) {
+    token_t t = source->get_token(reports);
+
+    const size_t t_at = tail;
+    while (t_at - quick::atomic_get(head) > mask) {
+      if (quick::atomic_get(stopping)) { delete reports; return; }
+      sched_yield();
+    }
+
+    slot &s = ring[t_at & mask];
+    s.token = t;
+    if (reports->reports.empty())
+      s.reports = NULL;
+    else
+      s.reports = reports, reports = new deferred_error_handler();
+    if (source->retired->empty())
+      s.retired = NULL;
+    else
+      s.retired = source->retired, source->retired = new retired_storage();
+    quick::atomic_set(tail, t_at + 1);
+
+    if (t.type == TT_ENDOFCODE)
+      break;
+  }
+  delete reports;
+}
+
+token_t lexer_pipeline::get_token(error_handler *herr) {
+  if (!running)
+    return source->get_token(herr);
+  if (finished)
+    return last;
+
+  const size_t h_at = head;
+  while (quick::atomic_get(tail) == h_at)
+    sched_yield();
+
+  slot &s = ring[h_at & mask];
+  token_t res = s.token;
+  if (s.reports) {
+    s.reports->replay(herr);
+    delete s.reports;
+  }
+  delete s.retired;
+  quick::atomic_set(head, h_at + 1);
+
+  if (res.type == TT_ENDOFCODE)
+    finished = true, last = res;
+  return res;
+}
+
+void lexer_pipeline::discard(slot &s) {
+  delete s.reports;
+  delete s.retired;
+}
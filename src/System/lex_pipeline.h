@@ -0,0 +1,91 @@
+/**
+ * @file lex_pipeline.h
+ * @brief Header declaring a lexer which runs another lexer ahead on its own thread.
+ *
+ * The C++ lexer does all preprocessing, including reading included files and
+ * expanding macros, none of which depends on what the parser has made of the
+ * code so far. This lexer runs a \c lexer_cpp on a second thread, which fills a
+ * bounded ring of tokens for the parser to drain. Looking identifiers up in the
+ * current scope is still done by the parser, on its own thread, through
+ * \c lexer::get_token_in_scope.
+ *
+ * @section License
+ *
+ * Copyright (C) 2012 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef _LEX_PIPELINE__H
+#define _LEX_PIPELINE__H
+
+#include <pthread.h>
+#include <System/lex_cpp.h>
+
+namespace jdip {
+  /**
+    @brief An implementation of \c jdi::lexer which reads tokens from a \c lexer_cpp
+           running on another thread.
+
+    The two threads share a single-producer, single-consumer ring of tokens, and
+    nothing else; neither ever takes a lock. Anything the lexer reports is held with
+    the token it was lexing at the time, and is handed to the parser's error handler
+    when that token is read. Likewise, any file or macro the lexer finishes with is
+    freed only once the parser reads the token after it, just as it would have been
+    were the lexer not running ahead.
+  **/
+  struct lexer_pipeline: lexer {
+    /// Read the next token from the ring, waiting for the lexer thread if it is empty.
+    token_t get_token(error_handler *herr = def_error_handler);
+
+    /** Start lexing on another thread.
+        @param source    The lexer to run. This lexer is owned and will be freed by the pipeline,
+                         and must not be used by anything else from here on.
+        @param capacity  The most tokens the lexer may get ahead of the parser; rounded up to a power of two.
+    **/
+    lexer_pipeline(lexer_cpp *source, size_t capacity = 1024);
+    /** Stop the lexer thread, and free the lexer and everything still in the ring. **/
+    ~lexer_pipeline();
+
+  private:
+    /// One token in the ring, with anything that must be dealt with once it is read.
+    struct slot {
+      token_t token; ///< The token lexed.
+      deferred_error_handler *reports; ///< Errors and warnings raised lexing this token, or NULL.
+      retired_storage *retired; ///< Files and macros finished with while lexing this token, or NULL.
+    };
+
+    lexer_cpp *source; ///< The lexer running on our thread.
+    slot *ring; ///< Our ring of tokens.
+    size_t mask; ///< The capacity of the ring, less one.
+    volatile size_t head; ///< The number of tokens read by the parser; written only by the parser.
+    volatile size_t tail; ///< The number of tokens written by the lexer; written only by the lexer.
+    volatile unsigned stopping; ///< Nonzero when the lexer thread should give up.
+    bool finished; ///< True once the parser has read the end of code.
+    token_t last; ///< The end-of-code token, to be returned again should the parser ask.
+    bool running; ///< True if the lexer thread was started.
+    pthread_t producer; ///< The lexer thread.
+
+    /// Run the lexer, filling the ring until the end of code is reached.
+    void produce();
+    /// Thread entry point; calls produce().
+    static void *run(void *pipeline);
+    /// Free what a slot holds, without reporting anything.
+    static void discard(slot &s);
+
+    lexer_pipeline(const lexer_pipeline&); ///< Not copyable.
+    void operator=(const lexer_pipeline&); ///< Not copyable.
+  };
+}
+
+#endif
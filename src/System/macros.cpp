@@ -28,33 +28,59 @@
 using namespace std;
 
 #include "macros.h"
+#include <System/lex_cpp.h>
 #include <General/parse_basics.h>
 #include <General/debug_macros.h>
+#include <General/atomics.h>
 using namespace jdip;
 
-macro_type::macro_type(string n, int ac): argc(ac), refc(1), name(n) {}
-macro_type::~macro_type() {}
+macro_token::macro_token(const token_t &t, int a): token(t), arg(a) {}
 
-macro_scalar::macro_scalar(string n, string val): macro_type(n,-1), value(val) {}
+macro_type::macro_type(const string &n, int ac): argc(ac), refc(1), name(n), tokens(NULL) {}
+macro_type::~macro_type() { delete tokens; }
+
+macro_scalar::macro_scalar(const string &n, const string &val): macro_type(n,-1), value(val) {}
 macro_scalar::~macro_scalar() {}
 
-macro_function::macro_function(string n, string val): macro_type(n,0), value(), args() {
+macro_function::macro_function(const string &n, const string &val): macro_type(n,0), value(), args(), definiens(val) {
   register const size_t bs = val.length();
   if (bs) {
     char *buf = new char[bs]; memcpy(buf, val.c_str(), bs);
     value.push_back(mv_chunk(buf, bs));
   }
+  by_token = !lexer_cpp::pastes(definiens.c_str(), definiens.length());
 }
-macro_function::macro_function(string n, const vector<string> &arglist, string val, bool variadic, error_handler *herr): macro_type(n,arglist.size()+variadic), value(), args(arglist) {
+macro_function::macro_function(const string &n, const vector<string> &arglist, const string &val, bool variadic, error_handler *herr): macro_type(n,arglist.size()+variadic), value(), args(arglist), definiens(val) {
   preparse(val, herr);
+  by_token = !lexer_cpp::pastes(definiens.c_str(), definiens.length());
 }
 macro_function::~macro_function() {
   for (size_t i = 0; i < value.size(); ++i)
     if (!value[i].is_arg) delete []value[i].data;
 }
 
+const vector<macro_token> &macro_type::get_tokens() const {
+  vector<macro_token> *res = quick::atomic_get(tokens);
+  if (res)
+    return *res;
+  res = new vector<macro_token>();
+  if (argc < 0) {
+    const string &value = ((const macro_scalar*)this)->value;
+    lexer_cpp::tokenize(value.c_str(), value.length(), 0, *res);
+  }
+  else
+    ((const macro_function*)this)->tokenize(*res);
+  if (quick::atomic_cas(tokens, (vector<macro_token>*)NULL, res))
+    return *res;
+  delete res; // Another thread split this macro first
+  return *quick::atomic_get(tokens);
+}
+
+void macro_type::retain(const macro_type* whom) {
+  quick::atomic_inc(whom->refc);
+}
 void macro_type::free(const macro_type* whom) {
-  if (!-- whom->refc){
+  if (!quick::atomic_dec(whom->refc)) {
     if (whom->argc >= 0) delete (macro_function*)whom;
     else delete (macro_scalar*)whom;
   }
@@ -73,7 +99,7 @@ macro_function::mv_chunk::mv_chunk(char* ndata, size_t len): data(ndata), metric
 macro_function::mv_chunk::mv_chunk(size_t argnum): data(NULL), metric(argnum), is_arg(true) {}
 
 string macro_function::mv_chunk::toString(macro_function *mf) {
-  if (is_arg) return "{{" + mf->args[metric] + "}}";
+  if (is_arg) return "{{" + (metric < mf->args.size()? mf->args[metric] : "__VA_ARGS__") + "}}";
   return string(data,metric);
 }
 
@@ -91,7 +117,7 @@ string macro_function::mv_chunk::toString(macro_function *mf) {
   comments and strings, as well as, according to the expanded-value specification
   in \c jdip::macro_function::value, handle the # and ## operators.
 **/
-inline void jdip::macro_function::preparse(string val, error_handler *herr)
+inline void jdip::macro_function::preparse(const string &val, error_handler *herr)
 {
   unsigned push_from = 0;
   map<string,int> parameters;
@@ -100,6 +126,8 @@ inline void jdip::macro_function::preparse(string val, error_handler *herr)
   
   for (pt i = 0; i < args.size(); i++) // Load parameters into map for searching and fetching index
     parameters[args[i]] = i;
+  if ((size_t)argc > args.size()) // The unnamed variadic parameter comes last
+    parameters["__VA_ARGS__"] = args.size();
   
   for (pt i = 0; i < val.length(); ) // Iterate the string
   {
@@ -172,6 +200,21 @@ inline void jdip::macro_function::preparse(string val, error_handler *herr)
     value.push_back(mv_chunk(val.c_str(), push_from, val.length() - push_from));
 }
 
+void jdip::macro_function::tokenize(vector<macro_token> &dest) const
+{
+  lexer_cpp::tokenize(definiens.c_str(), definiens.length(), 0, dest);
+  for (size_t i = 0; i < dest.size(); ++i) {
+    const token_t &t = dest[i].token;
+    if (t.type == TT_IDENTIFIER) {
+      const string id((const char*)t.str, t.len);
+      for (size_t a = 0; a < args.size(); ++a)
+        if (args[a] == id) { dest[i].arg = a; break; }
+      if ((size_t)argc > args.size() and id == "__VA_ARGS__")
+        dest[i].arg = args.size();
+    }
+  }
+}
+
 string macro_type::toString() const {
   if (argc >= 0)
   {
@@ -195,70 +238,85 @@ bool macro_function::parse(vector<string> &arg_list, char* &dest, char* &destend
 {
   if (arg_list.size() < args.size()) {
     if (arg_list.size() + 1 < args.size())
-      return errtok.report_error(herr, "Too few arguments to macro function `" + name + "': provided " + ::toString(arg_list.size()) + ", requested " + ::toString(args.size())), false;
+      return errtok.report_error(herr, DIAG_MACRO_ARGUMENTS, "Too few arguments to macro function `%s': provided %d, requested %d",
+                                 name, arg_list.size(), args.size()), false;
     arg_list.push_back("");
   }
   else if ((arg_list.size() > args.size() and args.size() == (unsigned)argc))
-    return errtok.report_error(herr, "Too many arguments to macro function `" + name + "'"), false;
-  size_t alloc = 1;
-  
+    return errtok.report_error(herr, DIAG_MACRO_ARGUMENTS, "Too many arguments to macro function `%s'", name), false;
+  if (args.size() < (unsigned)argc) { // Gather every excess argument into the variadic one
+    if (arg_list.size() < (unsigned)argc)
+      arg_list.resize(argc);
+    for (size_t i = argc; i < arg_list.size(); ++i)
+      arg_list[argc - 1] += "," + arg_list[i];
+    arg_list.resize(argc);
+  }
   if (value.empty())
     return false;
   
+  vector<macro_span> spans(arg_list.size());
+  for (size_t i = 0; i < arg_list.size(); ++i)
+    spans[i] = macro_span(arg_list[i].c_str(), arg_list[i].length());
+  string res;
+  substitute(spans.empty()? NULL : &spans[0], res);
+  
+  char* buf = new char[res.length() + 1];
+  memcpy(buf, res.c_str(), res.length() + 1);
+  dest = buf, destend = buf + res.length();
+  return true;
+}
+
+void macro_function::substitute(const macro_span *arg_list, string &dest) const
+{
+  size_t alloc = dest.length();
   for (size_t i = 0; i < value.size(); i++) {
     if (value[i].is_arg)
-      alloc += arg_list[value[i].metric].length();
+      alloc += arg_list[value[i].metric].len;
     else {
       dbg_assert(value[i].metric > 0);
-      if (*value[i].data == '#') {
-        dbg_assert(value[i].metric == 1);
-        alloc += (1 + arg_list[value[++i].metric].length()) << 1; // Make sure we have enough room for a string of nothing but newlines and backslashes
+      if (value[i].metric == 1 and *value[i].data == '#') {
+        alloc += (1 + arg_list[value[++i].metric].len) << 1; // Make sure we have enough room for a string of nothing but newlines and backslashes
         continue;
       }
       alloc += value[i].metric;
     }
   }
+  dest.reserve(alloc);
   
+  const size_t start = dest.length();
   bool last_was_arg = false; // True if the previous chunk was an argument.
-  char* buf = new char[alloc], *bufat = buf;
   for (size_t i = 0; i < value.size(); i++)
     if (value[i].is_arg)
     {
+      const macro_span &arg = arg_list[value[i].metric];
       if (last_was_arg) {
-        while (bufat > buf and is_useless(*--bufat)); ++bufat;
-        const string &ts = arg_list[value[i].metric];
-        register const char* argname = ts.c_str();
-        register size_t sz = ts.length();
-        while (is_useless(*argname)) ++argname, --sz;
-        memcpy(bufat, argname, sz);
-        bufat += sz;
-      }
-      else {
-        register const string& argname = arg_list[value[i].metric];
-        memcpy(bufat, argname.c_str(), argname.length());
-        bufat += argname.length();
+        size_t end = dest.length();
+        while (end > start and is_useless(dest[end - 1])) --end;
+        dest.erase(end);
+        size_t skip = 0;
+        while (skip < arg.len and is_useless(arg.str[skip])) ++skip;
+        dest.append(arg.str + skip, arg.len - skip);
       }
+      else
+        dest.append(arg.str, arg.len);
       last_was_arg = true;
     }
     else {
       last_was_arg = false;
       dbg_assert(value[i].metric > 0);
       if (value[i].metric == 1 and *value[i].data == '#') {
-        *bufat++ = '"';
+        dest += '"';
         dbg_assert(value[i+1].is_arg /* This should be guaranteed by the preparser. */);
-        for (const char* bi = arg_list[value[++i].metric].c_str(); *bi; bi++) {
-          if (*bi == '\n') { *bufat++ = '\\', *bufat++ = 'n'; continue; }
-          if (*bi == '\\') { *bufat++ = '\\', *bufat++ = '\\'; continue; }
-          if (*bi == '\r') { *bufat++ = '\\', *bufat++ = 'r'; continue; }
-          *bufat++ = *bi;
+        const macro_span &arg = arg_list[value[++i].metric];
+        for (const char* bi = arg.str; bi < arg.str + arg.len; bi++) {
+          if (*bi == '\n') { dest += "\\n"; continue; }
+          if (*bi == '\\') { dest += "\\\\"; continue; }
+          if (*bi == '\r') { dest += "\\r"; continue; }
+          dest += *bi;
         }
-        *bufat++ = '"';
+        dest += '"';
         continue;
       }
-      memcpy(bufat, value[i].data, value[i].metric);
-      bufat += value[i].metric;
+      dest.append(value[i].data, value[i].metric);
     }
-  *bufat = 0;
-  dest = buf, destend = bufat;
-  return true;
 }
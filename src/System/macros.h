@@ -33,6 +33,7 @@ namespace jdip {
   struct macro_type;
   struct macro_scalar;
   struct macro_function;
+  struct macro_token;
 }
 
 #include <string>
@@ -46,6 +47,13 @@ namespace jdip {
   using std::vector;
   using namespace jdi;
   
+  /// A span of text, such as an argument to a macro function, left where it was read rather than copied out.
+  struct macro_span {
+    const char *str; ///< The first character of the span.
+    size_t len; ///< The number of characters in the span.
+    macro_span(const char *s = NULL, size_t l = 0): str(s), len(l) {} ///< Construct from a pointer and a length.
+  };
+  
   /**
     @struct macro_type
     @brief  A generic structure representing a macro in memory.
@@ -60,19 +68,34 @@ namespace jdip {
       Hence, a value of -1 implies that this is an instance of macro_scalar.
       Otherwise, this is an instance of macro_function.
       If this value is greater than the size of the argument vector in the macro_function, then the function is variadic.
-    **/
+    **/
     const int argc;
     /// Macros should not be edited, only replaced, and therefore are easy to copy by reference; this tells how many references are made to this macro.
-    mutable unsigned refc;
+    /// Contexts on different threads may share a macro, so this count must only be modified through \c retain and \c free.
+    mutable volatile unsigned refc;
     /// A copy of the name of this macro; std::string will take care of the aliasing.
     string name;
+    /** Get the definiens of this macro split into tokens, so that expanding it does not read its
+        text again. Identifiers are left as TT_IDENTIFIER, as they may name macros; '#' and '##'
+        are kept as TTM_TOSTRING and TTM_CONCAT. The tokens are made the first time this is called,
+        as most macros, such as those predefined by a compiler, are never expanded; this is safe to
+        call while other threads expand the same macro.
+        See \c jdip::macro_token, in token.h, which needs the complete \c token_t. **/
+    const vector<macro_token> &get_tokens() const;
     
-    /// Release a macro
+    /// Add a reference to a macro; safe to call while other threads retain or release it.
+    static void retain(const macro_type* whom);
+    /// Release a macro; safe to call while other threads retain or release it.
     static void free(const macro_type* whom);
     
     /// Convert this macro to a string
     string toString() const;
     
+    private:
+      /// The tokens returned by \c get_tokens, or NULL until they are first asked for.
+      mutable vector<macro_token> *volatile tokens;
+      macro_type(const macro_type&); ///< Macros are shared by reference; see \c retain.
+    
     protected:
       /**
         The macro_type constructor is used to set the argument count or flag it inactive.
@@ -80,8 +103,8 @@ namespace jdip {
         the parameter count could cause failure to recognize the type of the current macro.
         @see argc
       **/
-      macro_type(string n, int argc);
-      /// The base destructor of macro_type does not do anything to free memebers: DO NOT INVOKE IT!
+      macro_type(const string &n, int argc);
+      /// The base destructor of macro_type frees only the tokens: DO NOT INVOKE IT!
       /// Use macro_type::free instead.
       ~macro_type();
   };
@@ -90,9 +113,9 @@ namespace jdip {
     @struct macro_scalar
     @brief  A structure representing a macro substitution in memory.
   **/
-  struct macro_scalar: macro_type {
+  struct macro_scalar: macro_type {
     string value; ///< The definiens of this macro.
-    macro_scalar(string n, string val=""); ///< The default constructor, taking an optional value parameter.
+    macro_scalar(const string &n, const string &val = string()); ///< The default constructor, taking an optional value parameter.
     ~macro_scalar(); ///< The macro_scalar destructor is only for debugging purposes.
   };
   
@@ -132,12 +155,16 @@ namespace jdip {
         
         By this convention, evaluating a macro function is as simple as unloading the argument-value pairs into a
         map and iterating the value vector, substituting value[i] with map[value[i]] where defined.
-    **/
-    vector<mv_chunk> value;
-    vector<string> args; //!< The names of each argument.
+    **/
+    vector<mv_chunk> value;
+    vector<string> args; //!< The names of each argument. A variadic macro has one more, numbered args.size(), which its definiens calls __VA_ARGS__.
+    string definiens; ///< The definiens of this macro as it was given, into which its tokens point.
+    /// True if this macro can be expanded by substituting its tokens; false if it uses '#' or '##',
+    /// which are applied to the text of its arguments by \c parse.
+    bool by_token;
     
     /// Default constructor; construct a zero-parameter macro function with the given value, or an empty value if none is specified.
-    macro_function(string n, string val="");
+    macro_function(const string &n, const string &val = string());
     /** Construct a macro function taking the arguments in arg_list.
         This function parses the given value based on the argument list.
         @param arg_list  Contains the arguments to be copied in.
@@ -148,13 +175,15 @@ namespace jdip {
         @note
           If \p arg_list is empty, and \p variadic is false, the behavior is the same as the default constructor. 
     **/
-    macro_function(string n, const vector<string> &arg_list, string value="", bool variadic=0, error_handler *herr = def_error_handler);
+    macro_function(const string &n, const vector<string> &arg_list, const string &value = string(), bool variadic=0, error_handler *herr = def_error_handler);
     
     /** An internal function used to parse the definiens of a macro into a vector for collapse at eval-time.
         Saves big on CPU when evaluating a function many times.
         @see jdi::macro_function::value
     **/
-    void preparse(string definiens, error_handler *herr);
+    void preparse(const string &definiens, error_handler *herr);
+    /// Split \c definiens into the given tokens, marking each which names a parameter.
+    void tokenize(vector<macro_token> &dest) const;
     
     /** Parse an argument vector into a string. 
         @param arg_list  Contains the arguments to be copied in.
@@ -164,6 +193,12 @@ namespace jdip {
         @param herr      The error handler to receive any errors.
     **/
     bool parse(vector<string> &arg_list, char* &dest, char* &destend, token_t errtok, error_handler *herr = def_error_handler) const;
+    /** Append the value of this macro to a string, substituting the given arguments.
+        @param args  The text of each argument; there must be exactly \c argc, any excess
+                     arguments to a variadic macro having been joined into its last.
+        @param dest  The string to append to. [out]
+    **/
+    void substitute(const macro_span *args, string &dest) const;
     
     /// Big surprise: The macro_function destructor also does nothing.
     ~macro_function();
@@ -0,0 +1,301 @@
+/**
+ * @file source_map.cpp
+ * @brief Source implementing the registry of source locations.
+ *
+ * @section License
+ *
+ * Copyright (C) 2012 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include "source_map.h"
+#include <map>
+#include <vector>
+#include <algorithm>
+#include <pthread.h>
+#ifdef __SSE2__
+  #include <emmintrin.h>
+#endif
+
+using namespace std;
+using namespace jdip;
+
+namespace {
+  /// Everything kept about a file which has been given a range of locations.
+  struct source_file {
+    string name; ///< The name of the file.
+    unsigned id; ///< The number of that name, by \c source_id.
+    unsigned size; ///< The number of locations in the range.
+    const char *text; ///< The text of the file.
+    vector<unsigned> breaks; ///< The offset of each line break in the text before \c indexed.
+    unsigned indexed; ///< The number of characters of the text which have been searched for line breaks.
+    size_t last_line; ///< The index in \c breaks of the line a location was last found on, tried first.
+    const vector<unsigned> *known; ///< Every line break in the text, if given to \c open_source; else NULL.
+    unsigned readers; ///< The number of threads searching the text for line breaks; it is not released while any are.
+    bool pinned; ///< True if this is a single position given by \c pin_source, rather than a file.
+    int line; ///< The line a pinned position resolves to.
+    int pos; ///< The position in that line a pinned position resolves to.
+    source_file(): id(0), size(0), text(NULL), indexed(0), last_line(0), known(NULL), readers(0), pinned(false), line(-1), pos(-1) {}
+  };
+  typedef map<source_location, source_file> file_map; ///< Maps the start of each range to its file.
+  typedef map<source_location, unsigned> range_map; ///< Maps the start of each free range to its size.
+  typedef map<pair<string, pair<int, int> >, source_location> pin_map; ///< Maps each pinned position to its location.
+
+  pthread_mutex_t registry_lock = PTHREAD_MUTEX_INITIALIZER; ///< Held while anything below is used.
+  pthread_cond_t registry_read = PTHREAD_COND_INITIALIZER; ///< Signalled when a file has no more readers.
+  file_map files; ///< Every file with a range.
+  file_map::iterator last_file = files.end(); ///< The file a location was last found in, tried first, or the end of \c files.
+  range_map unused; ///< Every range not given to a file.
+  bool began = false; ///< True once \c unused has been filled.
+  pin_map pins; ///< Every pinned position.
+  map<string, unsigned> ids; ///< The number of each file name seen.
+  vector<string> names(1); ///< Each file name seen, by number; zero is the empty name.
+
+  /// Number a file name, if it has not been; the registry must be locked.
+  unsigned name_id(const string &name) {
+    if (name.empty())
+      return 0;
+    pair<map<string, unsigned>::iterator, bool> ins = ids.insert(make_pair(name, (unsigned)names.size()));
+    if (ins.second)
+      names.push_back(name);
+    return ins.first->second;
+  }
+
+  /// Take a range of the given size out of those unused, returning its start, or zero if none is big enough.
+  source_location take_range(unsigned size) {
+    if (!began)
+      unused[1] = ~0u, began = true; // Everything but zero
+    for (range_map::iterator it = unused.begin(); it != unused.end(); ++it)
+      if (it->second >= size) {
+        const source_location start = it->first;
+        if (it->second > size)
+          unused[start + size] = it->second - size;
+        unused.erase(it);
+        return start;
+      }
+    return 0;
+  }
+
+  /// Return a range to those unused, joining it with those on either side.
+  void give_range(source_location start, unsigned size) {
+    range_map::iterator it = unused.insert(make_pair(start, size)).first, next = it;
+    if (++next != unused.end() and next->first - start == size)
+      it->second += next->second, unused.erase(next);
+    if (it != unused.begin()) {
+      range_map::iterator prev = it;
+      --prev;
+      if (start - prev->first == prev->second)
+        prev->second += it->second, unused.erase(it);
+    }
+  }
+
+  /// Find the file whose range holds the given location; the registry must be locked.
+  bool find_file(source_location loc, file_map::iterator &it) {
+    // Locations are mostly resolved in the order they were read, so usually in the file last found
+    if (last_file != files.end() and loc >= last_file->first and loc - last_file->first < last_file->second.size)
+      return it = last_file, true;
+    it = files.upper_bound(loc);
+    if (it == files.begin())
+      return false;
+    --it;
+    if (loc - it->first >= it->second.size)
+      return false;
+    last_file = it;
+    return true;
+  }
+
+  /// Record the line break at the given offset, if there is one there; a carriage return
+  /// followed by a line feed is a single break, recorded at the carriage return.
+  inline void note_break(const char *text, unsigned i, vector<unsigned> &breaks) {
+    if (text[i] == '\r' or (text[i] == '\n' and (!i or text[i-1] != '\r')))
+      breaks.push_back(i);
+  }
+
+  /// Find each line break in a span of a file's text. Most of the text holds no break at all,
+  /// so it is checked sixteen bytes at a time where SSE2 is available.
+  void index_lines(const char *text, unsigned i, unsigned length, vector<unsigned> &breaks) {
+    #ifdef __SSE2__
+      const __m128i lf = _mm_set1_epi8('\n'), cr = _mm_set1_epi8('\r');
+      for (; i + 16 <= length; i += 16) {
+        const __m128i chunk = _mm_loadu_si128((const __m128i*)(text + i));
+        unsigned mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, lf), _mm_cmpeq_epi8(chunk, cr)));
+        for (; mask; mask &= mask - 1)
+          note_break(text, i + __builtin_ctz(mask), breaks);
+      }
+    #endif
+    for (; i < length; ++i)
+      note_break(text, i, breaks);
+  }
+
+  /** Find the file holding a location, and the line and position of the location in it; the
+      registry must be locked. Line breaks are found only as far as the location, and with the
+      registry unlocked, so that other threads are not kept waiting on a long file. What is found
+      is added under the lock by whichever thread gets there first.
+      @return Returns whether the location was found; if not, nothing is changed. **/
+  bool place(source_location loc, file_map::iterator &it, int &line, int &pos) {
+    for (;;) {
+      if (!find_file(loc, it))
+        return false;
+      source_file &f = it->second;
+      if (f.pinned) {
+        line = f.line, pos = f.pos;
+        return true;
+      }
+      const unsigned off = loc - it->first;
+      if (f.known or off <= f.indexed) {
+        const vector<unsigned> &breaks = f.known? *f.known : f.breaks;
+        // The first break at or after the location; that of the line last found, or of the next, if it will do
+        size_t brk = f.last_line;
+        if (brk < breaks.size() and breaks[brk] < off and (brk + 1 == breaks.size() or breaks[brk + 1] >= off))
+          ++brk;
+        else if (!(brk <= breaks.size() and (brk == breaks.size() or breaks[brk] >= off) and (!brk or breaks[brk - 1] < off)))
+          brk = lower_bound(breaks.begin(), breaks.end(), off) - breaks.begin();
+        f.last_line = brk;
+        line = brk + 1;
+        pos = off - (brk? breaks[brk - 1] : 0);
+        return true;
+      }
+      
+      // Search at least twice as far as last time, so that walking a file costs one pass over it
+      const unsigned from = f.indexed, to = min(f.size - 1, max(off, max(2 * from, 4096u)));
+      vector<unsigned> found;
+      ++f.readers;
+      pthread_mutex_unlock(&registry_lock);
+      index_lines(f.text, from, to, found);
+      pthread_mutex_lock(&registry_lock);
+      if (f.indexed == from) {
+        f.breaks.insert(f.breaks.end(), found.begin(), found.end());
+        f.indexed = to;
+      }
+      if (!--f.readers)
+        pthread_cond_broadcast(&registry_read);
+    }
+  }
+}
+
+source_location jdip::open_source(const char *filename, const char *text, size_t length, const vector<unsigned> *breaks)
+{
+  if (length >= ~0u)
+    return 0;
+  pthread_mutex_lock(&registry_lock);
+  const source_location start = take_range(length + 1);
+  if (start) {
+    source_file &f = files[start];
+    f.name = filename;
+    f.id = name_id(f.name);
+    f.size = length + 1;
+    f.text = text;
+    f.known = breaks;
+  }
+  pthread_mutex_unlock(&registry_lock);
+  return start;
+}
+
+void jdip::release_source(source_location start)
+{
+  pthread_mutex_lock(&registry_lock);
+  file_map::iterator it;
+  while ((it = files.find(start)) != files.end() and it->second.readers)
+    pthread_cond_wait(&registry_read, &registry_lock);
+  if (it != files.end()) {
+    give_range(start, it->second.size);
+    if (it == last_file)
+      last_file = files.end();
+    files.erase(it);
+  }
+  pthread_mutex_unlock(&registry_lock);
+}
+
+void jdip::find_line_breaks(const char *text, size_t length, vector<unsigned> &breaks) {
+  index_lines(text, 0, length, breaks);
+}
+
+source_location jdip::pin_source(const char *filename, int line, int pos)
+{
+  pthread_mutex_lock(&registry_lock);
+  pair<pin_map::iterator, bool> ins = pins.insert(make_pair(make_pair(string(filename), make_pair(line, pos)), 0u));
+  if (ins.second) {
+    const source_location loc = ins.first->second = take_range(1);
+    if (loc) {
+      source_file &f = files[loc];
+      f.name = filename;
+      f.id = name_id(f.name);
+      f.size = 1;
+      f.pinned = true;
+      f.line = line, f.pos = pos;
+    }
+  }
+  const source_location res = ins.first->second;
+  pthread_mutex_unlock(&registry_lock);
+  return res;
+}
+
+bool jdip::resolve_source(source_location loc, string &filename, int &line, int &pos)
+{
+  if (!loc)
+    return false;
+  pthread_mutex_lock(&registry_lock);
+  file_map::iterator it;
+  const bool found = place(loc, it, line, pos);
+  if (found)
+    filename = it->second.name;
+  pthread_mutex_unlock(&registry_lock);
+  return found;
+}
+
+bool jdip::resolve_source(source_location loc, unsigned &file, int &line, int &pos)
+{
+  if (!loc)
+    return false;
+  pthread_mutex_lock(&registry_lock);
+  file_map::iterator it;
+  const bool found = place(loc, it, line, pos);
+  if (found)
+    file = it->second.id;
+  pthread_mutex_unlock(&registry_lock);
+  return found;
+}
+
+unsigned jdip::source_id(const string &filename)
+{
+  if (filename.empty())
+    return 0;
+  pthread_mutex_lock(&registry_lock);
+  const unsigned res = name_id(filename);
+  pthread_mutex_unlock(&registry_lock);
+  return res;
+}
+
+string jdip::source_name(unsigned file)
+{
+  string res;
+  pthread_mutex_lock(&registry_lock);
+  if (file < names.size())
+    res = names[file];
+  pthread_mutex_unlock(&registry_lock);
+  return res;
+}
+
+bool jdip::find_source(source_location loc, string &filename, source_location &start, unsigned &size)
+{
+  if (!loc)
+    return false;
+  pthread_mutex_lock(&registry_lock);
+  file_map::iterator it;
+  const bool found = find_file(loc, it);
+  if (found)
+    filename = it->second.name, start = it->first, size = it->second.size;
+  pthread_mutex_unlock(&registry_lock);
+  return found;
+}
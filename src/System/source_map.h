@@ -0,0 +1,79 @@
+/**
+ * @file source_map.h
+ * @brief Header declaring the registry which gives each source file a range of locations.
+ *
+ * A token records where it was read as a single \c source_location, rather than as a
+ * file name, line, and column. Each file a lexer opens is given its own range of these
+ * numbers, one for each of its characters, so that the location of a character is the
+ * start of its file's range plus its offset in the file. Only when an error is reported
+ * is a location resolved back into a file name, line, and column; where the lines of a file
+ * begin is only worked out the first time a location within it is resolved, unless it was
+ * given, as it is for files whose tokens are cached.
+ *
+ * The registry is shared by every lexer, on every thread. A lexer releases the ranges of
+ * its files when it is destroyed, after which those locations resolve to nothing.
+ *
+ * @section License
+ *
+ * Copyright (C) 2012 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef _SOURCE_MAP__H
+#define _SOURCE_MAP__H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+namespace jdip {
+  /// A position in some source file, as registered with \c open_source. Zero is no position.
+  typedef unsigned source_location;
+
+  /** Give a file a range of locations, one for each character of its text and one for its end.
+      @param filename  The name of the file, which is copied.
+      @param text      The text of the file, which must stay put until \c release_source is called.
+      @param length    The length of the text.
+      @param breaks    If given, the line breaks in the text, as found by \c find_line_breaks, which must
+                       stay put as the text does; otherwise, they are found as locations are resolved.
+      @return Returns the location of the first character, or zero if no range was left. **/
+  source_location open_source(const char *filename, const char *text, size_t length, const std::vector<unsigned> *breaks = NULL);
+  /// Find the offset of each line break in a text; a carriage return and line feed together are one break.
+  void find_line_breaks(const char *text, size_t length, std::vector<unsigned> &breaks);
+  /** Free the range of a file, after which its text may be freed. Locations within it resolve
+      to nothing after this, and the range may be given to another file.
+      @param start  The location returned by \c open_source. **/
+  void release_source(source_location start);
+  /** Return a location which resolves to the given position, for a token made up outside of
+      any file. Asking twice for the same position gives the same location; these are never freed. **/
+  source_location pin_source(const char *filename, int line, int pos);
+  /** Resolve a location into the name of its file, its line, and its position in that line.
+      @return Returns whether the location was found; if not, nothing is changed. **/
+  bool resolve_source(source_location loc, std::string &filename, int &line, int &pos);
+  /** Resolve a location into the number of its file, its line, and its position in that line.
+      Unlike a location, the number of a file stays good after the file is released: every
+      file of the same name is given the same number, which is never taken back.
+      @return Returns whether the location was found; if not, nothing is changed. **/
+  bool resolve_source(source_location loc, unsigned &file, int &line, int &pos);
+  /// Get the number of the file of the given name, as by \c resolve_source; the empty name is zero.
+  unsigned source_id(const std::string &filename);
+  /// Get the name of the file of the given number, or the empty string if there is no such file.
+  std::string source_name(unsigned file);
+  /** Find the range of the file holding a location, so that whoever places many locations can
+      tell which fall in the same file without asking each time.
+      @return Returns whether the location was found; if not, nothing is changed. **/
+  bool find_source(source_location loc, std::string &filename, source_location &start, unsigned &size);
+}
+
+#endif
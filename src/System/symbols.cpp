@@ -24,9 +24,11 @@
 #include <Storage/value_funcs.h>
 
 namespace jdip {
-  symbol_table symbols;
+  const symbol_table symbols;
 
-  symbol::symbol() {}
+  symbol::symbol():
+    type(0), prec_binary(0), prec_unary_pre(0), prec_unary_post(0),
+    operate(NULL), operate_unary_pre(NULL), operate_unary_post(NULL) {}
   symbol::symbol(unsigned char t, unsigned char p):
     type(t), prec_binary(t&ST_BINARY? p:0), prec_unary_pre(t&ST_UNARY_PRE? p:0), prec_unary_post(t&ST_UNARY_POST? p:0),
     operate(NULL), operate_unary_pre(NULL), operate_unary_post(NULL) {}
@@ -46,6 +48,12 @@ namespace jdip {
     if (!operate_unary_post) operate_unary_post = other.operate_unary_post;
     return *this;
   }
+  
+  const symbol &symbol_table::get(const std::string &sym) const {
+    static const symbol nonsymbol;
+    const_iterator it = find(sym);
+    return it == end()? nonsymbol : it->second;
+  }
 }
 
 using namespace jdip;
@@ -54,70 +62,70 @@ using namespace jdip;
 /// Simply maps all the symbols with their AST generation and evaluation information.
 symbol_table::symbol_table()
 {
-  symbols["::"] = symbol(ST_BINARY, precedence::scope);
+  (*this)["::"] = symbol(ST_BINARY, precedence::scope);
   
-  symbols["++"] = symbol(ST_UNARY_POST,precedence::unary_post,value_unary_increment);
-  symbols["--"] = symbol(ST_UNARY_POST,precedence::unary_post,value_unary_decrement);
-  symbols["("]  = symbol(ST_BINARY,precedence::unary_post);
-  symbols["["]  = symbol(ST_BINARY,precedence::unary_post);
-  symbols["."]  = symbol(ST_BINARY,precedence::unary_post);
-  symbols["->"] = symbol(ST_BINARY,precedence::unary_post);
+  (*this)["++"] = symbol(ST_UNARY_POST,precedence::unary_post,value_unary_increment);
+  (*this)["--"] = symbol(ST_UNARY_POST,precedence::unary_post,value_unary_decrement);
+  (*this)["("]  = symbol(ST_BINARY,precedence::unary_post);
+  (*this)["["]  = symbol(ST_BINARY,precedence::unary_post);
+  (*this)["."]  = symbol(ST_BINARY,precedence::unary_post);
+  (*this)["->"] = symbol(ST_BINARY,precedence::unary_post);
   
-  symbols["++"] |= symbol(ST_UNARY_PRE,precedence::unary_pre,value_unary_increment);
-  symbols["--"] |= symbol(ST_UNARY_PRE,precedence::unary_pre,value_unary_decrement);
-  symbols["+"]   = symbol(ST_UNARY_PRE,precedence::unary_pre,value_unary_positive);
-  symbols["-"]   = symbol(ST_UNARY_PRE,precedence::unary_pre,value_unary_negative);
-  symbols["!"]   = symbol(ST_UNARY_PRE,precedence::unary_pre,value_unary_not);
-  symbols["~"]   = symbol(ST_UNARY_PRE,precedence::unary_pre,value_unary_negate);
-  symbols["*"]   = symbol(ST_UNARY_PRE,precedence::unary_pre,value_unary_dereference);
-  symbols["&"]   = symbol(ST_UNARY_PRE,precedence::unary_pre,value_unary_reference);
-  symbols["(cast)"]   = symbol(ST_UNARY_PRE,precedence::unary_pre,value_unary_reference);
-  symbols["sizeof"] = symbol(ST_UNARY_PRE,precedence::unary_pre);
-  symbols["new"]    = symbol(ST_UNARY_PRE,precedence::unary_pre);
-  symbols["delete"] = symbol(ST_UNARY_PRE,precedence::unary_pre);
+  (*this)["++"] |= symbol(ST_UNARY_PRE,precedence::unary_pre,value_unary_increment);
+  (*this)["--"] |= symbol(ST_UNARY_PRE,precedence::unary_pre,value_unary_decrement);
+  (*this)["+"]   = symbol(ST_UNARY_PRE,precedence::unary_pre,value_unary_positive);
+  (*this)["-"]   = symbol(ST_UNARY_PRE,precedence::unary_pre,value_unary_negative);
+  (*this)["!"]   = symbol(ST_UNARY_PRE,precedence::unary_pre,value_unary_not);
+  (*this)["~"]   = symbol(ST_UNARY_PRE,precedence::unary_pre,value_unary_negate);
+  (*this)["*"]   = symbol(ST_UNARY_PRE,precedence::unary_pre,value_unary_dereference);
+  (*this)["&"]   = symbol(ST_UNARY_PRE,precedence::unary_pre,value_unary_reference);
+  (*this)["(cast)"]   = symbol(ST_UNARY_PRE,precedence::unary_pre,value_unary_reference);
+  (*this)["sizeof"] = symbol(ST_UNARY_PRE,precedence::unary_pre);
+  (*this)["new"]    = symbol(ST_UNARY_PRE,precedence::unary_pre);
+  (*this)["delete"] = symbol(ST_UNARY_PRE,precedence::unary_pre);
   
-  symbols[".*"]  = symbol(ST_BINARY, precedence::ptr_member);
-  symbols["->*"] = symbol(ST_BINARY, precedence::ptr_member);
+  (*this)[".*"]  = symbol(ST_BINARY, precedence::ptr_member);
+  (*this)["->*"] = symbol(ST_BINARY, precedence::ptr_member);
   
-  symbols["*"] |= symbol(ST_BINARY,precedence::multiplication,values_multiply);
-  symbols["/"]  = symbol(ST_BINARY,precedence::multiplication,values_divide);
-  symbols["%"]  = symbol(ST_BINARY,precedence::multiplication,values_modulo);
+  (*this)["*"] |= symbol(ST_BINARY,precedence::multiplication,values_multiply);
+  (*this)["/"]  = symbol(ST_BINARY,precedence::multiplication,values_divide);
+  (*this)["%"]  = symbol(ST_BINARY,precedence::multiplication,values_modulo);
   
-  symbols["+"] |= symbol(ST_BINARY,precedence::addition,values_add);
-  symbols["-"] |= symbol(ST_BINARY,precedence::addition,values_subtract);
+  (*this)["+"] |= symbol(ST_BINARY,precedence::addition,values_add);
+  (*this)["-"] |= symbol(ST_BINARY,precedence::addition,values_subtract);
   
-  symbols["<<"] = symbol(ST_BINARY,precedence::shift,values_lshift);
-  symbols[">>"] = symbol(ST_BINARY,precedence::shift,values_rshift);
+  (*this)["<<"] = symbol(ST_BINARY,precedence::shift,values_lshift);
+  (*this)[">>"] = symbol(ST_BINARY,precedence::shift,values_rshift);
   
-  symbols["<"]  = symbol(ST_BINARY,precedence::comparison,values_less);
-  symbols[">"]  = symbol(ST_BINARY,precedence::comparison,values_greater);
-  symbols["<="] = symbol(ST_BINARY,precedence::comparison,values_less_or_equal);
-  symbols[">="] = symbol(ST_BINARY,precedence::comparison,values_greater_or_equal);
+  (*this)["<"]  = symbol(ST_BINARY,precedence::comparison,values_less);
+  (*this)[">"]  = symbol(ST_BINARY,precedence::comparison,values_greater);
+  (*this)["<="] = symbol(ST_BINARY,precedence::comparison,values_less_or_equal);
+  (*this)[">="] = symbol(ST_BINARY,precedence::comparison,values_greater_or_equal);
   
-  symbols["=="]  = symbol(ST_BINARY,precedence::equivalence,values_equal);
-  symbols["!="]  = symbol(ST_BINARY,precedence::equivalence,values_notequal);
+  (*this)["=="]  = symbol(ST_BINARY,precedence::equivalence,values_equal);
+  (*this)["!="]  = symbol(ST_BINARY,precedence::equivalence,values_notequal);
   
-  symbols["&"] |= symbol(ST_BINARY,precedence::bit_and,values_bitand);
-  symbols["^"]  = symbol(ST_BINARY,precedence::bit_xor,values_bitxor);
-  symbols["|"]  = symbol(ST_BINARY,precedence::bit_or,values_bitor);
+  (*this)["&"] |= symbol(ST_BINARY,precedence::bit_and,values_bitand);
+  (*this)["^"]  = symbol(ST_BINARY,precedence::bit_xor,values_bitxor);
+  (*this)["|"]  = symbol(ST_BINARY,precedence::bit_or,values_bitor);
   
-  symbols["&&"] = symbol(ST_BINARY,precedence::logical_and,values_booland);
-  symbols["^^"] = symbol(ST_BINARY,precedence::logical_or,values_boolxor);
-  symbols["||"] = symbol(ST_BINARY,precedence::logical_or,values_boolor);
+  (*this)["&&"] = symbol(ST_BINARY,precedence::logical_and,values_booland);
+  (*this)["^^"] = symbol(ST_BINARY,precedence::logical_or,values_boolxor);
+  (*this)["||"] = symbol(ST_BINARY,precedence::logical_or,values_boolor);
   
-  symbols["?"]  = symbol(ST_TERNARY | ST_RTL_PARSED,precedence::ternary);
+  (*this)["?"]  = symbol(ST_TERNARY | ST_RTL_PARSED,precedence::ternary);
   
-  symbols["="]   = symbol(ST_BINARY | ST_RTL_PARSED,precedence::assign, values_latter);
-  symbols["+="]  = symbol(ST_BINARY | ST_RTL_PARSED,precedence::assign);
-  symbols["-="]  = symbol(ST_BINARY | ST_RTL_PARSED,precedence::assign);
-  symbols["*="]  = symbol(ST_BINARY | ST_RTL_PARSED,precedence::assign);
-  symbols["%="]  = symbol(ST_BINARY | ST_RTL_PARSED,precedence::assign);
-  symbols["/="]  = symbol(ST_BINARY | ST_RTL_PARSED,precedence::assign);
-  symbols["&="]  = symbol(ST_BINARY | ST_RTL_PARSED,precedence::assign);
-  symbols["^="]  = symbol(ST_BINARY | ST_RTL_PARSED,precedence::assign);
-  symbols["|="]  = symbol(ST_BINARY | ST_RTL_PARSED,precedence::assign);
-  symbols["<<="] = symbol(ST_BINARY | ST_RTL_PARSED,precedence::assign);
-  symbols[">>="] = symbol(ST_BINARY | ST_RTL_PARSED,precedence::assign);
+  (*this)["="]   = symbol(ST_BINARY | ST_RTL_PARSED,precedence::assign, values_latter);
+  (*this)["+="]  = symbol(ST_BINARY | ST_RTL_PARSED,precedence::assign);
+  (*this)["-="]  = symbol(ST_BINARY | ST_RTL_PARSED,precedence::assign);
+  (*this)["*="]  = symbol(ST_BINARY | ST_RTL_PARSED,precedence::assign);
+  (*this)["%="]  = symbol(ST_BINARY | ST_RTL_PARSED,precedence::assign);
+  (*this)["/="]  = symbol(ST_BINARY | ST_RTL_PARSED,precedence::assign);
+  (*this)["&="]  = symbol(ST_BINARY | ST_RTL_PARSED,precedence::assign);
+  (*this)["^="]  = symbol(ST_BINARY | ST_RTL_PARSED,precedence::assign);
+  (*this)["|="]  = symbol(ST_BINARY | ST_RTL_PARSED,precedence::assign);
+  (*this)["<<="] = symbol(ST_BINARY | ST_RTL_PARSED,precedence::assign);
+  (*this)[">>="] = symbol(ST_BINARY | ST_RTL_PARSED,precedence::assign);
   
-  symbols[","]  = symbol(ST_BINARY,precedence::comma,values_latter);
+  (*this)[","]  = symbol(ST_BINARY,precedence::comma,values_latter);
 }
@@ -92,9 +92,14 @@ namespace jdip {
   /// Our "own map type" to circumvent the lack of static code blocks in C++.
   struct symbol_table: public std::map<std::string, symbol> {
     symbol_table(); ///< Default constructor. Populates map.
+    /// Look up a symbol without inserting it; unknown symbols yield an empty symbol with no usage flags.
+    const symbol &get(const std::string &sym) const;
   };
-  extern symbol_table symbols; ///< The symbol table which will be searched while building ASTs.
-  typedef symbol_table::iterator symbol_iter; ///< Convenience typedef to the iterator type of the symbol table.
+  /// The symbol table which will be searched while building ASTs.
+  /// This table is populated at static initialization and is never modified afterward,
+  /// so it can be read from any number of parsing threads at once.
+  extern const symbol_table symbols;
+  typedef symbol_table::const_iterator symbol_iter; ///< Convenience typedef to the iterator type of the symbol table.
 }
 
 #endif
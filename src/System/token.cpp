@@ -23,29 +23,22 @@
 #include <API/context.h>
 using namespace jdip;
 
-#ifdef DEBUG_MODE
-  #define cdebuginit(x,y) ,x(y)
-#else
-  #define cdebuginit(x,y)
-#endif
-  
-token_t::token_t(): token_basics(type(TT_INVALID), file(""), linenum(), pos()) {}
-token_t::token_t(token_basics(TOKEN_TYPE t, const char* fn, int l, int p)): token_basics(type(t), file(fn), linenum(l), pos(p)) cdebuginit(def,NULL) {}
-token_t::token_t(token_basics(TOKEN_TYPE t, const char* fn, int l, int p), const char* ct, int ctl): token_basics(type(t), file(fn), linenum(l), pos(p)), content(ct, ctl) cdebuginit(def,NULL) {}
-token_t::token_t(token_basics(TOKEN_TYPE t, const char* fn, int l, int p), definition* d): token_basics(type(t), file(fn), linenum(l), pos(p)), def(d) {}
+token_t::token_t(): type(TT_INVALID), len(0), loc(0), str(NULL) {}
+token_t::token_t(TOKEN_TYPE t, source_location l): type(t), len(0), loc(l), str(NULL) {}
+token_t::token_t(TOKEN_TYPE t, source_location l, const char* ct, int ctl): type(t), len(ctl), loc(l), str(ct) {}
+token_t::token_t(TOKEN_TYPE t, source_location l, definition* d): type(t), len(0), loc(l), def(d) {}
+
+void token_t::locate(string &filename, int &line, int &pos) const {
+  resolve_source(loc, filename, line, pos);
+}
 
 void token_t::report_error(error_handler *herr, std::string error) const
 {
+  if (!herr->wants(DS_ERROR, DIAG_OTHER))
+    return;
   string fn; // Default values for non-existing info members
   int l = -1, p = -1;
-  
-  // Overwrite those which exist
-  token_basics(p = -1,
-    fn = (const char*)file,
-    l = linenum,
-    p = pos
-  );
-  
+  locate(fn, l, p);
   herr->error(error, fn, l, p);
 }
 
@@ -118,27 +111,23 @@ static struct token_info_c {
 #include <cstdio>
 void token_t::report_errorf(error_handler *herr, std::string error) const
 {
+  if (!herr->wants(DS_ERROR, DIAG_SYNTAX))
+    return;
   string fn; // Default values for non-existing info members
   int l = -1, p = -1;
-  
-  // Overwrite those which exist
-  token_basics(p = -1,
-    fn = (const char*)file,
-    l = linenum,
-    p = pos
-  );
+  locate(fn, l, p);
   
   size_t f;
-  string str = token_info.name[type];
-  f = str.find("%s");
+  string name = token_info.name[type];
+  f = name.find("%s");
   while (f != string::npos) {
-    str.replace(f,2,string((const char*)content.str,content.len));
-    f = str.find("%s");
+    name.replace(f,2,toString());
+    f = name.find("%s");
   }
   
   f = error.find("%s");
   while (f != string::npos) {
-    error.replace(f,2,str);
+    error.replace(f,2,name);
     f = error.find("%s");
   }
   
@@ -155,15 +144,61 @@ void token_t::report_errorf(error_handler *herr, std::string error) const
 }
 void token_t::report_warning(error_handler *herr, std::string error) const
 {
+  if (!herr->wants(DS_WARNING, DIAG_OTHER))
+    return;
   string fn; // Default values for non-existing info members
   int l = -1, p = -1;
-  
-  // Overwrite those which exist
-  token_basics(p = -1,
-    fn = (const char*)file,
-    l = linenum,
-    p = pos
-  );
+  locate(fn, l, p);
   
   herr->warning(error, fn, l, p);
 }
+
+void token_t::report(error_handler *herr, diagnostic &d) const {
+  resolve_source(loc, d.file, d.line, d.pos);
+  herr->report(d);
+}
+void token_t::report_error(error_handler *herr, const char *error, diagnostic_id id) const {
+  if (!herr->wants(DS_ERROR, id))
+    return;
+  diagnostic d(DS_ERROR, id, error);
+  report(herr, d);
+}
+void token_t::report_error(error_handler *herr, diagnostic_id id, const char *format, const std::string &arg) const {
+  if (!herr->wants(DS_ERROR, id))
+    return;
+  diagnostic d(DS_ERROR, id, format);
+  report(herr, d.arg(arg));
+}
+void token_t::report_error(error_handler *herr, diagnostic_id id, const char *format, const std::string &arg, long num1, long num2) const {
+  if (!herr->wants(DS_ERROR, id))
+    return;
+  diagnostic d(DS_ERROR, id, format);
+  report(herr, d.arg(arg).arg(num1).arg(num2));
+}
+void token_t::report_errorf(error_handler *herr, const char *error) const
+{
+  if (!herr->wants(DS_ERROR, DIAG_SYNTAX))
+    return;
+  
+  // Name the token in place, as report_errorf above would, but into the diagnostic's own storage
+  char name[diagnostic::text_size];
+  size_t n = 0;
+  const string &desc = token_info.name[type];
+  for (size_t i = 0; i < desc.length() and n < sizeof name; ++i)
+    if (desc[i] == '%' and i + 1 < desc.length() and desc[i+1] == 's') {
+      for (size_t j = 0; j < len and n < sizeof name; ++j)
+        name[n++] = str[j];
+      ++i;
+    }
+    else
+      name[n++] = desc[i];
+  
+  diagnostic d(DS_ERROR, DIAG_SYNTAX, error);
+  report(herr, d.arg(name, n));
+}
+void token_t::report_warning(error_handler *herr, const char *error) const {
+  if (!herr->wants(DS_WARNING, DIAG_OTHER))
+    return;
+  diagnostic d(DS_WARNING, DIAG_OTHER, error);
+  report(herr, d);
+}
@@ -25,6 +25,7 @@
 #define _TOKEN__H
 
 #include <string>
+#include <System/source_map.h>
 
 namespace jdip {
   enum TOKEN_TYPE {
@@ -117,74 +118,55 @@ namespace jdip {
     
     First and foremost, the structure denotes the type of the token. If that
     type is insufficient to discern the text of the token, the text is included
-    as well in the \c token_t::extra member. Otherwise, there is little point
-    to maintaining a pointer to that information in memory.
+    as well, in \c token_t::str and \c token_t::len.
     
     If the type of the token is a declarator or other sort of object backed by
-    a \c definition, then \c token_t::extra member will contain a \c definition*.
+    a \c definition, then \c token_t::def will contain a \c definition* instead;
+    the two share storage, so the text of such a token is no longer available.
     
-    For reasons of error reporting, the structure also contains information on
-    the origin of the token: the filename, the line number, and the position.
+    For reasons of error reporting, the structure also records where the token
+    was read, as a \c source_location. This is only resolved into a filename,
+    line number, and position when an error is actually reported.
+    
+    Tokens are copied by value through the whole parser, so this is kept to
+    sixteen bytes on 64-bit systems.
   **/
   struct token_t {
-    TOKEN_TYPE type; ///< The type of this token
-    
-    /// Construct a new, invalid token.
-    token_t();
-    #ifndef NO_ERROR_REPORTING
-      /// Log the name of the file from which this token was read.
-      volatile const char* file;
-      /// Log the line on which this token was named in the file.
-      int linenum;
-      #ifndef NO_ERROR_POSITION
-        /// We are logging positions for precise error reporting.
-        int pos;
-        
-        /// Construct a new token with the file, line number, and position in which it was declared.
-        #define full_token_constructor_parameters int, const char*, int, int
-        /// Wrapper to the token_t constructor which can ignore removed attributes.
-        #define token_basics(type,filename,line,pos) type,filename,line,pos
-      #else
-        /// Wrapper to the token_t constructor which can ignore removed attributes.
-        #define token_basics(type,filename,line,pos) type,filename,line
-        /// Construct a new token with the file and line number in which it was declared.
-        #define full_token_constructor_parameters int, const char*, int
-      #endif
-      /// Construct a new token without origin information.
-      token_t(TOKEN_TYPE t, const char* fn, int l);
-    #else
-      /// Wrapper to the token_t constructor which can ignore removed attributes.
-      #define token_basics(type,filename,line,pos) type
-      #define full_token_constructor_parameters TOKEN_TYPE, const char*, int
-    #endif
-    
-    /// Structure containing a pointer inside a string, and a length, representing a substring.
-    struct content {
+    TOKEN_TYPE type: 8; ///< The type of this token
+    /// The length of the string pointed to by \c str. Longer tokens are truncated.
+    unsigned len: 24;
+    /// Where this token was read, or zero if unknown; see \c resolve_source.
+    source_location loc;
+    union {
       /// A pointer to a substring of a larger buffer of code. NEITHER is null-terminated!
       /// This pointer is to be considered volatile as the buffer belongs to the system and
       /// can be modified or freed as soon as the file is closed. As such, any use of it must
       /// be made before the file is closed.
       volatile const char* str;
-      
-      /// The length of the string pointed to by \c content.
-      int len;
-      
-      /// Get the string contents of this token: This operation is somewhat costly.
-      inline string toString() { return string((const char*)str,len); }
-      
-      inline content() {}
-      inline content(const char* s, int l): str(s), len(l) {}
-    } content;
-    
-    /// For types, namespace-names, etc., the definition by which the type of this token was determined.
-    definition* def;
-    
-    /// Construct a token with the requested amount of information.
-    token_t(token_basics(TOKEN_TYPE t, const char* fn, int l, int p));
+      /// For types, namespace-names, etc., the definition by which the type of this token was determined.
+      definition* def;
+    };
+    
+    /// Get the string contents of this token: This operation is somewhat costly.
+    inline string toString() const { return string((const char*)str,len); }
+    
+    /// Construct a new, invalid token.
+    token_t();
+    /// Construct a token read from the given location.
+    token_t(TOKEN_TYPE t, source_location l);
     /// Construct a token with extra information regarding its content.
-    token_t(token_basics(TOKEN_TYPE t, const char* fn, int l, int p), const char*, int);
+    token_t(TOKEN_TYPE t, source_location l, const char*, int);
     /// Construct a token with extra information regarding its definition.
-    token_t(token_basics(TOKEN_TYPE t, const char* fn, int l, int p), definition*);
+    token_t(TOKEN_TYPE t, source_location l, definition*);
+    
+    /**
+      Look up where this token was read.
+      If no information is available, then the given values are left alone.
+      @param filename  Set to the name of the file the token was read from.
+      @param line      Set to the line on which it was read.
+      @param pos       Set to its position in that line.
+    **/
+    void locate(string &filename, int &line, int &pos) const;
     
     /**
       Pass error information to an error handler.
@@ -208,6 +190,56 @@ namespace jdip {
       @param error The text of the error.
     **/
     void report_warning(error_handler *herr, std::string error) const;
+    
+    /**
+      Pass an error which needs no formatting to an error handler, as a diagnostic.
+      Nothing is done unless the handler wants it; see \c error_handler::wants.
+      @param herr  The error_handler which will receive this notification.
+      @param error The text of the error, in static storage.
+      @param id    The kind of error.
+    **/
+    void report_error(error_handler *herr, const char *error, diagnostic_id id = DIAG_OTHER) const;
+    /**
+      Pass an error about something named to an error handler, as a diagnostic.
+      Nothing is done unless the handler wants it; see \c error_handler::wants.
+      @param herr    The error_handler which will receive this notification.
+      @param id      The kind of error.
+      @param format  The text of the error, in static storage, with %s for the name.
+      @param arg     The name.
+    **/
+    void report_error(error_handler *herr, diagnostic_id id, const char *format, const std::string &arg) const;
+    /// As above, with two counts besides the name, for %d in the format.
+    void report_error(error_handler *herr, diagnostic_id id, const char *format, const std::string &arg, long num1, long num2) const;
+    /**
+      Pass a \c DIAG_SYNTAX error to an error handler, inserting the token name in place of %s.
+      The name is captured, but the message is not formatted until the handler asks.
+      @param herr  The error_handler which will receive this notification.
+      @param error The text of the error, in static storage; use %s for token name.
+    **/
+    void report_errorf(error_handler *herr, const char *error) const;
+    /**
+      Pass a warning which needs no formatting to an error handler, as a \c DIAG_OTHER.
+      @param herr  The error_handler which will receive this notification.
+      @param error The text of the warning, in static storage.
+    **/
+    void report_warning(error_handler *herr, const char *error) const;
+    /**
+      Locate a diagnostic at this token, and pass it to an error handler. The caller is
+      to have asked \c error_handler::wants first, before capturing anything.
+      @param herr  The error_handler which will receive this notification.
+      @param d     The diagnostic, whose location is set.
+    **/
+    void report(error_handler *herr, diagnostic &d) const;
+  };
+  
+  /**
+    A token of the definiens of a macro, read once when the macro is first expanded.
+    See \c jdip::macro_type::get_tokens.
+  **/
+  struct macro_token {
+    token_t token; ///< The token; its content points into the definiens kept by the macro.
+    int arg; ///< The index of the parameter this token names, or -1 if it names none.
+    macro_token(const token_t &t, int a = -1); ///< Construct from a token and the index of the parameter it names.
   };
 }
 
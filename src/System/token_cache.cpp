@@ -0,0 +1,106 @@
+/**
+ * @file token_cache.cpp
+ * @brief Source implementing the cache of the raw tokens of each #included file.
+ *
+ * @section License
+ *
+ * Copyright (C) 2012 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include "token_cache.h"
+#include <map>
+#include <cstring>
+#include <pthread.h>
+#include <System/lex_cpp.h>
+#include <System/source_map.h>
+#include <General/atomics.h>
+
+using namespace std;
+using namespace jdip;
+
+namespace {
+  typedef map<string, raw_file*> file_map; ///< Maps the path of each file to the entry for its latest text.
+
+  pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER; ///< Held while anything below is used.
+  file_map latest; ///< The entry for the latest text of each file, each held by the cache.
+}
+
+size_t jdip::hash_text(const char *text, size_t length) {
+  unsigned a = 2166136261u, b = 16777619u;
+  size_t i = 0;
+  for (; i + 8 <= length; i += 8) {
+    unsigned w[2];
+    memcpy(w, text + i, 8);
+    a = (a ^ w[0]) * 0x9E3779B1u, a ^= a >> 15;
+    b = (b ^ w[1]) * 0x85EBCA77u, b ^= b >> 13;
+  }
+  for (; i < length; ++i)
+    a = (a ^ (unsigned char)text[i]) * 16777619u;
+  return (size_t)a * 31 + b + (size_t)length * 0x27D4EB2Du;
+}
+
+const raw_file *jdip::cache_tokens(const string &path, llreader &file)
+{
+  const size_t hash = hash_text(file.data, file.length);
+  pthread_mutex_lock(&cache_lock);
+  file_map::iterator it = latest.find(path);
+  if (it != latest.end() and it->second->hash == hash and it->second->text.length == file.length) {
+    const raw_file *res = it->second;
+    retain_tokens(res);
+    pthread_mutex_unlock(&cache_lock);
+    // The hash only rules most changes out; the entry is reused only if every byte matches
+    if (!memcmp(res->text.data, file.data, file.length))
+      return res;
+    release_tokens(res);
+  }
+  else
+    pthread_mutex_unlock(&cache_lock);
+
+  // Scan the file without holding the lock; if another thread scans it at the same time, the last to finish is kept
+  raw_file *res = new raw_file();
+  res->path = path;
+  res->hash = hash;
+  res->text.consume(file);
+  lexer_cpp::scan_raw(res->text.data, res->text.length, *res);
+  find_line_breaks(res->text.data, res->text.length, res->breaks);
+
+  retain_tokens(res);
+  pthread_mutex_lock(&cache_lock);
+  raw_file *&entry = latest[path];
+  const raw_file *replaced = entry;
+  entry = res;
+  pthread_mutex_unlock(&cache_lock);
+  if (replaced)
+    release_tokens(replaced);
+  return res;
+}
+
+void jdip::retain_tokens(const raw_file *entry) {
+  quick::atomic_inc(entry->refc);
+}
+void jdip::release_tokens(const raw_file *entry) {
+  if (!quick::atomic_dec(entry->refc))
+    delete entry;
+}
+
+void jdip::clear_token_cache()
+{
+  pthread_mutex_lock(&cache_lock);
+  file_map held;
+  held.swap(latest);
+  pthread_mutex_unlock(&cache_lock);
+  for (file_map::iterator it = held.begin(); it != held.end(); ++it)
+    release_tokens(it->second);
+}
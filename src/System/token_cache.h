@@ -0,0 +1,90 @@
+/**
+ * @file token_cache.h
+ * @brief Header declaring the cache of the raw tokens of each #included file.
+ *
+ * The tokens a file holds, before any macro is expanded or directive obeyed, depend only on
+ * its text. Each file #included by any lexer is therefore split into tokens only once, and
+ * the result is kept, keyed by the path of the file and a hash of its text. Later lexers
+ * including the same file replay those tokens instead of scanning its characters; they read
+ * by hand only the directives, and the few places where scanning reports a problem.
+ *
+ * The cache is shared by every lexer, on every thread. Entries are never changed once they
+ * are made, and are freed once neither the cache nor any lexer or memo holds them.
+ *
+ * @section License
+ *
+ * Copyright (C) 2012 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef _TOKEN_CACHE__H
+#define _TOKEN_CACHE__H
+
+#include <string>
+#include <vector>
+#include <General/llreader.h>
+
+namespace jdip {
+  /// A token as it is kept in the cache: where it lies in its file, and its type.
+  struct raw_token {
+    unsigned offset; ///< The position in the file of the first character of the token.
+    unsigned len: 24; ///< The number of characters in the token.
+    /// The \c TOKEN_TYPE of the token, or \c TT_INVALID where the lexer must read the text by hand:
+    /// at each pound sign, and at each place where reading the text reports an error.
+    unsigned type: 8;
+  };
+
+  /// Everything cached about the text of one file.
+  struct raw_file {
+    /// The number of holders of this entry: the cache, while this is the latest text of its file,
+    /// and each lexer and memo using it. It is freed once none are left. Lexers on different threads
+    /// may share an entry, so this count must only be modified through \c retain_tokens and \c release_tokens.
+    mutable volatile unsigned refc;
+    std::string path; ///< The path of the file.
+    /// A hash of the text of the file when it was read. The text may be mapped from the file, and so
+    /// change with it; comparing the text alone would not notice a file rewritten where it lies.
+    size_t hash;
+    llreader text; ///< The text of the file, into which the tokens of lexers replaying this entry point.
+    std::vector<raw_token> tokens; ///< Every token in the text, in order, including those in directives.
+    /// The offset of each pound sign which is the first thing on its line, outside any comment;
+    /// that is, of each directive which a lexer skipping a false conditional would stop at.
+    std::vector<unsigned> directives;
+    /// The offset of each place where reading the text reports an error, as marked in \c tokens.
+    std::vector<unsigned> errors;
+    std::vector<unsigned> breaks; ///< The offset of each line break in the text, as given to \c open_source.
+    raw_file(): refc(1), hash(0) {} ///< Construct held once, by whoever made the entry.
+  };
+
+  /** Find the cached tokens of a file which has just been opened, splitting its text into
+      tokens and caching them if its latest entry does not hold the same text. The entry it
+      replaces is released by the cache, and freed once nothing else holds it.
+      @param path  The path of the file, as it was opened.
+      @param file  The open file. If its text is cached anew, the reader is consumed by the cache;
+                   otherwise, it is left as it was, and can be closed in favor of the cached text.
+      @return Returns the entry, whose text the caller should read instead of its own. It is
+              retained for the caller, who must give it to \c release_tokens when done with it. **/
+  const raw_file *cache_tokens(const std::string &path, llreader &file);
+  /// Add a holder to an entry; safe to call while other threads retain or release it.
+  void retain_tokens(const raw_file *entry);
+  /// Remove a holder from an entry, freeing it if none are left; safe to call while other threads retain or release it.
+  void release_tokens(const raw_file *entry);
+
+  /// Hash the text of a file, eight bytes at a time in two independent lanes.
+  size_t hash_text(const char *text, size_t length);
+
+  /// Release the cache's hold on every entry; each is freed once no lexer or memo holds it.
+  void clear_token_cache();
+}
+
+#endif
@@ -14,7 +14,11 @@
 */
 
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <sstream>
 #include <unistd.h>
 using namespace std;
 #include <API/jdi.h>
@@ -23,6 +27,25 @@ using namespace std;
 #include <General/llreader.h>
 #include <General/quickstack.h>
 #include "debug_lexer.h"
+#include "thread_stress.h"
+#include "macro_stress.h"
+#include "macro_file_bench.h"
+#include "lex_bench.h"
+#include "memo_bench.h"
+#include "reparse_bench.h"
+#include "watch_bench.h"
+#include "declaration_bench.h"
+#include "harvest_bench.h"
+#include "retention_bench.h"
+#include "diagnostic_bench.h"
+#include "bench_util.h"
+#include "limit_stress.h"
+#include "merge_stress.h"
+#include "image_stress.h"
+#include "parse_bench.h"
+#include "scaling_bench.h"
+#include "stats_bench.h"
+#include "stress_gen.h"
 
 #ifdef linux
   #include <sys/time.h>
@@ -50,8 +73,62 @@ static void putcap(string cap) {
 
 void do_cli(context &ct);
 
-int main() {
+/** Run the end-to-end parse benchmark alone, before anything is added to the builtin context.
+    @param argc  The number of arguments, including the program and "--bench".
+    @param argv  The number of timed parses of each kind, then the file to write JSON to; by default,
+                 twenty parses, written to standard output.
+    @return Returns the exit status of the program. **/
+static int run_benchmark(int argc, char **argv) {
+  const unsigned runs = argc > 2? strtoul(argv[2], NULL, 10) : 20;
+  bool ok;
+  if (argc > 3) {
+    ofstream json(argv[3]);
+    if (!json) {
+      cerr << "Could not open " << argv[3] << " to write the results of the benchmark." << endl;
+      return 1;
+    }
+    ok = bench_parse(runs, json);
+  }
+  else
+    ok = bench_parse(runs, cout);
+  clean_up();
+  return !ok;
+}
+
+/** Write stress headers for other tools to parse, as \c write_stress_headers does.
+    @param argc  The number of arguments, including the program and "--stress".
+    @param argv  The directory to write to, then the size along each axis, as "axis=size".
+    @return Returns the exit status of the program. **/
+static int generate_stress(int argc, char **argv) {
+  if (argc < 3) {
+    cerr << "Usage: " << argv[0] << " --stress <directory> [axis=size]..." << endl << "Axes:";
+    for (int i = 0; i < STRESS_AXIS_COUNT; ++i)
+      cerr << " " << stress_axis_name((stress_axis)i);
+    cerr << endl;
+    return 1;
+  }
+  stress_params params;
+  const string bad = parse_stress_params(vector<string>(argv + 3, argv + argc), params);
+  if (!bad.empty()) {
+    cerr << "Could not read the sizes of the stress headers: " << bad << endl;
+    return 1;
+  }
+  vector<string> files;
+  const size_t bytes = write_stress_headers(params, argv[2], files);
+  if (!bytes) {
+    cerr << "Could not write the stress headers to " << argv[2] << endl;
+    return 1;
+  }
+  cout << "Wrote " << files.size() << " files, " << bytes << " bytes, beginning with " << files[0] << endl;
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  if (argc > 1 and !strcmp(argv[1], "--stress"))
+    return generate_stress(argc, argv);
   initialize();
+  if (argc > 1 and !strcmp(argv[1], "--bench"))
+    return run_benchmark(argc, argv);
   cout << endl << endl;
   
   putcap("Test simple macros");
@@ -81,7 +158,7 @@ int main() {
     builtin->add_search_directory("c:\\mingw\\include");
     builtin->add_search_directory("c:\\mingw/lib/gcc/mingw32/4.6.1/include-fixed");
     
-    llreader macro_reader("test/defines_custom.txt");
+    const char *macro_file = "test/defines_custom.txt";
   #else
     #ifdef __WIN32__
       builtin->add_search_directory("c:\\mingw/lib/gcc/mingw32/4.6.1/include/c++");
@@ -91,7 +168,7 @@ int main() {
       builtin->add_search_directory("c:\\mingw\\include");
       builtin->add_search_directory("c:\\mingw/lib/gcc/mingw32/4.6.1/include-fixed");
       
-      llreader macro_reader("test/defines_mingw.txt");
+      const char *macro_file = "test/defines_mingw.txt";
     #else
       builtin->add_search_directory("/usr/include/c++/4.7");
       builtin->add_search_directory("/usr/include/x86_64-linux-gnu/c++/4.7");
@@ -103,14 +180,19 @@ int main() {
       builtin->add_search_directory("/usr/include");
       builtin->add_search_directory("/home/josh/Projects/ENIGMA/ENIGMAsystem/SHELL");
       
-      llreader macro_reader("test/defines_linux.txt");
+      const char *macro_file = "test/defines_linux.txt";
     #endif
   #endif
   
-  if (macro_reader.is_open())
-    builtin->parse_C_stream(macro_reader, "defines.txt");
-  else
-    cout << "ERROR: Could not open GCC macro file for parse!" << endl;
+  {
+    start_time(ts);
+    int res = builtin->read_macros(macro_file);
+    end_time(te,tel);
+    if (res)
+      cout << "ERROR: Could not open GCC macro file for parse!" << endl;
+    else
+      cout << "Read " << builtin->get_macros().size() << " macros in " << tel << " microseconds." << endl;
+  }
   
   putcap("Test parser");
   llreader f("test/test.cc");
@@ -159,7 +241,6 @@ static char getch() {
 }
 #endif
 
-#include <cstring>
 #include <System/lex_cpp.h>
 #include <General/parse_basics.h>
 
@@ -221,6 +302,7 @@ void do_cli(context &ct) {
               case DEF_PROTECTED: flagnames[DEF_PROTECTED] = "DEF_PROTECTED";
               case DEF_INCOMPLETE: flagnames[DEF_INCOMPLETE] = "DEF_INCOMPLETE";
               case DEF_ATOMIC: flagnames[DEF_ATOMIC] = "DEF_ATOMIC";
+              case DEF_REFERENCED: flagnames[DEF_REFERENCED] = "DEF_REFERENCED";
               default: ;
             }
             bool hadone = false;
@@ -282,16 +364,172 @@ void do_cli(context &ct) {
         } else cout << "Bailing." << endl;
       } break;
     
+    case 'p': {
+        cout << "Enter the files to parse, separated by spaces:" << endl << ">> " << flush;
+        char buf[4096]; cin.getline(buf, 4096);
+        vector<string> files;
+        for (char *tok = strtok(buf, " "); tok; tok = strtok(NULL, " "))
+          files.push_back(tok);
+        context batch;
+        parse_report rep;
+        int failures = batch.parse_C_files(files, 0, def_error_handler, &rep);
+        for (size_t i = 0; i < rep.files.size(); ++i)
+          cout << "  " << rep.files[i].filename << ": " << (rep.files[i].result? "FAILED" : "parsed") << " in "
+               << rep.files[i].parse_usec << " microseconds with " << rep.files[i].error_count << " errors" << endl;
+        cout << "Parsed " << files.size() << " files on " << rep.thread_count << " threads in " << rep.parse_usec
+             << " microseconds; merged in " << rep.merge_usec << " microseconds; " << failures << " failed." << endl;
+      } break;
+    
+    case 'i': {
+        cout << "Enter the file to write an image to:" << endl << ">> " << flush;
+        char buf[4096]; cin.getline(buf, 4096);
+        const unsigned long save_start = jdip::microtime();
+        int failed = ct.save_image(buf);
+        const unsigned long save_usec = jdip::microtime() - save_start;
+        if (failed) { cout << "Could not write image." << endl; break; }
+        context loaded;
+        const unsigned long load_start = jdip::microtime();
+        failed = loaded.load_image(buf, def_error_handler);
+        const unsigned long load_usec = jdip::microtime() - load_start;
+        if (failed) { cout << "Could not read image back." << endl; break; }
+        stringstream before, after;
+        ct.output_definitions(before);
+        loaded.output_definitions(after);
+        cout << "Wrote image in " << save_usec << " microseconds; read it back in " << load_usec << " microseconds. "
+             << (before.str() == after.str()? "Definitions match." : "Definitions DIFFER.") << endl;
+        cout << (test_image_corruption(ct)? "Image corruption test passed." : "Image corruption test FAILED.") << endl;
+      } break;
+    
+    case 't':
+        cout << (test_thread_stress()? "Thread stress test passed." : "Thread stress test FAILED.") << endl;
+        cout << (test_snapshot_stress()? "Snapshot stress test passed." : "Snapshot stress test FAILED.") << endl;
+        cout << (test_source_stress()? "Source stress test passed." : "Source stress test FAILED.") << endl;
+      break;
+    
+    case 'b':
+        cout << (test_macro_stress()? "Macro stress test passed." : "Macro stress test FAILED.") << endl;
+      break;
+    
+    case 'l': {
+        cout << "Enter the files to lex, separated by spaces:" << endl << ">> " << flush;
+        char buf[4096]; cin.getline(buf, 4096);
+        vector<string> files;
+        for (char *tok = strtok(buf, " "); tok; tok = strtok(NULL, " "))
+          files.push_back(tok);
+        cout << (bench_lex_only(files)? "Lex benchmark passed." : "Lex benchmark FAILED.") << endl;
+      } break;
+    
+    case 'o': {
+        cout << "Enter the files to lex, separated by spaces:" << endl << ">> " << flush;
+        char buf[4096]; cin.getline(buf, 4096);
+        vector<string> files;
+        for (char *tok = strtok(buf, " "); tok; tok = strtok(NULL, " "))
+          files.push_back(tok);
+        cout << (bench_header_memo(files)? "Header memo benchmark passed." : "Header memo benchmark FAILED.") << endl;
+      } break;
+    
+    case 'u': {
+        cout << "Enter the files to track, separated by spaces:" << endl << ">> " << flush;
+        char buf[4096]; cin.getline(buf, 4096);
+        vector<string> files;
+        for (char *tok = strtok(buf, " "); tok; tok = strtok(NULL, " "))
+          files.push_back(tok);
+        cout << (bench_reparse(files)? "Reparse benchmark passed." : "Reparse benchmark FAILED.") << endl;
+      } break;
+    
+    case 'v': {
+        cout << "Enter a file of macro definitions (empty for test/defines_linux.txt):" << endl << ">> " << flush;
+        char buf[4096]; cin.getline(buf, 4096);
+        const string file = *buf? buf : "test/defines_linux.txt";
+        cout << (bench_read_macros(file)? "Macro file benchmark passed." : "Macro file benchmark FAILED.") << endl;
+      } break;
+    
+    case 'w': {
+        cout << "Enter the files to watch, separated by spaces:" << endl << ">> " << flush;
+        char buf[4096]; cin.getline(buf, 4096);
+        vector<string> files;
+        for (char *tok = strtok(buf, " "); tok; tok = strtok(NULL, " "))
+          files.push_back(tok);
+        cout << (bench_watch(files)? "Watch benchmark passed." : "Watch benchmark FAILED.") << endl;
+      } break;
+    
+    case 'a': {
+        cout << "Enter the files to parse, separated by spaces:" << endl << ">> " << flush;
+        char buf[4096]; cin.getline(buf, 4096);
+        vector<string> files;
+        for (char *tok = strtok(buf, " "); tok; tok = strtok(NULL, " "))
+          files.push_back(tok);
+        cout << (bench_declarations(files)? "Declaration benchmark passed." : "Declaration benchmark FAILED.") << endl;
+      } break;
+    
+    case 'g': {
+        cout << "Enter the files to harvest, separated by spaces:" << endl << ">> " << flush;
+        char buf[4096]; cin.getline(buf, 4096);
+        vector<string> files;
+        for (char *tok = strtok(buf, " "); tok; tok = strtok(NULL, " "))
+          files.push_back(tok);
+        cout << (bench_macro_harvest(files)? "Macro harvest benchmark passed." : "Macro harvest benchmark FAILED.") << endl;
+      } break;
+    
+    case 'j':
+        cout << (test_merge()? "Merge test passed." : "Merge test FAILED.") << endl;
+      break;
+    
+    case 'k': {
+        cout << "Enter the files to parse, separated by spaces:" << endl << ">> " << flush;
+        char buf[4096]; cin.getline(buf, 4096);
+        vector<string> files;
+        for (char *tok = strtok(buf, " "); tok; tok = strtok(NULL, " "))
+          files.push_back(tok);
+        cout << (bench_retention(files)? "Retention benchmark passed." : "Retention benchmark FAILED.") << endl;
+      } break;
+    
+    case 'n':
+        cout << (bench_diagnostics()? "Diagnostic benchmark passed." : "Diagnostic benchmark FAILED.") << endl;
+      break;
+    
+    case 'x':
+        cout << (test_parse_limits()? "Parse limit test passed." : "Parse limit test FAILED.") << endl;
+      break;
+    
+    case 'y': {
+        cout << "Enter the number of sizes to parse along each axis (empty for 6):" << endl << ">> " << flush;
+        char buf[64]; cin.getline(buf, 64);
+        const unsigned steps = *buf? strtoul(buf, NULL, 10) : 6;
+        cout << (bench_scaling(steps)? "Scaling benchmark passed." : "Scaling benchmark FAILED.") << endl;
+      } break;
+    
+    case 'z':
+        cout << (bench_parse_stats()? "Parse stats benchmark passed." : "Parse stats benchmark FAILED.") << endl;
+      break;
+    
     case 'h':
       cout <<
+      "'a' Parse a list of files, reporting each declaration as it is read and freeing it, and compare memory use with keeping all\n"
+      "'b' Time the expansion of ever more deeply nested macro calls, checking their values\n"
       "'c' Coerce an expression, printing its type\n"
       "'d' Define a symbol, printing it recursively\n"
       "'e' Evaluate an expression, printing its result\n"
       "'f' Print flags for a given definition\n"
+      "'g' Parse a list of files in full and harvesting only macros, checking that both agree, reporting timings\n"
       "'h' Print this help information\n"
+      "'i' Write the parsed context to an image, read it back, and check that both agree, and that damaged images are refused\n"
+      "'j' Merge a forward declaration with a class body, and overloads declared apart, from files parsed in parallel and in turn\n"
+      "'k' Parse a list of files keeping everything and keeping nothing optional, comparing memory use\n"
+      "'l' Lex a list of files one token at a time and into token arrays, and scan their #includes, reporting timings\n"
       "'m' Define a macro, printing a breakdown of its definition\n"
+      "'n' Parse a header full of mistakes, reporting them as text, through a ring read on another thread, and muted, reporting timings\n"
+      "'o' Lex a list of files with and without memoized headers, checking that both agree, reporting timings\n"
       "'r' Render an AST representing an expression\n"
       "'s' Render an AST representing an expression and show it\n"
+      "'t' Parse in many contexts on many threads, read published snapshots during parses, and resolve source locations, checking that all agree\n"
+      "'u' Track a list of files, change the headers of a few more, and check that only what changed is parsed again\n"
+      "'v' Read a file of macro definitions directly and by lexing it, checking that both agree, reporting timings\n"
+      "'w' Watch a list of files, change the headers of a few more, and check that each change is published once\n"
+      "'p' Parse a list of files in parallel, reporting timings\n"
+      "'x' Parse code too long or too broken to finish, stopping it by each limit a parse may be given\n"
+      "'y' Parse generated stress headers at doubling sizes along each axis, printing how the time grows\n"
+      "'z' Parse a small corpus keeping per-phase, per-file and per-macro stats, checking them and reporting their cost\n"
       "'q' Quit this interface\n";
     break;
       
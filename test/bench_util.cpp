@@ -0,0 +1,73 @@
+/* Copyright (C) 2012 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <ctime>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include <malloc.h>
+#include <utime.h>
+#include <dirent.h>
+#include <unistd.h>
+#include "bench_util.h"
+using namespace std;
+
+size_t heap_in_use() {
+  #if defined(__GLIBC__) && defined(__GLIBC_PREREQ)
+    #if __GLIBC_PREREQ(2, 33)
+      return mallinfo2().uordblks;
+    #endif
+  #endif
+  return 0;
+}
+
+void write_file(const string &fn, const string &text, long age) {
+  { ofstream f(fn.c_str()); f << text; }
+  utimbuf t;
+  t.actime = t.modtime = time(NULL) + age;
+  utime(fn.c_str(), &t);
+}
+
+error_counter::error_counter(unsigned show, const char *in): errors(0), warnings(0), shown(show), what(in) {}
+void error_counter::error(string err, string filename, int line, int pos) {
+  if (errors++ < shown)
+    cerr << (what? string(what) + " error: " : string()) << filename << ":" << line << ":" << pos << ": " << err << endl;
+}
+
+temp_dir::temp_dir(const char *tag) {
+  string name = string("/tmp/jdi_") + tag + "_XXXXXX";
+  vector<char> buf(name.begin(), name.end());
+  buf.push_back(0);
+  if (mkdtemp(&buf[0]))
+    path = &buf[0];
+}
+temp_dir::~temp_dir() {
+  if (path.empty())
+    return;
+  // Names are gathered first, as removing entries while reading the directory may skip some
+  vector<string> names;
+  if (DIR *d = opendir(path.c_str())) {
+    while (dirent *e = readdir(d))
+      if (strcmp(e->d_name, ".") and strcmp(e->d_name, ".."))
+        names.push_back(e->d_name);
+    closedir(d);
+  }
+  for (size_t i = 0; i < names.size(); ++i)
+    remove(file(names[i]).c_str());
+  rmdir(path.c_str());
+}
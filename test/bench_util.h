@@ -0,0 +1,69 @@
+/* Copyright (C) 2012 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/** @file  bench_util.h
+    @brief Helpers shared by the benchmarks and stress tests. The wall clock they read is
+           \c jdip::microtime, from the parser's own batch pool. **/
+
+#ifndef _BENCH_UTIL__H
+#define _BENCH_UTIL__H
+
+#include <string>
+#include <API/error_reporting.h>
+#include <Parser/parse_batch.h>
+
+/// Read the number of bytes allocated and not yet freed, or zero where that can not be found.
+size_t heap_in_use();
+
+/** Write a file, and move its modification time away from now, as an editor saving it might.
+    @param fn    The name of the file.
+    @param text  What the file is to hold.
+    @param age   The number of seconds from now to date the file. **/
+void write_file(const std::string &fn, const std::string &text, long age = 0);
+
+/// Error handler which ignores everything reported to it.
+struct quiet_error_handler: jdi::error_handler {
+  void error(std::string, std::string, int, int) {}
+  void warning(std::string, std::string, int, int) {}
+};
+
+/// Error handler which counts errors and warnings, printing the first few errors to stderr.
+struct error_counter: jdi::error_handler {
+  unsigned errors; ///< The number of errors reported so far.
+  unsigned warnings; ///< The number of warnings reported so far.
+  unsigned shown; ///< The number of errors to print before counting the rest silently.
+  const char *what; ///< What the errors are found in, printed before each, or NULL.
+  void error(std::string err, std::string filename, int line, int pos);
+  void warning(std::string, std::string, int, int) { ++warnings; }
+  /** @param show  The number of errors to print before counting the rest silently.
+      @param in    What the errors are found in, such as "Stress header", or NULL. **/
+  error_counter(unsigned show = 0, const char *in = NULL);
+};
+
+/** A fresh directory under /tmp for a test's scratch files. It is removed when this is
+    destroyed, along with every file left in it. **/
+struct temp_dir {
+  std::string path; ///< The path of the directory, or empty if it could not be made.
+  /// Return the path of the named file in the directory.
+  std::string file(const std::string &name) const { return path + "/" + name; }
+  /// Make a directory named for the given tag, such as /tmp/jdi_memo_XXXXXX for "memo".
+  temp_dir(const char *tag);
+  ~temp_dir();
+  private:
+    temp_dir(const temp_dir&); ///< Not copyable; only one may remove the directory.
+    temp_dir &operator=(const temp_dir&); ///< Not copyable; only one may remove the directory.
+};
+
+#endif
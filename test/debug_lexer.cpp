@@ -23,6 +23,6 @@ jdip::token_t debug_lexer::get_token(jdi::error_handler *) {
     jdip::token_t res = tokens[0]; tokens.pop_front();
     return res;
   }
-  return jdip::token_t(jdip::TT_ENDOFCODE,0,0,0);
+  return jdip::token_t(jdip::TT_ENDOFCODE,0);
 }
 debug_lexer::~debug_lexer() {}
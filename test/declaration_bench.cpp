@@ -0,0 +1,165 @@
+/* Copyright (C) 2012 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <iostream>
+#include <sstream>
+using namespace std;
+#include <API/jdi.h>
+#include "bench_util.h"
+#include "declaration_bench.h"
+
+using namespace jdi;
+using jdip::microtime;
+
+/// Write down each declaration reported, consuming all of them if asked to.
+struct declaration_log: declaration_handler {
+  vector<string> names; ///< The scope path and name of each declaration, and its line.
+  bool consume; ///< Whether to claim every declaration as dealt with.
+  bool declared(const declaration &d) {
+    ostringstream ss;
+    const string path = d.scope_path();
+    ss << (path.empty()? "" : path + "::") << d.def->name << "@" << d.line;
+    names.push_back(ss.str());
+    return consume;
+  }
+  declaration_log(bool c): consume(c) {}
+};
+
+/// Counts declarations, writing each one's type out and consuming it, as a code generator might.
+struct declaration_counter: declaration_handler {
+  unsigned long count; ///< The number of declarations seen.
+  size_t text; ///< The total length of the types written out.
+  bool declared(const declaration &d) {
+    ++count;
+    text += d.type.toString().length();
+    return true;
+  }
+  declaration_counter(): count(0), text(0) {}
+};
+
+static const char declaration_code[] =
+  "namespace ns { int f(int); struct s { int m; }; }\n"
+  "typedef int myint;\n"
+  "int g(myint), h;\n"
+  "enum e { A, B };\n"
+  "template<typename T> struct tpl { T x; };\n"
+  "int body(int x) { return x; }\n"
+  "struct outer { int member; };\n"
+  "int g(myint);\n";
+
+/// The declarations above, in the order they finish; g is declared again last.
+static const char *const declaration_names[] = {
+  "ns::f@1", "ns::s@1", "myint@2", "g@3", "h@3", "e@4", "tpl@5", "body@6", "outer@7", "g@8"
+};
+
+/// Parse the code above, checking what is reported, and that what is consumed is kept or freed as asked.
+static bool check_declarations(bool consume, bool drop, quiet_error_handler &herr) {
+  declaration_log log(consume);
+  context ct;
+  ct.report_declarations(&log, drop);
+  llreader src(declaration_code, true);
+  ct.parse_C_stream(src, "declarations.cc", &herr);
+  
+  bool ok = true;
+  const vector<string> expected(declaration_names, declaration_names + sizeof(declaration_names) / sizeof(*declaration_names));
+  if (log.names != expected) {
+    cout << "Reported " << log.names.size() << " declarations, not " << expected.size() << ":";
+    for (size_t i = 0; i < log.names.size(); ++i) cout << " " << log.names[i];
+    cout << endl;
+    ok = false;
+  }
+  
+  const bool dropped = consume and drop;
+  definition_scope *global = ct.get_global();
+  const char *const kept[] = { "myint", "e", "tpl", "outer", "ns" }, *const freed[] = { "g", "h", "body" };
+  for (size_t i = 0; i < sizeof(kept) / sizeof(*kept); ++i)
+    if (global->members.find(kept[i]) == global->members.end())
+      cout << "`" << kept[i] << "' was not kept." << endl, ok = false;
+  for (size_t i = 0; i < sizeof(freed) / sizeof(*freed); ++i)
+    if ((global->members.find(freed[i]) == global->members.end()) != dropped)
+      cout << "`" << freed[i] << "' was " << (dropped? "kept" : "freed") << "." << endl, ok = false;
+  definition *ns = global->members["ns"];
+  if (ns and (ns->flags & DEF_SCOPE)) {
+    definition_scope *nss = (definition_scope*)ns;
+    if ((nss->members.find("f") == nss->members.end()) != dropped)
+      cout << "`ns::f' was " << (dropped? "kept" : "freed") << "." << endl, ok = false;
+  }
+  return ok;
+}
+
+/// Drop what a statement declares while another of its declarations still names it; what is named must be kept.
+static bool check_references(quiet_error_handler &herr) {
+  declaration_log log(true);
+  context ct;
+  ct.report_declarations(&log, true);
+  llreader src("int a, k(int), k(char c = a);\n", true);
+  ct.parse_C_stream(src, "references.cc", &herr);
+  
+  bool ok = true;
+  definition_scope *global = ct.get_global();
+  if (global->members.find("a") == global->members.end())
+    cout << "`a' was freed while a default argument named it." << endl, ok = false;
+  definition_scope::defiter k = global->members.find("k");
+  if (k == global->members.end() or !(k->second->flags & DEF_FUNCTION))
+    return cout << "`k' was not kept." << endl, false;
+  
+  // Writing out the overload's parameters reads the definition its default argument names
+  string types;
+  definition_function *f = (definition_function*)k->second;
+  for (definition_function::overload_iter it = f->overloads.begin(); it != f->overloads.end(); ++it) {
+    definition_function *o = it->second;
+    types += full_type(o->type, o->referencers, o->modifiers).toString() + ";";
+  }
+  if (types.find("= a") == string::npos)
+    cout << "The default argument of `k' was lost: " << types << endl, ok = false;
+  return ok;
+}
+
+bool bench_declarations(const vector<string> &files) {
+  quiet_error_handler herr;
+  bool ok = true;
+  ok &= check_declarations(false, false, herr);
+  ok &= check_declarations(true, false, herr);
+  ok &= check_declarations(false, true, herr);
+  ok &= check_declarations(true, true, herr);
+  ok &= check_references(herr);
+  
+  for (size_t i = 0; i < files.size(); ++i) {
+    size_t before = heap_in_use();
+    unsigned long start = microtime();
+    context *whole = new context();
+    llreader wf(files[i].c_str());
+    whole->parse_C_stream(wf, files[i].c_str(), &herr);
+    const unsigned long whole_usec = microtime() - start;
+    const long whole_bytes = (long)heap_in_use() - (long)before;
+    delete whole;
+    
+    declaration_counter counter;
+    before = heap_in_use();
+    start = microtime();
+    context *streamed = new context();
+    streamed->report_declarations(&counter, true);
+    llreader sf(files[i].c_str());
+    streamed->parse_C_stream(sf, files[i].c_str(), &herr);
+    const unsigned long streamed_usec = microtime() - start;
+    const long streamed_bytes = (long)heap_in_use() - (long)before;
+    delete streamed;
+    
+    cout << files[i] << ": " << counter.count << " declarations. Keeping every one: " << whole_bytes << " bytes in "
+         << whole_usec << " microseconds; consuming each as it is read: " << streamed_bytes << " bytes in "
+         << streamed_usec << " microseconds." << endl;
+  }
+  return ok;
+}
@@ -0,0 +1,25 @@
+/* Copyright (C) 2012 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string>
+#include <vector>
+
+/** Parse a little code with a \c jdi::declaration_handler, checking that each declaration at namespace
+    scope is reported once, with its scope and line, and that declarations the handler consumes are
+    freed when asked, and kept otherwise. Then parse the given files with and without a handler which
+    consumes everything it can, reporting what each leaves in memory.
+    @param files  The files to parse; the #include directories of the \c builtin context are searched.
+    @return Returns whether every declaration was reported and kept or freed as expected. **/
+bool bench_declarations(const std::vector<std::string> &files);
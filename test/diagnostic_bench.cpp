@@ -0,0 +1,175 @@
+/* Copyright (C) 2012 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <map>
+#include <cstdio>
+#include <sstream>
+#include <iostream>
+#include <sched.h>
+#include <pthread.h>
+using namespace std;
+#include <API/jdi.h>
+#include <General/atomics.h>
+#include "bench_util.h"
+#include "diagnostic_bench.h"
+
+using namespace jdi;
+using jdip::microtime;
+
+/// Write a header which repeats the same mistakes, in the lexer and in the parser, the given number of times.
+static string broken_header(unsigned stanzas) {
+  ostringstream res;
+  res << "#define PICK(a, b, c) a\n";
+  for (unsigned i = 0; i < stanzas; ++i)
+    res << "int v" << i << " = PICK(1);\n"
+        << "#bogus" << i << "\n"
+        << "int w" << i << " = ;\n"
+        << "#warning careful with " << i << "\n";
+  return res.str();
+}
+
+/// Render one report as a line, the same way whichever way it was reported.
+static string render(bool is_error, const string &msg, const string &filename, int line, int pos) {
+  char buf[64];
+  sprintf(buf, ":%d:%d: ", line, pos);
+  return (is_error? "ERROR " : "Warning ") + filename + buf + msg;
+}
+
+/// Error handler which keeps each report as text.
+struct text_collector: error_handler {
+  vector<string> lines;
+  void error(string err, string filename, int line, int pos) { lines.push_back(render(true, err, filename, line, pos)); }
+  void warning(string err, string filename, int line, int pos) { lines.push_back(render(false, err, filename, line, pos)); }
+};
+
+/// The reading end of a ring: formats each diagnostic taken from it.
+struct ring_reader {
+  diagnostic_ring *ring;
+  vector<string> lines;
+  map<unsigned, string> names; ///< The name of each file seen, so the source map is asked once for each.
+  volatile int finished;
+  void read(const diagnostic &d) {
+    map<unsigned, string>::iterator it = names.find(d.file);
+    if (it == names.end())
+      it = names.insert(make_pair(d.file, d.filename())).first;
+    lines.push_back(render(d.severity == DS_ERROR, d.message(), it->second, d.line, d.pos));
+  }
+  /// Read everything now in the ring, returning whether there was anything.
+  bool drain() {
+    diagnostic d;
+    bool any = false;
+    while (ring->pop(d))
+      read(d), any = true;
+    return any;
+  }
+  /// The body of a thread reading as the ring is filled, until told the parse is over.
+  static void *run(void *self) {
+    ring_reader *rr = (ring_reader*)self;
+    for (;;) {
+      const bool last = quick::atomic_get(rr->finished); // Anything stored before this was set is read below
+      if (!rr->drain() and !last)
+        sched_yield(); // Let the parse have the processor, if it must share one with us
+      if (last)
+        return NULL;
+    }
+  }
+  ring_reader(diagnostic_ring *r): ring(r), finished(0) {}
+};
+
+/** Check that what a ring gave is what was reported as text, in order, with only what the ring
+    dropped missing, printing the first difference. **/
+static bool same_reports(const text_collector &text, const ring_reader &reader, const char *how) {
+  size_t t = 0;
+  for (size_t r = 0; r < reader.lines.size(); ++r, ++t) {
+    while (t < text.lines.size() and text.lines[t] != reader.lines[r]) ++t;
+    if (t >= text.lines.size()) {
+      cout << "A ring " << how << " gave `" << reader.lines[r] << "', which was not reported as text, or not in that order." << endl;
+      return false;
+    }
+  }
+  if (reader.lines.size() + reader.ring->dropped() != text.lines.size()) {
+    cout << "A ring " << how << " gave " << reader.lines.size() << " diagnostics and dropped " << reader.ring->dropped()
+         << "; " << text.lines.size() << " were reported as text." << endl;
+    return false;
+  }
+  return true;
+}
+
+/// Parse the given code into a fresh context, returning the microseconds taken.
+static unsigned long parse(string &code, error_handler *herr) {
+  context ct;
+  llreader f;
+  f.encapsulate(code);
+  const unsigned long start = microtime();
+  ct.parse_C_stream(f, "broken.h", herr);
+  return microtime() - start;
+}
+
+bool bench_diagnostics(unsigned stanzas) {
+  string code = broken_header(stanzas);
+  bool agree = true;
+  
+  diagnostic_ring muted(16);
+  for (int i = 0; i < DIAG_ID_COUNT; ++i)
+    muted.mute(DS_ERROR, diagnostic_id(i)), muted.mute(DS_WARNING, diagnostic_id(i));
+  parse(code, &muted); // Warm up, so that the first parse timed does not pay to fill the caches
+  
+  text_collector text;
+  const unsigned long text_usec = parse(code, &text);
+  
+  if (text.lines.size() < stanzas * 5u) {
+    cout << "Only " << text.lines.size() << " diagnostics were reported; expected " << stanzas * 5 << "." << endl;
+    agree = false;
+  }
+  
+  // Capture everything, and format it after; nothing should be dropped
+  diagnostic_ring whole(text.lines.size());
+  ring_reader after(&whole);
+  const unsigned long ring_usec = parse(code, &whole);
+  unsigned long start = microtime();
+  after.drain();
+  const unsigned long format_usec = microtime() - start;
+  agree &= same_reports(text, after, "read after the parse");
+  if (whole.dropped())
+    cout << "A ring with room for everything dropped " << whole.dropped() << " diagnostics." << endl, agree = false;
+  
+  // Format while capturing, on another thread, through a ring too small to hold everything
+  diagnostic_ring small(1024);
+  ring_reader during(&small);
+  pthread_t thread;
+  if (pthread_create(&thread, NULL, ring_reader::run, &during)) {
+    cout << "Could not start a thread to read the ring." << endl;
+    return false;
+  }
+  start = microtime();
+  parse(code, &small);
+  quick::atomic_set(during.finished, 1);
+  pthread_join(thread, NULL);
+  const unsigned long during_usec = microtime() - start;
+  agree &= same_reports(text, during, "read during the parse");
+  
+  const unsigned long muted_usec = parse(code, &muted);
+  diagnostic d;
+  if (muted.pop(d) or muted.dropped()) {
+    cout << "Muting every kind of diagnostic still captured `" << d.message() << "'." << endl;
+    agree = false;
+  }
+  
+  cout << "Reported " << text.lines.size() << " diagnostics as text in " << text_usec << " microseconds; "
+       << "captured them in " << ring_usec << " and formatted them in " << format_usec << "; "
+       << "captured and formatted them at once in " << during_usec << ", dropping " << small.dropped() << "; "
+       << "muted them in " << muted_usec << "." << endl;
+  return agree;
+}
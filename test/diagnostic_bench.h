@@ -0,0 +1,23 @@
+/* Copyright (C) 2012 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/** Parse a header full of mistakes, reporting each: as text, as handlers always have; into a
+    \c diagnostic_ring with room for all of them, formatted after the parse; into a small ring
+    read and formatted on another thread during the parse; and with every kind of diagnostic
+    muted, so nothing is captured at all. Each way is timed, and the messages formatted from
+    each ring are checked against those reported as text.
+    @param stanzas  The number of times the mistakes are repeated; each holds five.
+    @return Returns whether each ring gave the same messages, save any the small one dropped. **/
+bool bench_diagnostics(unsigned stanzas = 20000);
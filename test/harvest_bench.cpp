@@ -0,0 +1,93 @@
+/* Copyright (C) 2012 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <set>
+#include <iostream>
+using namespace std;
+#include <API/jdi.h>
+#include "bench_util.h"
+#include "harvest_bench.h"
+
+using namespace jdi;
+using jdip::microtime;
+
+/// Print every macro a context defines, one to a line, in order of name.
+static string list_macros(const context &ct) {
+  string res;
+  const macro_map &macros = ct.get_macros();
+  for (macro_iter_c it = macros.begin(); it != macros.end(); ++it)
+    res += it->second->toString() + "\n";
+  return res;
+}
+
+/// Parse a file into the given context, in full or harvesting only macros, returning the microseconds taken.
+static unsigned long parse_file(const string &fn, bool harvest, context &ct, quiet_error_handler &herr) {
+  ct.harvest_macros_only(harvest);
+  llreader f(fn.c_str());
+  const unsigned long start = microtime();
+  ct.parse_C_stream(f, fn.c_str(), &herr);
+  return microtime() - start;
+}
+
+bool bench_macro_harvest(const vector<string> &files) {
+  quiet_error_handler herr;
+  bool agree = true;
+  const size_t builtins = context().get_global()->members.size();
+  unsigned long full_usec = 0, harvest_usec = 0;
+  for (size_t i = 0; i < files.size(); ++i) {
+    context full, harvested;
+    full_usec += parse_file(files[i], false, full, herr);
+    harvest_usec += parse_file(files[i], true, harvested, herr);
+    if (list_macros(harvested) != list_macros(full)) {
+      cout << "Harvesting the macros of " << files[i] << " DIFFERS from parsing it." << endl;
+      agree = false;
+    }
+    if (harvested.get_global()->members.size() != builtins) {
+      cout << "Harvesting the macros of " << files[i] << " read " << harvested.get_global()->members.size() - builtins
+           << " definitions." << endl;
+      agree = false;
+    }
+  }
+  cout << "Parsed " << files.size() << " files in " << full_usec << " microseconds; harvested their macros in "
+       << harvest_usec << " microseconds." << endl;
+  
+  // Copies made for each tracked file must harvest as the context they are copied from does
+  context full, harvested;
+  harvested.harvest_macros_only();
+  unsigned long start = microtime();
+  full.track_files(files, 0, &herr);
+  full_usec = microtime() - start;
+  start = microtime();
+  harvested.track_files(files, 0, &herr);
+  harvest_usec = microtime() - start;
+  
+  include_graph gfull, gharvested;
+  full.get_dependencies(gfull);
+  harvested.get_dependencies(gharvested);
+  if (set<string>(gfull.files.begin(), gfull.files.end()) != set<string>(gharvested.files.begin(), gharvested.files.end())
+      or gfull.edges.size() != gharvested.edges.size()) {
+    cout << "Tracking files harvesting only macros read " << gharvested.files.size() << " files by "
+         << gharvested.edges.size() << " #includes; parsing them read " << gfull.files.size() << " by "
+         << gfull.edges.size() << "." << endl;
+    agree = false;
+  }
+  if (list_macros(harvested) != list_macros(full)) {
+    cout << "Tracking files harvesting only macros DIFFERS from tracking them parsed." << endl;
+    agree = false;
+  }
+  cout << "Tracked " << gfull.files.size() << " files in " << full_usec << " microseconds parsing them, and in "
+       << harvest_usec << " microseconds harvesting their macros." << endl;
+  return agree;
+}
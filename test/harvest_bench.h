@@ -0,0 +1,25 @@
+/* Copyright (C) 2012 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string>
+#include <vector>
+
+/** Parse each of the given files in a context of its own, once in full and once harvesting only
+    macros, checking that both leave the same macros defined, and that the harvest reads no
+    definitions. Then track all of the files, both ways, checking that both read the same files and
+    leave the same macros. Each way is timed.
+    @param files  The files to parse; the #include directories of the \c builtin context are searched.
+    @return Returns whether every harvest agreed with the full parse. **/
+bool bench_macro_harvest(const std::vector<std::string> &files);
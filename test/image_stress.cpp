@@ -0,0 +1,103 @@
+/* Copyright (C) 2012 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <fstream>
+#include <sstream>
+#include <iostream>
+using namespace std;
+#include <API/jdi.h>
+#include <System/builtins.h>
+#include "bench_util.h"
+#include "image_stress.h"
+
+using namespace jdi;
+
+/// Read a whole file into a string.
+static string read_image(const string &fn) {
+  ifstream f(fn.c_str(), ios::in | ios::binary);
+  ostringstream ss;
+  ss << f.rdbuf();
+  return ss.str();
+}
+
+/// Write the given bytes as an image, and return whether a fresh context refuses to load it.
+static bool refused(const string &fn, const string &image) {
+  { ofstream f(fn.c_str(), ios::out | ios::binary); f << image; }
+  quiet_error_handler herr;
+  context ct;
+  return ct.load_image(fn.c_str(), &herr) != 0;
+}
+
+/// Save a context as it is, and return whether a fresh context refuses to load what was saved.
+static bool refused(const string &fn, const context &ct) {
+  return !ct.save_image(fn.c_str()) and refused(fn, read_image(fn));
+}
+
+bool test_image_corruption(const context &ct) {
+  const temp_dir dir("image");
+  if (dir.path.empty()) {
+    cerr << "Could not make a scratch directory." << endl;
+    return false;
+  }
+  const string fn = dir.file("damaged.img");
+  if (ct.save_image(fn.c_str())) {
+    cerr << "Could not write an image to damage." << endl;
+    return false;
+  }
+  const string image = read_image(fn);
+  
+  bool ok = true;
+  unsigned long seed = 12345;
+  for (unsigned trial = 0; trial < 64 and !image.empty(); ++trial) {
+    string damaged = image;
+    for (int flip = 0; flip < 4; ++flip) {
+      seed = seed * 1103515245ul + 12345ul;
+      const size_t bit = (seed >> 8) % (damaged.length() * 8);
+      damaged[bit / 8] ^= char(1 << bit % 8);
+    }
+    if (damaged != image and !refused(fn, damaged))
+      cerr << "An image with four bits flipped was loaded (trial " << trial << ")." << endl, ok = false;
+  }
+  for (size_t cut = 1; cut < image.length(); cut += image.length() / 16 + 1)
+    if (!refused(fn, image.substr(0, image.length() - cut)))
+      cerr << "An image missing its last " << cut << " bytes was loaded." << endl, ok = false;
+  if (refused(fn, image))
+    cerr << "The undamaged image was refused." << endl, ok = false;
+  
+  // A writer with bugs of its own can damage what it writes before the checksum is taken
+  context owners;
+  quiet_error_handler herr;
+  llreader src("namespace a { int x; struct s {}; } namespace b {} a::s v;\n", true);
+  owners.parse_C_stream(src, "owners.cc", &herr);
+  definition_scope *a = (definition_scope*)owners.get_global()->members["a"];
+  definition_scope *b = (definition_scope*)owners.get_global()->members["b"];
+  definition *x = a->members["x"], *s = a->members["s"];
+  
+  b->members["x"] = x;
+  if (!refused(fn, owners))
+    cerr << "An image giving a definition two owners was loaded." << endl, ok = false;
+  b->members.erase("x");
+  b->members["int"] = jdip::builtin_primitives["int"];
+  if (!refused(fn, owners))
+    cerr << "An image giving a built-in type an owner was loaded." << endl, ok = false;
+  b->members.erase("int");
+  a->members.erase("s");
+  if (!refused(fn, owners))
+    cerr << "An image with a definition nothing owns was loaded." << endl, ok = false;
+  a->members["s"] = s;
+  if (refused(fn, owners))
+    cerr << "An image of a context with one owner for everything was refused." << endl, ok = false;
+  return ok;
+}
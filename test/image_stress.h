@@ -0,0 +1,24 @@
+/* Copyright (C) 2012 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <API/context.h>
+
+/** Save a context to an image, then load copies of it damaged in several ways: with bits flipped
+    throughout, cut short, and written from a context in which one definition is held by two
+    scopes, a built-in type is held by a scope, or a type is held by none. Each damaged image must
+    be refused, freeing what was read of it once; the undamaged image must still load.
+    @param ct  The context to save.
+    @return Returns whether every damaged image was refused and the undamaged one loaded. **/
+bool test_image_corruption(const jdi::context &ct);
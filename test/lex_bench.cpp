@@ -0,0 +1,128 @@
+/* Copyright (C) 2012 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <iostream>
+using namespace std;
+#include <API/jdi.h>
+#include <System/lex_cpp.h>
+#include "bench_util.h"
+#include "lex_bench.h"
+
+using namespace jdi;
+using namespace jdip;
+
+/// A copy of the macros of the builtin context, for a lexer of our own to read and define.
+struct builtin_macros {
+  macro_map macros;
+  builtin_macros(): macros(builtin->get_macros()) {
+    for (macro_iter it = macros.begin(); it != macros.end(); ++it)
+      macro_type::retain(it->second);
+  }
+  ~builtin_macros() {
+    for (macro_iter it = macros.begin(); it != macros.end(); ++it)
+      macro_type::free(it->second);
+  }
+};
+
+/// Lex a file through lexer::get_token, recording the type and length of each token, and each #include obeyed.
+static void lex_polling(const string &fn, macro_map &macros, token_array &dest, vector<string> &includes, quiet_error_handler &herr) {
+  llreader f(fn.c_str());
+  lexer_cpp *cpp = new lexer_cpp(f, macros, builtin->get_search_directories(), fn.c_str());
+  lexer *lex = cpp;
+  dest.clear();
+  for (token_t t = lex->get_token(&herr); t.type != TT_ENDOFCODE; t = lex->get_token(&herr))
+    dest.types.push_back(t.type), dest.lengths.push_back(t.len);
+  includes.clear();
+  for (size_t i = 0; i < cpp->includes.size(); ++i)
+    includes.push_back(cpp->includes[i].from + " -> " + cpp->includes[i].to);
+  delete lex;
+}
+
+/// Render each edge of an include graph as the lexer's includes are rendered above.
+static void render_edges(const include_graph &g, vector<string> &dest) {
+  dest.clear();
+  for (size_t i = 0; i < g.edges.size(); ++i)
+    dest.push_back(g.files[g.edges[i].from] + " -> " + g.files[g.edges[i].to]);
+}
+
+bool bench_lex_only(const vector<string> &files, unsigned rounds) {
+  static const char *const ways[] = { "get_token", "lex_C_stream", "lex_C_stream without preprocessing" };
+  quiet_error_handler herr;
+  token_array polled, bulk;
+  include_graph graph;
+  vector<string> lexed_edges, scanned_edges;
+  
+  bool agree = true;
+  for (size_t i = 0; i < files.size(); ++i) {
+    context ct;
+    builtin_macros bm;
+    llreader f(files[i].c_str());
+    lex_polling(files[i], bm.macros, polled, lexed_edges, herr);
+    ct.lex_C_stream(f, bulk, files[i].c_str(), true, &herr);
+    if (bulk.types != polled.types or bulk.lengths != polled.lengths) {
+      cout << "Tokens read from " << files[i] << " through get_token and lex_C_stream DIFFER." << endl;
+      agree = false;
+    }
+    context sct;
+    llreader sf(files[i].c_str());
+    sct.scan_includes(sf, graph, files[i].c_str(), &herr);
+    render_edges(graph, scanned_edges);
+    if (scanned_edges != lexed_edges) {
+      cout << "Includes read from " << files[i] << " through get_token and scan_includes DIFFER." << endl;
+      agree = false;
+    }
+  }
+  
+  for (int way = 0; way < 3; ++way) {
+    unsigned long best = ~0ul;
+    size_t tokens = 0;
+    for (unsigned r = 0; r < rounds; ++r) {
+      unsigned long usec = 0;
+      tokens = 0;
+      for (size_t i = 0; i < files.size(); ++i) {
+        context ct; // Copying the builtin context and its macros is not timed
+        builtin_macros bm;
+        token_array &dest = way? bulk : polled;
+        const unsigned long start = microtime();
+        if (way)
+          { llreader f(files[i].c_str()); ct.lex_C_stream(f, dest, files[i].c_str(), way == 1, &herr); }
+        else
+          lex_polling(files[i], bm.macros, dest, lexed_edges, herr);
+        usec += microtime() - start;
+        tokens += dest.size();
+      }
+      if (usec < best)
+        best = usec;
+    }
+    cout << "Read " << tokens << " tokens through " << ways[way] << " in " << best << " microseconds: "
+         << (best? double(tokens) / best : 0) << " million tokens per second." << endl;
+  }
+  
+  unsigned long best = ~0ul;
+  for (unsigned r = 0; r < rounds; ++r) {
+    unsigned long usec = 0;
+    for (size_t i = 0; i < files.size(); ++i) {
+      context ct;
+      llreader f(files[i].c_str());
+      const unsigned long start = microtime();
+      ct.scan_includes(f, graph, files[i].c_str(), &herr);
+      usec += microtime() - start;
+    }
+    if (usec < best)
+      best = usec;
+  }
+  cout << "Read the #include graphs through scan_includes in " << best << " microseconds." << endl;
+  return agree;
+}
@@ -0,0 +1,27 @@
+/* Copyright (C) 2012 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string>
+#include <vector>
+
+/** Lex each of the given files, timing how many tokens a second are read through
+    \c lexer::get_token, one token at a time, and through \c context::lex_C_stream, with
+    and without preprocessing, and checking that the first two read the same tokens. The #include
+    graph of each file is also read through \c context::scan_includes, timed, and checked against
+    the #includes the lexer obeyed. Each way is timed over a number of rounds, and the fastest round is reported.
+    @param files   The files to lex; the #include directories of the \c builtin context are searched.
+    @param rounds  The number of times to lex every file each way.
+    @return Returns whether both ways of preprocessing read the same tokens, and the scan the same #includes, from every file. **/
+bool bench_lex_only(const std::vector<std::string> &files, unsigned rounds = 5);
@@ -0,0 +1,187 @@
+/* Copyright (C) 2012 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <sstream>
+#include <iostream>
+#include <unistd.h>
+#include <pthread.h>
+using namespace std;
+#include <API/jdi.h>
+#include <General/atomics.h>
+#include "bench_util.h"
+#include "limit_stress.h"
+
+using namespace jdi;
+using jdip::microtime;
+
+/// Write the given number of declarations, each followed, if asked, by a mistake.
+static string declarations(unsigned count, bool broken) {
+  ostringstream res;
+  for (unsigned i = 0; i < count; ++i) {
+    res << "int v" << i << ";\n";
+    if (broken)
+      res << "int w" << i << " = ;\n";
+  }
+  return res.str();
+}
+
+/// Error counter which also counts the parses stopped by a limit, and remembers the last error.
+struct limit_error_counter: error_counter {
+  unsigned stops;
+  string last;
+  int last_line;
+  void error(string err, string filename, int line, int pos) {
+    error_counter::error(err, filename, line, pos);
+    last = err, last_line = line;
+  }
+  void report(const diagnostic &d) {
+    if (d.id == DIAG_LIMIT) ++stops;
+    error_counter::report(d);
+  }
+  limit_error_counter(): stops(0), last_line(-1) {}
+};
+
+/// Raise a flag after a delay, from another thread.
+struct canceller {
+  volatile int flag;
+  unsigned delay_usec;
+  static void *run(void *self) {
+    canceller *c = (canceller*)self;
+    usleep(c->delay_usec);
+    quick::atomic_set(c->flag, 1);
+    return NULL;
+  }
+  canceller(unsigned delay): flag(0), delay_usec(delay) {}
+};
+
+/// Return whether the global scope of the given context declares the given name.
+static bool declares(context &ct, const string &name) {
+  return ct.get_global()->members.find(name) != ct.get_global()->members.end();
+}
+
+/** Check how a limited parse ended, printing what was wrong.
+    @param what     A description of the parse, for what is printed.
+    @param ct       The context parsed into.
+    @param herr     The handler the parse reported to.
+    @param expect   How the parse should have ended.
+    @param usec     The microseconds the parse took.
+    @param max_usec The most microseconds it should have taken. **/
+static bool check_stop(const char *what, context &ct, const limit_error_counter &herr, parse_end expect, unsigned long usec, unsigned long max_usec) {
+  bool ok = true;
+  const size_t declared = ct.get_global()->members.size();
+  if (ct.parse_ending() != expect)
+    cout << "The " << what << " ended as " << ct.parse_ending() << ", rather than " << expect << "." << endl, ok = false;
+  if (herr.stops != 1)
+    cout << "The " << what << " reported stopping " << herr.stops << " times." << endl, ok = false;
+  if (usec > max_usec)
+    cout << "The " << what << " took " << usec << " microseconds; it should have stopped within " << max_usec << "." << endl, ok = false;
+  if (herr.last_line <= 0)
+    cout << "The " << what << " reported stopping at no line." << endl, ok = false;
+  if (!declares(ct, "v0"))
+    cout << "The " << what << " did not keep what it read before stopping." << endl, ok = false;
+  
+  // What was read must stay put, and the context must parse as ever
+  string more = "int after_stop;";
+  llreader f;
+  f.encapsulate(more);
+  limit_error_counter quiet;
+  if (ct.parse_C_stream(f, "more.h", &quiet) or quiet.errors or !declares(ct, "after_stop")
+      or ct.get_global()->members.size() != declared + 1 or ct.parse_ending() != PARSE_COMPLETE)
+    cout << "The context of the " << what << " did not parse again cleanly after it stopped." << endl, ok = false;
+  cout << "The " << what << " stopped after " << usec << " microseconds, having declared " << declared << " names; "
+       << herr.errors << " errors were reported, the last being `" << herr.last << "'." << endl;
+  return ok;
+}
+
+bool test_parse_limits() {
+  bool ok = true;
+  
+  // An error budget: only so many errors may be passed on, and the stop itself
+  {
+    string code = declarations(100000, true);
+    context ct;
+    parse_limits lim;
+    lim.max_errors = 50;
+    ct.limit_parses(lim);
+    limit_error_counter herr;
+    llreader f;
+    f.encapsulate(code);
+    const unsigned long start = microtime();
+    ct.parse_C_stream(f, "broken.h", &herr);
+    const unsigned long usec = microtime() - start;
+    ok &= check_stop("parse limited to 50 errors", ct, herr, PARSE_TOO_MANY_ERRORS, usec, 1000000);
+    if (herr.errors != lim.max_errors + 1)
+      cout << "The parse limited to 50 errors passed on " << herr.errors << ", counting the stop." << endl, ok = false;
+    if (declares(ct, "v99999"))
+      cout << "The parse limited to 50 errors read to the end anyway." << endl, ok = false;
+  }
+  
+  string code = declarations(2000000, false);
+  
+  // A deadline, in a file far longer than can be read in time; placing the stop must not read the rest of it
+  {
+    context ct;
+    parse_limits lim;
+    lim.max_usec = 20000;
+    ct.limit_parses(lim);
+    limit_error_counter herr;
+    llreader f;
+    f.encapsulate(code);
+    const unsigned long start = microtime();
+    ct.parse_C_stream(f, "long.h", &herr);
+    const unsigned long usec = microtime() - start;
+    ok &= check_stop("parse limited to 20 milliseconds", ct, herr, PARSE_OUT_OF_TIME, usec, 30000);
+  }
+  
+  // Cancellation, while lexing on another thread, which must be stopped as well
+  {
+    context ct;
+    canceller c(20000);
+    parse_limits lim;
+    lim.cancel = &c.flag;
+    ct.limit_parses(lim);
+    limit_error_counter herr;
+    llreader f;
+    f.encapsulate(code);
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, canceller::run, &c)) {
+      cout << "Could not start a thread to cancel the parse." << endl;
+      return false;
+    }
+    const unsigned long start = microtime();
+    ct.parse_C_stream_pipelined(f, "long.h", &herr);
+    const unsigned long usec = microtime() - start;
+    pthread_join(thread, NULL);
+    c.flag = 0; // Lowered, so that the context may parse again
+    ok &= check_stop("pipelined parse cancelled after 20 milliseconds", ct, herr, PARSE_CANCELLED, usec, 30000);
+  }
+  
+  // Copies of a context are limited as it is; a flag already raised stops them before they begin
+  {
+    volatile int raised = 1;
+    context ct;
+    parse_limits lim;
+    lim.cancel = &raised;
+    ct.limit_parses(lim);
+    context copied(ct);
+    limit_error_counter herr;
+    llreader f;
+    f.encapsulate(code);
+    copied.parse_C_stream(f, "long.h", &herr);
+    if (copied.parse_ending() != PARSE_CANCELLED or copied.get_global()->members.size() != ct.get_global()->members.size())
+      cout << "A copy of a cancelled context parsed anyway." << endl, ok = false;
+  }
+  return ok;
+}
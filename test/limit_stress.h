@@ -0,0 +1,22 @@
+/* Copyright (C) 2012 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/** Parse code far too long, or too broken, to finish within limits given by \c context::limit_parses,
+    once for each limit: an error budget, a deadline, and a cancellation flag set from another thread,
+    the last while lexing on a thread of its own. Each parse must stop for the right reason, soon after
+    the limit is reached, pass on no more errors than allowed, keep what it read before stopping, and
+    leave its context fit to parse again.
+    @return Returns whether every parse stopped as it should. **/
+bool test_parse_limits();
@@ -0,0 +1,100 @@
+/* Copyright (C) 2012 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <iostream>
+using namespace std;
+#include <API/jdi.h>
+#include "bench_util.h"
+#include "macro_file_bench.h"
+
+using namespace jdi;
+using jdip::microtime;
+
+/// Read a file of definitions into a fresh context, one way or the other, returning the microseconds taken.
+static unsigned long read_file(const string &fn, bool direct, string &listing) {
+  quiet_error_handler herr;
+  context ct;
+  unsigned long start;
+  if (direct) {
+    start = microtime();
+    ct.read_macros(fn.c_str(), &herr);
+  }
+  else {
+    llreader f(fn.c_str());
+    start = microtime();
+    ct.parse_C_stream(f, fn.c_str(), &herr);
+  }
+  const unsigned long usec = microtime() - start;
+  // Blanks ending a line are not part of a definition; the lexer keeps those before a comment
+  listing.clear();
+  const macro_map &macros = ct.get_macros();
+  for (macro_iter_c it = macros.begin(); it != macros.end(); ++it) {
+    const string def = it->second->toString() + "\n";
+    for (size_t i = 0; i < def.length(); ++i)
+      if (def[i] != ' ' or def[def.find_first_not_of(' ', i)] != '\n')
+        listing += def[i];
+  }
+  return usec;
+}
+
+/// Read a file both ways, printing whether they differ.
+static bool agree(const string &fn) {
+  string direct, lexed;
+  read_file(fn, true, direct);
+  read_file(fn, false, lexed);
+  if (direct == lexed)
+    return true;
+  cout << "Reading the macros of " << fn << " DIFFERS from lexing them:" << endl
+       << direct << "---- versus ----" << endl << lexed;
+  return false;
+}
+
+bool bench_read_macros(const string &file, unsigned runs) {
+  const temp_dir dir("macros");
+  if (dir.path.empty()) {
+    cerr << "Could not make a scratch directory." << endl;
+    return false;
+  }
+  const string edges = dir.file("edges.h");
+  write_file(edges,
+    "#define PLAIN 1\n"
+    "  #  define SPACED (2 + 3)  \n"
+    "#define CONTINUED 1 + \\\n  2\n"
+    "#define CALL(a, b) ((a) * \\\n (b))\n"
+    "#define COMMENTED 4 // not part of it\n"
+    "#define BLOCK 5 /* nor\n this */ + 6\n"
+    "#define QUOTED \"// kept\" '\\''\n"
+    "#define VARIADIC(fmt, ...) f(fmt, __VA_ARGS__)\n"
+    "#define NAMED(args...) g(args)\n"
+    "#define PASTE(a, b) a ## b #a\n"
+    "#define EMPTY\n"
+    "#define GONE 7\n"
+    "#undef GONE\n"
+    "#define PLAIN 8\n"
+    "int not_a_directive;\n");
+  bool ok = agree(edges);
+  ok &= agree(file);
+  
+  unsigned long direct_usec = (unsigned long)-1, lexed_usec = (unsigned long)-1;
+  string listing;
+  for (unsigned i = 0; i < runs; ++i) {
+    const unsigned long d = read_file(file, true, listing), l = read_file(file, false, listing);
+    if (d < direct_usec) direct_usec = d;
+    if (l < lexed_usec) lexed_usec = l;
+  }
+  cout << "Read the macros of " << file << " in " << direct_usec << " microseconds; lexing them took "
+       << lexed_usec << " microseconds." << endl;
+  return ok;
+}
@@ -0,0 +1,24 @@
+/* Copyright (C) 2012 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string>
+
+/** Read a file of macro definitions with \c context::read_macros and through \c context::parse_C_stream,
+    checking that both leave the same macros defined, then time each. A file written first, holding
+    continued lines, comments, quotes, variadic parameters and #undef, is read both ways and compared too.
+    @param file  The file of definitions to read, such as the output of gcc -dM -E.
+    @param runs  The number of times to read the file each way; the fastest of each is reported.
+    @return Returns whether both ways agreed on both files. **/
+bool bench_read_macros(const std::string &file, unsigned runs = 50);
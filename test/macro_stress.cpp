@@ -0,0 +1,76 @@
+/* Copyright (C) 2012 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <iostream>
+#include <sstream>
+using namespace std;
+#include <API/jdi.h>
+#include "bench_util.h"
+#include "macro_stress.h"
+
+using namespace jdi;
+
+/// Macros which each add one to their argument: plainly, through a macro named in an
+/// argument, and through a variadic argument.
+static const char stress_macros[] =
+  "#define INC(x) ((x) + 1)\n"
+  "#define APPLY(f, x) f(x)\n"
+  "#define ADD(a, ...) ((a) + (__VA_ARGS__))\n";
+
+/// Write calls to the macros above nested to the given depth, around a zero.
+static string nest(unsigned depth) {
+  static const char *const opens[] = { "INC(", "APPLY(INC, ", "ADD(1, " };
+  string res;
+  for (unsigned i = 0; i < depth; ++i)
+    res += opens[i % 3];
+  res += "0";
+  res.append(depth, ')');
+  return res;
+}
+
+/// Return whether the global scope of the given context holds a constant of the given name and value.
+static bool has_value(context &ct, const char *name, long val) {
+  definition_scope::defiter it = ct.get_global()->members.find(name);
+  if (it == ct.get_global()->members.end() or !(it->second->flags & DEF_VALUED))
+    return false;
+  const value &v = ((definition_valued*)it->second)->value_of;
+  return v.type == VT_INTEGER and v.val.i == val;
+}
+
+bool test_macro_stress(unsigned max_depth) {
+  bool passed = true;
+  for (unsigned depth = 16; depth <= max_depth; depth <<= 1) {
+    const string calls = nest(depth);
+    ostringstream code;
+    code << stress_macros
+         << "#if " << calls << " == " << depth << "\n"
+         << "enum { nest_if = 1 };\n"
+         << "#endif\n"
+         << "enum { nest_value = " << calls << " };\n";
+
+    context ct;
+    error_counter herr;
+    llreader src(code.str(), true);
+    const unsigned long start = jdip::microtime();
+    ct.parse_C_stream(src, "macro_stress.cc", &herr);
+    const unsigned long usec = jdip::microtime() - start;
+
+    const bool ok = !herr.errors and has_value(ct, "nest_if", 1) and has_value(ct, "nest_value", depth);
+    cout << "Expanded calls nested " << depth << " deep in " << usec << " microseconds"
+         << (ok? "." : "; the result was WRONG.") << endl;
+    passed = passed and ok;
+  }
+  return passed;
+}
@@ -0,0 +1,22 @@
+/* Copyright (C) 2012 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/** Parse code which nests calls to macro functions ever more deeply, both in #if directives
+    and in code, timing each parse and checking that each nest expands to its depth. Each call
+    must rescan everything it encloses, so the time may grow with the square of the depth, but
+    no faster; printing the times makes that easy to see.
+    @param max_depth  The deepest nest to parse; depths double from 16 up to this.
+    @return Returns whether every nest expanded correctly and without errors. **/
+bool test_macro_stress(unsigned max_depth = 512);
@@ -0,0 +1,151 @@
+/* Copyright (C) 2012 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <sstream>
+#include <iostream>
+using namespace std;
+#include <API/jdi.h>
+#include "bench_util.h"
+#include "memo_bench.h"
+
+using namespace jdi;
+using jdip::microtime;
+
+/// Everything a lex leaves behind which memoizing headers must not change.
+struct lex_result {
+  token_array tokens; ///< The tokens read.
+  string macros; ///< Each macro defined afterward, spelled out.
+  bool operator==(const lex_result &o) const {
+    return tokens.types == o.tokens.types and tokens.offsets == o.tokens.offsets and tokens.lengths == o.tokens.lengths
+       and tokens.files == o.tokens.files and tokens.filenames == o.tokens.filenames and macros == o.macros;
+  }
+};
+
+/// Lex a file in a new copy of the builtin context, returning the microseconds taken by the lex.
+static unsigned long lex_file(const string &fn, bool memoize, lex_result &dest, quiet_error_handler &herr) {
+  context ct;
+  ct.memoize_headers(memoize);
+  llreader f(fn.c_str());
+  const unsigned long start = microtime();
+  ct.lex_C_stream(f, dest.tokens, fn.c_str(), true, &herr);
+  const unsigned long usec = microtime() - start;
+  dest.macros.clear();
+  const macro_map &macros = ct.get_macros();
+  for (macro_iter_c it = macros.begin(); it != macros.end(); ++it)
+    dest.macros += it->second->toString() + "\n";
+  return usec;
+}
+
+/// Write a long header which defines EDIT as the given number, and includes a short one defining INNER as another.
+static void write_edit(const string &dir, unsigned edit, unsigned inner) {
+  ostringstream big;
+  big << "#include \"inner.h\"\n";
+  for (unsigned i = 0; i < 40000; ++i)
+    big << "int edited_" << i << ";\n";
+  big << "#define EDIT " << 1000 + edit << "\n";
+  write_file(dir + "/big.h", big.str());
+  ostringstream in;
+  in << "#define INNER " << 1000 + inner << "\n";
+  write_file(dir + "/inner.h", in.str());
+}
+
+/// Lex the file including the long header, memoizing headers, and return what EDIT and INNER were left as.
+static string lex_edit(const string &dir, quiet_error_handler &herr) {
+  context ct;
+  ct.memoize_headers();
+  token_array tokens;
+  const string fn = dir + "/main.c";
+  llreader f(fn.c_str());
+  ct.lex_C_stream(f, tokens, fn.c_str(), true, &herr);
+  string res;
+  const char *const names[] = { "EDIT", "INNER" };
+  for (size_t i = 0; i < 2; ++i) {
+    macro_iter_c mi = ct.get_macros().find(names[i]);
+    res += mi == ct.get_macros().end() or mi->second->argc >= 0? string("?") : ((const jdip::macro_scalar*)mi->second)->value;
+    res += i? "" : " ";
+  }
+  return res;
+}
+
+/** Save a long header again and again, each time changing it or what it includes, and lex a file
+    including it twice after each save. Each lex must see the latest text, and the versions replaced
+    must be freed; only the latest version of each file may stay cached. **/
+static bool edit_headers(quiet_error_handler &herr) {
+  const temp_dir dir("memo");
+  if (dir.path.empty()) {
+    cerr << "Could not make a scratch directory." << endl;
+    return false;
+  }
+  write_file(dir.file("main.c"), "#include \"big.h\"\nint after;\n");
+  bool ok = true;
+  const unsigned edits = 12;
+  size_t settled = 0, grown = 0;
+  for (unsigned e = 0; e < edits; ++e) {
+    write_edit(dir.path, e, e / 2);
+    ostringstream want;
+    want << 1000 + e << " " << 1000 + e / 2;
+    for (unsigned twice = 0; twice < 2; ++twice) {
+      const string got = lex_edit(dir.path, herr);
+      if (got != want.str())
+        cout << "After save " << e << ", EDIT and INNER were lexed as " << got << ", not " << want.str() << "." << endl, ok = false;
+    }
+    if (e == 1)
+      settled = heap_in_use();
+  }
+  if (settled)
+    grown = heap_in_use() - settled;
+  const size_t header = 40000 * 16;
+  if (settled and grown > 2 * header)
+    cout << "Saving the header " << edits - 2 << " more times kept " << grown << " more bytes; each version holds "
+         << header << " or so." << endl, ok = false;
+  cout << "Saved a header " << edits << " times; the cache and memos grew by " << (long)grown << " bytes after the second." << endl;
+  return ok;
+}
+
+bool bench_header_memo(const vector<string> &files, unsigned rounds) {
+  quiet_error_handler herr;
+  vector<lex_result> expected(files.size());
+  unsigned long plain = 0;
+  size_t tokens = 0;
+  for (size_t i = 0; i < files.size(); ++i) {
+    plain += lex_file(files[i], false, expected[i], herr);
+    tokens += expected[i].tokens.size();
+  }
+  
+  bool agree = true;
+  unsigned long first = 0, best = ~0ul;
+  lex_result got;
+  for (unsigned r = 0; r < rounds; ++r) {
+    unsigned long usec = 0;
+    for (size_t i = 0; i < files.size(); ++i) {
+      usec += lex_file(files[i], true, got, herr);
+      if (!(got == expected[i])) {
+        cout << "Lexing " << files[i] << " in round " << r << " with memoized headers DIFFERS from lexing it without." << endl;
+        agree = false;
+      }
+    }
+    if (!r)
+      first = usec;
+    else if (usec < best)
+      best = usec;
+  }
+  
+  cout << "Read " << tokens << " tokens in " << plain << " microseconds without memoized headers, in "
+       << first << " memoizing them";
+  if (rounds > 1)
+    cout << ", and in " << best << " replaying them";
+  cout << "." << endl;
+  return edit_headers(herr) and agree;
+}
@@ -0,0 +1,28 @@
+/* Copyright (C) 2012 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string>
+#include <vector>
+
+/** Lex each of the given files in a context of its own, once without memoizing headers, then
+    a number of rounds memoizing them, checking that every round reads the same tokens from the
+    same files and leaves the same macros defined. The first round with memos, which makes them,
+    and the fastest of the rest, which replay them, are timed against the round without. Then a
+    header is saved again and again, checking that each lex sees its latest text and that the
+    versions it replaces are freed.
+    @param files   The files to lex; the #include directories of the \c builtin context are searched.
+    @param rounds  The number of times to lex every file memoizing headers.
+    @return Returns whether every round agreed with the lex made without memos. **/
+bool bench_header_memo(const std::vector<std::string> &files, unsigned rounds = 5);
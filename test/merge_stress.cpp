@@ -0,0 +1,99 @@
+/* Copyright (C) 2012 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <iostream>
+using namespace std;
+#include <API/jdi.h>
+#include "bench_util.h"
+#include "merge_stress.h"
+
+using namespace jdi;
+
+/// Find a member of the global scope of a context, or NULL.
+static definition *global_member(context &ct, const string &name) {
+  definition_scope::defiter it = ct.get_global()->members.find(name);
+  return it == ct.get_global()->members.end()? NULL : it->second;
+}
+
+/** Check what a context holds after reading both files, printing what is wrong.
+    @param what  A description of how the files were read, for what is printed.
+    @param ct    The context they were read into.
+    @return Returns whether the context holds what it should. **/
+static bool check_merged(const char *what, context &ct) {
+  bool ok = true;
+  definition *s = global_member(ct, "S");
+  if (!s or !(s->flags & DEF_CLASS)) {
+    cerr << what << ": S was not kept as a class." << endl;
+    return false;
+  }
+  if (s->flags & DEF_INCOMPLETE)
+    cerr << what << ": S was kept only as declared, without its body." << endl, ok = false;
+  if (((definition_scope*)s)->members.find("x") == ((definition_scope*)s)->members.end())
+    cerr << what << ": S does not declare x." << endl, ok = false;
+  
+  // Both files refer to S; they must refer to the one kept
+  const char *const users[] = { "k", "by_pointer" };
+  for (size_t i = 0; i < sizeof users / sizeof *users; ++i) {
+    definition *d = global_member(ct, users[i]);
+    definition *type = d and (d->flags & DEF_TYPED)? ((definition_typed*)d)->type : NULL;
+    if (d and (d->flags & DEF_FUNCTION)) {
+      ref_stack::parameter_ct &params = ((ref_stack::node_func*)&((definition_function*)d)->referencers.top())->params;
+      type = params.size()? params[0].def : NULL;
+    }
+    if (type != s)
+      cerr << what << ": " << users[i] << " does not refer to the S kept." << endl, ok = false;
+  }
+  
+  definition *f = global_member(ct, "f");
+  if (!f or !(f->flags & DEF_FUNCTION))
+    cerr << what << ": f was not kept as a function." << endl, ok = false;
+  else if (((definition_function*)f)->overloads.size() != 3)
+    cerr << what << ": f has " << ((definition_function*)f)->overloads.size() << " overloads, not 3." << endl, ok = false;
+  if (!global_member(ct, "g") or !global_member(ct, "shared"))
+    cerr << what << ": a variable declared in one file or both was lost." << endl, ok = false;
+  return ok;
+}
+
+bool test_merge() {
+  const temp_dir dir("merge");
+  if (dir.path.empty()) {
+    cerr << "Could not make a scratch directory." << endl;
+    return false;
+  }
+  vector<string> files;
+  files.push_back(dir.file("a.h")), files.push_back(dir.file("b.h"));
+  write_file(dir.file("common.h"), "#ifndef COMMON_H\n#define COMMON_H\nextern int shared;\nvoid f(char);\n#endif\n");
+  write_file(files[0], "#include \"common.h\"\nstruct S;\nvoid f(int);\nint by_pointer(S *s);\n");
+  write_file(files[1], "#include \"common.h\"\nstruct S { int x; };\nvoid f(double);\nint g;\nS *k;\n");
+  
+  error_counter herr(1);
+  bool ok = true;
+  {
+    context batch;
+    batch.parse_C_files(files, 2, &herr);
+    ok &= check_merged("Parsing in parallel", batch);
+  }
+  {
+    context serial;
+    for (size_t i = 0; i < files.size(); ++i) {
+      llreader f(files[i].c_str());
+      serial.parse_C_stream(f, files[i].c_str(), &herr);
+    }
+    ok &= check_merged("Parsing in turn", serial);
+  }
+  if (herr.errors)
+    cerr << herr.errors << " errors were reported reading the files." << endl, ok = false;
+  return ok;
+}
@@ -0,0 +1,21 @@
+/* Copyright (C) 2012 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/** Merge a forward declaration of a class with its body, and overloads of a function declared
+    apart, in files parsed in parallel by \c context::parse_C_files, and in turn into one context.
+    Either way, the class must be complete, what refers to it must refer to the one kept, every
+    overload must be kept once, and a declaration made in both files must be kept once.
+    @return Returns whether both contexts held what they should. **/
+bool test_merge();
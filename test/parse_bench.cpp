@@ -0,0 +1,243 @@
+/* Copyright (C) 2012 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <sys/resource.h>
+using namespace std;
+#include <API/jdi.h>
+#include <System/lex_cpp.h>
+#include <General/parse_basics.h>
+#include "bench_util.h"
+#include "parse_bench.h"
+
+using namespace jdi;
+using namespace jdip;
+
+/// The number of headers in the corpus, each included by the next and by the main file.
+static const unsigned corpus_headers = 24;
+/// The number of stanzas of declarations in each header.
+static const unsigned corpus_stanzas = 40;
+
+/// The name of the build this was compiled in, by the flags of the targets in JustDefineIt.cbp.
+static const char *build_name() {
+  #if defined(RENDER_ASTS)
+    return "Debug-Render";
+  #elif defined(DEBUG_MODE)
+    return "Debug";
+  #elif defined(PROFILE_MODE)
+    return "Profile";
+  #else
+    return "Release";
+  #endif
+}
+
+/// Write the text of one header of the corpus.
+static string corpus_header(unsigned h) {
+  ostringstream s;
+  s << "#ifndef BENCH_HEADER_" << h << "\n#define BENCH_HEADER_" << h << "\n\n";
+  if (h)
+    s << "#include \"header_" << h - 1 << ".h\"\n\n";
+  s << "#define BENCH_LEVEL_" << h << " " << h % 4 << "\n"
+       "#define BENCH_FIELD_" << h << "(type, name) type name;\n"
+       "#define BENCH_GETTER_" << h << "(type, name) type get_##name() const;\n"
+       "#define BENCH_PAIR_" << h << "(a, b) BENCH_FIELD_" << h << "(a, first) BENCH_FIELD_" << h << "(b, second)\n\n"
+       "namespace bench_" << h << " {\n"
+       "  typedef unsigned long size_type;\n"
+       "  typedef const char *string_type;\n\n";
+  for (unsigned i = 0; i < corpus_stanzas; ++i) {
+    s << "  enum color_" << i << " { red_" << i << ", green_" << i << " = " << i + 2 << ", blue_" << i << " };\n"
+         "  struct base_" << i << " {\n"
+         "    int id;\n"
+         "    BENCH_PAIR_" << h << "(long, short)\n"
+         "    virtual int kind() const;\n"
+         "  };\n"
+         "  class widget_" << i << ": public base_" << i << " {\n"
+         "    BENCH_FIELD_" << h << "(int, x)\n"
+         "    BENCH_FIELD_" << h << "(double, y)\n"
+         "    color_" << i << " hue;\n"
+         "  public:\n"
+         "    static const int limit = " << i << " * 16 + BENCH_LEVEL_" << h << ";\n"
+         "    BENCH_GETTER_" << h << "(int, x)\n"
+         "    BENCH_GETTER_" << h << "(double, y)\n"
+         "    void resize(size_type width, size_type height, bool keep = true);\n"
+         "  };\n"
+         "  template<typename T, int N> struct holder_" << i << " {\n"
+         "    T items[N];\n"
+         "    size_type size() const;\n"
+         "    T &at(size_type index);\n"
+         "  };\n"
+         "  template<> struct holder_" << i << "<char, 1> { char only; };\n"
+         "  template<typename T> T largest_" << i << "(T a, T b);\n"
+         "#if BENCH_LEVEL_" << h << " > 1 && defined(BENCH_HEADER_" << h << ")\n"
+         "  int describe_" << i << "(int a, string_type b, size_type c);\n"
+         "#else\n"
+         "  long describe_" << i << "(const widget_" << i << " &w);\n"
+         "#endif\n"
+         "  extern holder_" << i << "<widget_" << i << ", " << i % 8 + 1 << "> instances_" << i << ";\n\n";
+  }
+  s << "}\n\n#endif\n";
+  return s.str();
+}
+
+/// Write the main file of the corpus, which includes every header and uses a little of each.
+static string corpus_main() {
+  ostringstream s;
+  for (unsigned h = 0; h < corpus_headers; ++h)
+    s << "#include \"header_" << h << ".h\"\n";
+  s << "\n";
+  for (unsigned h = 0; h < corpus_headers; ++h)
+    s << "bench_" << h << "::widget_" << h % corpus_stanzas << " main_widget_" << h << ";\n"
+         "bench_" << h << "::holder_0<int, " << h + 1 << "> main_holder_" << h << ";\n";
+  return s.str();
+}
+
+/// Count the definitions in a scope, and in every namespace and class within it.
+static size_t count_definitions(const definition_scope *scope) {
+  size_t res = 0;
+  for (definition_scope::defiter_c it = scope->members.begin(); it != scope->members.end(); ++it) {
+    ++res;
+    if (it->second->flags & (DEF_NAMESPACE | DEF_CLASS))
+      res += count_definitions((const definition_scope*)it->second);
+  }
+  return res;
+}
+
+/// The wall times of a set of parses, sorted, with what was read in each.
+struct run_times {
+  vector<unsigned long> usec;
+  /// Return the given percentile, by nearest rank.
+  unsigned long percentile(unsigned p) const {
+    const size_t rank = (usec.size() * p + 99) / 100;
+    return usec[rank? rank - 1 : 0];
+  }
+  /// Write these times, and the rates at the median, as a JSON object.
+  void write(ostream &json, size_t tokens, size_t bytes, size_t definitions, unsigned long expansions) const {
+    unsigned long total = 0;
+    for (size_t i = 0; i < usec.size(); ++i)
+      total += usec[i];
+    const double median = percentile(50)? percentile(50) / 1e6 : 1e-6;
+    json << "{\n"
+            "      \"runs\": " << usec.size() << ",\n"
+            "      \"usec\": { \"min\": " << usec.front() << ", \"p50\": " << percentile(50) << ", \"p90\": " << percentile(90)
+         << ", \"p99\": " << percentile(99) << ", \"max\": " << usec.back() << ", \"mean\": " << total / usec.size() << " },\n"
+            "      \"tokens_per_sec\": " << (unsigned long)(tokens / median) << ",\n"
+            "      \"bytes_per_sec\": " << (unsigned long)(bytes / median) << ",\n"
+            "      \"definitions_per_sec\": " << (unsigned long)(definitions / median) << ",\n"
+            "      \"macro_expansions_per_sec\": " << (unsigned long)(expansions / median) << "\n"
+            "    }";
+  }
+};
+
+/** Parse the corpus in a fresh copy of the builtin context.
+    @param fn       The main file of the corpus.
+    @param memoize  Whether headers are memoized, and those memoized already replayed.
+    @param herr     The handler to count errors.
+    @param defs     Receives the number of definitions the parse left. [out]
+    @return Returns the microseconds taken by the parse, from opening the main file. **/
+static unsigned long parse_corpus(const string &fn, bool memoize, error_counter &herr, size_t &defs) {
+  context ct; // Copying the builtin context is not timed, nor is freeing what was read
+  ct.memoize_headers(memoize);
+  const unsigned long start = microtime();
+  llreader f(fn.c_str());
+  ct.parse_C_stream(f, fn.c_str(), &herr);
+  const unsigned long usec = microtime() - start;
+  defs = count_definitions(ct.get_global());
+  return usec;
+}
+
+bool bench_parse(unsigned runs, ostream &json) {
+  if (!runs) runs = 1;
+  const temp_dir dir("bench");
+  if (dir.path.empty()) {
+    cerr << "Could not make a scratch directory for the benchmark corpus." << endl;
+    return false;
+  }
+  const string main_fn = dir.file("corpus.cc");
+  size_t bytes = 0;
+  for (unsigned h = 0; h <= corpus_headers; ++h) {
+    const string fn = h < corpus_headers? dir.file("header_" + toString((long)h) + ".h") : main_fn;
+    const string text = h < corpus_headers? corpus_header(h) : corpus_main();
+    { ofstream f(fn.c_str()); f << text; }
+    bytes += text.length();
+  }
+  
+  // What is read in each parse is counted once, apart from the timing
+  error_counter herr(5, "Benchmark corpus");
+  size_t tokens = 0;
+  unsigned long expansions = 0;
+  {
+    macro_map macros = builtin->get_macros();
+    for (macro_iter it = macros.begin(); it != macros.end(); ++it)
+      macro_type::retain(it->second);
+    llreader f(main_fn.c_str());
+    lexer_cpp lex(f, macros, builtin->get_search_directories(), main_fn.c_str());
+    while (lex.get_token(&herr).type != TT_ENDOFCODE)
+      ++tokens;
+    expansions = lex.expansion_count;
+    for (macro_iter it = macros.begin(); it != macros.end(); ++it)
+      macro_type::free(it->second);
+  }
+  
+  bool ok = true;
+  size_t definitions = 0, defs;
+  run_times cold, warm;
+  for (unsigned r = 0; r < runs; ++r) {
+    cold.usec.push_back(parse_corpus(main_fn, false, herr, defs));
+    if (!r) definitions = defs;
+    ok &= defs == definitions;
+  }
+  const unsigned long first = cold.usec[0];
+  parse_corpus(main_fn, true, herr, defs); // Memoize every header, untimed
+  ok &= defs == definitions;
+  for (unsigned r = 0; r < runs; ++r) {
+    warm.usec.push_back(parse_corpus(main_fn, true, herr, defs));
+    ok &= defs == definitions;
+  }
+  if (!ok)
+    cerr << "The benchmark corpus did not declare the same in every parse." << endl;
+  ok &= !herr.errors;
+  sort(cold.usec.begin(), cold.usec.end());
+  sort(warm.usec.begin(), warm.usec.end());
+  
+  rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+  
+  json << "{\n"
+          "  \"benchmark\": \"parse\",\n"
+          "  \"build\": { \"target\": \"" << build_name() << "\", \"optimized\": "
+  #ifdef __OPTIMIZE__
+       << "true"
+  #else
+       << "false"
+  #endif
+       << ", \"compiler\": \"" << __VERSION__ << "\" },\n"
+          "  \"corpus\": { \"files\": " << corpus_headers + 1 << ", \"bytes\": " << bytes << ", \"tokens\": " << tokens
+       << ", \"definitions\": " << definitions << ", \"macro_expansions\": " << expansions << " },\n"
+          "  \"errors\": " << herr.errors << ",\n"
+          "  \"warnings\": " << herr.warnings << ",\n"
+          "  \"first_parse_usec\": " << first << ",\n"
+          "  \"parses\": {\n"
+          "    \"cold\": ";
+  cold.write(json, tokens, bytes, definitions, expansions);
+  json << ",\n    \"warm\": ";
+  warm.write(json, tokens, bytes, definitions, expansions);
+  json << "\n  },\n"
+          "  \"peak_rss_kb\": " << ru.ru_maxrss << "\n"
+          "}" << endl;
+  return ok;
+}
@@ -0,0 +1,28 @@
+/* Copyright (C) 2012 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <ostream>
+
+/** Parse a fixed corpus of generated headers end to end, many times over, and write what was measured
+    as a JSON object, so that runs can be compared across versions and builds. The corpus is written to
+    a scratch directory and removed after; it reads nothing from the system, so every machine parses
+    the same code. Each cold parse reads and lexes every header anew, in a fresh copy of the builtin
+    context; each warm parse replays headers memoized by an untimed parse before it. Reported for each
+    are the percentiles of wall time, and the tokens, bytes, definitions, and macro expansions read per
+    second at the median, along with the peak resident memory of the process.
+    @param runs  The number of timed parses of each kind.
+    @param json  The stream to write the JSON object to.
+    @return Returns whether every parse read the corpus without error, and declared the same. **/
+bool bench_parse(unsigned runs, std::ostream &json);
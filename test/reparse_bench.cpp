@@ -0,0 +1,99 @@
+/* Copyright (C) 2012 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <sstream>
+#include <iostream>
+using namespace std;
+#include <API/jdi.h>
+#include "bench_util.h"
+#include "reparse_bench.h"
+
+using namespace jdi;
+using jdip::microtime;
+
+/// Spell out every definition a context holds.
+static string definitions(context &ct) {
+  stringstream ss;
+  ct.output_definitions(ss);
+  return ss.str();
+}
+
+/// Check that a reparse parsed again exactly the given files, and left what parsing all of them anew would.
+static bool check_reparse(const char *step, context &tracking, const vector<string> &all, const vector<string> &expected, quiet_error_handler &herr) {
+  parse_report report;
+  tracking.reparse_changed(1, &herr, &report);
+  vector<string> reparsed;
+  for (size_t i = 0; i < report.files.size(); ++i)
+    reparsed.push_back(report.files[i].filename);
+  context fresh;
+  fresh.parse_C_files(all, 1, &herr);
+  bool ok = true;
+  if (reparsed != expected)
+    cout << "After " << step << ", " << reparsed.size() << " files were parsed again, not " << expected.size() << "." << endl, ok = false;
+  if (definitions(tracking) != definitions(fresh))
+    cout << "After " << step << ", the tracking context DIFFERS from a fresh parse." << endl, ok = false;
+  return ok;
+}
+
+bool bench_reparse(const vector<string> &files) {
+  quiet_error_handler herr;
+  const temp_dir dir("reparse");
+  if (dir.path.empty()) {
+    cout << "Could not make a scratch directory." << endl;
+    return false;
+  }
+  const string a = dir.file("a.cc"), b = dir.file("b.cc"), shared = dir.file("shared.h"), one = dir.file("one.h");
+  write_file(shared, "#ifndef SHARED_H\n#define SHARED_H\nstruct shared { int x; };\n#endif\n", 0);
+  write_file(one, "int one_fn(int);\n", 0);
+  write_file(a, "#include \"shared.h\"\n#include \"one.h\"\nint a_var;\n", 0);
+  write_file(b, "#include \"shared.h\"\nint b_var;\n", 0);
+  
+  vector<string> all, just_a, none;
+  all.push_back(a), all.push_back(b);
+  just_a.push_back(a);
+  
+  bool ok = true;
+  context tracking;
+  tracking.track_files(all, 1, &herr);
+  include_graph g;
+  tracking.get_dependencies(g);
+  if (g.files.size() != 4 or g.edges.size() != 3)
+    cout << "Tracking found " << g.files.size() << " files and " << g.edges.size() << " #includes, not 4 and 3." << endl, ok = false;
+  ok &= check_reparse("changing nothing", tracking, all, none, herr);
+  write_file(one, "int one_fn(int);\nint one_more;\n", 10);
+  ok &= check_reparse("changing a header read by one file", tracking, all, just_a, herr);
+  write_file(shared, "#ifndef SHARED_H\n#define SHARED_H\nstruct shared { int x; };\n#endif\n", 20);
+  ok &= check_reparse("touching a header without changing it", tracking, all, none, herr);
+  write_file(shared, "#ifndef SHARED_H\n#define SHARED_H\nstruct shared { int x, y; };\n#endif\n", 30);
+  ok &= check_reparse("changing a header read by both files", tracking, all, all, herr);
+  write_file(a, "#include \"shared.h\"\nint a_var;\n", 40);
+  ok &= check_reparse("dropping an #include", tracking, all, just_a, herr);
+  tracking.get_dependencies(g);
+  if (g.files.size() != 3 or g.edges.size() != 2)
+    cout << "After dropping an #include, " << g.files.size() << " files and " << g.edges.size() << " #includes are tracked, not 3 and 2." << endl, ok = false;
+  
+  if (!files.empty()) {
+    context ct;
+    parse_report report;
+    ct.track_files(files, 0, &herr, &report);
+    ct.get_dependencies(g);
+    unsigned long start = microtime();
+    ct.reparse_changed(0, &herr);
+    const unsigned long unchanged = microtime() - start;
+    cout << "Tracked " << files.size() << " files reading " << g.files.size() << " files in " << report.parse_usec + report.merge_usec
+         << " microseconds; found nothing changed in " << unchanged << " microseconds." << endl;
+  }
+  return ok;
+}
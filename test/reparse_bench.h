@@ -0,0 +1,26 @@
+/* Copyright (C) 2012 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string>
+#include <vector>
+
+/** Track a few small files written to a scratch directory, then change, touch, and rewrite the
+    headers they include, checking after each that \c context::reparse_changed parses again only
+    the files which read a changed header, and leaves the same definitions as parsing every file
+    anew would. Then track the given files, and time finding that nothing has changed against
+    parsing them all again.
+    @param files  The files to track and time; the #include directories of the \c builtin context are searched.
+    @return Returns whether every reparse did what was expected of it. **/
+bool bench_reparse(const std::vector<std::string> &files);
@@ -0,0 +1,205 @@
+/* Copyright (C) 2012 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <iostream>
+using namespace std;
+#include <API/jdi.h>
+#include <Parser/handlers/handle_function_impl.h>
+#include "bench_util.h"
+#include "retention_bench.h"
+
+using namespace jdi;
+using jdip::microtime;
+
+static unsigned bodies_kept = 0; ///< The number of function bodies handed to \c keep_body.
+static int kept_body; ///< The address given for each body kept; nothing is stored there.
+
+/// Stand in for an external system harvesting function bodies, counting each.
+static void *keep_body(lexer *lex, jdip::token_t &token, definition_scope *scope, error_handler *herr) {
+  skip_function_implementation(lex, token, scope, herr);
+  ++bodies_kept;
+  return &kept_body;
+}
+
+static const char retention_code[] =
+  "struct pt { int x; };\n"
+  "int f(int a = 1 + 2, int b = sizeof(pt));\n"
+  "int f2(int a = 3 > 2, int b = (4, 5), int c = f(1, 2));\n"
+  "class c {\n"
+  "    typedef int priv_t;\n"
+  "    struct inner { int y; };\n"
+  "    int hidden;\n"
+  "    int helper(int) { return 0; }\n"
+  "    int later(int);\n"
+  "  public:\n"
+  "    priv_t shown;\n"
+  "    inner get();\n"
+  "    int call() { return helper(1); }\n"
+  "};\n"
+  "int c::later(int q) { return q; }\n"
+  "template<typename T> struct box { typename T::type value; };\n"
+  "int g() { return 0; }\n"
+  "template<typename T> class tb { int p(); public: int r(); };\n"
+  "template<typename T> int tb<T>::p() { return 0; }\n";
+
+/// Look a member up in a scope, or return NULL if it isn't there.
+static definition *member(definition_scope *scope, const char *name) {
+  definition_scope::defiter it = scope->members.find(name);
+  return it == scope->members.end()? NULL : it->second;
+}
+
+/// Parse the code above keeping what is asked, checking that exactly that was kept.
+static bool check_retention(unsigned flags) {
+  error_counter herr;
+  context ct;
+  ct.retain(flags);
+  bodies_kept = 0;
+  void *(*was)(lexer*, jdip::token_t&, definition_scope*, error_handler*) = handle_function_implementation;
+  handle_function_implementation = keep_body;
+  llreader src(retention_code, true);
+  ct.parse_C_stream(src, "retention.cc", &herr);
+  handle_function_implementation = was;
+  
+  bool ok = true;
+  if (herr.errors)
+    cout << herr.errors << " errors parsing with retention " << flags << "." << endl, ok = false;
+  
+  definition_scope *global = ct.get_global();
+  definition *f = member(global, "f");
+  if (f and f->flags & DEF_FUNCTION and !((definition_function*)f)->referencers.empty()
+      and ((definition_function*)f)->referencers.top().type == ref_stack::RT_FUNCTION) {
+    const ref_stack::parameter_ct &params = ((const ref_stack::node_func&)((definition_function*)f)->referencers.top()).params;
+    for (size_t i = 0; i < params.size(); ++i)
+      if (!params[i].default_value != !(flags & RETAIN_DEFAULT_ARGUMENTS))
+        cout << "Default argument " << i << " of `f' was " << (params[i].default_value? "kept" : "not kept") << "." << endl, ok = false;
+  }
+  else cout << "`f' was not read as a function." << endl, ok = false;
+  definition *f2 = member(global, "f2");
+  if (!f2 or !(f2->flags & DEF_FUNCTION) or ((definition_function*)f2)->referencers.empty()
+      or ((definition_function*)f2)->referencers.top().type != ref_stack::RT_FUNCTION
+      or ((const ref_stack::node_func&)((definition_function*)f2)->referencers.top()).params.size() != 3)
+    cout << "`f2' was not read as a function of three parameters." << endl, ok = false;
+  
+  definition *c = member(global, "c");
+  if (c and c->flags & DEF_CLASS) {
+    const char *const always[] = { "priv_t", "inner", "shown", "get", "call" }, *const priv[] = { "hidden", "helper", "later" };
+    for (size_t i = 0; i < sizeof(always) / sizeof(*always); ++i)
+      if (!member((definition_scope*)c, always[i]))
+        cout << "`c::" << always[i] << "' was not kept." << endl, ok = false;
+    for (size_t i = 0; i < sizeof(priv) / sizeof(*priv); ++i)
+      if (!member((definition_scope*)c, priv[i]) != !(flags & RETAIN_PRIVATE_MEMBERS))
+        cout << "Private `c::" << priv[i] << "' was " << (flags & RETAIN_PRIVATE_MEMBERS? "not kept" : "kept") << "." << endl, ok = false;
+  }
+  else cout << "`c' was not read as a class." << endl, ok = false;
+  
+  definition *box = member(global, "box");
+  if (box and box->flags & DEF_TEMPLATE and !((definition_template*)box)->dependents.empty()) {
+    const definition_template::deplist &deps = ((definition_template*)box)->dependents;
+    for (size_t i = 0; i < deps.size(); ++i)
+      if (!deps[i]->def != !(flags & RETAIN_HYPOTHETICALS))
+        cout << "The expression of a dependent type of `box' was " << (deps[i]->def? "kept" : "not kept") << "." << endl, ok = false;
+  }
+  else cout << "`box' was not read as a template with a dependent type." << endl, ok = false;
+  
+  // Five bodies are read, but those of helper, later, and p go with them if private members are not kept
+  const unsigned bodies = !(flags & RETAIN_IMPLEMENTATIONS)? 0 : flags & RETAIN_PRIVATE_MEMBERS? 5 : 2;
+  if (bodies_kept != bodies)
+    cout << bodies_kept << " function bodies were kept, not " << bodies << "." << endl, ok = false;
+  return ok;
+}
+
+static const char access_code[] =
+  "class a { int hidden(); public: int shown(); private: int later(); };\n"
+  "struct s { int open(); private: int closed; };\n"
+  "int a::hidden() { return 0; }\n"
+  "int a::later() { return 1; }\n"
+  "int s::closed = 2;\n"
+  "int s::open() { return 3; }\n";
+
+/// Check that members are dropped by the access in effect where they are declared, and that only the
+/// definitions of members so dropped are read past; defining a member never declared is still an error.
+static bool check_access() {
+  bool ok = true;
+  for (int undeclared = 0; undeclared < 2; ++undeclared) {
+    error_counter herr;
+    context ct;
+    ct.retain(0);
+    const string code = string(access_code) + (undeclared? "int a::missing() { return 4; }\n" : "");
+    llreader src(code, true);
+    ct.parse_C_stream(src, "access.cc", &herr);
+    if (!herr.errors != !undeclared)
+      cout << herr.errors << " errors reading member definitions " << (undeclared? "including" : "without") << " `a::missing'." << endl, ok = false;
+    
+    definition_scope *global = ct.get_global();
+    definition *a = member(global, "a"), *s = member(global, "s");
+    if (!a or !(a->flags & DEF_CLASS) or !s or !(s->flags & DEF_CLASS))
+      return cout << "`a' and `s' were not read as classes." << endl, false;
+    if (member((definition_scope*)a, "hidden") or member((definition_scope*)a, "later") or member((definition_scope*)s, "closed"))
+      cout << "A private member was kept." << endl, ok = false;
+    if (!member((definition_scope*)a, "shown") or !member((definition_scope*)s, "open"))
+      cout << "A public member was not kept." << endl, ok = false;
+  }
+  return ok;
+}
+
+/// Check that default arguments which are not kept are read past whole, even where their commas
+/// and angle brackets are those of template arguments, which the expression reader cannot read.
+static bool check_skipped_defaults() {
+  error_counter herr;
+  context ct;
+  ct.retain(0);
+  llreader src("namespace q { template<typename T, typename U> struct tw { enum { n = 1 }; }; }\n"
+               "int d(int x = q::tw<int, char>::n, int y = sizeof(q::tw<q::tw<int, int>, char>), int z = 1 > 0);\n", true);
+  ct.parse_C_stream(src, "defaults.cc", &herr);
+  definition *d = member(ct.get_global(), "d");
+  if (herr.errors or !d or !(d->flags & DEF_FUNCTION) or ((definition_function*)d)->referencers.empty()
+      or ((definition_function*)d)->referencers.top().type != ref_stack::RT_FUNCTION
+      or ((const ref_stack::node_func&)((definition_function*)d)->referencers.top()).params.size() != 3)
+    return cout << "`d' was not read as a function of three parameters, with " << herr.errors << " errors." << endl, false;
+  return true;
+}
+
+bool bench_retention(const vector<string> &files) {
+  bool ok = check_access();
+  ok &= check_skipped_defaults();
+  ok &= check_retention(RETAIN_ALL);
+  ok &= check_retention(0);
+  ok &= check_retention(RETAIN_ALL & ~RETAIN_PRIVATE_MEMBERS);
+  ok &= check_retention(RETAIN_PRIVATE_MEMBERS | RETAIN_IMPLEMENTATIONS);
+  
+  error_counter herr;
+  for (size_t i = 0; i < files.size(); ++i) {
+    long bytes[2]; unsigned long usec[2];
+    { // Included files are cached on their first read; cache them before anything is measured
+      context warm;
+      llreader f(files[i].c_str());
+      warm.parse_C_stream(f, files[i].c_str(), &herr);
+    }
+    for (int keep = 0; keep < 2; ++keep) {
+      const size_t before = heap_in_use();
+      const unsigned long start = microtime();
+      context *ct = new context();
+      ct->retain(keep? RETAIN_ALL : 0);
+      llreader f(files[i].c_str());
+      ct->parse_C_stream(f, files[i].c_str(), &herr);
+      usec[keep] = microtime() - start;
+      bytes[keep] = (long)heap_in_use() - (long)before;
+      delete ct;
+    }
+    cout << files[i] << ": keeping everything, " << bytes[1] << " bytes in " << usec[1] << " microseconds; keeping nothing optional, "
+         << bytes[0] << " bytes in " << usec[0] << " microseconds." << endl;
+  }
+  return ok;
+}
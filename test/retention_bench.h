@@ -0,0 +1,25 @@
+/* Copyright (C) 2012 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string>
+#include <vector>
+
+/** Parse a little code keeping everything, then keeping nothing optional, checking that default
+    arguments, dependent type expressions, private variables and functions, and function bodies are
+    each kept or skipped as asked, without any error. Then parse the given files both ways, reporting
+    the memory each leaves in use.
+    @param files  The files to parse; the #include directories of the \c builtin context are searched.
+    @return Returns whether everything was kept or skipped as expected. **/
+bool bench_retention(const std::vector<std::string> &files);
@@ -0,0 +1,97 @@
+/* Copyright (C) 2012 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include <iomanip>
+#include <iostream>
+using namespace std;
+#include <API/jdi.h>
+#include "stress_gen.h"
+#include "bench_util.h"
+#include "scaling_bench.h"
+
+using namespace jdi;
+using jdip::microtime;
+
+/// The smallest size parsed along each axis, chosen so that it takes about as long to parse as the others.
+static const unsigned first_size[STRESS_AXIS_COUNT] = { 32, 500, 32, 16, 32, 500, 64, 64, 32 };
+
+/// The exponent of growth above which an axis is marked as super-linear; timing noise keeps this above one.
+static const double superlinear = 1.35;
+
+/// Parse a stress header in a fresh copy of the builtin context, returning the microseconds taken.
+static unsigned long parse_stress(const string &fn, error_counter &herr) {
+  context ct;
+  const unsigned long start = microtime();
+  llreader f(fn.c_str());
+  ct.parse_C_stream(f, fn.c_str(), &herr);
+  return microtime() - start;
+}
+
+bool bench_scaling(unsigned steps) {
+  const temp_dir dir("scaling");
+  if (dir.path.empty()) {
+    cout << "Could not make a scratch directory for the stress headers." << endl;
+    return false;
+  }
+  error_counter herr(5, "Stress header");
+  bool ok = true;
+  cout << setw(20) << left << "axis" << right << setw(9) << "size" << setw(10) << "bytes" << setw(12) << "usec"
+       << setw(12) << "usec/unit" << setw(10) << "exponent" << endl;
+  for (int axis = 0; axis < STRESS_AXIS_COUNT; ++axis) {
+    vector<double> times;
+    for (unsigned step = 0; step < steps; ++step) {
+      stress_params params;
+      params.size[axis] = first_size[axis] << step;
+      vector<string> files;
+      const size_t bytes = write_stress_headers(params, dir.path, files);
+      if (!bytes) {
+        cout << "Could not write the stress headers." << endl;
+        ok = false;
+        break;
+      }
+      const unsigned errors = herr.errors;
+      unsigned long best = ~0ul;
+      for (int round = 0; round < 5; ++round) {
+        const unsigned long usec = parse_stress(files[0], herr);
+        if (usec < best) best = usec;
+      }
+      for (size_t i = 0; i < files.size(); ++i)
+        remove(files[i].c_str());
+      if (herr.errors != errors) {
+        cout << stress_axis_name((stress_axis)axis) << "=" << params.size[axis] << " was not read without error." << endl;
+        ok = false;
+      }
+      
+      const double usec = best? best : 1;
+      cout << setw(20) << left << stress_axis_name((stress_axis)axis) << right << setw(9) << params.size[axis]
+           << setw(10) << bytes << setw(12) << best << setw(12) << fixed << setprecision(3) << usec / params.size[axis];
+      if (step)
+        cout << setw(10) << setprecision(2) << log(usec / times.back()) / log(2.0);
+      cout << endl;
+      times.push_back(usec);
+    }
+    
+    // Only the largest sizes are long enough to time well; judge by the last two doublings together
+    const size_t n = times.size(), from = n > 2? n - 3 : 0;
+    const double growth = n > 1? log(times[n - 1] / times[from]) / log(2.0) / (n - 1 - from) : 0;
+    if (growth > superlinear)
+      cout << setw(20) << left << stress_axis_name((stress_axis)axis) << right << " is SUPER-LINEAR: time grows as size^"
+           << setprecision(2) << growth << " over its largest sizes." << endl;
+  }
+  return ok;
+}
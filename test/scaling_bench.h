@@ -0,0 +1,23 @@
+/* Copyright (C) 2012 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/** Parse stress headers from \c write_stress_headers at doubling sizes along each axis in turn, the
+    others left out, and print how the time of the parse grows. For each size, the best of five parses
+    is printed, with the exponent of its growth from the size before: near one, the parse scales
+    linearly; near two, quadratically. An axis whose time grows by an exponent well above one over its
+    last two doublings is marked as super-linear.
+    @param steps  The number of sizes to parse along each axis, each double the last.
+    @return Returns whether every stress header was parsed without error. **/
+bool bench_scaling(unsigned steps);
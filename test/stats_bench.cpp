@@ -0,0 +1,220 @@
+/* Copyright (C) 2012 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <fstream>
+#include <sstream>
+#include <iostream>
+using namespace std;
+#include <API/jdi.h>
+#include <API/compile_settings.h>
+#include <System/lex_cpp.h>
+#include "bench_util.h"
+#include "stats_bench.h"
+
+using namespace jdi;
+using namespace jdip;
+
+#if PARSE_STATS
+
+static const unsigned stats_uses = 2000; ///< The number of calls to \c TWICE in the main file.
+static const unsigned stats_branches = 200; ///< The number of #if directives in the main file.
+
+/// Write the corpus into the given directory, returning the name of each file in the order first opened.
+static vector<string> write_corpus(const string &dir) {
+  vector<string> fn;
+  fn.push_back(dir + "/main.cc"), fn.push_back(dir + "/a.h"), fn.push_back(dir + "/c.h"), fn.push_back(dir + "/b.h");
+  ostringstream main, a, c, b;
+  main << "#include \"a.h\"\n#include \"b.h\"\n#define TWICE(x) ((x) + (x))\n";
+  for (unsigned i = 0; i < stats_uses; ++i) {
+    main << "int m" << i << " = TWICE(" << i << ");\n";
+    if (i < stats_branches)
+      main << "#if ONE\nint t" << i << ";\n#else\nint f" << i << ";\n#endif\n";
+  }
+  a << "#define ONE 1\n#include \"c.h\"\n";
+  for (unsigned i = 0; i < 500; ++i)
+    a << "struct sa" << i << " { int x; c" << i % 300 << " y; };\n";
+  b << "#include \"c.h\"\n";
+  for (unsigned i = 0; i < 500; ++i)
+    b << "sa" << i << " *b" << i << "(c" << i % 300 << " y);\n";
+  c << "#ifndef C_H\n#define C_H\n";
+  for (unsigned i = 0; i < 300; ++i)
+    c << "typedef int c" << i << ";\n";
+  c << "#endif\n";
+  const string text[] = { main.str(), a.str(), c.str(), b.str() };
+  for (size_t i = 0; i < fn.size(); ++i) {
+    ofstream f(fn[i].c_str());
+    f << text[i];
+  }
+  return fn;
+}
+
+/** Parse the main file of the corpus in a fresh copy of the builtin context.
+    @param fn         The main file.
+    @param pipelined  Whether to lex on a thread of its own.
+    @param stats      Receives the stats, or NULL to keep none. [out]
+    @param herr       The handler to count errors.
+    @return Returns the microseconds taken by the parse. **/
+static unsigned long parse_corpus(const string &fn, bool pipelined, parse_stats *stats, error_counter &herr) {
+  context ct;
+  const unsigned long start = microtime();
+  llreader f(fn.c_str());
+  if (pipelined)
+    ct.parse_C_stream_pipelined(f, fn.c_str(), &herr, stats);
+  else
+    ct.parse_C_stream(f, fn.c_str(), &herr, stats);
+  return microtime() - start;
+}
+
+/** Check the stats of one parse of the corpus, printing what is wrong.
+    @param what        A description of the parse, for what is printed.
+    @param st          The stats kept.
+    @param wall        The microseconds the parse took, timed from outside.
+    @param threads     The number of threads the parse was timed on.
+    @param fn          The files of the corpus, in the order first opened.
+    @param expansions  The number of macros expanded in lexing the corpus.
+    @return Returns whether the stats are as they should be. **/
+static bool check_stats(const char *what, const parse_stats &st, unsigned long wall, unsigned threads,
+                        const vector<string> &fn, unsigned long expansions) {
+  bool ok = true;
+  if (st.usec > wall) {
+    cerr << what << ": took " << st.usec << " microseconds, longer than the " << wall << " the whole parse took." << endl;
+    ok = false;
+  }
+  
+  // Each phase is charged at most a microsecond short on each thread, in truncation; the phases of
+  // each thread add up to the time that thread was timed, which is at most the time of the parse
+  unsigned long sum = 0;
+  for (int i = 0; i < PHASE_COUNT; ++i) {
+    sum += st.phases[i].usec;
+    if (!st.phases[i].count) {
+      cerr << what << ": the " << parse_stats::phase_name(parse_phase(i)) << " phase was never entered." << endl;
+      ok = false;
+    }
+  }
+  if (sum > threads * (st.usec + PHASE_COUNT) or (sum + PHASE_COUNT < st.usec)) {
+    cerr << what << ": the phases add up to " << sum << " microseconds, not the " << st.usec << " taken." << endl;
+    ok = false;
+  }
+  
+  static const unsigned opened[] = { 1, 1, 2, 1 };
+  if (st.files.size() != fn.size()) {
+    cerr << what << ": " << st.files.size() << " files were read, not " << fn.size() << "." << endl;
+    return false;
+  }
+  unsigned long exclusive = 0;
+  for (size_t i = 0; i < fn.size(); ++i) {
+    const parse_stats::file_stats &f = st.files[i];
+    exclusive += f.exclusive_usec;
+    if (f.filename != fn[i])
+      cerr << what << ": file " << i << " read was `" << f.filename << "', not `" << fn[i] << "'." << endl, ok = false;
+    if (f.opened != opened[i])
+      cerr << what << ": " << f.filename << " was opened " << f.opened << " times, not " << opened[i] << "." << endl, ok = false;
+    if (f.inclusive_usec < f.exclusive_usec)
+      cerr << what << ": " << f.filename << " took less time with what it includes than without." << endl, ok = false;
+  }
+  if (exclusive > st.files[0].inclusive_usec + 2 * fn.size() or exclusive + 2 * fn.size() < st.files[0].inclusive_usec) {
+    cerr << what << ": the files took " << exclusive << " microseconds between them, not the "
+         << st.files[0].inclusive_usec << " taken with the main file open." << endl;
+    ok = false;
+  }
+  
+  unsigned long counted = 0;
+  for (map<string, unsigned long>::const_iterator it = st.expansions.begin(); it != st.expansions.end(); ++it)
+    counted += it->second;
+  map<string, unsigned long>::const_iterator twice = st.expansions.find("TWICE"), one = st.expansions.find("ONE");
+  if (counted != expansions) {
+    cerr << what << ": " << counted << " expansions were counted, not " << expansions << "." << endl;
+    ok = false;
+  }
+  if (twice == st.expansions.end() or twice->second != stats_uses) {
+    cerr << what << ": TWICE was counted " << (twice == st.expansions.end()? 0 : twice->second)
+         << " times, not " << stats_uses << "." << endl;
+    ok = false;
+  }
+  if (one == st.expansions.end() or one->second != stats_branches) {
+    cerr << what << ": ONE was counted " << (one == st.expansions.end()? 0 : one->second)
+         << " times, not " << stats_branches << "." << endl;
+    ok = false;
+  }
+  return ok;
+}
+
+bool bench_parse_stats() {
+  const temp_dir dir("stats");
+  if (dir.path.empty()) {
+    cerr << "Could not make a scratch directory for the corpus." << endl;
+    return false;
+  }
+  const vector<string> fn = write_corpus(dir.path);
+  
+  // What is expanded is counted apart from the parse, by the lexer alone
+  error_counter herr(1);
+  unsigned long expansions = 0;
+  {
+    macro_map macros = builtin->get_macros();
+    for (macro_iter it = macros.begin(); it != macros.end(); ++it)
+      macro_type::retain(it->second);
+    llreader f(fn[0].c_str());
+    lexer_cpp lex(f, macros, builtin->get_search_directories(), fn[0].c_str());
+    while (lex.get_token(&herr).type != TT_ENDOFCODE);
+    expansions = lex.expansion_count;
+    for (macro_iter it = macros.begin(); it != macros.end(); ++it)
+      macro_type::free(it->second);
+  }
+  
+  bool ok = true;
+  parse_stats serial, pipelined;
+  unsigned long wall = parse_corpus(fn[0], false, &serial, herr);
+  ok &= check_stats("Parsing on one thread", serial, wall, 1, fn, expansions);
+  serial.print(cout, 4);
+  wall = parse_corpus(fn[0], true, &pipelined, herr);
+  ok &= check_stats("Parsing while lexing on another thread", pipelined, wall, 2, fn, expansions);
+  for (int i = PHASE_OTHER + 1; i < PHASE_COUNT; ++i) // Each thread enters PHASE_OTHER once
+    if (pipelined.phases[i].count != serial.phases[i].count) {
+      cerr << "Lexing on another thread entered the " << parse_stats::phase_name(parse_phase(i)) << " phase "
+           << pipelined.phases[i].count << " times, not " << serial.phases[i].count << "." << endl;
+      ok = false;
+    }
+  
+  // Where stats are compiled in, they may be kept on any parse; they must not cost much. This corpus is
+  // nearly all short declarations and macro calls, each timed, so it costs more here than in most headers
+  unsigned long with = ~0ul, without = ~0ul;
+  for (int i = 0; i < 7; ++i) {
+    parse_stats st;
+    with = min(with, parse_corpus(fn[0], false, &st, herr));
+    without = min(without, parse_corpus(fn[0], false, NULL, herr));
+  }
+  cout << "Best of 7 parses: " << without << " microseconds without stats, " << with << " with ("
+       << (with > without? "+" : "") << (long)(100.0 * ((double)with - without) / without) << "%)." << endl;
+  if (with > without + without / 2) {
+    cerr << "Keeping stats slows parsing by more than half." << endl;
+    ok = false;
+  }
+  
+  if (herr.errors) {
+    cerr << herr.errors << " errors were reported parsing the corpus." << endl;
+    ok = false;
+  }
+  return ok;
+}
+
+#else
+
+bool bench_parse_stats() {
+  cout << "Parse stats are compiled out; nothing to check." << endl;
+  return true;
+}
+
+#endif
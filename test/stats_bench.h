@@ -0,0 +1,24 @@
+/* Copyright (C) 2012 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/** Parse a small generated corpus of a few headers, one included twice, with its timing and counts
+    kept in a \c parse_stats, on one thread and lexing on another. The phases of each parse must add
+    up to its time, every phase must have been entered, each file must have been read as often as
+    it was included, no file may take less time with what it includes than without, and each macro
+    must have been counted exactly as often as it was expanded. Both parses must count the same.
+    The time taken with and without stats kept is printed, with what was kept; keeping them must not
+    slow the parse by more than half.
+    @return Returns whether the stats kept were as they should be. **/
+bool bench_parse_stats();
@@ -0,0 +1,199 @@
+/* Copyright (C) 2012 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+using namespace std;
+#include "stress_gen.h"
+
+stress_params::stress_params() {
+  for (int i = 0; i < STRESS_AXIS_COUNT; ++i)
+    size[i] = 0;
+}
+
+static const char *const axis_names[STRESS_AXIS_COUNT] = {
+  "namespace_depth", "classes", "inheritance_depth", "template_parameters", "specializations",
+  "macros", "macro_nesting", "if_nesting", "include_fanout"
+};
+
+const char *stress_axis_name(stress_axis axis) {
+  return axis_names[axis];
+}
+
+string parse_stress_params(const vector<string> &args, stress_params &dest) {
+  for (size_t i = 0; i < args.size(); ++i) {
+    const size_t eq = args[i].find('=');
+    int axis = 0;
+    while (axis < STRESS_AXIS_COUNT and (eq == string::npos or args[i].compare(0, eq, axis_names[axis])))
+      ++axis;
+    if (axis == STRESS_AXIS_COUNT)
+      return "unknown axis in `" + args[i] + "'";
+    char *end;
+    const char *num = args[i].c_str() + eq + 1;
+    const unsigned long n = strtoul(num, &end, 10);
+    if (*end or end == num)
+      return "bad size in `" + args[i] + "'";
+    dest.size[axis] = n;
+  }
+  return "";
+}
+
+/* Each part below grows linearly in text with its size, and each name it uses is declared one step
+   away, save a few names at the end, reached through every step at once. Any cost growing faster
+   than the size is the parser's own. */
+
+/// Namespaces nested to the given depth, each naming the type of the one around it.
+static void write_namespaces(ostream &s, unsigned depth) {
+  for (unsigned i = 0; i < depth; ++i) {
+    s << "namespace ns_" << i << " {\n  struct type_" << i << " { int x; };\n";
+    if (i) s << "  typedef type_" << i - 1 << " outer_" << i << ";\n";
+  }
+  for (unsigned i = 0; i < depth; ++i)
+    s << "}";
+  if (!depth) return;
+  s << "\n";
+  for (unsigned i = 0; i < depth; ++i)
+    s << "ns_" << i << "::";
+  s << "type_" << depth - 1 << " innermost_type;\n\n";
+}
+
+/// Classes, each pointing to the last.
+static void write_classes(ostream &s, unsigned count) {
+  for (unsigned i = 0; i < count; ++i) {
+    s << "struct class_" << i << " {\n";
+    if (i) s << "  class_" << i - 1 << " *prev;\n";
+    s << "  int value;\n  int get(int index) const;\n};\n";
+  }
+  s << "\n";
+}
+
+/// Classes derived each from the last, each naming a type of its base. Nothing names a type of a more distant
+/// ancestor, as \c definition_class::look_up searches only the direct bases of a class.
+static void write_inheritance(ostream &s, unsigned depth) {
+  for (unsigned i = 0; i < depth; ++i) {
+    s << "struct derived_" << i;
+    if (i) s << ": derived_" << i - 1 << " {\n  typedef type_" << i - 1 << " type_" << i << ";\n";
+    else   s << " {\n  typedef int type_0;\n";
+    s << "  type_" << i << " member_" << i << ";\n};\n";
+  }
+  s << "\n";
+}
+
+/// One class template of the given number of parameters, instantiated with four lists of arguments.
+static void write_template_parameters(ostream &s, unsigned count) {
+  if (!count) return;
+  static const char *const types[] = { "int", "char", "long", "double" };
+  s << "template<";
+  for (unsigned i = 0; i < count; ++i)
+    s << (i? ", " : "") << "typename T" << i;
+  s << "> struct params {\n";
+  for (unsigned i = 0; i < count; ++i)
+    s << "  T" << i << " member_" << i << ";\n";
+  s << "};\n";
+  for (unsigned v = 0; v < 4; ++v) {
+    s << "params<";
+    for (unsigned i = 0; i < count; ++i)
+      s << (i? ", " : "") << types[(i + v) % 4];
+    s << "> instance_" << v << ";\n";
+  }
+  s << "\n";
+}
+
+/// One class template with the given number of explicit specializations, each instantiated.
+static void write_specializations(ostream &s, unsigned count) {
+  if (!count) return;
+  s << "template<int N> struct spec { int generic; };\n";
+  for (unsigned i = 0; i < count; ++i)
+    s << "template<> struct spec<" << i << "> { int special_" << i << "; };\n";
+  for (unsigned i = 0; i < count; ++i)
+    s << "spec<" << i << "> spec_use_" << i << ";\n";
+  s << "\n";
+}
+
+/// Macros, each expanded once.
+static void write_macros(ostream &s, unsigned count) {
+  for (unsigned i = 0; i < count; ++i)
+    s << "#define MACRO_" << i << " " << i << "\n";
+  for (unsigned i = 0; i < count; ++i)
+    s << "int macro_var_" << i << " = MACRO_" << i << ";\n";
+  s << "\n";
+}
+
+/// Macros each expanding to the last, the last of which is expanded in code and in an #if.
+static void write_macro_nesting(ostream &s, unsigned depth) {
+  if (!depth) return;
+  s << "#define NEST_0 1\n";
+  for (unsigned i = 1; i < depth; ++i)
+    s << "#define NEST_" << i << " NEST_" << i - 1 << "\n";
+  s << "int nested_macro = NEST_" << depth - 1 << ";\n"
+       "#if NEST_" << depth - 1 << "\nint nested_if;\n#endif\n\n";
+}
+
+/// Conditional blocks nested to the given depth, each with an #else which is skipped.
+static void write_if_nesting(ostream &s, unsigned depth) {
+  for (unsigned i = 0; i < depth; ++i)
+    s << "#if " << i << " < " << depth << "\nint if_var_" << i << ";\n";
+  for (unsigned i = depth; i--; )
+    s << "#else\nint if_never_" << i << ";\n#endif\n";
+  s << "\n";
+}
+
+/// Write a file, returning whether it was written.
+static bool write_file(const string &fn, const string &text, vector<string> &files) {
+  ofstream f(fn.c_str());
+  f << text;
+  files.push_back(fn);
+  return f.good();
+}
+
+size_t write_stress_headers(const stress_params &params, const string &dir, vector<string> &files) {
+  files.clear();
+  ostringstream s;
+  s << "// Stress header generated with";
+  for (int i = 0; i < STRESS_AXIS_COUNT; ++i)
+    s << " " << axis_names[i] << "=" << params.size[i];
+  s << "\n\n";
+  const unsigned fanout = params.size[STRESS_INCLUDE_FANOUT];
+  for (unsigned i = 0; i < fanout; ++i)
+    s << "#include \"fan_" << i << ".h\"\n";
+  write_namespaces(s, params.size[STRESS_NAMESPACE_DEPTH]);
+  write_classes(s, params.size[STRESS_CLASSES]);
+  write_inheritance(s, params.size[STRESS_INHERITANCE_DEPTH]);
+  write_template_parameters(s, params.size[STRESS_TEMPLATE_PARAMETERS]);
+  write_specializations(s, params.size[STRESS_SPECIALIZATIONS]);
+  write_macros(s, params.size[STRESS_MACROS]);
+  write_macro_nesting(s, params.size[STRESS_MACRO_NESTING]);
+  write_if_nesting(s, params.size[STRESS_IF_NESTING]);
+  
+  bool ok = write_file(dir + "/stress.cc", s.str(), files);
+  size_t bytes = s.str().length();
+  
+  // Each header of the fan includes one they share, which its guard keeps from being read twice
+  for (unsigned i = 0; i < fanout; ++i) {
+    ostringstream h, fn;
+    fn << dir << "/fan_" << i << ".h";
+    h << "#ifndef FAN_" << i << "_H\n#define FAN_" << i << "_H\n#include \"fan_common.h\"\n"
+         "struct fan_" << i << " { fan_common shared; int own; };\n#endif\n";
+    ok &= write_file(fn.str(), h.str(), files);
+    bytes += h.str().length();
+  }
+  if (fanout) {
+    const string common = "#ifndef FAN_COMMON_H\n#define FAN_COMMON_H\nstruct fan_common { int x; };\n#endif\n";
+    ok &= write_file(dir + "/fan_common.h", common, files);
+    bytes += common.length();
+  }
+  return ok? bytes : 0;
+}
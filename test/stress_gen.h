@@ -0,0 +1,54 @@
+/* Copyright (C) 2012 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string>
+#include <vector>
+
+/// The ways in which generated stress headers can be made larger.
+enum stress_axis {
+  STRESS_NAMESPACE_DEPTH,     ///< Namespaces nested within one another, named in full from outside them.
+  STRESS_CLASSES,             ///< Classes, each referring to the last.
+  STRESS_INHERITANCE_DEPTH,   ///< Classes each derived from the last, naming what the first declares.
+  STRESS_TEMPLATE_PARAMETERS, ///< Parameters of one class template, instantiated with several lists of arguments.
+  STRESS_SPECIALIZATIONS,     ///< Explicit specializations of one class template, each instantiated.
+  STRESS_MACROS,              ///< Macros, each expanded once.
+  STRESS_MACRO_NESTING,       ///< Macros each expanding to the last, the last of which is expanded.
+  STRESS_IF_NESTING,          ///< Conditional blocks nested within one another.
+  STRESS_INCLUDE_FANOUT,      ///< Headers included by the main file.
+  STRESS_AXIS_COUNT           ///< The number of axes.
+};
+
+/// The size of generated stress headers along each axis; zero leaves that part out.
+struct stress_params {
+  unsigned size[STRESS_AXIS_COUNT]; ///< The size along each \c stress_axis.
+  stress_params(); ///< Construct with every size zero.
+};
+
+/// Return the name of an axis, as accepted by \c parse_stress_params.
+const char *stress_axis_name(stress_axis axis);
+
+/** Read sizes given as "axis=size", such as "classes=1000", into the given parameters.
+    @param args  The sizes to read.
+    @param dest  The parameters to set. [in-out]
+    @return Returns the empty string, or a description of the first size which could not be read. **/
+std::string parse_stress_params(const std::vector<std::string> &args, stress_params &dest);
+
+/** Write a set of stress headers of the given sizes: a main file, and any headers it includes. The
+    code reads nothing from the system, and is correct C++ which the parser should read without error.
+    @param params  The size of the code along each axis.
+    @param dir     The directory to write to, which must exist.
+    @param files   Receives the name of each file written, the main file first. [out]
+    @return Returns the number of bytes written, or zero if a file could not be written. **/
+size_t write_stress_headers(const stress_params &params, const std::string &dir, std::vector<std::string> &files);
@@ -0,0 +1,271 @@
+/* Copyright (C) 2012 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <pthread.h>
+#include <unistd.h>
+using namespace std;
+#include <API/jdi.h>
+#include <API/snapshot.h>
+#include <General/atomics.h>
+#include <System/source_map.h>
+#include "bench_util.h"
+#include "thread_stress.h"
+
+using namespace jdi;
+
+/// Code touching macro definition and removal, #if evaluation, kludge macros, and anonymous names.
+/// Every other parse on each thread is pipelined, adding a lexer thread of its own.
+static const char stress_code[] =
+  "#define STRESS_SCALAR 1\n"
+  "#define STRESS_FUNC(a, b) ((a) + (b))\n"
+  "#undef SHARED_SCALAR\n"
+  "#define SHARED_SCALAR 2\n"
+  "#if STRESS_FUNC(STRESS_SCALAR, SHARED_SCALAR) == 3 && defined(SHARED_FUNC)\n"
+  "  typedef int stress_int;\n"
+  "#else\n"
+  "  typedef long stress_int;\n"
+  "#endif\n"
+  "namespace stress {\n"
+  "  enum { red, green, blue };\n"
+  "  enum color { cyan = SHARED_FUNC(STRESS_SCALAR), magenta, yellow };\n"
+  "  struct point { stress_int x, y; };\n"
+  "  union { int i; float f; } pun;\n"
+  "  class shape { public: point origin; int sides; __attribute__((unused)) unsigned long area; };\n"
+  "  template<typename T> struct box { T value; };\n"
+  "  extern __typeof__(red) current_color;\n"
+  "  const bool enabled = true;\n"
+  "}\n";
+
+struct stress_job {
+  context *base; ///< The context every iteration copies from; shared by all threads.
+  const string *expected; ///< The definitions a lone parse produces.
+  unsigned expected_errors; ///< The number of errors a lone parse reports.
+  unsigned iterations; ///< The number of contexts to parse into.
+  unsigned failures; ///< The number of parses which disagreed with the lone parse [out].
+};
+
+static string stress_parse(context &base, unsigned &errors, bool pipelined = false) {
+  context ct(base);
+  error_counter herr;
+  llreader src(string(stress_code), true);
+  if (pipelined)
+    ct.parse_C_stream_pipelined(src, "stress.cc", &herr);
+  else
+    ct.parse_C_stream(src, "stress.cc", &herr);
+  errors = herr.errors;
+  ostringstream defs;
+  ct.output_definitions(defs);
+  return defs.str();
+}
+
+static void *stress_thread(void *param) {
+  stress_job *job = (stress_job*)param;
+  for (unsigned i = 0; i < job->iterations; ++i) {
+    unsigned errors;
+    if (stress_parse(*job->base, errors, i & 1) != *job->expected or errors != job->expected_errors)
+      ++job->failures;
+  }
+  return NULL;
+}
+
+bool test_thread_stress(unsigned thread_count, unsigned iterations) {
+  if (!thread_count) {
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    thread_count = ncpu < 4? 4 : ncpu;
+  }
+
+  context base;
+  base.add_macro("SHARED_SCALAR", "1");
+  base.add_macro_func("SHARED_FUNC", "x", "((x) + 10)", false);
+
+  unsigned expected_errors;
+  const string expected = stress_parse(base, expected_errors);
+
+  vector<stress_job> jobs(thread_count);
+  vector<pthread_t> threads(thread_count);
+  for (unsigned i = 0; i < thread_count; ++i) {
+    stress_job j = { &base, &expected, expected_errors, iterations, 0 };
+    jobs[i] = j;
+  }
+
+  unsigned started = 0;
+  for (; started < thread_count; ++started)
+    if (pthread_create(&threads[started], NULL, stress_thread, &jobs[started])) {
+      cout << "Failed to start thread " << started << "." << endl;
+      break;
+    }
+  unsigned failures = 0;
+  for (unsigned i = 0; i < started; ++i) {
+    pthread_join(threads[i], NULL);
+    failures += jobs[i].failures;
+  }
+
+  cout << "Parsed " << started * iterations << " contexts on " << started << " threads; "
+       << failures << " disagreed with a lone parse." << endl;
+  return started == thread_count and !failures;
+}
+
+struct snapshot_job {
+  snapshot_publisher *pub; ///< The publisher every thread reads from.
+  volatile unsigned *done; ///< Nonzero once the writer has published its last version.
+  unsigned reads; ///< The number of snapshots this thread inspected [out].
+  unsigned failures; ///< The number of snapshots which were not self-consistent [out].
+};
+
+/// Check that the macro VERSION in each snapshot names a variable declared in the same snapshot.
+static void *snapshot_thread(void *param) {
+  snapshot_job *job = (snapshot_job*)param;
+  for (bool last = false; !last; ) {
+    last = quick::atomic_get(*job->done);
+    snapshot_publisher::reader snap(*job->pub);
+    if (!snap.get()) continue;
+    ++job->reads;
+    const macro_map &macros = snap->get_macros();
+    macro_iter_c mi = macros.find("VERSION");
+    if (mi == macros.end() or mi->second->argc != -1) { ++job->failures; continue; }
+    const string name = "version_" + ((const jdip::macro_scalar*)mi->second)->value;
+    const definition_scope *global = snap->get_global();
+    if (global->members.find(name) == global->members.end())
+      ++job->failures;
+  }
+  return NULL;
+}
+
+bool test_snapshot_stress(unsigned thread_count, unsigned versions) {
+  if (!thread_count) {
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    thread_count = ncpu < 4? 4 : ncpu;
+  }
+
+  context base;
+  snapshot_publisher pub;
+  volatile unsigned done = 0;
+  vector<snapshot_job> jobs(thread_count);
+  vector<pthread_t> threads(thread_count);
+  unsigned started = 0;
+  for (; started < thread_count; ++started) {
+    snapshot_job j = { &pub, &done, 0, 0 };
+    jobs[started] = j;
+    if (pthread_create(&threads[started], NULL, snapshot_thread, &jobs[started])) {
+      cout << "Failed to start thread " << started << "." << endl;
+      break;
+    }
+  }
+
+  unsigned errors = 0;
+  for (unsigned v = 0; v < versions; ++v) {
+    context *next = new context(base);
+    ostringstream code;
+    code << "#define VERSION " << v << "\n" "int version_" << v << ";\n";
+    error_counter herr;
+    llreader src(code.str(), true);
+    next->parse_C_stream(src, "version.cc", &herr);
+    errors += herr.errors;
+    pub.publish(next);
+  }
+  quick::atomic_set(done, 1u);
+
+  unsigned reads = 0, failures = 0;
+  for (unsigned i = 0; i < started; ++i) {
+    pthread_join(threads[i], NULL);
+    reads += jobs[i].reads;
+    failures += jobs[i].failures;
+  }
+
+  cout << "Published " << versions << " contexts to " << started << " threads, which read "
+       << reads << " snapshots; " << failures << " were inconsistent." << endl;
+  return started == thread_count and !failures and !errors;
+}
+
+/// The width of every line of the text resolved by \c test_source_stress; every third ends in CR LF.
+static const unsigned source_width = 32;
+
+/// Write lines of \c source_width characters into a string.
+static string source_text(unsigned lines) {
+  string res;
+  for (unsigned k = 0; k < lines; ++k)
+    res += (k % 3? string(source_width - 1, 'x') + "\n" : string(source_width - 2, 'x') + "\r\n");
+  return res;
+}
+
+/// Check that a location resolves to the line and position it has in the text of \c source_text.
+static bool source_placed(jdip::source_location start, unsigned off) {
+  const unsigned k = off / source_width, brk = k * source_width + source_width - (k % 3? 1 : 2);
+  const int line = k + 1 + (brk < off);
+  const int pos = off - (brk < off? brk : k? (k - 1) * source_width + source_width - ((k - 1) % 3? 1 : 2) : 0);
+  unsigned file; int l = -1, p = -1;
+  return jdip::resolve_source(start + off, file, l, p) and l == line and p == pos;
+}
+
+struct source_job {
+  jdip::source_location shared; ///< The start of the long file every thread resolves in.
+  unsigned size; ///< The length of that file.
+  unsigned lookups; ///< The number of locations to resolve.
+  unsigned seed; ///< Where this thread's choice of locations begins.
+  unsigned failures; ///< The number of locations which resolved wrongly [out].
+};
+
+/// Resolve locations throughout the long file, and open, resolve in and release short files between.
+static void *source_thread(void *param) {
+  source_job *job = (source_job*)param;
+  const string own = source_text(256);
+  unsigned r = job->seed;
+  for (unsigned i = 0; i < job->lookups; ++i) {
+    r = r * 1103515245 + 12345;
+    if (!source_placed(job->shared, (r >> 4) % job->size))
+      ++job->failures;
+    if (!(i % 64)) {
+      const jdip::source_location start = jdip::open_source("own.h", own.c_str(), own.length());
+      if (!start or !source_placed(start, own.length() - 1) or !source_placed(start, r % own.length()))
+        ++job->failures;
+      jdip::release_source(start);
+    }
+  }
+  return NULL;
+}
+
+bool test_source_stress(unsigned thread_count, unsigned lookups) {
+  if (!thread_count) {
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    thread_count = ncpu < 4? 4 : ncpu;
+  }
+
+  const string text = source_text(1 << 16);
+  const jdip::source_location shared = jdip::open_source("shared.h", text.c_str(), text.length());
+  vector<source_job> jobs(thread_count);
+  vector<pthread_t> threads(thread_count);
+  unsigned started = 0;
+  for (; started < thread_count; ++started) {
+    source_job j = { shared, (unsigned)text.length(), lookups, started * 7919, 0 };
+    jobs[started] = j;
+    if (pthread_create(&threads[started], NULL, source_thread, &jobs[started])) {
+      cout << "Failed to start thread " << started << "." << endl;
+      break;
+    }
+  }
+  unsigned failures = 0;
+  for (unsigned i = 0; i < started; ++i) {
+    pthread_join(threads[i], NULL);
+    failures += jobs[i].failures;
+  }
+  jdip::release_source(shared);
+
+  cout << "Resolved " << started * lookups << " locations on " << started << " threads; "
+       << failures << " were misplaced." << endl;
+  return shared and started == thread_count and !failures;
+}
@@ -0,0 +1,39 @@
+/* Copyright (C) 2012 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/** Parse the same code in many contexts on many threads at once, all copied from one shared
+    context, and check that every parse yields exactly what a lone parse yields. Half of the
+    parses are pipelined, with their lexers running on yet more threads. Meant to be
+    run under ThreadSanitizer (-fsanitize=thread) to catch state shared between contexts.
+    @param thread_count  The number of threads to spawn; zero means one per online processor.
+    @param iterations    The number of contexts each thread will create and parse into.
+    @return Returns whether all parses agreed. **/
+bool test_thread_stress(unsigned thread_count = 0, unsigned iterations = 64);
+
+/** Publish many versions of a context through a \c jdi::snapshot_publisher while many threads
+    read whichever is current, checking that each snapshot read is whole and none is freed
+    beneath its reader. Meant to be run under ThreadSanitizer or AddressSanitizer.
+    @param thread_count  The number of reader threads to spawn; zero means one per online processor.
+    @param versions      The number of contexts to parse and publish.
+    @return Returns whether every snapshot read was consistent. **/
+bool test_snapshot_stress(unsigned thread_count = 0, unsigned versions = 256);
+
+/** Resolve locations in one long file on many threads at once, while each thread also opens,
+    resolves in and releases files of its own, checking every line and position found. The
+    long file's lines are found only as far as each location needs, away from the registry lock.
+    @param thread_count  The number of threads to spawn; zero means one per online processor.
+    @param lookups       The number of locations each thread resolves.
+    @return Returns whether every location resolved where it should. **/
+bool test_source_stress(unsigned thread_count = 0, unsigned lookups = 4096);
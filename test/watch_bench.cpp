@@ -0,0 +1,149 @@
+/* Copyright (C) 2012 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cstdio>
+#include <sstream>
+#include <iostream>
+#include <unistd.h>
+using namespace std;
+#include <API/jdi.h>
+#include <API/watcher.h>
+#include "bench_util.h"
+#include "watch_bench.h"
+
+using namespace jdi;
+using jdip::microtime;
+
+/// Wait for a watcher to have published the given number of contexts, giving up after a few seconds.
+static bool wait_for(const context_watcher &w, unsigned long count) {
+  for (const unsigned long start = microtime(); w.publish_count() < count; usleep(1000))
+    if (microtime() - start > 5000000ul)
+      return false;
+  return true;
+}
+
+/// Check whether the context last published declares the given name globally.
+static bool published(snapshot_publisher &pub, const string &name) {
+  snapshot_publisher::reader snap(pub);
+  if (!snap.get()) return false;
+  const definition_scope *global = snap->get_global();
+  return global->members.find(name) != global->members.end();
+}
+
+/// Check that a change was published once, and holds the given name.
+static bool check_published(const char *step, context_watcher &w, snapshot_publisher &pub, unsigned long count, const string &name) {
+  bool ok = true;
+  if (!wait_for(w, count))
+    cout << "After " << step << ", nothing was published." << endl, ok = false;
+  else if (w.publish_count() != count)
+    cout << "After " << step << ", " << w.publish_count() - count + 1 << " contexts were published, not 1." << endl, ok = false;
+  if (ok and !published(pub, name))
+    cout << "After " << step << ", the published context lacks `" << name << "'." << endl, ok = false;
+  return ok;
+}
+
+bool bench_watch(const vector<string> &files) {
+  quiet_error_handler herr;
+  const temp_dir dir("watch");
+  if (dir.path.empty()) {
+    cout << "Could not make a scratch directory." << endl;
+    return false;
+  }
+  const string a = dir.file("a.cc"), shared = dir.file("shared.h"), two = dir.file("two.h"), other = dir.file("other.txt");
+  write_file(shared, "int shared_var;\n", 0);
+  write_file(a, "#include \"shared.h\"\nint a_var;\n", 0);
+  vector<string> all;
+  all.push_back(a);
+  
+  bool ok = true;
+  {
+    context *tracking = new context();
+    tracking->track_files(all, 1, &herr);
+    snapshot_publisher pub;
+    context_watcher w(tracking, pub, 50, 1, &herr);
+    if (w.start()) {
+      cout << "Could not start watching." << endl;
+      ok = false;
+    } else {
+      if (w.publish_count() != 1 or !published(pub, "a_var"))
+        cout << "Starting to watch did not publish the context." << endl, ok = false;
+      if (w.watch_count() != 1)
+        cout << "Watching " << w.watch_count() << " directories, not 1." << endl, ok = false;
+      
+      // Several writes in quick succession are one change
+      for (int i = 0; i < 5; ++i) {
+        ostringstream text;
+        text << "int shared_var;\n";
+        for (int j = 0; j <= i; ++j) text << "int burst_" << j << ";\n";
+        write_file(shared, text.str(), 10 + i);
+        usleep(5000);
+      }
+      ok &= check_published("a burst of writes", w, pub, 2, "burst_4");
+      if (w.reparse_count() != 1)
+        cout << "A burst of writes was parsed " << w.reparse_count() << " times, not once." << endl, ok = false;
+      
+      // Editors often save by writing a new file and renaming it over the old
+      write_file(shared + ".tmp", "int shared_var;\nint renamed;\n", 20);
+      rename((shared + ".tmp").c_str(), shared.c_str());
+      ok &= check_published("renaming over a header", w, pub, 3, "renamed");
+      
+      // A header newly included is watched from then on
+      write_file(two, "int two_var;\n", 30);
+      write_file(a, "#include \"shared.h\"\n#include \"two.h\"\nint a_var;\n", 30);
+      ok &= check_published("including another header", w, pub, 4, "two_var");
+      write_file(two, "int two_var;\nint two_more;\n", 40);
+      ok &= check_published("changing the new header", w, pub, 5, "two_more");
+      
+      const unsigned long events = w.event_count();
+      write_file(other, "Nobody reads this.\n", 50);
+      usleep(200000);
+      if (w.event_count() != events or w.publish_count() != 5)
+        cout << "Changing a file nobody read was acted upon." << endl, ok = false;
+      w.stop();
+    }
+  }
+  
+  if (!files.empty()) {
+    // Track the given files along with one scratch file, whose header is changed to time publishing
+    const string scratch = dir.file("scratch.cc"), header = dir.file("scratch.h");
+    write_file(header, "int scratch_0;\n", 0);
+    write_file(scratch, "#include \"scratch.h\"\n", 0);
+    vector<string> tracked = files;
+    tracked.push_back(scratch);
+    
+    context *tracking = new context();
+    tracking->track_files(tracked, 0, &herr);
+    include_graph g;
+    tracking->get_dependencies(g);
+    unsigned long start = microtime();
+    tracking->reparse_changed(0, &herr);
+    const unsigned long poll_usec = microtime() - start;
+    
+    snapshot_publisher pub;
+    context_watcher w(tracking, pub, 50, 0, &herr);
+    if (!w.start()) {
+      start = microtime();
+      write_file(header, "int scratch_0;\nint scratch_1;\n", 10);
+      if (!wait_for(w, 2) or !published(pub, "scratch_1"))
+        cout << "A change to a watched header was not published." << endl, ok = false;
+      const unsigned long publish_usec = microtime() - start;
+      cout << "Watching " << g.files.size() << " files in " << w.watch_count() << " directories; a change was published in "
+           << publish_usec << " microseconds, 50000 of them waiting for more changes. Polling every file instead takes "
+           << poll_usec << " microseconds each time." << endl;
+      w.stop();
+    } else cout << "Could not start watching the given files." << endl, ok = false;
+  }
+  return ok;
+}
@@ -0,0 +1,25 @@
+/* Copyright (C) 2012 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string>
+#include <vector>
+
+/** Watch a few small files written to a scratch directory, then change their headers in bursts,
+    by writing in place and by renaming over them, checking that each burst is published once with
+    what changed, and that changes to files nobody read are ignored. Then watch the given files,
+    reporting how many directories that takes, and how long a change takes to be published.
+    @param files  The files to track and watch; the #include directories of the \c builtin context are searched.
+    @return Returns whether every change was published as expected. **/
+bool bench_watch(const std::vector<std::string> &files);